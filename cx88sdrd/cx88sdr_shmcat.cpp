@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR shared-memory reader
+ *
+ * Attaches to one card of cx88sdrd and writes its stream to stdout, a
+ * drop-in for "cat /dev/swradioN" that does not cost the card a second
+ * copy_to_user(). Overruns are reported on stderr.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include "cx88sdr/shm.hpp"
+
+using namespace cx88sdr;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int)
+{
+	running = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -n CARD   card number as listed by the daemon (default: 0)\n"
+		"  -s PATH   control socket (default: %s)\n"
+		"  -b KB     block size in KB (default: 256)\n"
+		"  -l        list the cards and exit\n",
+		prog, shm_socket_default().c_str());
+}
+
+static bool write_all(const uint8_t *data, size_t len)
+{
+	while (len) {
+		ssize_t ret = write(STDOUT_FILENO, data, len);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		data += ret;
+		len -= static_cast<size_t>(ret);
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	std::string socket_path = shm_socket_default();
+	size_t block_size = 256 << 10;
+	unsigned int card = 0;
+	bool list = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:b:lh")) != -1) {
+		switch (opt) {
+		case 'n':
+			card = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 's':
+			socket_path = optarg;
+			break;
+		case 'b':
+			block_size = static_cast<size_t>(atoi(optarg)) << 10;
+			break;
+		case 'l':
+			list = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	try {
+		if (list) {
+			fputs(shm_command("list", socket_path).c_str(), stdout);
+			return 0;
+		}
+
+		shm_reader rd(card, block_size, socket_path);
+
+		while (running) {
+			block b;
+
+			if (!rd.next(b, 1000))
+				continue;
+			if (b.lost)
+				fprintf(stderr, "overrun at %llu, %llu bytes lost\n",
+					(unsigned long long)b.pos, (unsigned long long)b.lost);
+			if (!write_all(b.data, b.size))
+				break;
+			if (!rd.valid(b))
+				fprintf(stderr, "block at %llu overwritten while written out\n",
+					(unsigned long long)b.pos);
+		}
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,454 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR shared-memory fan-out daemon
+ *
+ * Reads every card once, from the mmap()ed DMA ring, into a POSIX
+ * shared-memory ring per card and publishes the write position to any
+ * number of local readers (cx88sdr::shm_reader). Readers attach and are
+ * accounted through a line based Unix-socket control channel:
+ *
+ *   list                  cards, rate, format and attached readers
+ *   attach CARD           allocate a reader slot: "shm NAME SLOT"
+ *   detach CARD SLOT      free a slot (also done when the connection closes)
+ *   stats CARD            write position, lost bytes, per-reader lag/overruns
+ *   set CARD KEY VALUE    rate, format, gain, gain2, gain_6db, dc_offset,
+ *                         input, irq_interval
+ *
+ * Every reply ends with "ok" or "err <message>".
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/device.hpp"
+#include "cx88sdr/shm.hpp"
+
+using namespace cx88sdr;
+
+struct card_ctx {
+	explicit card_ctx(const std::string &path) : dev(path) {}
+
+	device			dev;
+	std::unique_ptr<reader>	rd;
+	shm_ring		ring;
+	std::string		shm_name;
+	std::thread		thread;
+	int			cpu = -1;
+	std::atomic<uint64_t>	blocks{0};
+	std::atomic<uint64_t>	dropped{0};	/* Lapped by DMA while being copied */
+};
+
+struct client {
+	int			fd;
+	std::string		in;
+	/* (card, slot) pairs held by this connection */
+	std::vector<std::pair<size_t, unsigned int>> slots;
+};
+
+static std::vector<std::unique_ptr<card_ctx>> cards;
+static std::atomic<bool> running{true};
+
+static void on_signal(int)
+{
+	running = false;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -d DEV    capture device, repeatable (default: all cx88_sdr cards)\n"
+		"  -s PATH   control socket (default: %s)\n"
+		"  -r MB     shared-memory ring size per card in MB (default: 64)\n"
+		"  -b KB     capture block size in KB (default: 256)\n"
+		"  -c CPUS   comma separated capture CPU per card\n",
+		prog, shm_socket_default().c_str());
+}
+
+static const char *format_name(format f)
+{
+	return (f == format::ru16le) ? "ru16le" : "ru8";
+}
+
+/* One copy per card, whatever the number of readers */
+static void capture(card_ctx &c)
+{
+	shm_header *h = c.ring.header();
+	uint64_t size = c.ring.size();
+
+	while (running.load(std::memory_order_relaxed)) {
+		uint64_t fill = h->fill.load(std::memory_order_relaxed);
+		block b;
+
+		if (!c.rd->next(b, 100))
+			continue;
+
+		/* A gap on the card invalidates everything before it */
+		if (b.pos != h->write.load(std::memory_order_relaxed))
+			fill = std::max(fill, b.pos + size);
+		fill = std::max(fill, b.pos + b.size);
+		h->fill.store(fill, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		memcpy(c.ring.data() + (b.pos % size), b.data, b.size);
+		if (b.lost)
+			h->lost.fetch_add(b.lost, std::memory_order_relaxed);
+		c.blocks.fetch_add(1, std::memory_order_relaxed);
+		/*
+		 * Lapped by DMA during the copy: never published, so the next
+		 * block comes in as a gap and readers skip over this one.
+		 */
+		if (!c.rd->valid(b)) {
+			c.dropped.fetch_add(1, std::memory_order_relaxed);
+			h->lost.fetch_add(b.size, std::memory_order_relaxed);
+			continue;
+		}
+		c.ring.publish(b.pos + b.size);
+	}
+}
+
+static bool card_arg(std::istringstream &args, size_t &nr)
+{
+	return (args >> nr) && nr < cards.size();
+}
+
+static void cmd_list(std::ostringstream &out)
+{
+	for (size_t i = 0; i < cards.size(); i++) {
+		card_ctx &c = *cards[i];
+		shm_header *h = c.ring.header();
+		unsigned int readers = 0;
+
+		for (unsigned int j = 0; j < shm_max_readers; j++)
+			readers += c.ring.slots()[j].used.load(std::memory_order_relaxed);
+		out << "card " << i << " " << c.dev.path() << " " << c.dev.bus_info()
+		    << " rate " << h->sample_rate.load() << " format "
+		    << format_name(static_cast<format>(h->format.load()))
+		    << " readers " << readers << "\n";
+	}
+}
+
+static void cmd_attach(client &cl, size_t nr, std::ostringstream &out)
+{
+	card_ctx &c = *cards[nr];
+	shm_header *h = c.ring.header();
+	struct ucred cred = {};
+	socklen_t len = sizeof(cred);
+
+	for (unsigned int i = 0; i < shm_max_readers; i++) {
+		shm_slot &s = c.ring.slots()[i];
+
+		if (s.used.load(std::memory_order_relaxed))
+			continue;
+		getsockopt(cl.fd, SOL_SOCKET, SO_PEERCRED, &cred, &len);
+		s.pid = cred.pid;
+		s.overruns.store(0, std::memory_order_relaxed);
+		s.lost.store(0, std::memory_order_relaxed);
+		s.read.store(h->write.load(std::memory_order_acquire), std::memory_order_relaxed);
+		s.used.store(1, std::memory_order_release);
+		cl.slots.emplace_back(nr, i);
+		out << "shm " << c.shm_name << " " << i << "\n";
+		return;
+	}
+	throw std::runtime_error("no free reader slot");
+}
+
+static void slot_free(size_t nr, unsigned int slot)
+{
+	cards[nr]->ring.slots()[slot].used.store(0, std::memory_order_release);
+}
+
+static void cmd_stats(size_t nr, std::ostringstream &out)
+{
+	card_ctx &c = *cards[nr];
+	shm_header *h = c.ring.header();
+	uint64_t write = h->write.load(std::memory_order_acquire);
+
+	out << "card " << nr << " write " << write << " lost " << h->lost.load()
+	    << " blocks " << c.blocks.load() << " dropped " << c.dropped.load() << "\n";
+	for (unsigned int i = 0; i < shm_max_readers; i++) {
+		shm_slot &s = c.ring.slots()[i];
+		uint64_t read = s.read.load(std::memory_order_acquire);
+
+		if (!s.used.load(std::memory_order_acquire))
+			continue;
+		out << "reader " << i << " pid " << s.pid << " lag " << (write > read ? write - read : 0)
+		    << " overruns " << s.overruns.load() << " lost " << s.lost.load() << "\n";
+	}
+}
+
+static void cmd_set(card_ctx &c, const std::string &key, const std::string &val)
+{
+	shm_header *h = c.ring.header();
+	int v = atoi(val.c_str());
+
+	if (key == "rate")
+		c.dev.set_sample_rate(static_cast<uint32_t>(strtoul(val.c_str(), nullptr, 0)));
+	else if (key == "format")
+		c.dev.set_format((val == "ru16le") ? format::ru16le : format::ru8);
+	else if (key == "gain")
+		c.dev.set_gain(v);
+	else if (key == "gain2")
+		c.dev.set_gain2(v);
+	else if (key == "gain_6db")
+		c.dev.set_gain_6db(v);
+	else if (key == "dc_offset")
+		c.dev.set_dc_offset(v);
+	else if (key == "input")
+		c.dev.set_input(v);
+	else if (key == "irq_interval")
+		c.dev.set_irq_interval(v);
+	else
+		throw std::runtime_error("unknown key " + key);
+
+	h->sample_rate.store(c.dev.sample_rate());
+	h->format.store(static_cast<uint32_t>(c.dev.get_format()));
+}
+
+static std::string command(client &cl, const std::string &line)
+{
+	std::istringstream args(line);
+	std::ostringstream out;
+	std::string cmd;
+	size_t nr;
+
+	try {
+		args >> cmd;
+		if (cmd == "list") {
+			cmd_list(out);
+		} else if (cmd == "attach" || cmd == "detach" || cmd == "stats" || cmd == "set") {
+			if (!card_arg(args, nr))
+				throw std::runtime_error("no such card");
+			if (cmd == "attach") {
+				cmd_attach(cl, nr, out);
+			} else if (cmd == "detach") {
+				unsigned int slot;
+				auto it = cl.slots.end();
+
+				if (args >> slot)
+					it = std::find(cl.slots.begin(), cl.slots.end(),
+						       std::make_pair(nr, slot));
+				if (it == cl.slots.end())
+					throw std::runtime_error("slot not held");
+				slot_free(nr, slot);
+				cl.slots.erase(it);
+			} else if (cmd == "stats") {
+				cmd_stats(nr, out);
+			} else {
+				std::string key, val;
+
+				if (!(args >> key >> val))
+					throw std::runtime_error("usage: set CARD KEY VALUE");
+				cmd_set(*cards[nr], key, val);
+			}
+		} else {
+			throw std::runtime_error("unknown command " + cmd);
+		}
+	} catch (const std::exception &e) {
+		return out.str() + "err " + e.what() + "\n";
+	}
+	return out.str() + "ok\n";
+}
+
+static int control_listen(const std::string &path)
+{
+	struct sockaddr_un addr = {};
+	int fd;
+
+	if (path.size() >= sizeof(addr.sun_path))
+		throw std::runtime_error("socket path too long");
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), "socket");
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+	unlink(path.c_str());
+	if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+	    listen(fd, 16) < 0) {
+		std::system_error e(errno, std::generic_category(), "bind " + path);
+
+		close(fd);
+		throw e;
+	}
+	chmod(path.c_str(), 0660);
+	return fd;
+}
+
+static void control_loop(int lfd)
+{
+	std::map<int, client> clients;
+
+	while (running.load(std::memory_order_relaxed)) {
+		std::vector<struct pollfd> pfds = { { lfd, POLLIN, 0 } };
+
+		for (auto &cl : clients)
+			pfds.push_back({ cl.first, POLLIN, 0 });
+		if (poll(pfds.data(), pfds.size(), 200) <= 0)
+			continue;
+
+		if (pfds[0].revents & POLLIN) {
+			int fd = accept4(lfd, nullptr, nullptr, SOCK_CLOEXEC);
+
+			if (fd >= 0)
+				clients[fd] = client{ fd, {}, {} };
+		}
+
+		for (size_t i = 1; i < pfds.size(); i++) {
+			client &cl = clients[pfds[i].fd];
+			char buf[1024];
+			ssize_t ret;
+			size_t eol;
+
+			if (!pfds[i].revents)
+				continue;
+			ret = recv(cl.fd, buf, sizeof(buf), 0);
+			if (ret <= 0 || cl.in.size() > 4096) {
+				/* Slots live as long as the connection */
+				for (auto &s : cl.slots)
+					slot_free(s.first, s.second);
+				close(cl.fd);
+				clients.erase(pfds[i].fd);
+				continue;
+			}
+			cl.in.append(buf, static_cast<size_t>(ret));
+			while ((eol = cl.in.find('\n')) != std::string::npos) {
+				std::string reply = command(cl, cl.in.substr(0, eol));
+
+				cl.in.erase(0, eol + 1);
+				send(cl.fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+			}
+		}
+	}
+
+	for (auto &cl : clients)
+		close(cl.first);
+}
+
+int main(int argc, char **argv)
+{
+	std::string socket_path;
+	std::vector<std::string> paths;
+	std::vector<int> cpus;
+	size_t ring_size = 64 << 20, block_size = 256 << 10;
+	int opt, lfd;
+
+	while ((opt = getopt(argc, argv, "d:s:r:b:c:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			paths.push_back(optarg);
+			break;
+		case 's':
+			socket_path = optarg;
+			break;
+		case 'r':
+			ring_size = static_cast<size_t>(atoi(optarg)) << 20;
+			break;
+		case 'b':
+			block_size = static_cast<size_t>(atoi(optarg)) << 10;
+			break;
+		case 'c': {
+			std::stringstream ss(optarg);
+			std::string cpu;
+
+			while (std::getline(ss, cpu, ','))
+				cpus.push_back(atoi(cpu.c_str()));
+			break;
+		}
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	/* As root, in the directory readers of every user look in first */
+	if (socket_path.empty()) {
+		if (geteuid() == 0)
+			mkdir(shm_socket_dir, 0755);
+		socket_path = shm_socket_default();
+	}
+
+	if (paths.empty())
+		paths = device::enumerate();
+	if (paths.empty()) {
+		fprintf(stderr, "no cx88_sdr devices found\n");
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	try {
+		for (size_t i = 0; i < paths.size(); i++) {
+			auto c = std::make_unique<card_ctx>(paths[i]);
+			std::vector<int> local = c->dev.local_cpus();
+			shm_header *h;
+
+			c->rd = std::make_unique<reader>(c->dev, block_size);
+			c->shm_name = "/cx88sdr-" + paths[i].substr(paths[i].rfind('/') + 1);
+			c->ring = shm_ring::create(c->shm_name, std::max(ring_size, 4 * c->rd->block_size()));
+			h = c->ring.header();
+			h->sample_rate.store(c->dev.sample_rate());
+			h->format.store(static_cast<uint32_t>(c->dev.get_format()));
+			h->write.store(c->rd->position());
+			h->fill.store(c->rd->position());
+
+			if (i < cpus.size() && cpus[i] >= 0)
+				c->cpu = cpus[i];
+			else if (!local.empty())
+				c->cpu = local[i % local.size()];
+			cards.push_back(std::move(c));
+		}
+
+		lfd = control_listen(socket_path);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	for (auto &c : cards) {
+		c->thread = std::thread(capture, std::ref(*c));
+		if (c->cpu >= 0) {
+			cpu_set_t set;
+
+			CPU_ZERO(&set);
+			CPU_SET(c->cpu, &set);
+			pthread_setaffinity_np(c->thread.native_handle(), sizeof(set), &set);
+		}
+		fprintf(stderr, "%s: %s, %s reader, %zu MB ring\n", c->dev.path().c_str(),
+			c->shm_name.c_str(),
+			(c->rd->active_mode() == reader::mode::mmap) ? "mmap" : "read",
+			c->ring.size() >> 20);
+	}
+
+	control_loop(lfd);
+
+	for (auto &c : cards)
+		c->thread.join();
+	close(lfd);
+	unlink(socket_path.c_str());
+	cards.clear();
+	return 0;
+}
@@ -0,0 +1,5 @@
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# GNU Radio source block for the CX2388x SDR driver
+
+from .cx88sdr_python import *
@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR GNU Radio source throughput benchmark
+ *
+ * Runs the source block into a null sink, both pinned to one CPU, and
+ * reports the rate it delivered, the CPU time it took and the gaps. A
+ * live card shows whether one core keeps up with the sample rate; a
+ * replay card fed by cx88sdr_replay -x 0 shows the most the block does.
+ */
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/resource.h>
+
+#include <gnuradio/blocks/null_sink.h>
+#include <gnuradio/top_block.h>
+
+#include "cx88sdr/device.hpp"
+#include "cx88sdr_source.h"
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int)
+{
+	running = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -d DEV    capture device (default: /dev/swradio0)\n"
+		"  -o TYPE   complex, float or raw (default: complex)\n"
+		"  -f FMT    ru8 or ru16le (default: ru8)\n"
+		"  -r RATE   sample rate in Hz (default: 28800000)\n"
+		"  -b KB     block size (default: 256)\n"
+		"  -c CPU    CPU to pin the flowgraph to (default: first CPU local to the card)\n"
+		"  -s SECS   run time (default: 10)\n",
+		prog);
+}
+
+static double cpu_seconds()
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+	       (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	std::string path = "/dev/swradio0";
+	int output = gr::cx88sdr::source::COMPLEX, block_kb = 256, cpu = -1, opt;
+	double rate = 28800000, secs = 10;
+	bool ru16 = false;
+
+	while ((opt = getopt(argc, argv, "d:o:f:r:b:c:s:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			path = optarg;
+			break;
+		case 'o':
+			output = !strcmp(optarg, "raw") ? gr::cx88sdr::source::RAW :
+				 !strcmp(optarg, "float") ? gr::cx88sdr::source::FLOAT :
+				 gr::cx88sdr::source::COMPLEX;
+			break;
+		case 'f':
+			ru16 = !strcmp(optarg, "ru16le");
+			break;
+		case 'r':
+			rate = atof(optarg);
+			break;
+		case 'b':
+			block_kb = atoi(optarg);
+			break;
+		case 'c':
+			cpu = atoi(optarg);
+			break;
+		case 's':
+			secs = atof(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc || !(secs > 0)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	try {
+		if (cpu < 0) {
+			std::vector<int> local = cx88sdr::device(path).local_cpus();
+
+			cpu = local.empty() ? 0 : local[0];
+		}
+
+		auto tb = gr::make_top_block("cx88sdr_grbench");
+		auto src = gr::cx88sdr::source::make(path, output, ru16, rate, block_kb);
+		auto sink = gr::blocks::null_sink::make(src->output_signature()->sizeof_stream_item(0));
+
+		src->set_processor_affinity({ cpu });
+		sink->set_processor_affinity({ cpu });
+		tb->connect(src, 0, sink, 0);
+
+		double achieved = src->sample_rate();
+
+		fprintf(stderr, "%s: %.3f Hz, %s, %d KB blocks, CPU %d, %.1f s\n", path.c_str(),
+			achieved, (output == gr::cx88sdr::source::RAW) ? "raw" :
+			(output == gr::cx88sdr::source::FLOAT) ? "float" : "complex",
+			block_kb, cpu, secs);
+
+		auto t0 = std::chrono::steady_clock::now();
+		double cpu0 = cpu_seconds();
+
+		tb->start();
+		while (running && std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - t0).count() < secs)
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		tb->stop();
+		tb->wait();
+
+		double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		double used = cpu_seconds() - cpu0;
+		double items = static_cast<double>(sink->nitems_read(0));
+
+		fprintf(stderr, "%.0f samples, %.3f MS/s, %.1f%% of one core, %.1f MS/s per core, "
+			"%llu gaps losing %llu samples, %llu FIFO overflows\n",
+			items, items / wall / 1e6, 100 * used / wall,
+			(used > 0) ? items / used / 1e6 : 0.0,
+			(unsigned long long)src->overruns(), (unsigned long long)src->lost(),
+			(unsigned long long)src->fifo_overflows());
+		if (used > 0 && items / used < achieved)
+			fprintf(stderr, "warning: one core converts less than the sample rate\n");
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * GNU Radio source block for the CX2388x SDR driver, Python bindings
+ */
+
+#include <pybind11/pybind11.h>
+
+#include "cx88sdr_source.h"
+
+namespace py = pybind11;
+
+PYBIND11_MODULE(cx88sdr_python, m)
+{
+	using gr::cx88sdr::source;
+
+	/* The gr.sync_block base must be registered first */
+	py::module::import("gnuradio.gr");
+
+	py::class_<source, gr::sync_block, gr::block, gr::basic_block,
+		   std::shared_ptr<source>> cls(m, "source");
+
+	cls.def(py::init(&source::make), py::arg("path") = "/dev/swradio0",
+		py::arg("output") = static_cast<int>(source::COMPLEX), py::arg("ru16") = false,
+		py::arg("rate") = 28800000.0, py::arg("block_kb") = 256)
+		.def("set_sample_rate", &source::set_sample_rate, py::arg("rate"))
+		.def("sample_rate", &source::sample_rate)
+		.def("set_gain", &source::set_gain, py::arg("val"))
+		.def("set_gain_6db", &source::set_gain_6db, py::arg("on"))
+		.def("set_gain2", &source::set_gain2, py::arg("val"))
+		.def("set_dc_offset", &source::set_dc_offset, py::arg("val"))
+		.def("set_input", &source::set_input, py::arg("val"))
+		.def("set_irq_interval", &source::set_irq_interval, py::arg("pages"))
+		.def("set_holdoff", &source::set_holdoff, py::arg("us"))
+		.def("overruns", &source::overruns)
+		.def("lost", &source::lost)
+		.def("fifo_overflows", &source::fifo_overflows);
+
+	cls.attr("COMPLEX") = static_cast<int>(source::COMPLEX);
+	cls.attr("FLOAT") = static_cast<int>(source::FLOAT);
+	cls.attr("RAW") = static_cast<int>(source::RAW);
+}
@@ -0,0 +1,277 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * GNU Radio source block for the CX2388x SDR driver
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <vector>
+
+#include <gnuradio/io_signature.h>
+#include <gnuradio/logger.h>
+#include <pmt/pmt.h>
+
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/convert.hpp"
+#include "cx88sdr/device.hpp"
+#include "cx88sdr_source.h"
+
+namespace gr {
+namespace cx88sdr {
+
+namespace cx = ::cx88sdr;
+
+static int64_t realtime_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int item_size(int output, bool ru16)
+{
+	if (output == source::COMPLEX)
+		return sizeof(gr_complex);
+	if (output == source::FLOAT)
+		return sizeof(float);
+	return ru16 ? 2 : 1;
+}
+
+class source_impl : public source {
+public:
+	source_impl(const std::string &path, int output, bool ru16, double rate, int block_kb);
+
+	bool start() override;
+	bool stop() override;
+	int work(int noutput_items, gr_vector_const_void_star &input_items,
+		 gr_vector_void_star &output_items) override;
+
+	void set_sample_rate(double rate) override
+	{
+		dev_.set_sample_rate(static_cast<uint32_t>(rate));
+	}
+	double sample_rate() const override { return dev_.achieved_rate(); }
+
+	void set_gain(int val) override { dev_.set_gain(val); }
+	void set_gain_6db(bool on) override { dev_.set_gain_6db(on); }
+	void set_gain2(int val) override { dev_.set_gain2(val); }
+	void set_dc_offset(int val) override { dev_.set_dc_offset(val); }
+	void set_input(int val) override { dev_.set_input(val); }
+	void set_irq_interval(int pages) override { dev_.set_irq_interval(pages); }
+	void set_holdoff(int us) override { dev_.set_holdoff(us); }
+
+	uint64_t overruns() const override { return overruns_; }
+	uint64_t lost() const override { return lost_; }
+	uint64_t fifo_overflows() const override { return fifo_overflows_; }
+
+private:
+	/* A tag waiting for the stream to get to its sample, rate > 0 for a rate change */
+	struct pending {
+		uint64_t	sample;
+		pmt::pmt_t	key;
+		pmt::pmt_t	value;
+		double		rate;
+	};
+
+	void poll_events();
+	void queue(const pending &p);
+	int64_t time_of(uint64_t sample) const;
+	void tag_time(uint64_t item, uint64_t sample);
+	void convert(const uint8_t *in, void *out, size_t n);
+
+	cx::device			dev_;
+	std::unique_ptr<cx::reader>	rd_;
+	cx::block			blk_;
+	int				output_;
+	size_t				ss_, block_size_, left_ = 0;
+	/* time_of(): a stream sample, its CLOCK_REALTIME and the rate since */
+	uint64_t			anchor_ = 0;
+	int64_t				anchor_ns_ = 0;
+	double				rate_ = 0;
+	bool				retime_ = true;
+	std::vector<pending>		pending_;
+	std::atomic<uint64_t>		overruns_{ 0 }, lost_{ 0 }, fifo_overflows_{ 0 };
+
+	const pmt::pmt_t		rx_time_ = pmt::string_to_symbol("rx_time");
+	const pmt::pmt_t		rx_rate_ = pmt::string_to_symbol("rx_rate");
+	const pmt::pmt_t		overrun_ = pmt::string_to_symbol("overrun");
+	const pmt::pmt_t		fifo_overflow_ = pmt::string_to_symbol("fifo_overflow");
+};
+
+source::sptr source::make(const std::string &path, int output, bool ru16, double rate,
+			  int block_kb)
+{
+	return gnuradio::make_block_sptr<source_impl>(path, output, ru16, rate, block_kb);
+}
+
+source_impl::source_impl(const std::string &path, int output, bool ru16, double rate,
+			 int block_kb)
+	: gr::sync_block("cx88sdr_source", gr::io_signature::make(0, 0, 0),
+			 gr::io_signature::make(1, 1, item_size(output, ru16))),
+	  dev_(path), output_(output)
+{
+	dev_.set_format(ru16 ? cx::format::ru16le : cx::format::ru8);
+	dev_.set_sample_rate(static_cast<uint32_t>(rate));
+	ss_ = dev_.sample_size();
+	block_size_ = static_cast<size_t>(std::max(4, block_kb)) << 10;
+}
+
+bool source_impl::start()
+{
+	/* Before the reader starts, so no change in the first block is missed */
+	dev_.subscribe_config();
+	dev_.subscribe_faults();
+	rd_ = std::make_unique<cx::reader>(dev_, block_size_);
+	if (rd_->active_mode() != cx::reader::mode::mmap)
+		GR_LOG_WARN(d_logger, "mmap unavailable, using read()");
+
+	blk_ = cx::block();
+	left_ = 0;
+	rate_ = dev_.achieved_rate();
+	anchor_ = rd_->position() / ss_;
+	anchor_ns_ = realtime_ns() - static_cast<int64_t>(
+		(dev_.pos().write - rd_->position()) * 1e9 / (rate_ * ss_));
+	retime_ = true;
+	pending_.clear();
+	return true;
+}
+
+bool source_impl::stop()
+{
+	rd_.reset();
+	return true;
+}
+
+void source_impl::queue(const pending &p)
+{
+	auto it = std::upper_bound(pending_.begin(), pending_.end(), p,
+				   [](const pending &a, const pending &b) {
+					   return a.sample < b.sample;
+				   });
+
+	pending_.insert(it, p);
+}
+
+/* Changes and faults up to the end of the block just fetched are queued by now */
+void source_impl::poll_events()
+{
+	cx::config_change c;
+	cx::fault_event f;
+
+	while (dev_.next_config(c, 0)) {
+		if (c.id == CX88SDR_CONFIG_RATE) {
+			double rate = cx::device::achieved_rate(static_cast<uint32_t>(c.value),
+								dev_.get_format());
+
+			queue({ c.pos / ss_, rx_rate_, pmt::from_double(rate), rate });
+		} else if (c.id == CX88SDR_CONFIG_FORMAT) {
+			GR_LOG_WARN(d_logger, "format changed under the block, output is garbled");
+		}
+	}
+	while (dev_.next_fault(f, 0)) {
+		if (f.faults & CX88SDR_FAULT_OVERFLOW)
+			fifo_overflows_++;
+		queue({ f.pos / ss_, fifo_overflow_, pmt::from_long(f.faults), 0 });
+	}
+}
+
+/* Stream positions count lost samples too, so times stay right across gaps */
+int64_t source_impl::time_of(uint64_t sample) const
+{
+	double d = static_cast<double>(static_cast<int64_t>(sample - anchor_));
+
+	return anchor_ns_ + static_cast<int64_t>(d * 1e9 / rate_);
+}
+
+void source_impl::tag_time(uint64_t item, uint64_t sample)
+{
+	int64_t ns = time_of(sample);
+
+	add_item_tag(0, item, rx_time_,
+		     pmt::make_tuple(pmt::from_uint64(static_cast<uint64_t>(ns / 1000000000)),
+				     pmt::from_double((ns % 1000000000) / 1e9)));
+	add_item_tag(0, item, rx_rate_, pmt::from_double(rate_));
+}
+
+void source_impl::convert(const uint8_t *in, void *out, size_t n)
+{
+	namespace cv = cx::convert;
+	auto in16 = reinterpret_cast<const uint16_t *>(in);
+
+	if (output_ == COMPLEX) {
+		if (ss_ == 2)
+			cv::ru16_to_cf32(in16, static_cast<float *>(out), n);
+		else
+			cv::ru8_to_cf32(in, static_cast<float *>(out), n);
+	} else if (output_ == FLOAT) {
+		if (ss_ == 2)
+			cv::ru16_to_f32(in16, static_cast<float *>(out), n);
+		else
+			cv::ru8_to_f32(in, static_cast<float *>(out), n);
+	} else {
+		memcpy(out, in, n * ss_);
+	}
+}
+
+int source_impl::work(int noutput_items, gr_vector_const_void_star &,
+		      gr_vector_void_star &output_items)
+{
+	uint8_t *out = static_cast<uint8_t *>(output_items[0]);
+	size_t osize = output_signature()->sizeof_stream_item(0);
+	size_t produced = 0, want = static_cast<size_t>(noutput_items);
+
+	while (produced < want) {
+		uint64_t item = nitems_written(0) + produced;
+
+		if (!left_) {
+			/* The previous block may have been lapped while it was converted */
+			bool torn = blk_.size && !rd_->valid(blk_);
+
+			/* Short timeouts, the scheduler calls again and can stop in between */
+			if (!rd_->next(blk_, 100))
+				break;
+			poll_events();
+			if (blk_.lost || torn) {
+				overruns_++;
+				lost_ += blk_.lost / ss_;
+				add_item_tag(0, item, overrun_, pmt::from_uint64(blk_.lost / ss_));
+				retime_ = true;
+			}
+			left_ = blk_.size / ss_;
+		}
+
+		uint64_t sample = (blk_.pos + blk_.size) / ss_ - left_;
+		size_t n = std::min(left_, want - produced);
+
+		if (retime_) {
+			tag_time(item, sample);
+			retime_ = false;
+		}
+		while (!pending_.empty() && pending_.front().sample < sample + n) {
+			const pending &p = pending_.front();
+			uint64_t at = item + ((p.sample > sample) ? p.sample - sample : 0);
+
+			if (p.rate > 0) {
+				anchor_ns_ = time_of(p.sample);
+				anchor_ = p.sample;
+				rate_ = p.rate;
+				tag_time(at, p.sample);
+			} else {
+				add_item_tag(0, at, p.key, p.value);
+			}
+			pending_.erase(pending_.begin());
+		}
+
+		convert(blk_.data + blk_.size - left_ * ss_, out + produced * osize, n);
+		left_ -= n;
+		produced += n;
+	}
+	return static_cast<int>(produced);
+}
+
+}
+}
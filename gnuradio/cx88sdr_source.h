@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * GNU Radio source block for the CX2388x SDR driver
+ *
+ * Converts straight out of the mmap()ed DMA ring into the output buffer,
+ * with one pass per sample instead of the file source, type conversion and
+ * offset blocks of the flowgraphs in grc/. Stream tags:
+ *
+ *   rx_time        (uint64 seconds, double fraction) CLOCK_REALTIME of the
+ *                  item, on the first item, after a gap and at a rate change
+ *   rx_rate        achieved sample rate in Hz, double, with every rx_time
+ *   overrun        uint64 samples lost in the ring before the item, 0 when
+ *                  the samples before it were overwritten while converted
+ *   fifo_overflow  uint32 CX88SDR_FAULT_* bits, the card dropped samples
+ *                  close before the item
+ */
+
+#ifndef CX88SDR_GR_SOURCE_H
+#define CX88SDR_GR_SOURCE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+namespace cx88sdr {
+
+class source : virtual public gr::sync_block {
+public:
+	typedef std::shared_ptr<source> sptr;
+
+	/* COMPLEX: I = sample, Q = 0; FLOAT: real; RAW: the card's bytes, byte or short */
+	enum output_type { COMPLEX = 0, FLOAT = 1, RAW = 2 };
+
+	/* ru16 selects RU16LE, fixed for the life of the block */
+	static sptr make(const std::string &path = "/dev/swradio0", int output = COMPLEX,
+			 bool ru16 = false, double rate = 28800000, int block_kb = 256);
+
+	virtual void set_sample_rate(double rate) = 0;
+	virtual double sample_rate() const = 0;
+
+	/* Driver controls, ranges as in cx88sdr::device */
+	virtual void set_gain(int val) = 0;
+	virtual void set_gain_6db(bool on) = 0;
+	virtual void set_gain2(int val) = 0;
+	virtual void set_dc_offset(int val) = 0;
+	virtual void set_input(int val) = 0;
+	virtual void set_irq_interval(int pages) = 0;
+	virtual void set_holdoff(int us) = 0;
+
+	/* Gaps, samples lost in them, and FIFO overflows so far */
+	virtual uint64_t overruns() const = 0;
+	virtual uint64_t lost() const = 0;
+	virtual uint64_t fifo_overflows() const = 0;
+};
+
+}
+}
+
+#endif
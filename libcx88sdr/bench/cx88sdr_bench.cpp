@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR capture throughput benchmark
+ *
+ * Streams every selected card through a session for a fixed time, one
+ * consumer thread per card touching every byte, and reports throughput
+ * against the configured byte rate, lost/dropped data and CPU usage.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/resource.h>
+
+#include "cx88sdr/session.hpp"
+
+using namespace cx88sdr;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -d DEV    capture device, repeatable (default: all cx88_sdr cards)\n"
+		"  -t SEC    duration in seconds (default: 10)\n"
+		"  -b KB     block size in KB (default: 1024)\n"
+		"  -m MODE   auto, mmap or read (default: auto)\n"
+		"  -c CPUS   comma separated reader CPU per card\n",
+		prog);
+}
+
+static const char *mode_name(reader::mode m)
+{
+	return (m == reader::mode::mmap) ? "mmap" : "read";
+}
+
+static double cpu_seconds()
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+	       (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<std::string> paths;
+	session_options opts;
+	int seconds = 10, opt;
+
+	while ((opt = getopt(argc, argv, "d:t:b:m:c:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			paths.push_back(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'b':
+			opts.block_size = static_cast<size_t>(atoi(optarg)) << 10;
+			break;
+		case 'm':
+			if (!strcmp(optarg, "mmap"))
+				opts.mode = reader::mode::mmap;
+			else if (!strcmp(optarg, "read"))
+				opts.mode = reader::mode::read;
+			else
+				opts.mode = reader::mode::automatic;
+			break;
+		case 'c': {
+			std::stringstream ss(optarg);
+			std::string cpu;
+
+			while (std::getline(ss, cpu, ','))
+				opts.cpus.push_back(atoi(cpu.c_str()));
+			break;
+		}
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (paths.empty())
+		paths = device::enumerate();
+	if (paths.empty()) {
+		fprintf(stderr, "no cx88_sdr devices found\n");
+		return 1;
+	}
+
+	try {
+		session s(paths, opts);
+		std::vector<std::thread> consumers;
+		std::vector<uint64_t> checksum(s.size()), invalid(s.size());
+		std::atomic<bool> done{false};
+		double cpu0 = cpu_seconds();
+		auto t0 = std::chrono::steady_clock::now();
+
+		s.start();
+		for (size_t i = 0; i < s.size(); i++) {
+			consumers.emplace_back([&, i] {
+				while (!done.load(std::memory_order_relaxed)) {
+					uint64_t sum = 0;
+					block b;
+
+					if (!s.pop(i, b)) {
+						std::this_thread::sleep_for(std::chrono::microseconds(200));
+						continue;
+					}
+					for (size_t n = 0; n < b.size; n++)
+						sum += b.data[n];
+					checksum[i] += sum;
+					if (!s.valid(i, b))
+						invalid[i]++;
+					s.release(i, b);
+				}
+			});
+		}
+
+		std::this_thread::sleep_for(std::chrono::seconds(seconds));
+		done = true;
+		for (auto &t : consumers)
+			t.join();
+		s.stop();
+
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		double cpu = cpu_seconds() - cpu0;
+		double total = 0;
+
+		printf("%-14s %-5s %10s %10s %12s %8s %8s\n",
+		       "device", "mode", "MB/s", "rate MB/s", "lost bytes", "dropped", "invalid");
+		for (size_t i = 0; i < s.size(); i++) {
+			card_stats st = s.stats(i);
+			double rate = s.card(i).sample_rate() * s.card(i).sample_size() / 1e6;
+			double mbs = st.bytes / elapsed / 1e6;
+
+			total += mbs;
+			printf("%-14s %-5s %10.2f %10.2f %12llu %8llu %8llu\n",
+			       s.card(i).path().c_str(), mode_name(s.mode(i)), mbs, rate,
+			       (unsigned long long)st.lost, (unsigned long long)st.dropped,
+			       (unsigned long long)invalid[i]);
+		}
+		printf("total %.2f MB/s, CPU %.1f%% of one core (%.3f s CPU per GB)\n",
+		       total, 100.0 * cpu / elapsed, (total > 0) ? cpu / (total * elapsed / 1e3) : 0.0);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR read() cost benchmark
+ *
+ * Lets DMA fill a backlog in the ring, then drains it with read() at each
+ * buffer size, so the copies run at memory speed instead of the sample
+ * rate. Reports the wall and system time per call and per MB.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/resource.h>
+
+#include "cx88sdr/device.hpp"
+
+using namespace cx88sdr;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -d DEV    capture device (default: first cx88_sdr card)\n"
+		"  -s MB     backlog drained per buffer size (default: 32)\n"
+		"  -b LIST   comma separated buffer sizes in KB\n"
+		"            (default: 4,64,1024,16384)\n"
+		"  -r N      rounds per buffer size, best is kept (default: 3)\n",
+		prog);
+}
+
+static double sys_seconds()
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<size_t> sizes = { 4 << 10, 64 << 10, 1 << 20, 16 << 20 };
+	std::string path;
+	size_t backlog = 32 << 20;
+	int rounds = 3, opt;
+
+	while ((opt = getopt(argc, argv, "d:s:b:r:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			path = optarg;
+			break;
+		case 's':
+			backlog = static_cast<size_t>(atoi(optarg)) << 20;
+			break;
+		case 'b': {
+			std::stringstream ss(optarg);
+			std::string kb;
+
+			sizes.clear();
+			while (std::getline(ss, kb, ','))
+				sizes.push_back(static_cast<size_t>(atoi(kb.c_str())) << 10);
+			break;
+		}
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (path.empty()) {
+		std::vector<std::string> paths = device::enumerate();
+
+		if (paths.empty()) {
+			fprintf(stderr, "no cx88_sdr devices found\n");
+			return 1;
+		}
+		path = paths[0];
+	}
+
+	try {
+		printf("%-10s %10s %12s %12s %12s\n",
+		       "buffer KB", "MB/s", "us/call", "sys us/MB", "calls");
+		for (size_t bs : sizes) {
+			std::vector<uint8_t> buf(bs);
+			double best = 0, best_sys = 0;
+			uint64_t calls = 0;
+
+			if (!bs)
+				continue;
+			for (int r = 0; r < rounds; r++) {
+				/* Each open starts reading at the current DMA page */
+				device dev(path);
+				position p = dev.pos();
+				size_t left = backlog;
+				uint64_t n = 0;
+
+				if (backlog + (2 << 20) > p.size)
+					throw std::runtime_error("backlog too close to the ring size");
+				dev.wait(p.read + backlog, 10000);
+
+				double sys0 = sys_seconds();
+				auto t0 = std::chrono::steady_clock::now();
+
+				while (left) {
+					size_t got = dev.read(buf.data(), std::min(bs, left));
+
+					if (!got)
+						throw std::runtime_error("backlog not available");
+					left -= got;
+					n++;
+				}
+
+				double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+				double sys = sys_seconds() - sys0;
+
+				if (!best || wall < best) {
+					best = wall;
+					best_sys = sys;
+					calls = n;
+				}
+			}
+			printf("%-10zu %10.1f %12.2f %12.1f %12llu\n", bs >> 10,
+			       backlog / best / 1e6, best * 1e6 / calls,
+			       best_sys * 1e6 / (backlog / 1e6), (unsigned long long)calls);
+		}
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Level statistics and a closed-loop gain / DC offset controller. The
+ * controller steps Gain, then Gain +6dB, then Gain 2 up or down when the
+ * signal stays clipped or under-ranged for a few windows, and DC Offset
+ * when the mean drifts from mid-scale. Every change is reported with the
+ * sample index it applies from, taken from the driver's configuration
+ * change event.
+ */
+
+#ifndef CX88SDR_AGC_HPP
+#define CX88SDR_AGC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cx88sdr/device.hpp"
+
+namespace cx88sdr {
+
+/*
+ * Over 8-bit codes, RU16LE samples are binned by their high byte. Min, max,
+ * mean and clip counts cover every sample, the histogram every
+ * hist_stride-th.
+ */
+struct level_stats {
+	static constexpr size_t hist_stride = 4;
+
+	uint64_t	count = 0;
+	uint64_t	sum = 0;		/* Of 8-bit codes */
+	uint64_t	clip_low = 0;		/* Code 0 */
+	uint64_t	clip_high = 0;		/* Code 255 */
+	uint32_t	min = 255;
+	uint32_t	max = 0;
+	uint64_t	hist_count = 0;
+	uint64_t	hist[256] = {};
+
+	void add(const uint8_t *in, size_t n);
+	void add(const uint16_t *in, size_t n);
+	void reset() { *this = level_stats(); }
+
+	double mean() const { return count ? static_cast<double>(sum) / count : 128; }
+	double clip_rate() const { return count ? static_cast<double>(clip_low + clip_high) / count : 0; }
+	/* Code below which a fraction p of the samples lie */
+	unsigned int percentile(double p) const;
+	/* Peak deviation from mid-scale at the 0.1/99.9 percentiles, 1.0 = full scale */
+	double level() const;
+};
+
+struct agc_options {
+	double		level_low = 0.45;	/* Step up below */
+	double		level_high = 0.85;	/* Step down above */
+	double		clip_max = 1e-5;	/* Step down above this clip rate */
+	double		dc_max = 0.03;		/* Mean offset from mid-scale, 1.0 = full scale */
+	unsigned int	hold = 3;		/* Windows a condition must persist */
+	unsigned int	settle = 2;		/* Windows ignored after a change */
+	bool		gain = true;		/* Control Gain, Gain +6dB, Gain 2 */
+	bool		dc = true;		/* Control DC Offset */
+};
+
+/* Control values the controller starts from, or has set */
+struct agc_controls {
+	int		gain = 0;
+	int		gain_6db = 0;
+	int		gain2 = 0;
+	int		dc = 0;
+};
+
+struct agc_change {
+	uint64_t	sample;		/* First sample the new value may apply to, 0 without a card */
+	std::string	control;	/* gain, gain_6db, gain2 or dc_offset */
+	int		from;
+	int		to;
+	double		level;
+	double		clip_rate;
+	double		mean;
+};
+
+/*
+ * Takes the configuration change events of dev's file handle: use a
+ * device of its own if something else reads them.
+ */
+class agc {
+public:
+	agc(device &dev, const agc_options &opts = agc_options());
+	/* Without a card: changes are only decided and returned, from start */
+	agc(const agc_controls &start, const agc_options &opts = agc_options());
+
+	/* Feed the statistics of one window, returns the changes made, if any */
+	std::vector<agc_change> update(const level_stats &s);
+	const agc_controls &controls() const { return ctl_; }
+
+private:
+	bool step_gain(int dir, const level_stats &s, std::vector<agc_change> &out);
+	void set(const char *name, uint32_t id, int &cur, int val, const level_stats &s,
+		 std::vector<agc_change> &out);
+
+	device		*dev_ = nullptr;
+	agc_options	opts_;
+	size_t		sample_size_ = 1;
+	agc_controls	ctl_;
+	int		dc_dir_ = 1;		/* Sign of the mean's response to DC Offset */
+	double		dc_mean_ = 0;		/* Mean before the last DC Offset step */
+	bool		dc_probe_ = false;
+	unsigned int	hot_ = 0, cold_ = 0, off_ = 0, settle_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Audio node of the cx88_sdr driver (module parameter audio=1,...): the
+ * card's audio ADC as 48 kHz interleaved stereo, clocked from the same
+ * crystal as the main stream, with cross-references between the two.
+ */
+
+#ifndef CX88SDR_AUDIO_HPP
+#define CX88SDR_AUDIO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cx88sdr/device.hpp"
+
+namespace cx88sdr {
+
+/* Both streams' byte positions at one audio page, see struct cx88sdr_xref */
+struct audio_xref {
+	uint64_t	audio;
+	uint64_t	main;		/* To within a page of the main stream */
+	uint64_t	ts_ns;		/* CLOCK_MONOTONIC */
+};
+
+/* main = offset + ratio * audio, in bytes of each stream */
+struct audio_clock {
+	double		ratio = 0;
+	double		offset = 0;
+
+	double main_at(uint64_t audio) const { return offset + ratio * static_cast<double>(audio); }
+};
+
+class audio_device {
+public:
+	static constexpr unsigned int rate = 48000;
+	static constexpr unsigned int channels = 2;
+	static constexpr size_t frame_size = channels * sizeof(int16_t);
+
+	explicit audio_device(const std::string &path);
+	~audio_device();
+
+	audio_device(const audio_device &) = delete;
+	audio_device &operator=(const audio_device &) = delete;
+
+	/* Audio node of the card main is open on, empty if it has none */
+	static std::string find(const device &main);
+
+	int fd() const { return fd_; }
+
+	/* Read up to frames stereo frames, blocking until the first, 0 on EAGAIN */
+	size_t read(int16_t *buf, size_t frames);
+	position pos() const;
+	/* Latest cross-references, oldest first, *seq as in struct cx88sdr_xrefs */
+	std::vector<audio_xref> xrefs(uint64_t *seq = nullptr) const;
+
+	/*
+	 * Least-squares line through the cross-references. The main positions
+	 * are page granular, the fit averages that out: a few seconds of them
+	 * place an audio sample to a fraction of a main stream page.
+	 */
+	static audio_clock fit(const std::vector<audio_xref> &x);
+
+private:
+	int		fd_ = -1;
+	std::string	path_;
+};
+
+}
+
+#endif
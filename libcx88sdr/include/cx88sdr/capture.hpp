@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Block reader using the fastest path the driver offers: blocks point
+ * straight into the mmap()ed DMA ring, or are read() into a buffer on
+ * drivers without mmap support.
+ */
+
+#ifndef CX88SDR_CAPTURE_HPP
+#define CX88SDR_CAPTURE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cx88sdr/device.hpp"
+
+namespace cx88sdr {
+
+struct block {
+	const uint8_t	*data = nullptr;
+	size_t		size = 0;
+	uint64_t	pos = 0;	/* Absolute byte position of data[0] */
+	uint64_t	lost = 0;	/* Bytes overwritten before they could be read */
+};
+
+class reader {
+public:
+	enum class mode { automatic, mmap, read };
+
+	/*
+	 * Starts at the current DMA write position, or where the device was
+	 * seek()ed to. block_size is rounded to pages.
+	 */
+	reader(device &dev, size_t block_size, mode m = mode::automatic);
+
+	/*
+	 * Fetch the next block, false on timeout. In mmap mode the data stays
+	 * valid until DMA laps it, check with valid() after processing.
+	 */
+	bool next(block &b, unsigned int timeout_ms = 1000);
+	bool valid(const block &b) const;
+
+	/* Read into caller-owned memory, always copies */
+	bool next_into(block &b, uint8_t *buf, unsigned int timeout_ms = 1000);
+
+	mode active_mode() const { return mode_; }
+	size_t block_size() const { return block_size_; }
+	uint64_t position() const { return pos_; }
+
+private:
+	/* DMA may be ahead of the published position by up to one IRQ interval */
+	static constexpr uint64_t guard = 4 << 20;
+
+	uint64_t wait_block(unsigned int timeout_ms);
+
+	device			&dev_;
+	size_t			block_size_;
+	mode			mode_;
+	uint64_t		pos_;
+	std::vector<uint8_t>	buf_;
+};
+
+}
+
+#endif
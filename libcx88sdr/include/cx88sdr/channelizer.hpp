@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Polyphase FFT channelizer: splits the real ADC band into M uniform
+ * channels, channel k centred on k * in_rate / M, each a complex stream
+ * at in_rate * oversample / M. Only channels 0 to M / 2 exist for real
+ * input, the others are their mirror images.
+ *
+ * One prototype lowpass of M * taps coefficients serves every channel: the
+ * FIR runs once per frame for all of them, and one M-point FFT turns the
+ * result into all M channel outputs. Two real frames share each complex FFT.
+ */
+
+#ifndef CX88SDR_CHANNELIZER_HPP
+#define CX88SDR_CHANNELIZER_HPP
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cx88sdr {
+
+class fft;
+class workers;
+
+struct channelizer_options {
+	unsigned int	channels = 64;		/* M, power of two, 16 to 65536 */
+	/*
+	 * Output rate in channel spacings: 1 is critically sampled, 2 (the
+	 * default) keeps the filter transition bands out of the passbands.
+	 * A power of two, at most channels / 8.
+	 */
+	unsigned int	oversample = 2;
+	unsigned int	taps = 16;		/* Prototype taps per channel */
+	double		atten_db = 80;		/* Prototype stopband attenuation */
+	std::vector<unsigned int> select;	/* Channels to output, empty: 0 to M / 2 */
+	unsigned int	threads = 1;		/* 0: one per CPU */
+};
+
+class channelizer {
+public:
+	explicit channelizer(const channelizer_options &opts);
+	~channelizer();
+
+	channelizer(const channelizer &) = delete;
+	channelizer &operator=(const channelizer &) = delete;
+
+	/*
+	 * Feed n input samples, appends the outputs they complete to out[i]
+	 * for channel selected()[i]. Returns the outputs per channel.
+	 */
+	size_t process(const float *in, size_t n, std::vector<std::vector<std::complex<float>>> &out);
+	size_t process(const uint8_t *in, size_t n, std::vector<std::vector<std::complex<float>>> &out);
+	size_t process(const uint16_t *in, size_t n, std::vector<std::vector<std::complex<float>>> &out);
+
+	unsigned int channels() const { return m_; }
+	unsigned int decimation() const { return d_; }
+	const std::vector<unsigned int> &selected() const { return select_; }
+	uint64_t inputs() const { return inputs_; }
+	uint64_t outputs() const { return frames_; }
+
+private:
+	size_t run(std::vector<std::vector<std::complex<float>>> &out);
+
+	unsigned int			m_, d_, taps_;
+	std::vector<unsigned int>	select_;
+	/* Row p holds h[p * M + M - 1 - i], time reversed for contiguous loads */
+	std::vector<float>		poly_;
+	std::vector<std::complex<float>> rot_;	/* e^(-2 pi j i / M) */
+	std::unique_ptr<fft>		fft_;
+	std::vector<float>		buf_;	/* Pending input, buf_[0] is sample base_ */
+	int64_t				base_;
+	uint64_t			inputs_ = 0, frames_ = 0;
+	std::unique_ptr<workers>	pool_;
+};
+
+}
+
+#endif
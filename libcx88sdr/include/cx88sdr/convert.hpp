@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Sample conversion kernels. RU8/RU16LE samples are unsigned and real, the
+ * complex outputs carry them as I with Q = 0, as the GNU Radio flowgraphs
+ * in grc/ do. Every kernel is compiled for AVX2 and the baseline ISA and
+ * picked at load time.
+ */
+
+#ifndef CX88SDR_CONVERT_HPP
+#define CX88SDR_CONVERT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cx88sdr {
+namespace convert {
+
+/* Real float, centered and scaled to [-1, 1) */
+void ru8_to_f32(const uint8_t *in, float *out, size_t n);
+void ru16_to_f32(const uint16_t *in, float *out, size_t n);
+
+/* Interleaved complex, n input samples produce 2 * n output values */
+void ru8_to_cf32(const uint8_t *in, float *out, size_t n);
+void ru8_to_cs16(const uint8_t *in, int16_t *out, size_t n);
+void ru8_to_cs8(const uint8_t *in, int8_t *out, size_t n);
+void ru16_to_cf32(const uint16_t *in, float *out, size_t n);
+void ru16_to_cs16(const uint16_t *in, int16_t *out, size_t n);
+void ru16_to_cs8(const uint16_t *in, int8_t *out, size_t n);
+
+}
+}
+
+#endif
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * RAII handle for one /dev/swradioN node of the cx88_sdr driver.
+ */
+
+#ifndef CX88SDR_DEVICE_HPP
+#define CX88SDR_DEVICE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <cx88_sdr_uapi.h>
+
+namespace cx88sdr {
+
+enum class format : uint32_t {
+	ru8	= V4L2_SDR_FMT_RU8,
+	ru16le	= V4L2_SDR_FMT_RU16LE,
+};
+
+/* Absolute byte positions, see struct cx88sdr_pos */
+struct position {
+	uint64_t	read;
+	uint64_t	write;
+	uint64_t	size;
+};
+
+/* Where a seek put the read position, see struct cx88sdr_seek */
+struct seek_result {
+	uint64_t	pos;
+	uint64_t	lost;		/* Bytes the position was moved up, overwritten */
+};
+
+/* Configuration change marker, see struct cx88sdr_event_config */
+struct config_change {
+	uint64_t	pos;
+	uint64_t	settled;
+	uint32_t	id;		/* control ID, CX88SDR_CONFIG_RATE or _FORMAT */
+	int32_t		value;
+};
+
+/* Hardware fault, see struct cx88sdr_event_fault */
+struct fault_event {
+	uint64_t	pos;
+	uint32_t	faults;		/* CX88SDR_FAULT_* bits */
+	uint32_t	status;
+	uint64_t	fifo_overflows;	/* Counts on the card so far */
+	uint64_t	sync_errors;
+	uint64_t	risc_errors;
+	uint64_t	pci_errors;
+};
+
+class device {
+public:
+	explicit device(const std::string &path);
+	~device();
+
+	device(device &&other) noexcept;
+	device &operator=(device &&other) noexcept;
+	device(const device &) = delete;
+	device &operator=(const device &) = delete;
+
+	/* /dev/swradioN */
+	static device open_index(unsigned int nr);
+	/* All swradio nodes driven by cx88_sdr, in minor order */
+	static std::vector<std::string> enumerate();
+	/* Replay cards (replay module parameter), in minor order */
+	static std::vector<std::string> enumerate_replay();
+
+	int fd() const { return fd_; }
+	const std::string &path() const { return path_; }
+	std::string bus_info() const;
+	/* A replay card: no PCI device, samples come from write() */
+	bool replay() const { return bus_info().rfind("platform:", 0) == 0; }
+	/* CPUs local to the card's PCI slot, empty if unknown */
+	std::vector<int> local_cpus() const;
+
+	void set_sample_rate(uint32_t hz);
+	uint32_t sample_rate() const;
+	/* Rate the PLL really runs at for a requested rate, not rounded to Hz */
+	static double achieved_rate(uint32_t hz, format fmt);
+	double achieved_rate() const { return achieved_rate(sample_rate(), get_format()); }
+	void set_format(format fmt);
+	format get_format() const;
+	size_t sample_size() const;
+
+	/* Typed controls, ranges as registered by the driver */
+	void set_gain(int val);			/* 0..31 */
+	void set_gain_6db(bool on);
+	void set_gain2(int val);		/* AGC_ADJ3, 0..16 */
+	void set_dc_offset(int val);		/* AGC_TIP3, 0..64 */
+	void set_input(int val);		/* 0..3 */
+	void set_afc_pll(bool on);
+	void set_input_vsync(bool on);
+	void set_htotal(int val);		/* 8..2040 */
+	void set_irq_interval(int pages);	/* 1..512 */
+	void set_position_poll(int us);		/* 0 or 100..100000 */
+	void set_holdoff(int us);		/* 0..1000000 */
+	void set_mode(int mode);		/* CX88SDR_MODE_* */
+
+	int32_t control(uint32_t id) const;
+	void set_control(uint32_t id, int32_t val);
+
+	position pos() const;
+	/*
+	 * Move the read position to data still in the ring, for read() and
+	 * for a reader made afterwards: an absolute byte position, pos bytes
+	 * past the oldest data, or the byte sampled at a CLOCK_REALTIME time.
+	 */
+	seek_result seek(uint64_t pos);
+	seek_result seek_oldest(uint64_t pos = 0);
+	seek_result seek_time(int64_t time_ns);
+	bool seeked() const { return seeked_; }
+	/* Wait until write >= pos, returns the write position */
+	uint64_t wait(uint64_t pos, unsigned int timeout_ms) const;
+	/* Queue a config_change for every change of rate, format or ADC control */
+	void subscribe_config();
+	/* Next queued change, false if none within timeout_ms (-1 waits forever) */
+	bool next_config(config_change &c, int timeout_ms);
+	/* Queue a fault_event for every FIFO overflow, RISC or PCI error */
+	void subscribe_faults();
+	/* Next queued fault, as next_config(); either keeps the other's events */
+	bool next_fault(fault_event &f, int timeout_ms);
+
+	/* read(2), returns 0 on EAGAIN */
+	size_t read(void *buf, size_t len);
+
+	/*
+	 * Map the ring twice back-to-back, so ring_base()[n % size] is valid
+	 * for up to size bytes past it. Returns false if mmap is unsupported.
+	 */
+	bool map_ring();
+	const uint8_t *ring_base() const { return static_cast<const uint8_t *>(map_); }
+	size_t ring_size() const { return ring_size_; }
+
+private:
+	void close();
+	seek_result do_seek(uint32_t whence, uint64_t pos, int64_t time_ns);
+	bool dequeue(int timeout_ms);
+
+	int		fd_ = -1;
+	std::string	path_;
+	void		*map_ = nullptr;
+	size_t		map_len_ = 0;
+	size_t		ring_size_ = 0;
+	bool		seeked_ = false;
+	/* Events dequeued while waiting for the other kind */
+	std::deque<config_change> configs_;
+	std::deque<fault_event>	faults_;
+};
+
+}
+
+#endif
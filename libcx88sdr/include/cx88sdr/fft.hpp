@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Power of two complex FFT on split (separate real and imaginary) arrays,
+ * in place, X[k] = sum x[n] e^(-2 pi j k n / N). The butterflies are
+ * vectorised over eight points once a stage is eight points wide.
+ */
+
+#ifndef CX88SDR_FFT_HPP
+#define CX88SDR_FFT_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace cx88sdr {
+
+class fft {
+public:
+	/* n: power of two, at least 16 */
+	explicit fft(unsigned int n);
+
+	unsigned int size() const { return n_; }
+
+	/*
+	 * Index in the array forward_permuted() takes of input sample i, for
+	 * producers that can scatter into bit-reversed order for free.
+	 */
+	unsigned int perm(unsigned int i) const { return rev_[i]; }
+
+	/* Input in perm() order, output in natural order */
+	void forward_permuted(float *re, float *im) const;
+	/* Natural order in and out */
+	void forward(float *re, float *im) const;
+
+private:
+	unsigned int			n_;
+	std::vector<unsigned int>	rev_;
+	/* Stage with half width h has its h twiddles at offset h - 1 */
+	std::vector<float>		tw_re_, tw_im_;
+};
+
+}
+
+#endif
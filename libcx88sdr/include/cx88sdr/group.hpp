@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Group node of the cx88_sdr driver (module parameter group=0,1,...): all
+ * cards of the group in one read(), a frame holding one page of each.
+ */
+
+#ifndef CX88SDR_GROUP_HPP
+#define CX88SDR_GROUP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cx88sdr/device.hpp"
+
+namespace cx88sdr {
+
+struct group_state {
+	uint64_t		frame;	/* Next frame read() returns */
+	uint64_t		lost;	/* Frames skipped, a card was about to lap the reader */
+	std::vector<position>	cards;	/* Per card, write - read is its lead */
+};
+
+class group_device {
+public:
+	explicit group_device(const std::string &path);
+	~group_device();
+
+	group_device(const group_device &) = delete;
+	group_device &operator=(const group_device &) = delete;
+
+	/* Path of the group node, empty if the driver has none */
+	static std::string find();
+
+	int fd() const { return fd_; }
+	size_t cards() const { return cards_; }
+	size_t page_size() const { return page_; }
+	size_t frame_size() const { return cards_ * page_; }
+
+	/* Rate and format of every card in the group */
+	void set_sample_rate(uint32_t hz);
+	void set_format(format fmt);
+
+	/*
+	 * Read up to frames whole frames into buf, blocking until the first
+	 * is complete on every card. Card c of frame f starts at
+	 * buf + f * frame_size() + c * page_size().
+	 */
+	size_t read(uint8_t *buf, size_t frames);
+	group_state state() const;
+
+private:
+	int		fd_ = -1;
+	std::string	path_;
+	size_t		cards_ = 0;
+	size_t		page_ = 0;
+};
+
+}
+
+#endif
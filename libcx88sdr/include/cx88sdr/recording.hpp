@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Capture container, three files sharing one base name:
+ *
+ *   NAME.sigmf-data  the raw RU8/RU16LE samples, as a plain dump would be
+ *   NAME.sigmf-meta  SigMF metadata, the card's configuration under the
+ *                    "cx88sdr:" extension, a capture segment per gap and
+ *                    an annotation per gap, configuration change and
+ *                    hardware fault
+ *   NAME.cx88idx     binary index: a fixed header, then records sorted by
+ *                    sample, meant to be mmap()ed and binary searched
+ *
+ * "Sample" is an index into the data file. "Global" is the card's stream
+ * position in samples (DMA byte position / sample size), it jumps where
+ * samples were lost. Every record carries both, so times interpolate on
+ * the stream position and stay right across gaps.
+ *
+ * Time records are taken as blocks arrive, good to about one IRQ interval
+ * (CX88SDR_IOC_G_POS granularity) plus scheduling latency. Gap, config and
+ * fault records carry times interpolated from them, so record times never go
+ * backwards unless CLOCK_REALTIME does.
+ *
+ * The header counts are completed on close; until then, and after a crash,
+ * readers go by the file sizes.
+ */
+
+#ifndef CX88SDR_RECORDING_HPP
+#define CX88SDR_RECORDING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cx88sdr/device.hpp"
+
+namespace cx88sdr {
+
+constexpr char recording_magic[8] = { 'C', 'X', '8', '8', 'I', 'D', 'X', '1' };
+constexpr uint32_t recording_version = 1;
+
+/* Driver configuration, the fields of struct cx88sdr_ctrl */
+struct recording_ctrl {
+	uint32_t	freq;
+	uint32_t	pixelformat;
+	uint32_t	buffersize;
+	uint32_t	gain;
+	uint32_t	agc_adj3;
+	uint32_t	agc_tip3;
+	uint32_t	input;
+	uint32_t	htotal;
+	uint32_t	irq_pages;
+	uint32_t	pos_poll;
+	uint32_t	holdoff;
+	uint32_t	gain_6db;
+	uint32_t	afc_pll;
+	uint32_t	input_vsync;
+	uint32_t	reserved[2];
+
+	static recording_ctrl from(const device &dev);
+};
+
+struct recording_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	header_size;	/* Records start here */
+	uint32_t	record_size;
+	uint32_t	sample_size;
+	double		sample_rate;	/* Achieved rate, Hz */
+	uint64_t	count;		/* Records, kept current while recording */
+	uint64_t	samples;	/* Samples in the data file, idem */
+	int64_t		start_ns;	/* CLOCK_REALTIME of sample 0 */
+	recording_ctrl	ctrl;		/* At the start of the recording */
+	char		bus_info[32];
+	uint8_t		reserved[104];
+};
+
+enum class record_type : uint32_t {
+	time	= 1,	/* Timestamp of a sample */
+	gap	= 2,	/* Samples lost before sample, global jumps by value */
+	config	= 3,	/* Control id set to value, from sample */
+	fault	= 4,	/* CX88SDR_FAULT_* bits id, interrupt status value, at sample */
+};
+
+/* "FIFO overflow, RISC error" for CX88SDR_FAULT_* bits */
+std::string fault_names(uint32_t faults);
+
+struct index_record {
+	uint64_t	sample;
+	uint64_t	global;
+	int64_t		time_ns;	/* CLOCK_REALTIME */
+	record_type	type;
+	uint32_t	id;		/* config: control ID or CX88SDR_CONFIG_* */
+	int64_t		value;
+};
+
+static_assert(sizeof(recording_header) == 256, "recording_header is part of the file format");
+static_assert(sizeof(index_record) == 40, "index_record is part of the file format");
+
+class recording_writer {
+public:
+	/* Creates or truncates the three files */
+	recording_writer(const std::string &base, const device &dev);
+	/* Same, for samples that did not come straight from a card */
+	recording_writer(const std::string &base, double sample_rate, size_t sample_size,
+			 const recording_ctrl &ctrl, const std::string &bus_info);
+	~recording_writer();
+
+	recording_writer(const recording_writer &) = delete;
+	recording_writer &operator=(const recording_writer &) = delete;
+
+	/*
+	 * Append n bytes read from stream byte position pos, time_ns is when
+	 * the last of them was received. A position past the end of the
+	 * previous write records a gap.
+	 */
+	void write(const uint8_t *data, size_t n, uint64_t pos, int64_t time_ns);
+	/*
+	 * Configuration change at stream byte position pos, indexed once the
+	 * data gets there. Report changes before writing the block they fall
+	 * in, later ones are indexed at the end of the data written so far.
+	 */
+	void config(uint64_t pos, uint32_t id, int64_t value);
+	/* Hardware fault at stream byte position pos, indexed as config() */
+	void fault(uint64_t pos, uint32_t faults, uint32_t status);
+	/* Complete the index header and the metadata, also done by the destructor */
+	void close();
+
+	/* Samples between time records, default a tenth of a second */
+	void set_index_interval(uint64_t samples) { interval_ = samples; }
+	uint64_t samples() const { return hdr_.samples; }
+	uint64_t gaps() const { return gaps_; }
+	uint64_t lost() const { return lost_; }
+
+private:
+	void add(index_record r);
+	void pend(index_record r);
+	void flush_config(uint64_t until);
+	void write_meta() const;
+
+	std::string			base_;
+	int				data_fd_ = -1, idx_fd_ = -1;
+	recording_header		hdr_ = {};
+	index_record			last_ = {}, last_time_ = {};
+	std::vector<index_record>	pending_;	/* Changes and faults not reached yet, global in bytes */
+	std::vector<index_record>	events_;	/* Gaps, config changes and faults, for the metadata */
+	uint64_t			next_global_ = 0, global0_ = 0;
+	uint64_t			interval_;
+	uint64_t			gaps_ = 0, lost_ = 0;
+	bool				started_ = false;
+};
+
+/* Read side, the data and the index mmap()ed read-only */
+class recording {
+public:
+	explicit recording(const std::string &base);
+	~recording();
+
+	recording(const recording &) = delete;
+	recording &operator=(const recording &) = delete;
+
+	const recording_header &header() const { return *hdr_; }
+	double sample_rate() const { return hdr_->sample_rate; }
+	size_t sample_size() const { return hdr_->sample_size; }
+	uint64_t samples() const { return samples_; }
+	/* Sample n is at data() + n * sample_size() */
+	const uint8_t *data() const { return data_; }
+
+	const index_record *records() const { return recs_; }
+	uint64_t record_count() const { return count_; }
+
+	/* Stream position of a sample */
+	uint64_t global_of(uint64_t sample) const;
+	/* Time of a sample, from the nearest time record at or before it */
+	int64_t time_of(uint64_t sample) const;
+	/* First sample at or after time_ns, samples() if none */
+	uint64_t sample_at(int64_t time_ns) const;
+	/* Gap, config and fault records, in order */
+	std::vector<index_record> events() const;
+
+private:
+
+	const recording_header	*hdr_ = nullptr;
+	const index_record	*recs_ = nullptr;
+	uint64_t		count_ = 0, samples_ = 0;
+	const uint8_t		*data_ = nullptr;
+	void			*idx_map_ = nullptr, *data_map_ = nullptr;
+	size_t			idx_len_ = 0, data_len_ = 0;
+};
+
+}
+
+#endif
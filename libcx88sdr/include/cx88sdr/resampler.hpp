@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Streaming polyphase resampler from the ADC rate to any output rate.
+ * Kaiser windowed sinc, linearly interpolated between filter phases, so
+ * the ratio does not have to be rational. Output n is the input at time
+ * n * in_rate / out_rate exactly, there is no group delay to correct.
+ */
+
+#ifndef CX88SDR_RESAMPLER_HPP
+#define CX88SDR_RESAMPLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cx88sdr {
+
+class workers;
+
+struct resampler_options {
+	double		in_rate = 0;		/* Use device::achieved_rate() */
+	double		out_rate = 0;
+	/*
+	 * Taps per phase at the input rate, rounded up to a multiple of 8 and
+	 * scaled by in_rate / out_rate when decimating.
+	 */
+	unsigned int	taps = 32;
+	unsigned int	phases = 256;		/* Power of two */
+	double		bandwidth = 0.9;	/* Passband, fraction of the lower Nyquist */
+	double		atten_db = 80;		/* Stopband attenuation */
+	unsigned int	threads = 1;		/* 0: one per CPU */
+};
+
+class resampler {
+public:
+	explicit resampler(const resampler_options &opts);
+	~resampler();
+
+	resampler(const resampler &) = delete;
+	resampler &operator=(const resampler &) = delete;
+
+	/* Feed n input samples, appends every output they complete to out */
+	size_t process(const float *in, size_t n, std::vector<float> &out);
+	size_t process(const uint8_t *in, size_t n, std::vector<float> &out);
+	size_t process(const uint16_t *in, size_t n, std::vector<float> &out);
+
+	unsigned int taps() const { return taps_; }
+	uint64_t inputs() const { return inputs_; }
+	uint64_t outputs() const { return outputs_; }
+
+private:
+	size_t run(std::vector<float> &out);
+
+	unsigned int			taps_;
+	unsigned int			shift_;		/* Fraction bits above the phase index */
+	std::vector<float>		table_;		/* phases + 1 rows of taps_ */
+	uint64_t			step_int_, step_frac_;
+	std::vector<float>		buf_;		/* Pending input, buf_[0] is sample base_ */
+	int64_t				base_;
+	uint64_t			inputs_ = 0, outputs_ = 0;
+	std::unique_ptr<workers>	pool_;
+};
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Multi-card capture session: one reader thread per card, pinned to a CPU
+ * local to the card, feeding a lock-free SPSC block queue per card.
+ */
+
+#ifndef CX88SDR_SESSION_HPP
+#define CX88SDR_SESSION_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/device.hpp"
+#include "cx88sdr/spsc_queue.hpp"
+
+namespace cx88sdr {
+
+struct session_options {
+	size_t		block_size = 1 << 20;
+	size_t		queue_depth = 32;
+	reader::mode	mode = reader::mode::automatic;
+	/* CPU per card, -1 or missing entries: first CPU local to the card */
+	std::vector<int> cpus;
+};
+
+struct card_stats {
+	uint64_t	blocks = 0;
+	uint64_t	bytes = 0;
+	uint64_t	lost = 0;		/* Overwritten in the ring */
+	uint64_t	dropped = 0;		/* Consumer queue full */
+};
+
+class session {
+public:
+	explicit session(const std::vector<std::string> &paths,
+			 const session_options &opts = session_options());
+	~session();
+
+	session(const session &) = delete;
+	session &operator=(const session &) = delete;
+
+	size_t size() const { return cards_.size(); }
+	device &card(size_t i) { return cards_[i]->dev; }
+	reader::mode mode(size_t i) const { return cards_[i]->rd->active_mode(); }
+
+	void start();
+	void stop();
+
+	/*
+	 * Consumer side, one consumer thread per card. Every popped block must
+	 * be given back with release(), in mmap mode valid() tells whether
+	 * the ring data was overwritten while it was being processed.
+	 */
+	bool pop(size_t i, block &b);
+	bool valid(size_t i, const block &b) const;
+	void release(size_t i, const block &b);
+
+	card_stats stats(size_t i) const;
+
+private:
+	struct card_ctx {
+		explicit card_ctx(const std::string &path) : dev(path) {}
+
+		device				dev;
+		std::unique_ptr<reader>		rd;
+		std::unique_ptr<spsc_queue<block>> full;
+		std::unique_ptr<spsc_queue<uint8_t *>> empty;
+		std::vector<std::unique_ptr<uint8_t[]>> pool;
+		std::thread			thread;
+		int				cpu = -1;
+		std::atomic<uint64_t>		blocks{0};
+		std::atomic<uint64_t>		bytes{0};
+		std::atomic<uint64_t>		lost{0};
+		std::atomic<uint64_t>		dropped{0};
+	};
+
+	void run(card_ctx &c);
+
+	session_options			opts_;
+	std::vector<std::unique_ptr<card_ctx>> cards_;
+	std::atomic<bool>		running_{false};
+};
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Shared-memory fan-out: cx88sdrd reads every card once into a POSIX
+ * shared-memory ring, any number of local readers attach through its
+ * Unix-socket control channel and consume the ring without copies.
+ *
+ * Positions are the card's absolute DMA byte positions (struct
+ * cx88sdr_pos), so shm and device positions can be compared directly.
+ *
+ * The object holds the daemon's header, the reader slots and the data
+ * ring, each page aligned: readers map the header and the data read-only,
+ * only the slots writable.
+ */
+
+#ifndef CX88SDR_SHM_HPP
+#define CX88SDR_SHM_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/device.hpp"
+
+namespace cx88sdr {
+
+/* Made by a daemon running as root, or by the init system */
+constexpr const char *shm_socket_dir = "/run/cx88sdrd";
+constexpr uint32_t shm_magic = 0x43583838;	/* "CX88" */
+constexpr uint32_t shm_version = 2;
+constexpr size_t shm_max_readers = 32;
+
+/* One per attached reader, allocated by the daemon, counters written by the reader */
+struct alignas(64) shm_slot {
+	std::atomic<uint32_t>	used;
+	int32_t			pid;
+	std::atomic<uint64_t>	read;		/* Everything before has been consumed */
+	std::atomic<uint64_t>	overruns;	/* Times the daemon lapped this reader */
+	std::atomic<uint64_t>	lost;		/* Bytes skipped because of overruns */
+};
+
+struct shm_header {
+	uint32_t		magic;
+	uint32_t		version;
+	uint64_t		size;		/* Data ring size, page aligned */
+	uint64_t		slots_offset;	/* Start of the shm_max_readers slots */
+	uint64_t		data_offset;	/* Start of the data ring in the object */
+	std::atomic<uint32_t>	sample_rate;
+	std::atomic<uint32_t>	format;		/* V4L2_SDR_FMT_RU8 or RU16LE */
+
+	/*
+	 * [fill - size, write) is readable. fill is raised before a block is
+	 * copied in, write after, so a reader that still sees its data at or
+	 * above fill - size after processing got it intact.
+	 */
+	alignas(64) std::atomic<uint64_t> write;
+	std::atomic<uint64_t>	fill;
+	std::atomic<uint32_t>	seq;		/* Futex, bumped on every publish */
+	std::atomic<uint64_t>	lost;		/* Bytes the daemon lost on the card */
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+	      "shm positions must be address-free atomics");
+
+/* Shared-memory object, its data ring mapped twice back-to-back */
+class shm_ring {
+public:
+	/* Daemon side, replaces any existing object of that name */
+	static shm_ring create(const std::string &name, size_t size);
+	/* Reader side */
+	static shm_ring open(const std::string &name);
+
+	shm_ring() = default;
+	~shm_ring();
+	shm_ring(shm_ring &&other) noexcept;
+	shm_ring &operator=(shm_ring &&other) noexcept;
+	shm_ring(const shm_ring &) = delete;
+	shm_ring &operator=(const shm_ring &) = delete;
+
+	/* Read-only on the reader side */
+	shm_header *header() const { return hdr_; }
+	shm_slot *slots() const { return slots_; }
+	/* data()[n % size()] is valid for up to size() bytes past it */
+	uint8_t *data() const { return data_; }
+	size_t size() const { return size_; }
+
+	/* Make data up to write visible, fill must have been raised before the copy */
+	void publish(uint64_t write);
+	/* Wait for a publish past seq, false on timeout */
+	bool wait(uint32_t seq, unsigned int timeout_ms) const;
+
+private:
+	void unmap();
+
+	std::string	name_;
+	bool		owner_ = false;
+	shm_header	*hdr_ = nullptr;
+	shm_slot	*slots_ = nullptr;
+	uint8_t		*data_ = nullptr;
+	size_t		size_ = 0;
+	void		*map_ = nullptr;
+	size_t		map_len_ = 0;
+};
+
+/* The control socket in shm_socket_dir if it exists, else in $XDG_RUNTIME_DIR */
+std::string shm_socket_default();
+
+/* One control command, returns the reply lines without the final "ok" */
+std::string shm_command(const std::string &line,
+			const std::string &socket_path = shm_socket_default());
+
+/*
+ * Block reader on a daemon ring, same interface as reader. The slot is
+ * held, and counted by the daemon, for the lifetime of the object.
+ */
+class shm_reader {
+public:
+	shm_reader(unsigned int card, size_t block_size,
+		   const std::string &socket_path = shm_socket_default());
+	~shm_reader();
+
+	shm_reader(const shm_reader &) = delete;
+	shm_reader &operator=(const shm_reader &) = delete;
+
+	bool next(block &b, unsigned int timeout_ms = 1000);
+	bool valid(const block &b) const;
+
+	uint32_t sample_rate() const { return ring_.header()->sample_rate.load(); }
+	format get_format() const { return static_cast<format>(ring_.header()->format.load()); }
+	size_t sample_size() const { return (get_format() == format::ru16le) ? 2 : 1; }
+	size_t block_size() const { return block_size_; }
+	uint64_t position() const { return pos_; }
+	unsigned int slot() const { return slot_; }
+
+private:
+	int		fd_ = -1;
+	shm_ring	ring_;
+	unsigned int	slot_ = 0;
+	size_t		block_size_;
+	uint64_t	pos_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Averaged power spectra for long-term band monitoring, and the file they
+ * are logged to. spectrum_analyzer turns the real ADC stream into lines
+ * of fft_size / 2 bins, bin k centred on k * in_rate / fft_size, each the
+ * mean of `average` Hann-windowed frames overlapping by half, in dBFS (a
+ * full-scale sine reads 0 dB).
+ *
+ * A spectrogram is two files sharing one base name:
+ *
+ *   NAME.cx88spg     compressed blocks of block_lines lines each
+ *   NAME.cx88spgidx  binary index: a fixed header, then one record per
+ *                    block sorted by time, meant to be mmap()ed and
+ *                    binary searched
+ *
+ * Bins are quantised to one byte, code c standing for db_min + c * db_step
+ * dB, clipped at both ends. A block starts with the time and stream
+ * position of each of its lines (int64_t, uint64_t), followed by a bit
+ * stream, LSB first: for every line and every group of 32 bins, a 4-bit
+ * width w, then 32 w-bit zigzag codes of the int8_t difference to the
+ * same bins of the line before (zeros before the first line of a block).
+ * Blocks decode on their own. Band noise mostly changes by a step or two
+ * between lines, which packs into 2 or 3 bits per bin.
+ *
+ * The header counts are completed on close; until then, and after a crash,
+ * readers go by the file sizes.
+ */
+
+#ifndef CX88SDR_SPECTROGRAM_HPP
+#define CX88SDR_SPECTROGRAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cx88sdr/recording.hpp"
+
+namespace cx88sdr {
+
+class fft;
+class workers;
+
+struct spectrum_options {
+	unsigned int	fft_size = 4096;	/* Power of two, 64 to 65536 */
+	unsigned int	average = 1024;		/* Frames per line */
+	double		in_rate = 0;		/* Use device::achieved_rate() */
+	unsigned int	threads = 1;		/* 0: one per CPU */
+};
+
+class spectrum_analyzer {
+public:
+	explicit spectrum_analyzer(const spectrum_options &opts);
+	~spectrum_analyzer();
+
+	spectrum_analyzer(const spectrum_analyzer &) = delete;
+	spectrum_analyzer &operator=(const spectrum_analyzer &) = delete;
+
+	/*
+	 * Feed n samples, appends bins() dB values to out for each line they
+	 * complete, and the input index of its first sample to starts.
+	 * Returns the lines completed.
+	 */
+	size_t process(const float *in, size_t n, std::vector<float> &out,
+		       std::vector<uint64_t> &starts);
+	size_t process(const uint8_t *in, size_t n, std::vector<float> &out,
+		       std::vector<uint64_t> &starts);
+	size_t process(const uint16_t *in, size_t n, std::vector<float> &out,
+		       std::vector<uint64_t> &starts);
+	/* Drop the partial line, the next one starts at the next sample fed */
+	void reset();
+
+	unsigned int fft_size() const { return n_; }
+	unsigned int bins() const { return n_ / 2; }
+	unsigned int average() const { return avg_; }
+	unsigned int hop() const { return n_ / 2; }
+	double in_rate() const { return rate_; }
+	/* Input samples between the starts of consecutive lines */
+	uint64_t line_samples() const { return static_cast<uint64_t>(avg_) * hop(); }
+	uint64_t inputs() const { return inputs_; }
+	uint64_t lines() const { return lines_; }
+
+private:
+	size_t run(std::vector<float> &out, std::vector<uint64_t> &starts);
+
+	unsigned int			n_, avg_;
+	double				rate_;
+	std::vector<float>		win_;
+	float				scale_;
+	std::unique_ptr<fft>		fft_;
+	std::vector<float>		buf_;	/* Pending input, buf_[0] is input base_ */
+	uint64_t			base_ = 0;
+	uint64_t			origin_ = 0;	/* Input of frame 0 */
+	uint64_t			frames_ = 0;	/* Frames since origin_ summed */
+	std::vector<float>		acc_;	/* |Z|^2 of the current line, all n_ bins */
+	uint64_t			inputs_ = 0, lines_ = 0;
+	std::unique_ptr<workers>	pool_;
+};
+
+constexpr char spectrogram_magic[8] = { 'C', 'X', '8', '8', 'S', 'P', 'G', '1' };
+constexpr uint32_t spectrogram_version = 1;
+
+struct spectrogram_options {
+	float		db_min = -150;		/* Level of code 0 */
+	float		db_step = 0.625f;	/* dB per code, 255 codes above db_min */
+	unsigned int	block_lines = 64;	/* Lines per compressed block */
+};
+
+struct spectrogram_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	header_size;	/* Records start here */
+	uint32_t	record_size;
+	uint32_t	bins;
+	uint32_t	fft_size;
+	uint32_t	average;	/* Frames per line */
+	uint32_t	hop;		/* Input samples between frames */
+	uint32_t	block_lines;
+	double		sample_rate;	/* Input rate, Hz */
+	float		db_min;
+	float		db_step;
+	uint64_t	count;		/* Blocks, completed on close */
+	uint64_t	lines;		/* idem */
+	int64_t		start_ns;	/* CLOCK_REALTIME of the first line */
+	recording_ctrl	ctrl;		/* At the start of the log */
+	char		bus_info[32];
+	uint8_t		reserved[80];
+};
+
+struct spectrogram_block {
+	uint64_t	offset;		/* In the data file */
+	uint64_t	first_line;
+	int64_t		first_ns;	/* Start of the first line, CLOCK_REALTIME */
+	int64_t		last_ns;	/* Start of the last line */
+	uint32_t	size;		/* Bytes */
+	uint32_t	lines;
+};
+
+/* Per line, at the start of every block */
+struct spectrogram_line {
+	int64_t		time_ns;	/* First sample, CLOCK_REALTIME */
+	uint64_t	global;		/* Stream position of the first sample */
+};
+
+static_assert(sizeof(spectrogram_header) == 256, "spectrogram_header is part of the file format");
+static_assert(sizeof(spectrogram_block) == 40, "spectrogram_block is part of the file format");
+static_assert(sizeof(spectrogram_line) == 16, "spectrogram_line is part of the file format");
+
+class spectrogram_writer {
+public:
+	/* Creates or truncates both files */
+	spectrogram_writer(const std::string &base, const spectrum_analyzer &an,
+			   const spectrogram_options &opts, const recording_ctrl &ctrl = {},
+			   const std::string &bus_info = {});
+	~spectrogram_writer();
+
+	spectrogram_writer(const spectrogram_writer &) = delete;
+	spectrogram_writer &operator=(const spectrogram_writer &) = delete;
+
+	/* Append a line of bins() dB values, starting at time_ns and stream position global */
+	void add(const float *db, int64_t time_ns, uint64_t global);
+	/* Write the partial block and complete the header, also done by the destructor */
+	void close();
+
+	uint64_t lines() const { return hdr_.lines; }
+	uint64_t bytes() const { return offset_; }
+
+private:
+	void flush();
+
+	std::string			base_;
+	int				data_fd_ = -1, idx_fd_ = -1;
+	spectrogram_header		hdr_ = {};
+	std::vector<uint8_t>		codes_;		/* Lines of the block being filled */
+	std::vector<spectrogram_line>	meta_;
+	std::vector<uint8_t>		out_;
+	uint64_t			offset_ = 0;
+};
+
+/* Read side, both files mmap()ed read-only */
+class spectrogram {
+public:
+	explicit spectrogram(const std::string &base);
+	~spectrogram();
+
+	spectrogram(const spectrogram &) = delete;
+	spectrogram &operator=(const spectrogram &) = delete;
+
+	const spectrogram_header &header() const { return *hdr_; }
+	unsigned int bins() const { return hdr_->bins; }
+	double bin_hz() const { return hdr_->sample_rate / hdr_->fft_size; }
+	float db(uint8_t code) const { return hdr_->db_min + code * hdr_->db_step; }
+	/* Line duration, ns */
+	int64_t line_ns() const;
+
+	const spectrogram_block *blocks() const { return blocks_; }
+	uint64_t block_count() const { return count_; }
+	uint64_t lines() const;
+
+	/* Decode block i, appending bins() codes per line to codes and its lines to meta */
+	void decode(uint64_t i, std::vector<uint8_t> &codes,
+		    std::vector<spectrogram_line> &meta) const;
+	/*
+	 * Lines starting in [t0_ns, t1_ns), found by a binary search on the
+	 * index, decoded as decode() does. Returns the number of lines.
+	 */
+	size_t read(int64_t t0_ns, int64_t t1_ns, std::vector<uint8_t> &codes,
+		    std::vector<spectrogram_line> &meta) const;
+
+private:
+	const spectrogram_header	*hdr_ = nullptr;
+	const spectrogram_block		*blocks_ = nullptr;
+	uint64_t			count_ = 0;
+	const uint8_t			*data_ = nullptr;
+	void				*idx_map_ = nullptr, *data_map_ = nullptr;
+	size_t				idx_len_ = 0, data_len_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Bounded lock-free single producer, single consumer queue.
+ */
+
+#ifndef CX88SDR_SPSC_QUEUE_HPP
+#define CX88SDR_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace cx88sdr {
+
+template <typename T>
+class spsc_queue {
+public:
+	/* Capacity is rounded up to a power of two */
+	explicit spsc_queue(size_t capacity)
+	{
+		size_t size = 2;
+
+		while (size < capacity)
+			size <<= 1;
+		mask_ = size - 1;
+		slots_.reset(new T[size]);
+	}
+
+	spsc_queue(const spsc_queue &) = delete;
+	spsc_queue &operator=(const spsc_queue &) = delete;
+
+	/* Producer side */
+	bool push(const T &val)
+	{
+		size_t tail = tail_.load(std::memory_order_relaxed);
+
+		if (tail - head_cache_ > mask_) {
+			head_cache_ = head_.load(std::memory_order_acquire);
+			if (tail - head_cache_ > mask_)
+				return false;
+		}
+		slots_[tail & mask_] = val;
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/* Consumer side */
+	bool pop(T &val)
+	{
+		size_t head = head_.load(std::memory_order_relaxed);
+
+		if (head == tail_cache_) {
+			tail_cache_ = tail_.load(std::memory_order_acquire);
+			if (head == tail_cache_)
+				return false;
+		}
+		val = slots_[head & mask_];
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t size_approx() const
+	{
+		return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed);
+	}
+
+	size_t capacity() const { return mask_ + 1; }
+
+private:
+	static constexpr size_t cacheline = 64;
+
+	std::unique_ptr<T[]>			slots_;
+	size_t					mask_;
+
+	/* Written by the consumer */
+	alignas(cacheline) std::atomic<size_t>	head_{0};
+	size_t					tail_cache_ = 0;
+
+	/* Written by the producer */
+	alignas(cacheline) std::atomic<size_t>	tail_{0};
+	size_t					head_cache_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Time-base corrector for composite video captured in a raw video mode
+ * (Mode control). Finds the sync pulses in the ADC stream, takes each line
+ * from its hsync leading edge to the next one, to a fraction of a sample,
+ * and resamples it to a fixed number of pixels, so tape timebase errors
+ * come out as straight lines. Fields are numbered from the vertical sync
+ * and output as 8-bit frames, one byte per pixel, blanking included.
+ *
+ * Sync search runs on the calling thread with vector compares, line
+ * resampling is spread over the worker threads.
+ */
+
+#ifndef CX88SDR_TBC_HPP
+#define CX88SDR_TBC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace cx88sdr {
+
+class workers;
+
+enum class video_standard {
+	ntsc,		/* 525 lines, 910 pixels (4fsc) */
+	pal,		/* 625 lines, 1135 pixels (4fsc) */
+};
+
+struct tbc_options {
+	video_standard	standard = video_standard::ntsc;
+	double		in_rate = 0;		/* Use device::achieved_rate() */
+	unsigned int	width = 0;		/* Pixels per line, 0: 4fsc */
+	/*
+	 * Frame rows: false puts both fields in line number order (first
+	 * field, then second), true weaves them with the top field (PAL first
+	 * field, NTSC second field) on the even rows.
+	 */
+	bool		weave = false;
+	unsigned int	threads = 1;		/* 0: one per CPU */
+};
+
+struct tbc_stats {
+	uint64_t	lines;			/* Lines timed from their own sync */
+	uint64_t	flywheel;		/* Lines whose sync was missing */
+	uint64_t	relocks;		/* Times the line lock was lost */
+	uint64_t	fields;
+	uint64_t	frames;
+	uint64_t	dropped;		/* Frames missing a field */
+};
+
+class tbc {
+public:
+	explicit tbc(const tbc_options &opts);
+	~tbc();
+
+	tbc(const tbc &) = delete;
+	tbc &operator=(const tbc &) = delete;
+
+	/* Feed n samples, appends each frame they complete to out */
+	size_t process(const uint8_t *in, size_t n, std::vector<uint8_t> &out);
+	size_t process(const uint16_t *in, size_t n, std::vector<uint8_t> &out);
+
+	unsigned int width() const { return width_; }
+	unsigned int height() const { return height_; }
+	size_t frame_size() const { return static_cast<size_t>(width_) * height_; }
+	/* Frame rate as a fraction, for container headers */
+	unsigned int rate_num() const { return rate_num_; }
+	unsigned int rate_den() const { return rate_den_; }
+	const tbc_stats &stats() const { return stats_; }
+	/* Sync tip and blanking levels in use, 8-bit */
+	double sync_level() const { return tip_; }
+	double blank_level() const { return blank_; }
+
+private:
+	struct frame;
+
+	struct line {
+		double		start;		/* Absolute sample of the hsync leading edge */
+		bool		timed;		/* Start taken from a pulse, not the flywheel */
+		bool		hsync;		/* Timed by a normal hsync pulse */
+		int		field = -1;	/* 0: first, 1: second */
+		int		number = -1;	/* Line within the field */
+		frame		*fr = nullptr;
+	};
+
+	struct job {
+		double		start, len;	/* Absolute samples */
+		uint8_t		*dst;
+	};
+
+	size_t run(std::vector<uint8_t> &out);
+	void advance(double pos);
+	void pulse(double start, double width);
+	void push_line(double start, bool measured, bool hsync);
+	void bind(line &l, int field, int number);
+	void vsync(bool second);
+	void close_field();
+	void retire();
+	void unlock();
+	void histogram_levels(const uint8_t *p, size_t n);
+	void set_threshold();
+
+	/* Standard */
+	unsigned int			width_, height_, rate_num_, rate_den_;
+	unsigned int			field_lines_[2];
+	unsigned int			vsync_line_;	/* Field line the first broad pulse falls in */
+	bool				weave_;
+	int				top_;		/* Field on the even rows when weaving */
+	double				us_;		/* Samples per microsecond */
+	double				h_nom_;
+
+	/* Input, buf_[0] is absolute sample base_ */
+	std::vector<uint8_t>		buf_;
+	int64_t				base_ = 0;
+	int64_t				scan_ = 0;
+	bool				in_pulse_ = false;
+	double				pulse_start_ = 0;
+
+	/* Levels and the edge thresholds derived from them */
+	double				tip_ = 0, blank_ = 0;
+	bool				levels_ = false;
+	uint8_t				thr_lo_ = 0, thr_hi_ = 0;
+	double				thr_ = 0;
+
+	/* Line lock */
+	bool				locked_ = false;
+	double				h_, next_ = 0, last_hsync_ = -1;
+	unsigned int			miss_ = 0;
+	bool				in_vsync_ = false;
+	std::deque<line>		lines_;		/* Recent lines, retired in order */
+
+	/* Field numbering and frames */
+	int				field_ = -1;
+	int				next_number_ = 0;
+	std::deque<std::unique_ptr<frame>> frames_;
+	frame				*cur_ = nullptr;
+	std::vector<job>		jobs_;
+
+	tbc_stats			stats_ = {};
+	std::unique_ptr<workers>	pool_;
+};
+
+}
+
+#endif
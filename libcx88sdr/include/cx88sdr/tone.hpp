@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Single-tone ADC figures of merit after IEEE 1241: a capture of a clean
+ * sine goes through averaged, 4-term Blackman-Harris windowed power
+ * spectra, and the bins are split into DC, the tone, its harmonics (folded
+ * into the first Nyquist zone) and noise. Levels are in dBFS, a full-scale
+ * sine reads 0 dB:
+ *
+ *   SNR    tone over noise, harmonics left out
+ *   THD    harmonics over tone, dBc
+ *   SINAD  tone over noise and harmonics
+ *   ENOB   (SINAD - 1.76) / 6.02, and enob_fs referred to a full-scale tone
+ *   SFDR   tone over the highest other bin outside DC, dBc
+ *
+ * Noise is the mean of the noise bins times all bins but DC, so the bins
+ * taken by harmonics don't lower it.
+ */
+
+#ifndef CX88SDR_TONE_HPP
+#define CX88SDR_TONE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cx88sdr {
+
+class fft;
+class workers;
+
+struct tone_options {
+	unsigned int	fft_size = 65536;	/* Power of two, 1024 to 1048576 */
+	double		in_rate = 0;		/* Use device::achieved_rate() */
+	double		tone_hz = 0;		/* Input frequency, 0: the highest bin */
+	unsigned int	harmonics = 5;		/* Highest harmonic counted in THD */
+	unsigned int	threads = 0;		/* 0: one per CPU */
+};
+
+struct tone_result {
+	uint64_t	frames;		/* Spectra averaged */
+	double		tone_hz;	/* Measured, in the first Nyquist zone */
+	double		tone_dbfs;
+	double		noise_dbfs;	/* Total over the band */
+	double		snr_db;
+	double		thd_db;
+	double		sinad_db;
+	double		enob;
+	double		enob_fs;
+	double		sfdr_db;
+	double		spur_hz;	/* Highest bin that set the SFDR */
+	double		clip_rate;	/* Share of samples on the lowest or highest 8-bit code */
+};
+
+class tone_analyzer {
+public:
+	explicit tone_analyzer(const tone_options &opts);
+	~tone_analyzer();
+
+	tone_analyzer(const tone_analyzer &) = delete;
+	tone_analyzer &operator=(const tone_analyzer &) = delete;
+
+	/* Whole frames of n samples, at least one; the rest is ignored */
+	tone_result analyze(const uint8_t *in, size_t n);
+	tone_result analyze(const uint16_t *in, size_t n);
+
+	unsigned int fft_size() const { return n_; }
+	double bin_hz() const { return rate_ / n_; }
+	/* Averaged power of the last analysis, fft_size / 2 + 1 bins, dBFS */
+	std::vector<double> spectrum_db() const;
+
+private:
+	template <typename T> tone_result run(const T *in, size_t n);
+	tone_result measure(uint64_t clipped, uint64_t samples, uint64_t frames) const;
+
+	unsigned int			n_, harmonics_;
+	double				rate_, tone_hz_;
+	std::vector<float>		win_;
+	double				scale_;
+	std::unique_ptr<fft>		fft_;
+	std::vector<double>		power_;	/* One-sided, scaled to dBFS, n_ / 2 + 1 bins */
+	std::unique_ptr<workers>	pool_;
+};
+
+}
+
+#endif
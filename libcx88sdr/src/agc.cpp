@@ -0,0 +1,253 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "cx88sdr/agc.hpp"
+#include "simd.hpp"
+
+namespace cx88sdr {
+
+/* Controls ranges, as registered by the driver */
+static constexpr int gain_max = 31;
+static constexpr int gain2_max = 16;
+static constexpr int dc_max = 64;
+
+struct minmax {
+	uint32_t	min, max;
+	uint64_t	sum, low, high;
+};
+
+/*
+ * Vectorizes to packed min/max/compare. 32-bit accumulators keep the
+ * widening cheap, callers pass at most 2^24 samples.
+ */
+CX88SDR_SIMD
+static minmax scan_ru8(const uint8_t *__restrict in, size_t n)
+{
+	uint32_t sum = 0, low = 0, high = 0;
+	uint8_t lo = 255, hi = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		lo = std::min(lo, in[i]);
+		hi = std::max(hi, in[i]);
+		sum += in[i];
+		low += (in[i] == 0);
+		high += (in[i] == 255);
+	}
+	return { lo, hi, sum, low, high };
+}
+
+CX88SDR_SIMD
+static minmax scan_ru16(const uint16_t *__restrict in, size_t n)
+{
+	uint32_t sum = 0, low = 0, high = 0;
+	uint16_t lo = 255, hi = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		uint16_t v = in[i] >> 8;
+
+		lo = std::min(lo, v);
+		hi = std::max(hi, v);
+		sum += v;
+		low += (v == 0);
+		high += (v == 255);
+	}
+	return { lo, hi, sum, low, high };
+}
+
+/*
+ * Every hist_stride-th sample only, percentiles do not need more and the
+ * histogram is the one part that does not vectorize. Four interleaved
+ * tables break the store-to-load dependency on runs of equal codes.
+ */
+template <typename T, unsigned int S>
+static uint64_t histogram(const T *in, size_t n, uint64_t *hist)
+{
+	constexpr size_t st = level_stats::hist_stride;
+	uint32_t h[4][256] = {};
+	size_t i = 0;
+
+	for (; i + 4 * st <= n; i += 4 * st) {
+		h[0][in[i] >> S]++;
+		h[1][in[i + st] >> S]++;
+		h[2][in[i + 2 * st] >> S]++;
+		h[3][in[i + 3 * st] >> S]++;
+	}
+	for (; i < n; i += st)
+		h[0][in[i] >> S]++;
+	for (unsigned int b = 0; b < 256; b++)
+		hist[b] += static_cast<uint64_t>(h[0][b]) + h[1][b] + h[2][b] + h[3][b];
+	return (n + st - 1) / st;
+}
+
+/* Chunks keep the 32-bit counters from overflowing */
+static constexpr size_t chunk = 1 << 24;
+
+void level_stats::add(const uint8_t *in, size_t n)
+{
+	for (size_t off = 0; off < n; off += chunk) {
+		size_t len = std::min(chunk, n - off);
+		minmax r = scan_ru8(in + off, len);
+
+		hist_count += histogram<uint8_t, 0>(in + off, len, hist);
+		min = std::min(min, r.min);
+		max = std::max(max, r.max);
+		sum += r.sum;
+		clip_low += r.low;
+		clip_high += r.high;
+		count += len;
+	}
+}
+
+void level_stats::add(const uint16_t *in, size_t n)
+{
+	for (size_t off = 0; off < n; off += chunk) {
+		size_t len = std::min(chunk, n - off);
+		minmax r = scan_ru16(in + off, len);
+
+		hist_count += histogram<uint16_t, 8>(in + off, len, hist);
+		min = std::min(min, r.min);
+		max = std::max(max, r.max);
+		sum += r.sum;
+		clip_low += r.low;
+		clip_high += r.high;
+		count += len;
+	}
+}
+
+unsigned int level_stats::percentile(double p) const
+{
+	uint64_t target = static_cast<uint64_t>(p * hist_count), acc = 0;
+
+	for (unsigned int b = 0; b < 256; b++) {
+		acc += hist[b];
+		if (acc > target)
+			return b;
+	}
+	return 255;
+}
+
+double level_stats::level() const
+{
+	double lo = 128.0 - percentile(0.001), hi = percentile(0.999) + 1 - 128.0;
+
+	return std::max(lo, hi) / 128.0;
+}
+
+agc::agc(device &dev, const agc_options &opts)
+	: dev_(&dev), opts_(opts), sample_size_(dev.sample_size())
+{
+	ctl_.gain = dev.control(V4L2_CID_GAIN);
+	ctl_.gain_6db = dev.control(V4L2_CID_CX88SDR_GAIN_6DB);
+	ctl_.gain2 = dev.control(V4L2_CID_CX88SDR_AGC_ADJ3);
+	ctl_.dc = dev.control(V4L2_CID_CX88SDR_AGC_TIP3);
+	dev.subscribe_config();
+}
+
+agc::agc(const agc_controls &start, const agc_options &opts)
+	: opts_(opts), ctl_(start)
+{
+}
+
+void agc::set(const char *name, uint32_t id, int &cur, int val,
+	      const level_stats &s, std::vector<agc_change> &out)
+{
+	uint64_t sample = 0;
+
+	if (dev_) {
+		config_change c;
+		bool marked = false;
+
+		dev_->set_control(id, val);
+		/* The driver queues the change's position before VIDIOC_S_CTRL returns */
+		while (!marked && dev_->next_config(c, 0))
+			marked = c.id == id && c.value == val;
+		sample = (marked ? c.pos : dev_->pos().write) / sample_size_;
+	}
+	out.push_back({ sample, name, cur, val, s.level(), s.clip_rate(), s.mean() });
+	cur = val;
+}
+
+/* Up: Gain, then +6dB, then Gain 2. Down: Gain 2, then Gain, then +6dB */
+bool agc::step_gain(int dir, const level_stats &s, std::vector<agc_change> &out)
+{
+	if (dir > 0) {
+		if (ctl_.gain < gain_max)
+			set("gain", V4L2_CID_GAIN, ctl_.gain, ctl_.gain + 1, s, out);
+		else if (!ctl_.gain_6db)
+			set("gain_6db", V4L2_CID_CX88SDR_GAIN_6DB, ctl_.gain_6db, 1, s, out);
+		else if (ctl_.gain2 < gain2_max)
+			set("gain2", V4L2_CID_CX88SDR_AGC_ADJ3, ctl_.gain2, ctl_.gain2 + 1, s, out);
+		else
+			return false;
+	} else {
+		if (ctl_.gain2 > 0)
+			set("gain2", V4L2_CID_CX88SDR_AGC_ADJ3, ctl_.gain2, ctl_.gain2 - 1, s, out);
+		else if (ctl_.gain > 0)
+			set("gain", V4L2_CID_GAIN, ctl_.gain, ctl_.gain - 1, s, out);
+		else if (ctl_.gain_6db)
+			set("gain_6db", V4L2_CID_CX88SDR_GAIN_6DB, ctl_.gain_6db, 0, s, out);
+		else
+			return false;
+	}
+	return true;
+}
+
+std::vector<agc_change> agc::update(const level_stats &s)
+{
+	std::vector<agc_change> out;
+	double level = s.level(), offset = (s.mean() - 127.5) / 128.0;
+
+	if (!s.count)
+		return out;
+
+	/* The window still holds samples from before the last change */
+	if (settle_) {
+		settle_--;
+		return out;
+	}
+
+	if (opts_.dc) {
+		/* Learn which way DC Offset moves the mean from the last step */
+		if (dc_probe_) {
+			if (std::fabs(offset) > std::fabs(dc_mean_) && (offset > 0) == (dc_mean_ > 0))
+				dc_dir_ = -dc_dir_;
+			dc_probe_ = false;
+		}
+
+		off_ = (std::fabs(offset) > opts_.dc_max) ? off_ + 1 : 0;
+		if (off_ >= opts_.hold) {
+			int val = ctl_.dc + ((offset > 0) ? -dc_dir_ : dc_dir_);
+
+			if (val >= 0 && val <= dc_max) {
+				dc_mean_ = offset;
+				dc_probe_ = true;
+				set("dc_offset", V4L2_CID_CX88SDR_AGC_TIP3, ctl_.dc, val, s, out);
+			}
+			off_ = 0;
+		}
+	}
+
+	if (opts_.gain) {
+		bool hot = s.clip_rate() > opts_.clip_max || level > opts_.level_high;
+		bool cold = !hot && level < opts_.level_low;
+
+		hot_ = hot ? hot_ + 1 : 0;
+		cold_ = cold ? cold_ + 1 : 0;
+		if (hot_ >= opts_.hold || cold_ >= opts_.hold) {
+			step_gain(hot_ ? -1 : 1, s, out);
+			hot_ = 0;
+			cold_ = 0;
+		}
+	}
+
+	if (!out.empty())
+		settle_ = opts_.settle;
+	return out;
+}
+
+}
@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "cx88sdr/audio.hpp"
+
+namespace cx88sdr {
+
+static std::system_error sys_error(const std::string &what)
+{
+	return std::system_error(errno, std::generic_category(), what);
+}
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+	int ret;
+
+	do {
+		ret = ioctl(fd, req, arg);
+	} while (ret < 0 && errno == EINTR);
+	return ret;
+}
+
+audio_device::audio_device(const std::string &path) : path_(path)
+{
+	struct cx88sdr_xrefs x = {};
+
+	fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd_ < 0)
+		throw sys_error("open " + path);
+	if (xioctl(fd_, CX88SDR_IOC_G_XREF, &x) < 0) {
+		std::system_error e = (errno == ENOTTY) ?
+			std::system_error(ENODEV, std::generic_category(),
+					  path + " is not a cx88_sdr audio node") :
+			sys_error(path + ": CX88SDR_IOC_G_XREF");
+
+		::close(fd_);
+		throw e;
+	}
+}
+
+audio_device::~audio_device()
+{
+	if (fd_ >= 0)
+		::close(fd_);
+}
+
+std::string audio_device::find(const device &main)
+{
+	DIR *dir = opendir("/sys/class/video4linux");
+	std::string bus = main.bus_info(), found;
+	struct dirent *ent;
+
+	if (!dir)
+		return {};
+
+	while ((ent = readdir(dir)) && found.empty()) {
+		std::string name = ent->d_name, label;
+		struct v4l2_capability cap = {};
+		int fd;
+
+		if (name.rfind("swradio", 0))
+			continue;
+		std::ifstream f("/sys/class/video4linux/" + name + "/name");
+		if (!std::getline(f, label) || label != "CX2388x SDR Audio")
+			continue;
+
+		/* The audio node reports the bus of its card */
+		fd = ::open(("/dev/" + name).c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		if (xioctl(fd, VIDIOC_QUERYCAP, &cap) == 0 &&
+		    bus == reinterpret_cast<const char *>(cap.bus_info))
+			found = "/dev/" + name;
+		::close(fd);
+	}
+	closedir(dir);
+	return found;
+}
+
+size_t audio_device::read(int16_t *buf, size_t frames)
+{
+	uint8_t *p = reinterpret_cast<uint8_t *>(buf);
+	size_t want = frames * frame_size, got = 0;
+
+	/* A signal can split a frame, finish it */
+	while (got < want && (got == 0 || got % frame_size)) {
+		ssize_t ret = ::read(fd_, p + got, want - got);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && errno == EAGAIN && !got)
+			return 0;
+		if (ret < 0)
+			throw sys_error(path_ + ": read");
+		got += static_cast<size_t>(ret);
+	}
+	return got / frame_size;
+}
+
+position audio_device::pos() const
+{
+	struct cx88sdr_pos p = {};
+
+	if (xioctl(fd_, CX88SDR_IOC_G_POS, &p) < 0)
+		throw sys_error(path_ + ": CX88SDR_IOC_G_POS");
+	return { p.read, p.write, p.size };
+}
+
+std::vector<audio_xref> audio_device::xrefs(uint64_t *seq) const
+{
+	struct cx88sdr_xrefs x = {};
+	std::vector<audio_xref> v;
+
+	if (xioctl(fd_, CX88SDR_IOC_G_XREF, &x) < 0)
+		throw sys_error(path_ + ": CX88SDR_IOC_G_XREF");
+	for (uint32_t i = 0; i < x.count && i < CX88SDR_XREF_MAX; i++)
+		v.push_back({ x.xref[i].audio, x.xref[i].main, x.xref[i].ts_ns });
+	if (seq)
+		*seq = x.seq;
+	return v;
+}
+
+audio_clock audio_device::fit(const std::vector<audio_xref> &x)
+{
+	double ma = 0, mm = 0, saa = 0, sam = 0;
+	audio_clock c;
+
+	if (x.size() < 2)
+		return c;
+
+	/* Relative to the first one, absolute positions lose bits in a double */
+	for (const audio_xref &r : x) {
+		ma += static_cast<double>(r.audio - x[0].audio);
+		mm += static_cast<double>(r.main - x[0].main);
+	}
+	ma /= static_cast<double>(x.size());
+	mm /= static_cast<double>(x.size());
+	for (const audio_xref &r : x) {
+		double a = static_cast<double>(r.audio - x[0].audio) - ma;
+		double m = static_cast<double>(r.main - x[0].main) - mm;
+
+		saa += a * a;
+		sam += a * m;
+	}
+	if (saa == 0)
+		return c;
+
+	c.ratio = sam / saa;
+	c.offset = static_cast<double>(x[0].main) + mm -
+		   c.ratio * (static_cast<double>(x[0].audio) + ma);
+	return c;
+}
+
+}
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ */
+
+#include <cstring>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "cx88sdr/capture.hpp"
+
+namespace cx88sdr {
+
+reader::reader(device &dev, size_t block_size, mode m)
+	: dev_(dev), mode_(m)
+{
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+	block_size_ = (block_size + page - 1) / page * page;
+	if (block_size_ > dev_.ring_size() / 4)
+		block_size_ = dev_.ring_size() / 4;
+
+	if (mode_ != mode::read && dev_.map_ring())
+		mode_ = mode::mmap;
+	else
+		mode_ = mode::read;
+
+	if (mode_ == mode::mmap && !dev_.seeked())
+		pos_ = dev_.pos().write;
+	else
+		pos_ = dev_.pos().read;
+}
+
+/* Wait for a full block past pos_, skipping ahead if DMA lapped us */
+uint64_t reader::wait_block(unsigned int timeout_ms)
+{
+	uint64_t write = dev_.wait(pos_ + block_size_, timeout_ms);
+	uint64_t lost = 0;
+
+	if (write < pos_ + block_size_)
+		return UINT64_MAX;
+
+	if (write - pos_ > dev_.ring_size() - guard) {
+		uint64_t restart = write - block_size_;
+
+		lost = restart - pos_;
+		pos_ = restart;
+	}
+	return lost;
+}
+
+bool reader::next(block &b, unsigned int timeout_ms)
+{
+	if (mode_ == mode::read) {
+		buf_.resize(block_size_);
+		return next_into(b, buf_.data(), timeout_ms);
+	}
+
+	uint64_t lost = wait_block(timeout_ms);
+
+	if (lost == UINT64_MAX)
+		return false;
+
+	b.data = dev_.ring_base() + (pos_ % dev_.ring_size());
+	b.size = block_size_;
+	b.pos = pos_;
+	b.lost = lost;
+	pos_ += block_size_;
+	return true;
+}
+
+bool reader::valid(const block &b) const
+{
+	if (mode_ == mode::read)
+		return true;
+	return dev_.pos().write - b.pos <= dev_.ring_size() - guard;
+}
+
+bool reader::next_into(block &b, uint8_t *buf, unsigned int timeout_ms)
+{
+	if (mode_ == mode::mmap) {
+		uint64_t lost = wait_block(timeout_ms);
+		bool ok;
+
+		if (lost == UINT64_MAX)
+			return false;
+
+		b.data = dev_.ring_base() + (pos_ % dev_.ring_size());
+		b.pos = pos_;
+		memcpy(buf, b.data, block_size_);
+		b.data = buf;
+		b.size = block_size_;
+		ok = valid(b);
+		b.lost = lost + (ok ? 0 : block_size_);
+		pos_ += block_size_;
+		return true;
+	}
+
+	struct pollfd pfd = { dev_.fd(), POLLIN, 0 };
+	size_t done = 0;
+
+	if (poll(&pfd, 1, static_cast<int>(timeout_ms)) <= 0)
+		return false;
+
+	/* Blocking read(), returns once the whole block is there */
+	while (done < block_size_)
+		done += dev_.read(buf + done, block_size_ - done);
+
+	b.data = buf;
+	b.size = block_size_;
+	b.pos = pos_;
+	b.lost = (dev_.pos().write - pos_ > dev_.ring_size()) ? block_size_ : 0;
+	pos_ += block_size_;
+	return true;
+}
+
+}
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Channel k of frame n, ending at input sample t = n * D:
+ *
+ *   y_k[n] = sum_l h[l] x[t - l] e^(-2 pi j k (t - l) / M)
+ *          = e^(-2 pi j k t / M) sum_m u[m] e^(2 pi j k m / M)
+ *   u[m]   = sum_p h[m + p M] x[t - m - p M]
+ *
+ * u is the polyphase FIR, the sum over m an inverse DFT of a real frame:
+ * the conjugate of its forward DFT. Frames n and n + 1 go through one
+ * complex FFT as u_n + j u_n+1 and are separated per selected channel.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "cx88sdr/channelizer.hpp"
+#include "cx88sdr/convert.hpp"
+#include "cx88sdr/fft.hpp"
+#include "kaiser.hpp"
+#include "simd.hpp"
+#include "workers.hpp"
+
+namespace cx88sdr {
+
+/* Input samples per task, small enough to balance, large enough to amortise */
+static constexpr size_t task_inputs = 32768;
+
+channelizer::channelizer(const channelizer_options &opts)
+	: m_(opts.channels), taps_(opts.taps)
+{
+	unsigned int os = opts.oversample;
+	size_t len = static_cast<size_t>(m_) * taps_;
+	double fc = 0.5 / m_, beta = kaiser_beta(opts.atten_db), half = len / 2.0, sum = 0;
+	std::vector<double> h(len);
+
+	if (m_ < 16 || m_ > 65536 || (m_ & (m_ - 1)))
+		throw std::invalid_argument("channelizer: channels must be a power of two, 16 to 65536");
+	if (!os || (os & (os - 1)) || os > m_ / 8)
+		throw std::invalid_argument("channelizer: oversample must be a power of two up to channels / 8");
+	if (!taps_)
+		throw std::invalid_argument("channelizer: taps must be positive");
+	d_ = m_ / os;
+
+	select_ = opts.select;
+	if (select_.empty()) {
+		for (unsigned int k = 0; k <= m_ / 2; k++)
+			select_.push_back(k);
+	}
+	for (unsigned int k : select_) {
+		if (k >= m_)
+			throw std::invalid_argument("channelizer: channel out of range");
+	}
+
+	/* Lowpass with its -6 dB point at the channel edge, in_rate / 2M */
+	for (size_t l = 0; l < len; l++) {
+		double t = l - (len - 1) / 2.0;
+		double x = 2 * M_PI * fc * t;
+
+		h[l] = 2 * fc * ((x == 0) ? 1 : std::sin(x) / x) * kaiser(t, half, beta);
+		sum += h[l];
+	}
+
+	poly_.resize(len);
+	for (unsigned int p = 0; p < taps_; p++) {
+		for (unsigned int i = 0; i < m_; i++)
+			poly_[static_cast<size_t>(p) * m_ + i] =
+				static_cast<float>(h[static_cast<size_t>(p) * m_ + m_ - 1 - i] / sum);
+	}
+
+	rot_.resize(m_);
+	for (unsigned int i = 0; i < m_; i++)
+		rot_[i] = std::polar(1.0f, static_cast<float>(-2 * M_PI * i / m_));
+
+	fft_ = std::make_unique<fft>(m_);
+
+	/* Silence before the first sample */
+	base_ = -static_cast<int64_t>(len - 1);
+	buf_.assign(len - 1, 0.0f);
+
+	pool_ = std::make_unique<workers>(opts.threads);
+}
+
+channelizer::~channelizer() = default;
+
+/*
+ * v[i] = sum_p poly[p][i] x[i - p M], i.e. u[M - 1 - i] with x at t - (M - 1),
+ * for two frames d samples apart: they share the coefficient loads, and the
+ * sums stay in registers across taps.
+ */
+CX88SDR_SIMD
+static void poly_fir(const float *x, size_t d, const float *poly, unsigned int m,
+		     unsigned int taps, float *v0, float *v1)
+{
+	for (unsigned int i = 0; i < m; i += 16) {
+		v8f acc00 = {}, acc01 = {}, acc10 = {}, acc11 = {};
+
+		for (unsigned int p = 0; p < taps; p++) {
+			const float *xp = x + i - static_cast<size_t>(p) * m;
+			const float *hp = poly + static_cast<size_t>(p) * m + i;
+			v8f h0, h1, a0, a1, b0, b1;
+
+			v8f_load(h0, hp);
+			v8f_load(h1, hp + 8);
+			v8f_load(a0, xp);
+			v8f_load(a1, xp + 8);
+			v8f_load(b0, xp + d);
+			v8f_load(b1, xp + d + 8);
+			acc00 += a0 * h0;
+			acc01 += a1 * h1;
+			acc10 += b0 * h0;
+			acc11 += b1 * h1;
+		}
+		v8f_store(v0 + i, acc00);
+		v8f_store(v0 + i + 8, acc01);
+		v8f_store(v1 + i, acc10);
+		v8f_store(v1 + i + 8, acc11);
+	}
+}
+
+size_t channelizer::run(std::vector<std::vector<std::complex<float>>> &out)
+{
+	int64_t last = base_ + static_cast<int64_t>(buf_.size()) - 1;
+	size_t n, pairs, per_task, tasks, first;
+	uint64_t end;
+
+	if (last < 0)
+		return 0;
+
+	/* Frames in pairs, frame n needs input up to n * D */
+	end = static_cast<uint64_t>(last) / d_ + 1;
+	end &= ~static_cast<uint64_t>(1);
+	if (end <= frames_)
+		return 0;
+
+	n = end - frames_;
+	pairs = n / 2;
+	per_task = std::max<size_t>(1, task_inputs / (2 * d_));
+	tasks = (pairs + per_task - 1) / per_task;
+	out.resize(select_.size());
+	first = out[0].size();
+	for (auto &o : out)
+		o.resize(first + n);
+
+	pool_->run(tasks, [&](size_t task) {
+		std::vector<float> v0(m_), v1(m_), re(m_), im(m_);
+		size_t pair = task * per_task, stop = std::min(pairs, pair + per_task);
+
+		for (; pair < stop; pair++) {
+			uint64_t f = frames_ + 2 * pair;
+			/* Index into buf_ of x[t - (M - 1)] for frame f */
+			int64_t x0 = static_cast<int64_t>(f * d_) - (m_ - 1) - base_;
+
+			poly_fir(&buf_[x0], d_, poly_.data(), m_, taps_, v0.data(), v1.data());
+			for (unsigned int m = 0; m < m_; m++) {
+				re[fft_->perm(m)] = v0[m_ - 1 - m];
+				im[fft_->perm(m)] = v1[m_ - 1 - m];
+			}
+			fft_->forward_permuted(re.data(), im.data());
+
+			/* Power of two M, phases modulo M are masks */
+			unsigned int mask = m_ - 1;
+			unsigned int r0 = static_cast<unsigned int>(f * d_) & mask, r1 = (r0 + d_) & mask;
+			size_t o = 2 * pair;
+
+			for (size_t c = 0; c < select_.size(); c++) {
+				unsigned int k = select_[c], kk = (m_ - k) & mask;
+				float zr = re[k], zi = im[k], cr = re[kk], ci = -im[kk];
+				/* conj() of the separated forward DFTs, halved */
+				std::complex<float> y0(0.5f * (zr + cr), -0.5f * (zi + ci));
+				std::complex<float> y1(0.5f * (zi - ci), 0.5f * (zr - cr));
+
+				out[c][first + o] = y0 * rot_[(r0 * k) & mask];
+				out[c][first + o + 1] = y1 * rot_[(r1 * k) & mask];
+			}
+		}
+	});
+
+	/* Keep what the next frame still needs */
+	int64_t keep = static_cast<int64_t>(end * d_) - static_cast<int64_t>(poly_.size() - 1);
+
+	buf_.erase(buf_.begin(), buf_.begin() + (keep - base_));
+	base_ = keep;
+	frames_ = end;
+	return n;
+}
+
+size_t channelizer::process(const float *in, size_t n,
+			    std::vector<std::vector<std::complex<float>>> &out)
+{
+	buf_.insert(buf_.end(), in, in + n);
+	inputs_ += n;
+	return run(out);
+}
+
+size_t channelizer::process(const uint8_t *in, size_t n,
+			    std::vector<std::vector<std::complex<float>>> &out)
+{
+	size_t old = buf_.size();
+
+	buf_.resize(old + n);
+	convert::ru8_to_f32(in, &buf_[old], n);
+	inputs_ += n;
+	return run(out);
+}
+
+size_t channelizer::process(const uint16_t *in, size_t n,
+			    std::vector<std::vector<std::complex<float>>> &out)
+{
+	size_t old = buf_.size();
+
+	buf_.resize(old + n);
+	convert::ru16_to_f32(in, &buf_[old], n);
+	inputs_ += n;
+	return run(out);
+}
+
+}
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Plain loops written for the vectorizer, see simd.hpp.
+ */
+
+#include "cx88sdr/convert.hpp"
+#include "simd.hpp"
+
+namespace cx88sdr {
+namespace convert {
+
+CX88SDR_SIMD
+void ru8_to_f32(const uint8_t *__restrict in, float *__restrict out, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = (static_cast<float>(in[i]) - 128.0f) * (1.0f / 128.0f);
+}
+
+CX88SDR_SIMD
+void ru16_to_f32(const uint16_t *__restrict in, float *__restrict out, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = (static_cast<float>(in[i]) - 32768.0f) * (1.0f / 32768.0f);
+}
+
+CX88SDR_SIMD
+void ru8_to_cf32(const uint8_t *__restrict in, float *__restrict out, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[2 * i] = (static_cast<float>(in[i]) - 128.0f) * (1.0f / 128.0f);
+		out[2 * i + 1] = 0.0f;
+	}
+}
+
+CX88SDR_SIMD
+void ru8_to_cs16(const uint8_t *__restrict in, int16_t *__restrict out, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[2 * i] = static_cast<int16_t>((in[i] - 128) * 256);
+		out[2 * i + 1] = 0;
+	}
+}
+
+CX88SDR_SIMD
+void ru8_to_cs8(const uint8_t *__restrict in, int8_t *__restrict out, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[2 * i] = static_cast<int8_t>(in[i] ^ 0x80);
+		out[2 * i + 1] = 0;
+	}
+}
+
+CX88SDR_SIMD
+void ru16_to_cf32(const uint16_t *__restrict in, float *__restrict out, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[2 * i] = (static_cast<float>(in[i]) - 32768.0f) * (1.0f / 32768.0f);
+		out[2 * i + 1] = 0.0f;
+	}
+}
+
+CX88SDR_SIMD
+void ru16_to_cs16(const uint16_t *__restrict in, int16_t *__restrict out, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[2 * i] = static_cast<int16_t>(in[i] ^ 0x8000);
+		out[2 * i + 1] = 0;
+	}
+}
+
+CX88SDR_SIMD
+void ru16_to_cs8(const uint16_t *__restrict in, int8_t *__restrict out, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[2 * i] = static_cast<int8_t>((in[i] >> 8) ^ 0x80);
+		out[2 * i + 1] = 0;
+	}
+}
+
+}
+}
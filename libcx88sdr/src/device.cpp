@@ -0,0 +1,449 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "cx88sdr/device.hpp"
+
+namespace cx88sdr {
+
+static std::system_error sys_error(const std::string &what)
+{
+	return std::system_error(errno, std::generic_category(), what);
+}
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+	int ret;
+
+	do {
+		ret = ioctl(fd, req, arg);
+	} while (ret < 0 && errno == EINTR);
+	return ret;
+}
+
+device::device(const std::string &path) : path_(path)
+{
+	struct v4l2_capability cap = {};
+	struct cx88sdr_pos p = {};
+
+	fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd_ < 0)
+		throw sys_error("open " + path);
+
+	if (xioctl(fd_, VIDIOC_QUERYCAP, &cap) < 0 ||
+	    strcmp(reinterpret_cast<const char *>(cap.driver), "cx88_sdr")) {
+		close();
+		throw std::system_error(ENODEV, std::generic_category(),
+					path + " is not a cx88_sdr device");
+	}
+
+	if (xioctl(fd_, CX88SDR_IOC_G_POS, &p) < 0) {
+		close();
+		throw sys_error(path + ": CX88SDR_IOC_G_POS");
+	}
+	ring_size_ = p.size;
+}
+
+device::~device()
+{
+	close();
+}
+
+device::device(device &&other) noexcept
+{
+	*this = std::move(other);
+}
+
+device &device::operator=(device &&other) noexcept
+{
+	if (this != &other) {
+		close();
+		fd_ = std::exchange(other.fd_, -1);
+		path_ = std::move(other.path_);
+		map_ = std::exchange(other.map_, nullptr);
+		map_len_ = std::exchange(other.map_len_, 0);
+		ring_size_ = other.ring_size_;
+		seeked_ = other.seeked_;
+		configs_ = std::move(other.configs_);
+		faults_ = std::move(other.faults_);
+	}
+	return *this;
+}
+
+void device::close()
+{
+	if (map_)
+		munmap(map_, map_len_);
+	map_ = nullptr;
+	map_len_ = 0;
+	if (fd_ >= 0)
+		::close(fd_);
+	fd_ = -1;
+}
+
+device device::open_index(unsigned int nr)
+{
+	return device("/dev/swradio" + std::to_string(nr));
+}
+
+std::vector<std::string> device::enumerate()
+{
+	std::vector<std::pair<unsigned int, std::string>> found;
+	DIR *dir = opendir("/sys/class/video4linux");
+	struct dirent *ent;
+
+	if (!dir)
+		return {};
+
+	while ((ent = readdir(dir))) {
+		unsigned int nr;
+		std::string name = ent->d_name;
+		char link[256];
+		ssize_t len;
+
+		if (sscanf(ent->d_name, "swradio%u", &nr) != 1)
+			continue;
+		len = readlink(("/sys/class/video4linux/" + name + "/device/driver").c_str(),
+			       link, sizeof(link) - 1);
+		if (len <= 0)
+			continue;
+		link[len] = '\0';
+		if (std::string(link).rfind("/cx88_sdr") == std::string::npos)
+			continue;
+		/* A card's audio node shares its PCI device */
+		std::ifstream f("/sys/class/video4linux/" + name + "/name");
+		std::string label;
+		if (std::getline(f, label) && label == "CX2388x SDR Audio")
+			continue;
+		found.emplace_back(nr, "/dev/" + name);
+	}
+	closedir(dir);
+
+	std::sort(found.begin(), found.end());
+	std::vector<std::string> paths;
+	for (auto &f : found)
+		paths.push_back(f.second);
+	return paths;
+}
+
+std::vector<std::string> device::enumerate_replay()
+{
+	std::vector<std::pair<unsigned int, std::string>> found;
+	DIR *dir = opendir("/sys/class/video4linux");
+	struct dirent *ent;
+
+	if (!dir)
+		return {};
+
+	/* No PCI device to follow, go by the node name */
+	while ((ent = readdir(dir))) {
+		unsigned int nr;
+		std::string label;
+
+		if (sscanf(ent->d_name, "swradio%u", &nr) != 1)
+			continue;
+		std::ifstream f(std::string("/sys/class/video4linux/") + ent->d_name + "/name");
+		if (std::getline(f, label) && label == "CX2388x SDR Replay")
+			found.emplace_back(nr, std::string("/dev/") + ent->d_name);
+	}
+	closedir(dir);
+
+	std::sort(found.begin(), found.end());
+	std::vector<std::string> paths;
+	for (auto &f : found)
+		paths.push_back(f.second);
+	return paths;
+}
+
+std::string device::bus_info() const
+{
+	struct v4l2_capability cap = {};
+
+	if (xioctl(fd_, VIDIOC_QUERYCAP, &cap) < 0)
+		throw sys_error(path_ + ": VIDIOC_QUERYCAP");
+	return reinterpret_cast<const char *>(cap.bus_info);
+}
+
+std::vector<int> device::local_cpus() const
+{
+	std::string node = path_.substr(path_.rfind('/') + 1);
+	std::ifstream f("/sys/class/video4linux/" + node + "/device/local_cpulist");
+	std::vector<int> cpus;
+	std::string range;
+
+	/* "0-7,16-23" */
+	while (std::getline(f, range, ',')) {
+		int lo, hi;
+
+		if (sscanf(range.c_str(), "%d-%d", &lo, &hi) == 2) {
+			for (int cpu = lo; cpu <= hi; cpu++)
+				cpus.push_back(cpu);
+		} else if (sscanf(range.c_str(), "%d", &lo) == 1) {
+			cpus.push_back(lo);
+		}
+	}
+	return cpus;
+}
+
+void device::set_sample_rate(uint32_t hz)
+{
+	struct v4l2_frequency f = {};
+
+	f.type = V4L2_TUNER_SDR;
+	f.frequency = hz;
+	if (xioctl(fd_, VIDIOC_S_FREQUENCY, &f) < 0)
+		throw sys_error(path_ + ": VIDIOC_S_FREQUENCY");
+}
+
+uint32_t device::sample_rate() const
+{
+	struct v4l2_frequency f = {};
+
+	f.type = V4L2_TUNER_SDR;
+	if (xioctl(fd_, VIDIOC_G_FREQUENCY, &f) < 0)
+		throw sys_error(path_ + ": VIDIOC_G_FREQUENCY");
+	return f.frequency;
+}
+
+/* Same PLL search as cx88sdr_adc_fmt_set(), from the driver's CX88SDR_XTAL_FREQ */
+double device::achieved_rate(uint32_t hz, format fmt)
+{
+	const int64_t xtal = 28636363;
+	int64_t pll_freq = (fmt == format::ru16le) ? 2LL * hz : hz;
+	int64_t pll_int, pll_frac = 0;
+
+	for (pll_int = 14; pll_int < 64; pll_int++) {
+		pll_frac = pll_freq * 0x2000000LL / xtal - (pll_int << 20);
+		if (pll_frac <= 0xfffff)
+			break;
+	}
+
+	return static_cast<double>(xtal) * static_cast<double>((pll_int << 20) + pll_frac) /
+	       static_cast<double>(1 << 25) / ((fmt == format::ru16le) ? 2 : 1);
+}
+
+void device::set_format(format fmt)
+{
+	struct v4l2_format f = {};
+
+	f.type = V4L2_BUF_TYPE_SDR_CAPTURE;
+	f.fmt.sdr.pixelformat = static_cast<uint32_t>(fmt);
+	if (xioctl(fd_, VIDIOC_S_FMT, &f) < 0)
+		throw sys_error(path_ + ": VIDIOC_S_FMT");
+}
+
+format device::get_format() const
+{
+	struct v4l2_format f = {};
+
+	f.type = V4L2_BUF_TYPE_SDR_CAPTURE;
+	if (xioctl(fd_, VIDIOC_G_FMT, &f) < 0)
+		throw sys_error(path_ + ": VIDIOC_G_FMT");
+	return static_cast<format>(f.fmt.sdr.pixelformat);
+}
+
+size_t device::sample_size() const
+{
+	return (get_format() == format::ru16le) ? 2 : 1;
+}
+
+int32_t device::control(uint32_t id) const
+{
+	struct v4l2_control c = {};
+
+	c.id = id;
+	if (xioctl(fd_, VIDIOC_G_CTRL, &c) < 0)
+		throw sys_error(path_ + ": VIDIOC_G_CTRL");
+	return c.value;
+}
+
+void device::set_control(uint32_t id, int32_t val)
+{
+	struct v4l2_control c = {};
+
+	c.id = id;
+	c.value = val;
+	if (xioctl(fd_, VIDIOC_S_CTRL, &c) < 0)
+		throw sys_error(path_ + ": VIDIOC_S_CTRL");
+}
+
+void device::set_gain(int val)		{ set_control(V4L2_CID_GAIN, val); }
+void device::set_gain_6db(bool on)	{ set_control(V4L2_CID_CX88SDR_GAIN_6DB, on); }
+void device::set_gain2(int val)		{ set_control(V4L2_CID_CX88SDR_AGC_ADJ3, val); }
+void device::set_dc_offset(int val)	{ set_control(V4L2_CID_CX88SDR_AGC_TIP3, val); }
+void device::set_input(int val)		{ set_control(V4L2_CID_CX88SDR_INPUT, val); }
+void device::set_afc_pll(bool on)	{ set_control(V4L2_CID_CX88SDR_AFC_PLL, on); }
+void device::set_input_vsync(bool on)	{ set_control(V4L2_CID_CX88SDR_INPUT_VSYNC, on); }
+void device::set_htotal(int val)	{ set_control(V4L2_CID_CX88SDR_HTOTAL, val); }
+void device::set_irq_interval(int pages) { set_control(V4L2_CID_CX88SDR_IRQ_PAGES, pages); }
+void device::set_position_poll(int us)	{ set_control(V4L2_CID_CX88SDR_POS_POLL, us); }
+void device::set_holdoff(int us)	{ set_control(V4L2_CID_CX88SDR_HOLDOFF, us); }
+void device::set_mode(int mode)		{ set_control(V4L2_CID_CX88SDR_MODE, mode); }
+
+position device::pos() const
+{
+	struct cx88sdr_pos p = {};
+
+	if (xioctl(fd_, CX88SDR_IOC_G_POS, &p) < 0)
+		throw sys_error(path_ + ": CX88SDR_IOC_G_POS");
+	return { p.read, p.write, p.size };
+}
+
+seek_result device::do_seek(uint32_t whence, uint64_t pos, int64_t time_ns)
+{
+	struct cx88sdr_seek s = {};
+
+	s.whence = whence;
+	s.pos = pos;
+	s.time_ns = time_ns;
+	if (xioctl(fd_, CX88SDR_IOC_SEEK, &s) < 0)
+		throw sys_error(path_ + ": CX88SDR_IOC_SEEK");
+	seeked_ = true;
+	return { s.pos, s.lost };
+}
+
+seek_result device::seek(uint64_t pos)
+{
+	return do_seek(CX88SDR_SEEK_SET, pos, 0);
+}
+
+seek_result device::seek_oldest(uint64_t pos)
+{
+	return do_seek(CX88SDR_SEEK_OLDEST, pos, 0);
+}
+
+seek_result device::seek_time(int64_t time_ns)
+{
+	return do_seek(CX88SDR_SEEK_TIME, 0, time_ns);
+}
+
+uint64_t device::wait(uint64_t pos, unsigned int timeout_ms) const
+{
+	struct cx88sdr_wait w = {};
+
+	w.pos = pos;
+	w.timeout_ms = timeout_ms;
+	if (xioctl(fd_, CX88SDR_IOC_WAIT, &w) < 0 && errno != ETIMEDOUT && errno != EAGAIN)
+		throw sys_error(path_ + ": CX88SDR_IOC_WAIT");
+	return w.write;
+}
+
+void device::subscribe_config()
+{
+	struct v4l2_event_subscription sub = {};
+
+	sub.type = CX88SDR_EVENT_CONFIG;
+	if (xioctl(fd_, VIDIOC_SUBSCRIBE_EVENT, &sub) < 0)
+		throw sys_error(path_ + ": VIDIOC_SUBSCRIBE_EVENT");
+}
+
+void device::subscribe_faults()
+{
+	struct v4l2_event_subscription sub = {};
+
+	sub.type = CX88SDR_EVENT_FAULT;
+	if (xioctl(fd_, VIDIOC_SUBSCRIBE_EVENT, &sub) < 0)
+		throw sys_error(path_ + ": VIDIOC_SUBSCRIBE_EVENT");
+}
+
+/* Move the next event to its queue, false if none within timeout_ms */
+bool device::dequeue(int timeout_ms)
+{
+	struct pollfd pfd = { fd_, POLLPRI, 0 };
+	struct v4l2_event ev = {};
+
+	if (poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR)
+		throw sys_error(path_ + ": poll");
+	if (!(pfd.revents & POLLPRI))
+		return false;
+	if (xioctl(fd_, VIDIOC_DQEVENT, &ev) < 0) {
+		if (errno == ENOENT)
+			return false;
+		throw sys_error(path_ + ": VIDIOC_DQEVENT");
+	}
+
+	if (ev.type == CX88SDR_EVENT_CONFIG) {
+		struct cx88sdr_event_config cfg;
+
+		memcpy(&cfg, ev.u.data, sizeof(cfg));
+		configs_.push_back({ cfg.pos, cfg.settled, cfg.id, cfg.value });
+	} else if (ev.type == CX88SDR_EVENT_FAULT) {
+		struct cx88sdr_event_fault flt;
+
+		memcpy(&flt, ev.u.data, sizeof(flt));
+		faults_.push_back({ flt.pos, flt.faults, flt.status, flt.fifo_overflows,
+				    flt.sync_errors, flt.risc_errors, flt.pci_errors });
+	}
+	return true;
+}
+
+bool device::next_config(config_change &c, int timeout_ms)
+{
+	while (configs_.empty()) {
+		if (!dequeue(timeout_ms))
+			return false;
+	}
+	c = configs_.front();
+	configs_.pop_front();
+	return true;
+}
+
+bool device::next_fault(fault_event &f, int timeout_ms)
+{
+	while (faults_.empty()) {
+		if (!dequeue(timeout_ms))
+			return false;
+	}
+	f = faults_.front();
+	faults_.pop_front();
+	return true;
+}
+
+size_t device::read(void *buf, size_t len)
+{
+	ssize_t ret;
+
+	do {
+		ret = ::read(fd_, buf, len);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0) {
+		if (errno == EAGAIN)
+			return 0;
+		throw sys_error(path_ + ": read");
+	}
+	return static_cast<size_t>(ret);
+}
+
+bool device::map_ring()
+{
+	void *map;
+
+	if (map_)
+		return true;
+
+	map = mmap(nullptr, 2 * ring_size_, PROT_READ, MAP_SHARED, fd_, 0);
+	if (map == MAP_FAILED)
+		return false;
+	map_ = map;
+	map_len_ = 2 * ring_size_;
+	return true;
+}
+
+}
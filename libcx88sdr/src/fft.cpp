@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ */
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include "cx88sdr/fft.hpp"
+#include "simd.hpp"
+
+namespace cx88sdr {
+
+fft::fft(unsigned int n) : n_(n)
+{
+	unsigned int bits = 0;
+
+	if (n < 16 || (n & (n - 1)))
+		throw std::invalid_argument("fft: size must be a power of two, at least 16");
+	while ((1U << bits) < n)
+		bits++;
+
+	rev_.resize(n);
+	for (unsigned int i = 0; i < n; i++) {
+		unsigned int r = 0;
+
+		for (unsigned int b = 0; b < bits; b++)
+			r |= ((i >> b) & 1) << (bits - 1 - b);
+		rev_[i] = r;
+	}
+
+	tw_re_.resize(n - 1);
+	tw_im_.resize(n - 1);
+	for (unsigned int h = 1; h < n; h <<= 1) {
+		for (unsigned int j = 0; j < h; j++) {
+			double a = -M_PI * j / h;
+
+			tw_re_[h - 1 + j] = static_cast<float>(std::cos(a));
+			tw_im_[h - 1 + j] = static_cast<float>(std::sin(a));
+		}
+	}
+}
+
+typedef int v8i __attribute__((vector_size(32)));
+
+/*
+ * Stages with h < 8 pair points inside one vector. They run on two
+ * vectors (16 points) at a time: shuffle the a and b points of each pair
+ * into separate vectors, butterfly, shuffle back.
+ */
+struct small_stage {
+	v8i	a, b;		/* Lanes of (x0, x1) holding a and b points */
+	v8i	x0, x1;		/* Lanes of (a, b) holding x0 and x1 */
+	v8f	wr, wi;
+};
+
+static const float c8 = static_cast<float>(M_SQRT1_2);
+
+static const small_stage small_stages[3] = {
+	{	/* h = 1, w = 1 */
+		{ 0, 2, 4, 6, 8, 10, 12, 14 }, { 1, 3, 5, 7, 9, 11, 13, 15 },
+		{ 0, 8, 1, 9, 2, 10, 3, 11 }, { 4, 12, 5, 13, 6, 14, 7, 15 },
+		{ 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 0, 0, 0, 0, 0, 0 },
+	},
+	{	/* h = 2, w = 1, -j */
+		{ 0, 1, 4, 5, 8, 9, 12, 13 }, { 2, 3, 6, 7, 10, 11, 14, 15 },
+		{ 0, 1, 8, 9, 2, 3, 10, 11 }, { 4, 5, 12, 13, 6, 7, 14, 15 },
+		{ 1, 0, 1, 0, 1, 0, 1, 0 }, { 0, -1, 0, -1, 0, -1, 0, -1 },
+	},
+	{	/* h = 4, w = e^(-pi j k / 4) */
+		{ 0, 1, 2, 3, 8, 9, 10, 11 }, { 4, 5, 6, 7, 12, 13, 14, 15 },
+		{ 0, 1, 2, 3, 8, 9, 10, 11 }, { 4, 5, 6, 7, 12, 13, 14, 15 },
+		{ 1, c8, 0, -c8, 1, c8, 0, -c8 }, { 0, -c8, -1, -c8, 0, -c8, -1, -c8 },
+	},
+};
+
+CX88SDR_SIMD
+static void fft_stages(float *re, float *im, unsigned int n, const float *tw_re,
+		       const float *tw_im)
+{
+	/* Radix-2 DIT */
+	for (unsigned int g = 0; g < n; g += 16) {
+		v8f r0, r1, i0, i1;
+
+		v8f_load(r0, re + g);
+		v8f_load(r1, re + g + 8);
+		v8f_load(i0, im + g);
+		v8f_load(i1, im + g + 8);
+		for (const small_stage &st : small_stages) {
+			v8f ar = __builtin_shuffle(r0, r1, st.a), br = __builtin_shuffle(r0, r1, st.b);
+			v8f ai = __builtin_shuffle(i0, i1, st.a), bi = __builtin_shuffle(i0, i1, st.b);
+			v8f tr = br * st.wr - bi * st.wi, ti = br * st.wi + bi * st.wr;
+
+			br = ar - tr;
+			bi = ai - ti;
+			ar += tr;
+			ai += ti;
+			r0 = __builtin_shuffle(ar, br, st.x0);
+			r1 = __builtin_shuffle(ar, br, st.x1);
+			i0 = __builtin_shuffle(ai, bi, st.x0);
+			i1 = __builtin_shuffle(ai, bi, st.x1);
+		}
+		v8f_store(re + g, r0);
+		v8f_store(re + g + 8, r1);
+		v8f_store(im + g, i0);
+		v8f_store(im + g + 8, i1);
+	}
+
+	for (unsigned int h = 8; h < n; h <<= 1) {
+		const float *wr = tw_re + h - 1, *wi = tw_im + h - 1;
+
+		for (unsigned int g = 0; g < n; g += 2 * h) {
+			float *ar = re + g, *ai = im + g, *br = ar + h, *bi = ai + h;
+
+			for (unsigned int j = 0; j < h; j += 8) {
+				v8f xr, xi, yr, yi, cr, ci, tr, ti;
+
+				v8f_load(xr, ar + j);
+				v8f_load(xi, ai + j);
+				v8f_load(yr, br + j);
+				v8f_load(yi, bi + j);
+				v8f_load(cr, wr + j);
+				v8f_load(ci, wi + j);
+				tr = yr * cr - yi * ci;
+				ti = yr * ci + yi * cr;
+				v8f_store(br + j, xr - tr);
+				v8f_store(bi + j, xi - ti);
+				v8f_store(ar + j, xr + tr);
+				v8f_store(ai + j, xi + ti);
+			}
+		}
+	}
+}
+
+void fft::forward_permuted(float *re, float *im) const
+{
+	fft_stages(re, im, n_, tw_re_.data(), tw_im_.data());
+}
+
+void fft::forward(float *re, float *im) const
+{
+	for (unsigned int i = 0; i < n_; i++) {
+		if (i < rev_[i]) {
+			std::swap(re[i], re[rev_[i]]);
+			std::swap(im[i], im[rev_[i]]);
+		}
+	}
+	forward_permuted(re, im);
+}
+
+}
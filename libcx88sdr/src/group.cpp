@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "cx88sdr/group.hpp"
+
+namespace cx88sdr {
+
+static std::system_error sys_error(const std::string &what)
+{
+	return std::system_error(errno, std::generic_category(), what);
+}
+
+static int xioctl(int fd, unsigned long req, void *arg)
+{
+	int ret;
+
+	do {
+		ret = ioctl(fd, req, arg);
+	} while (ret < 0 && errno == EINTR);
+	return ret;
+}
+
+group_device::group_device(const std::string &path) : path_(path)
+{
+	struct cx88sdr_group_pos p = {};
+
+	fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd_ < 0)
+		throw sys_error("open " + path);
+	if (xioctl(fd_, CX88SDR_IOC_G_GROUP, &p) < 0) {
+		std::system_error e = (errno == ENOTTY) ?
+			std::system_error(ENODEV, std::generic_category(),
+					  path + " is not a cx88_sdr group node") :
+			sys_error(path + ": CX88SDR_IOC_G_GROUP");
+
+		::close(fd_);
+		throw e;
+	}
+	cards_ = p.cards;
+	page_ = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+group_device::~group_device()
+{
+	if (fd_ >= 0)
+		::close(fd_);
+}
+
+std::string group_device::find()
+{
+	DIR *dir = opendir("/sys/class/video4linux");
+	struct dirent *ent;
+	std::string found;
+
+	if (!dir)
+		return {};
+
+	while ((ent = readdir(dir)) && found.empty()) {
+		std::string name = ent->d_name, label;
+
+		if (name.rfind("swradio", 0))
+			continue;
+		std::ifstream f("/sys/class/video4linux/" + name + "/name");
+		if (std::getline(f, label) && label == "CX2388x SDR Group")
+			found = "/dev/" + name;
+	}
+	closedir(dir);
+	return found;
+}
+
+void group_device::set_sample_rate(uint32_t hz)
+{
+	struct v4l2_frequency f = {};
+
+	f.type = V4L2_TUNER_SDR;
+	f.frequency = hz;
+	if (xioctl(fd_, VIDIOC_S_FREQUENCY, &f) < 0)
+		throw sys_error(path_ + ": VIDIOC_S_FREQUENCY");
+}
+
+void group_device::set_format(format fmt)
+{
+	struct v4l2_format f = {};
+
+	f.type = V4L2_BUF_TYPE_SDR_CAPTURE;
+	f.fmt.sdr.pixelformat = static_cast<uint32_t>(fmt);
+	if (xioctl(fd_, VIDIOC_S_FMT, &f) < 0)
+		throw sys_error(path_ + ": VIDIOC_S_FMT");
+}
+
+size_t group_device::read(uint8_t *buf, size_t frames)
+{
+	size_t want = frames * frame_size(), got = 0;
+
+	/* A signal can split a frame, finish it */
+	while (got < want && (got == 0 || got % frame_size())) {
+		ssize_t ret = ::read(fd_, buf + got, want - got);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && errno == EAGAIN && !got)
+			return 0;
+		if (ret < 0)
+			throw sys_error(path_ + ": read");
+		got += static_cast<size_t>(ret);
+	}
+	return got / frame_size();
+}
+
+group_state group_device::state() const
+{
+	struct cx88sdr_group_pos p = {};
+	group_state s;
+
+	if (xioctl(fd_, CX88SDR_IOC_G_GROUP, &p) < 0)
+		throw sys_error(path_ + ": CX88SDR_IOC_G_GROUP");
+	s.frame = p.frame;
+	s.lost = p.lost;
+	for (uint32_t i = 0; i < p.cards && i < CX88SDR_GROUP_MAX; i++)
+		s.cards.push_back({ p.card[i].read, p.card[i].write, p.card[i].size });
+	return s;
+}
+
+}
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Kaiser window helpers for the windowed sinc filter designs.
+ */
+
+#ifndef CX88SDR_KAISER_HPP
+#define CX88SDR_KAISER_HPP
+
+#include <cmath>
+
+namespace cx88sdr {
+
+static inline double bessel_i0(double x)
+{
+	double sum = 1, term = 1;
+
+	for (int k = 1; k < 50 && term > 1e-12 * sum; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static inline double kaiser_beta(double atten_db)
+{
+	if (atten_db > 50)
+		return 0.1102 * (atten_db - 8.7);
+	if (atten_db > 21)
+		return 0.5842 * std::pow(atten_db - 21, 0.4) + 0.07886 * (atten_db - 21);
+	return 0;
+}
+
+/* Window value at t, for a window spanning (-half, half) */
+static inline double kaiser(double t, double half, double beta)
+{
+	return (std::fabs(t) < half) ? bessel_i0(beta * std::sqrt(1 - (t / half) * (t / half))) : 0;
+}
+
+}
+
+#endif
@@ -0,0 +1,485 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cx88sdr/recording.hpp"
+
+namespace cx88sdr {
+
+static std::system_error sys_error(const std::string &what)
+{
+	return std::system_error(errno, std::generic_category(), what);
+}
+
+static void write_all(int fd, const void *data, size_t len, const std::string &what)
+{
+	const uint8_t *p = static_cast<const uint8_t *>(data);
+
+	while (len) {
+		ssize_t ret = ::write(fd, p, len);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			throw sys_error(what);
+		p += ret;
+		len -= static_cast<size_t>(ret);
+	}
+}
+
+recording_ctrl recording_ctrl::from(const device &dev)
+{
+	struct v4l2_format f = {};
+	recording_ctrl c = {};
+
+	f.type = V4L2_BUF_TYPE_SDR_CAPTURE;
+	if (ioctl(dev.fd(), VIDIOC_G_FMT, &f) < 0)
+		throw sys_error(dev.path() + ": VIDIOC_G_FMT");
+
+	c.freq = dev.sample_rate();
+	c.pixelformat = f.fmt.sdr.pixelformat;
+	c.buffersize = f.fmt.sdr.buffersize;
+	c.gain = static_cast<uint32_t>(dev.control(V4L2_CID_GAIN));
+	c.agc_adj3 = static_cast<uint32_t>(dev.control(V4L2_CID_CX88SDR_AGC_ADJ3));
+	c.agc_tip3 = static_cast<uint32_t>(dev.control(V4L2_CID_CX88SDR_AGC_TIP3));
+	c.input = static_cast<uint32_t>(dev.control(V4L2_CID_CX88SDR_INPUT));
+	c.htotal = static_cast<uint32_t>(dev.control(V4L2_CID_CX88SDR_HTOTAL));
+	c.irq_pages = static_cast<uint32_t>(dev.control(V4L2_CID_CX88SDR_IRQ_PAGES));
+	c.pos_poll = static_cast<uint32_t>(dev.control(V4L2_CID_CX88SDR_POS_POLL));
+	c.holdoff = static_cast<uint32_t>(dev.control(V4L2_CID_CX88SDR_HOLDOFF));
+	c.gain_6db = static_cast<uint32_t>(dev.control(V4L2_CID_CX88SDR_GAIN_6DB));
+	c.afc_pll = static_cast<uint32_t>(dev.control(V4L2_CID_CX88SDR_AFC_PLL));
+	c.input_vsync = static_cast<uint32_t>(dev.control(V4L2_CID_CX88SDR_INPUT_VSYNC));
+	return c;
+}
+
+/* ISO 8601 UTC with nanoseconds, as SigMF core:datetime */
+static std::string iso8601(int64_t ns)
+{
+	time_t secs = static_cast<time_t>(ns / 1000000000);
+	long frac = static_cast<long>(ns % 1000000000);
+	char buf[64], out[80];
+	struct tm tm;
+
+	if (frac < 0) {
+		secs--;
+		frac += 1000000000;
+	}
+	gmtime_r(&secs, &tm);
+	strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+	snprintf(out, sizeof(out), "%s.%09ldZ", buf, frac);
+	return out;
+}
+
+std::string fault_names(uint32_t faults)
+{
+	static const char *const names[] = { "FIFO overflow", "sync error", "RISC error",
+					     "PCI error" };
+	std::string out;
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (faults & (1U << i))
+			out += (out.empty() ? "" : ", ") + std::string(names[i]);
+	}
+	return out.empty() ? "fault" : out;
+}
+
+static const char *control_name(uint32_t id)
+{
+	switch (id) {
+	case CX88SDR_CONFIG_RATE:		return "sample_rate";
+	case CX88SDR_CONFIG_FORMAT:		return "pixelformat";
+	case V4L2_CID_GAIN:			return "gain";
+	case V4L2_CID_CX88SDR_GAIN_6DB:		return "gain_6db";
+	case V4L2_CID_CX88SDR_AGC_ADJ3:		return "agc_adj3";
+	case V4L2_CID_CX88SDR_AGC_TIP3:		return "agc_tip3";
+	case V4L2_CID_CX88SDR_INPUT:		return "input";
+	case V4L2_CID_CX88SDR_AFC_PLL:		return "afc_pll";
+	case V4L2_CID_CX88SDR_INPUT_VSYNC:	return "input_vsync";
+	case V4L2_CID_CX88SDR_HTOTAL:		return "htotal";
+	default:				return "unknown";
+	}
+}
+
+recording_writer::recording_writer(const std::string &base, const device &dev)
+	: recording_writer(base, dev.achieved_rate(), dev.sample_size(),
+			   recording_ctrl::from(dev), dev.bus_info())
+{
+}
+
+recording_writer::recording_writer(const std::string &base, double sample_rate,
+				   size_t sample_size, const recording_ctrl &ctrl,
+				   const std::string &bus_info)
+	: base_(base)
+{
+	if ((sample_size != 1 && sample_size != 2) || !(sample_rate > 0))
+		throw std::invalid_argument("recording_writer: bad sample size or rate");
+
+	memcpy(hdr_.magic, recording_magic, sizeof(hdr_.magic));
+	hdr_.version = recording_version;
+	hdr_.header_size = sizeof(recording_header);
+	hdr_.record_size = sizeof(index_record);
+	hdr_.sample_size = static_cast<uint32_t>(sample_size);
+	hdr_.sample_rate = sample_rate;
+	hdr_.ctrl = ctrl;
+	strncpy(hdr_.bus_info, bus_info.c_str(), sizeof(hdr_.bus_info) - 1);
+	interval_ = static_cast<uint64_t>(hdr_.sample_rate / 10);
+
+	data_fd_ = ::open((base + ".sigmf-data").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (data_fd_ < 0)
+		throw sys_error("open " + base + ".sigmf-data");
+	idx_fd_ = ::open((base + ".cx88idx").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (idx_fd_ < 0) {
+		std::system_error e = sys_error("open " + base + ".cx88idx");
+
+		::close(data_fd_);
+		throw e;
+	}
+	write_all(idx_fd_, &hdr_, sizeof(hdr_), base_ + ".cx88idx");
+	write_meta();
+}
+
+recording_writer::~recording_writer()
+{
+	try {
+		close();
+	} catch (...) {
+	}
+}
+
+void recording_writer::add(index_record r)
+{
+	write_all(idx_fd_, &r, sizeof(r), base_ + ".cx88idx");
+	hdr_.count++;
+	last_ = r;
+	if (r.type == record_type::time)
+		last_time_ = r;
+	else
+		events_.push_back(r);
+}
+
+/* Index the pending config changes from before stream sample until */
+void recording_writer::flush_config(uint64_t until)
+{
+	size_t ss = hdr_.sample_size, i = 0;
+
+	for (; i < pending_.size() && pending_[i].global / ss < until; i++) {
+		index_record r = pending_[i];
+		uint64_t g = r.global / ss;
+		/* Changes inside a gap land on its first sample */
+		uint64_t back = next_global_ - std::min(g, next_global_);
+
+		if (back <= hdr_.samples - last_.sample) {
+			r.sample = hdr_.samples - back;
+			r.global = g;
+		} else {
+			/* Reported too late to go in order, keep the index sorted */
+			r.sample = last_.sample;
+			r.global = last_.global;
+		}
+		r.time_ns = last_time_.time_ns +
+			    std::llround((static_cast<double>(r.global) - last_time_.global) *
+					 1e9 / hdr_.sample_rate);
+		add(r);
+	}
+	pending_.erase(pending_.begin(), pending_.begin() + static_cast<ptrdiff_t>(i));
+}
+
+void recording_writer::write(const uint8_t *data, size_t n, uint64_t pos, int64_t time_ns)
+{
+	size_t ss = hdr_.sample_size;
+	uint64_t global = pos / ss, count = n / ss;
+	/* Stream time of the first sample */
+	int64_t t0 = time_ns - std::llround(count * 1e9 / hdr_.sample_rate);
+
+	if (data_fd_ < 0)
+		throw std::logic_error("recording_writer: closed");
+
+	if (!started_) {
+		started_ = true;
+		global0_ = next_global_ = global;
+		hdr_.start_ns = t0;
+		add({ 0, global, t0, record_type::time, 0, 0 });
+	} else if (global > next_global_) {
+		uint64_t lost = global - next_global_;
+
+		flush_config(global);
+		add({ hdr_.samples, global, t0, record_type::gap, 0, static_cast<int64_t>(lost) });
+		gaps_++;
+		lost_ += lost;
+	} else if (global < next_global_) {
+		/* Overlap with what is already written */
+		uint64_t skip = std::min<uint64_t>(next_global_ - global, count);
+
+		data += skip * ss;
+		count -= skip;
+		global += skip;
+	}
+	if (!count)
+		return;
+
+	write_all(data_fd_, data, count * ss, base_ + ".sigmf-data");
+	hdr_.samples += count;
+	next_global_ = global + count;
+	flush_config(next_global_);
+
+	if (hdr_.samples - last_time_.sample >= interval_)
+		add({ hdr_.samples, next_global_, time_ns, record_type::time, 0, 0 });
+}
+
+void recording_writer::pend(index_record r)
+{
+	auto it = std::upper_bound(pending_.begin(), pending_.end(), r,
+				   [](const index_record &a, const index_record &b) {
+					   return a.global < b.global;
+				   });
+
+	pending_.insert(it, r);
+}
+
+void recording_writer::config(uint64_t pos, uint32_t id, int64_t value)
+{
+	pend({ 0, pos, 0, record_type::config, id, value });
+}
+
+void recording_writer::fault(uint64_t pos, uint32_t faults, uint32_t status)
+{
+	pend({ 0, pos, 0, record_type::fault, faults, status });
+}
+
+void recording_writer::close()
+{
+	if (data_fd_ < 0)
+		return;
+
+	if (started_) {
+		/* Changes at or past the end, e.g. the rate change that ended it */
+		for (index_record &r : pending_)
+			r.global = std::min(r.global, next_global_ * hdr_.sample_size);
+		flush_config(next_global_ + 1);
+	}
+	if (pwrite(idx_fd_, &hdr_, sizeof(hdr_), 0) != sizeof(hdr_) ||
+	    fsync(data_fd_) < 0 || fsync(idx_fd_) < 0) {
+		std::system_error e = sys_error(base_);
+
+		::close(data_fd_);
+		::close(idx_fd_);
+		data_fd_ = idx_fd_ = -1;
+		throw e;
+	}
+	::close(data_fd_);
+	::close(idx_fd_);
+	data_fd_ = idx_fd_ = -1;
+	write_meta();
+}
+
+void recording_writer::write_meta() const
+{
+	const recording_ctrl &c = hdr_.ctrl;
+	std::string tmp = base_ + ".sigmf-meta.tmp";
+	std::ostringstream j;
+
+	j.precision(17);
+	j << "{\n  \"global\": {\n"
+	  << "    \"core:datatype\": \"" << (hdr_.sample_size == 2 ? "ru16_le" : "ru8") << "\",\n"
+	  << "    \"core:sample_rate\": " << hdr_.sample_rate << ",\n"
+	  << "    \"core:version\": \"1.0.0\",\n"
+	  << "    \"core:hw\": \"CX2388x " << hdr_.bus_info << "\",\n"
+	  << "    \"core:recorder\": \"cx88sdr_record\",\n"
+	  << "    \"core:extensions\": [\n"
+	  << "      { \"name\": \"cx88sdr\", \"version\": \"1.0.0\", \"optional\": true }\n"
+	  << "    ],\n"
+	  << "    \"cx88sdr:bus_info\": \"" << hdr_.bus_info << "\",\n"
+	  << "    \"cx88sdr:freq\": " << c.freq << ",\n"
+	  << "    \"cx88sdr:pixelformat\": " << c.pixelformat << ",\n"
+	  << "    \"cx88sdr:buffersize\": " << c.buffersize << ",\n"
+	  << "    \"cx88sdr:gain\": " << c.gain << ",\n"
+	  << "    \"cx88sdr:agc_adj3\": " << c.agc_adj3 << ",\n"
+	  << "    \"cx88sdr:agc_tip3\": " << c.agc_tip3 << ",\n"
+	  << "    \"cx88sdr:input\": " << c.input << ",\n"
+	  << "    \"cx88sdr:htotal\": " << c.htotal << ",\n"
+	  << "    \"cx88sdr:irq_pages\": " << c.irq_pages << ",\n"
+	  << "    \"cx88sdr:pos_poll\": " << c.pos_poll << ",\n"
+	  << "    \"cx88sdr:holdoff\": " << c.holdoff << ",\n"
+	  << "    \"cx88sdr:gain_6db\": " << (c.gain_6db ? "true" : "false") << ",\n"
+	  << "    \"cx88sdr:afc_pll\": " << (c.afc_pll ? "true" : "false") << ",\n"
+	  << "    \"cx88sdr:input_vsync\": " << (c.input_vsync ? "true" : "false") << ",\n"
+	  << "    \"cx88sdr:samples\": " << hdr_.samples << ",\n"
+	  << "    \"cx88sdr:lost\": " << lost_ << "\n"
+	  << "  },\n  \"captures\": [\n"
+	  << "    { \"core:sample_start\": 0, \"core:global_index\": " << global0_
+	  << ", \"core:datetime\": \"" << iso8601(hdr_.start_ns) << "\" }";
+
+	/* A new segment after every gap */
+	for (const index_record &r : events_) {
+		if (r.type == record_type::gap)
+			j << ",\n    { \"core:sample_start\": " << r.sample
+			  << ", \"core:global_index\": " << r.global
+			  << ", \"core:datetime\": \"" << iso8601(r.time_ns) << "\" }";
+	}
+
+	j << "\n  ],\n  \"annotations\": [";
+	for (size_t i = 0; i < events_.size(); i++) {
+		const index_record &r = events_[i];
+
+		j << (i ? ",\n" : "\n") << "    { \"core:sample_start\": " << r.sample << ", ";
+		if (r.type == record_type::gap)
+			j << "\"core:comment\": \"" << r.value << " samples lost\", "
+			  << "\"cx88sdr:lost\": " << r.value << " }";
+		else if (r.type == record_type::fault)
+			j << "\"core:comment\": \"" << fault_names(r.id) << "\", "
+			  << "\"cx88sdr:faults\": " << r.id << ", \"cx88sdr:status\": " << r.value << " }";
+		else
+			j << "\"core:comment\": \"" << control_name(r.id) << " = " << r.value << "\", "
+			  << "\"cx88sdr:control\": " << r.id << ", \"cx88sdr:value\": " << r.value << " }";
+	}
+	j << (events_.empty() ? "]\n}\n" : "\n  ]\n}\n");
+
+	/* Readers never see a half written file */
+	std::ofstream f(tmp, std::ios::trunc);
+
+	f << j.str();
+	f.close();
+	if (!f || rename(tmp.c_str(), (base_ + ".sigmf-meta").c_str()) < 0)
+		throw sys_error("write " + base_ + ".sigmf-meta");
+}
+
+static void *map_file(const std::string &path, size_t &len)
+{
+	struct stat st;
+	void *p = nullptr;
+	int fd;
+
+	fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw sys_error("open " + path);
+	if (fstat(fd, &st) < 0) {
+		std::system_error e = sys_error("stat " + path);
+
+		::close(fd);
+		throw e;
+	}
+	len = static_cast<size_t>(st.st_size);
+	if (len)
+		p = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED)
+		throw sys_error("mmap " + path);
+	return p;
+}
+
+recording::recording(const std::string &base)
+{
+	idx_map_ = map_file(base + ".cx88idx", idx_len_);
+	hdr_ = static_cast<const recording_header *>(idx_map_);
+	if (idx_len_ < sizeof(recording_header) ||
+	    memcmp(hdr_->magic, recording_magic, sizeof(recording_magic)) ||
+	    hdr_->version != recording_version || hdr_->record_size != sizeof(index_record) ||
+	    hdr_->header_size < sizeof(recording_header) || hdr_->header_size > idx_len_ ||
+	    (hdr_->sample_size != 1 && hdr_->sample_size != 2) || !(hdr_->sample_rate > 0)) {
+		if (idx_map_)
+			munmap(idx_map_, idx_len_);
+		throw std::runtime_error(base + ".cx88idx: not a cx88sdr index");
+	}
+	recs_ = reinterpret_cast<const index_record *>(static_cast<const uint8_t *>(idx_map_) +
+							hdr_->header_size);
+	count_ = (idx_len_ - hdr_->header_size) / sizeof(index_record);
+
+	try {
+		data_map_ = map_file(base + ".sigmf-data", data_len_);
+	} catch (...) {
+		munmap(idx_map_, idx_len_);
+		throw;
+	}
+	data_ = static_cast<const uint8_t *>(data_map_);
+	samples_ = data_len_ / hdr_->sample_size;
+}
+
+recording::~recording()
+{
+	if (data_map_)
+		munmap(data_map_, data_len_);
+	munmap(idx_map_, idx_len_);
+}
+
+uint64_t recording::global_of(uint64_t sample) const
+{
+	/* Last record at or before sample, a gap wins over a time record at the same sample */
+	const index_record *r = std::upper_bound(recs_, recs_ + count_, sample,
+						 [](uint64_t s, const index_record &a) {
+							 return s < a.sample;
+						 });
+
+	if (r == recs_)
+		return sample;
+	r--;
+	return r->global + (sample - r->sample);
+}
+
+int64_t recording::time_of(uint64_t sample) const
+{
+	uint64_t g = global_of(sample);
+	const index_record *r = std::upper_bound(recs_, recs_ + count_, g,
+						 [](uint64_t v, const index_record &a) {
+							 return v < a.global;
+						 });
+
+	/* Gap and config records are rare, the time record is close */
+	while (r != recs_ && (r - 1)->type != record_type::time)
+		r--;
+	if (r == recs_)
+		return hdr_->start_ns + std::llround(sample * 1e9 / hdr_->sample_rate);
+	r--;
+	return r->time_ns + std::llround((static_cast<double>(g) - r->global) * 1e9 / hdr_->sample_rate);
+}
+
+uint64_t recording::sample_at(int64_t time_ns) const
+{
+	const index_record *r = std::upper_bound(recs_, recs_ + count_, time_ns,
+						 [](int64_t t, const index_record &a) {
+							 return t < a.time_ns;
+						 });
+	uint64_t g, s;
+
+	if (r == recs_)
+		return 0;
+	r--;
+	g = r->global + static_cast<uint64_t>(std::max(0.0, std::ceil((time_ns - r->time_ns) *
+								  hdr_->sample_rate / 1e9)));
+	s = r->sample + (g - r->global);
+	/* Inside the gap after r: the first sample after it */
+	if (r + 1 != recs_ + count_)
+		s = std::min(s, (r + 1)->sample);
+	return std::min(s, samples_);
+}
+
+std::vector<index_record> recording::events() const
+{
+	std::vector<index_record> ev;
+
+	for (uint64_t i = 0; i < count_; i++) {
+		if (recs_[i].type != record_type::time)
+			ev.push_back(recs_[i]);
+	}
+	return ev;
+}
+
+}
@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "cx88sdr/convert.hpp"
+#include "cx88sdr/resampler.hpp"
+#include "kaiser.hpp"
+#include "simd.hpp"
+#include "workers.hpp"
+
+namespace cx88sdr {
+
+/* Outputs per task, small enough to balance, large enough to amortise */
+static constexpr size_t task_outputs = 16384;
+
+resampler::resampler(const resampler_options &opts)
+{
+	double ratio = opts.out_rate / opts.in_rate, fc, beta, half;
+	unsigned int phases = opts.phases;
+	long double step;
+
+	if (!(opts.in_rate > 0) || !(opts.out_rate > 0))
+		throw std::invalid_argument("resampler: rates must be positive");
+	if (phases < 2 || (phases & (phases - 1)))
+		throw std::invalid_argument("resampler: phases must be a power of two");
+
+	/* Narrower filter, more taps when decimating */
+	taps_ = static_cast<unsigned int>(std::ceil(opts.taps / std::min(1.0, ratio)));
+	taps_ = (std::max(taps_, 8U) + 7) & ~7U;
+	fc = 0.5 * std::min(1.0, ratio) * (1 + opts.bandwidth) / 2;
+	beta = kaiser_beta(opts.atten_db);
+	half = taps_ / 2.0;
+
+	/* Row p is the kernel at fractional delay p / phases */
+	table_.resize(static_cast<size_t>(phases + 1) * taps_);
+	for (unsigned int p = 0; p <= phases; p++) {
+		float *row = &table_[static_cast<size_t>(p) * taps_];
+		double sum = 0;
+
+		for (unsigned int k = 0; k < taps_; k++) {
+			double t = static_cast<double>(p) / phases + half - 1 - k;
+			double w = kaiser(t, half, beta);
+			double x = 2 * M_PI * fc * t;
+			double h = 2 * fc * ((x == 0) ? 1 : std::sin(x) / x) * w;
+
+			row[k] = static_cast<float>(h);
+			sum += h;
+		}
+		for (unsigned int k = 0; k < taps_; k++)
+			row[k] = static_cast<float>(row[k] / sum);
+	}
+
+	shift_ = 64;
+	while (phases >>= 1)
+		shift_--;
+
+	/* 64.64 fixed point input time per output, drift free for any capture length */
+	step = static_cast<long double>(opts.in_rate) / opts.out_rate;
+	step_int_ = static_cast<uint64_t>(step);
+	step_frac_ = static_cast<uint64_t>(std::ldexp(step - step_int_, 64));
+
+	/* Silence before the first sample */
+	base_ = -static_cast<int64_t>(taps_ / 2 - 1);
+	buf_.assign(taps_ / 2 - 1, 0.0f);
+
+	pool_ = std::make_unique<workers>(opts.threads);
+}
+
+resampler::~resampler() = default;
+
+CX88SDR_SIMD
+static void fir_range(const float *x, const float *table, unsigned int taps, unsigned int shift,
+		      uint64_t ipos, uint64_t frac, uint64_t step_int, uint64_t step_frac,
+		      float *out, size_t n)
+{
+	for (size_t o = 0; o < n; o++) {
+		const float *xp = x + ipos;
+		const float *h0 = table + (frac >> shift) * taps;
+		const float *h1 = h0 + taps;
+		float a = static_cast<float>((frac << (64 - shift)) >> 40) * (1.0f / 16777216.0f);
+		v8f acc0 = {}, acc1 = {};
+		uint64_t f;
+
+		for (unsigned int k = 0; k < taps; k += 8) {
+			v8f v, c0, c1;
+
+			v8f_load(v, xp + k);
+			v8f_load(c0, h0 + k);
+			v8f_load(c1, h1 + k);
+			acc0 += v * c0;
+			acc1 += v * c1;
+		}
+		float y0 = v8f_sum(acc0), y1 = v8f_sum(acc1);
+
+		out[o] = y0 + a * (y1 - y0);
+
+		f = frac + step_frac;
+		ipos += step_int + (f < frac);
+		frac = f;
+	}
+}
+
+size_t resampler::run(std::vector<float> &out)
+{
+	/* Output o needs input up to floor(t_o) + taps / 2 */
+	int64_t last = base_ + static_cast<int64_t>(buf_.size()) - 1 - static_cast<int64_t>(taps_ / 2);
+	auto time = [this](uint64_t o, uint64_t &frac) {
+		unsigned __int128 f = static_cast<unsigned __int128>(o) * step_frac_;
+
+		frac = static_cast<uint64_t>(f);
+		return o * step_int_ + static_cast<uint64_t>(f >> 64);
+	};
+	uint64_t end, frac;
+	size_t n, first, tasks;
+	double step = step_int_ + std::ldexp(static_cast<double>(step_frac_), -64);
+
+	if (last < 0)
+		return 0;
+
+	/* First output past the available input */
+	end = static_cast<uint64_t>((last + 1) / step);
+	while (end > outputs_ && time(end - 1, frac) > static_cast<uint64_t>(last))
+		end--;
+	while (time(end, frac) <= static_cast<uint64_t>(last))
+		end++;
+	if (end <= outputs_)
+		return 0;
+
+	n = end - outputs_;
+	first = out.size();
+	out.resize(first + n);
+	tasks = (n + task_outputs - 1) / task_outputs;
+
+	pool_->run(tasks, [&](size_t task) {
+		uint64_t o = outputs_ + task * task_outputs, f;
+		size_t cnt = std::min(task_outputs, static_cast<size_t>(end - o));
+		/* Index into buf_ of the first tap of output o */
+		uint64_t ipos = time(o, f) - (taps_ / 2 - 1) - base_;
+
+		fir_range(buf_.data(), table_.data(), taps_, shift_, ipos, f, step_int_, step_frac_,
+			  &out[first + (o - outputs_)], cnt);
+	});
+
+	/* Keep what the next output still needs */
+	int64_t keep = static_cast<int64_t>(time(end, frac)) - (taps_ / 2 - 1);
+
+	keep = std::min(keep, base_ + static_cast<int64_t>(buf_.size()));
+
+	buf_.erase(buf_.begin(), buf_.begin() + (keep - base_));
+	base_ = keep;
+	outputs_ = end;
+	return n;
+}
+
+size_t resampler::process(const float *in, size_t n, std::vector<float> &out)
+{
+	buf_.insert(buf_.end(), in, in + n);
+	inputs_ += n;
+	return run(out);
+}
+
+size_t resampler::process(const uint8_t *in, size_t n, std::vector<float> &out)
+{
+	size_t old = buf_.size();
+
+	buf_.resize(old + n);
+	convert::ru8_to_f32(in, &buf_[old], n);
+	inputs_ += n;
+	return run(out);
+}
+
+size_t resampler::process(const uint16_t *in, size_t n, std::vector<float> &out)
+{
+	size_t old = buf_.size();
+
+	buf_.resize(old + n);
+	convert::ru16_to_f32(in, &buf_[old], n);
+	inputs_ += n;
+	return run(out);
+}
+
+}
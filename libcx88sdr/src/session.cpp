@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ */
+
+#include <functional>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "cx88sdr/session.hpp"
+
+namespace cx88sdr {
+
+session::session(const std::vector<std::string> &paths, const session_options &opts)
+	: opts_(opts)
+{
+	for (size_t i = 0; i < paths.size(); i++) {
+		auto c = std::make_unique<card_ctx>(paths[i]);
+		std::vector<int> local = c->dev.local_cpus();
+
+		c->rd = std::make_unique<reader>(c->dev, opts_.block_size, opts_.mode);
+		c->full = std::make_unique<spsc_queue<block>>(opts_.queue_depth);
+		c->empty = std::make_unique<spsc_queue<uint8_t *>>(opts_.queue_depth);
+
+		/* Read mode needs buffers, mmap mode hands out ring pointers */
+		if (c->rd->active_mode() == reader::mode::read) {
+			for (size_t n = 0; n < c->full->capacity() - 1; n++) {
+				c->pool.emplace_back(new uint8_t[c->rd->block_size()]);
+				c->empty->push(c->pool.back().get());
+			}
+		}
+
+		if (i < opts_.cpus.size() && opts_.cpus[i] >= 0)
+			c->cpu = opts_.cpus[i];
+		else if (!local.empty())
+			c->cpu = local[i % local.size()];
+		cards_.push_back(std::move(c));
+	}
+}
+
+session::~session()
+{
+	stop();
+}
+
+void session::start()
+{
+	if (running_.exchange(true))
+		return;
+
+	for (auto &c : cards_) {
+		c->thread = std::thread(&session::run, this, std::ref(*c));
+		if (c->cpu >= 0) {
+			cpu_set_t set;
+
+			CPU_ZERO(&set);
+			CPU_SET(c->cpu, &set);
+			pthread_setaffinity_np(c->thread.native_handle(), sizeof(set), &set);
+		}
+	}
+}
+
+void session::stop()
+{
+	if (!running_.exchange(false))
+		return;
+
+	for (auto &c : cards_)
+		if (c->thread.joinable())
+			c->thread.join();
+}
+
+void session::run(card_ctx &c)
+{
+	std::vector<uint8_t> scratch;
+	uint8_t *buf = nullptr;
+
+	while (running_.load(std::memory_order_relaxed)) {
+		block b;
+		bool ok;
+
+		if (c.rd->active_mode() == reader::mode::read) {
+			/* The buffer is kept until a block made it into the queue */
+			if (!buf && !c.empty->pop(buf)) {
+				/* Consumer is behind, keep the stream moving */
+				scratch.resize(c.rd->block_size());
+				if (c.rd->next_into(b, scratch.data(), 100))
+					c.dropped.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			ok = c.rd->next_into(b, buf, 100);
+		} else {
+			ok = c.rd->next(b, 100);
+		}
+
+		if (!ok)
+			continue;
+
+		c.blocks.fetch_add(1, std::memory_order_relaxed);
+		c.bytes.fetch_add(b.size, std::memory_order_relaxed);
+		c.lost.fetch_add(b.lost, std::memory_order_relaxed);
+
+		if (c.full->push(b))
+			buf = nullptr;
+		else
+			c.dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+bool session::pop(size_t i, block &b)
+{
+	return cards_[i]->full->pop(b);
+}
+
+bool session::valid(size_t i, const block &b) const
+{
+	return cards_[i]->rd->valid(b);
+}
+
+void session::release(size_t i, const block &b)
+{
+	card_ctx &c = *cards_[i];
+
+	if (c.rd->active_mode() == reader::mode::read)
+		c.empty->push(const_cast<uint8_t *>(b.data));
+}
+
+card_stats session::stats(size_t i) const
+{
+	const card_ctx &c = *cards_[i];
+	card_stats s;
+
+	s.blocks = c.blocks.load(std::memory_order_relaxed);
+	s.bytes = c.bytes.load(std::memory_order_relaxed);
+	s.lost = c.lost.load(std::memory_order_relaxed);
+	s.dropped = c.dropped.load(std::memory_order_relaxed);
+	return s;
+}
+
+}
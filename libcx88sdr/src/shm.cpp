@@ -0,0 +1,388 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cx88sdr/shm.hpp"
+
+namespace cx88sdr {
+
+static std::system_error sys_error(const std::string &what)
+{
+	return std::system_error(errno, std::generic_category(), what);
+}
+
+static size_t page_align(size_t len)
+{
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+	return (len + page - 1) / page * page;
+}
+
+static size_t slots_len()
+{
+	return page_align(sizeof(shm_slot) * shm_max_readers);
+}
+
+/* Slots read-write, header and data ring with prot, the data ring twice */
+static void *map_object(int fd, size_t hdr_len, size_t size, int prot)
+{
+	size_t data = hdr_len + slots_len();
+	uint8_t *base;
+
+	base = static_cast<uint8_t *>(mmap(nullptr, data + 2 * size, PROT_NONE,
+					   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	if (base == MAP_FAILED)
+		return nullptr;
+
+	if (mmap(base, hdr_len, prot, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+	    mmap(base + hdr_len, slots_len(), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+		 static_cast<off_t>(hdr_len)) == MAP_FAILED ||
+	    mmap(base + data, size, prot, MAP_SHARED | MAP_FIXED, fd,
+		 static_cast<off_t>(data)) == MAP_FAILED ||
+	    mmap(base + data + size, size, prot, MAP_SHARED | MAP_FIXED, fd,
+		 static_cast<off_t>(data)) == MAP_FAILED) {
+		munmap(base, data + 2 * size);
+		return nullptr;
+	}
+	return base;
+}
+
+std::string shm_socket_default()
+{
+	const char *run = getenv("XDG_RUNTIME_DIR");
+	struct stat st;
+
+	if ((stat(shm_socket_dir, &st) == 0 && S_ISDIR(st.st_mode)) || !run || !*run)
+		return std::string(shm_socket_dir) + "/cx88sdrd.sock";
+	return std::string(run) + "/cx88sdrd.sock";
+}
+
+shm_ring shm_ring::create(const std::string &name, size_t size)
+{
+	size_t hdr_len = page_align(sizeof(shm_header));
+	shm_ring r;
+	int fd;
+
+	size = page_align(size);
+	shm_unlink(name.c_str());
+	fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0)
+		throw sys_error("shm_open " + name);
+	/* Readers must be able to update their slot */
+	fchmod(fd, 0660);
+
+	if (ftruncate(fd, static_cast<off_t>(hdr_len + slots_len() + size)) < 0 ||
+	    !(r.map_ = map_object(fd, hdr_len, size, PROT_READ | PROT_WRITE))) {
+		std::system_error e = sys_error("shm " + name);
+
+		::close(fd);
+		shm_unlink(name.c_str());
+		throw e;
+	}
+	::close(fd);
+
+	r.name_ = name;
+	r.owner_ = true;
+	r.map_len_ = hdr_len + slots_len() + 2 * size;
+	r.hdr_ = new (r.map_) shm_header();
+	r.slots_ = reinterpret_cast<shm_slot *>(static_cast<uint8_t *>(r.map_) + hdr_len);
+	for (size_t i = 0; i < shm_max_readers; i++)
+		new (&r.slots_[i]) shm_slot();
+	r.hdr_->size = size;
+	r.hdr_->slots_offset = hdr_len;
+	r.hdr_->data_offset = hdr_len + slots_len();
+	r.hdr_->version = shm_version;
+	r.hdr_->magic = shm_magic;
+	r.data_ = static_cast<uint8_t *>(r.map_) + r.hdr_->data_offset;
+	r.size_ = size;
+	return r;
+}
+
+shm_ring shm_ring::open(const std::string &name)
+{
+	shm_header *hdr;
+	size_t hdr_len, size;
+	shm_ring r;
+	int fd;
+
+	fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+	if (fd < 0)
+		throw sys_error("shm_open " + name);
+
+	hdr = static_cast<shm_header *>(mmap(nullptr, sizeof(*hdr), PROT_READ, MAP_SHARED, fd, 0));
+	if (hdr == MAP_FAILED) {
+		std::system_error e = sys_error("mmap " + name);
+
+		::close(fd);
+		throw e;
+	}
+	if (hdr->magic != shm_magic || hdr->version != shm_version ||
+	    hdr->slots_offset != page_align(sizeof(*hdr)) ||
+	    hdr->data_offset != hdr->slots_offset + slots_len()) {
+		munmap(hdr, sizeof(*hdr));
+		::close(fd);
+		throw std::system_error(EPROTO, std::generic_category(),
+					name + " is not a cx88sdrd ring");
+	}
+	hdr_len = hdr->slots_offset;
+	size = hdr->size;
+	munmap(hdr, sizeof(*hdr));
+
+	r.map_ = map_object(fd, hdr_len, size, PROT_READ);
+	if (!r.map_) {
+		std::system_error e = sys_error("mmap " + name);
+
+		::close(fd);
+		throw e;
+	}
+	::close(fd);
+
+	r.name_ = name;
+	r.map_len_ = hdr_len + slots_len() + 2 * size;
+	r.hdr_ = static_cast<shm_header *>(r.map_);
+	r.slots_ = reinterpret_cast<shm_slot *>(static_cast<uint8_t *>(r.map_) + hdr_len);
+	r.data_ = static_cast<uint8_t *>(r.map_) + r.hdr_->data_offset;
+	r.size_ = size;
+	return r;
+}
+
+shm_ring::~shm_ring()
+{
+	unmap();
+}
+
+shm_ring::shm_ring(shm_ring &&other) noexcept
+{
+	*this = std::move(other);
+}
+
+shm_ring &shm_ring::operator=(shm_ring &&other) noexcept
+{
+	if (this != &other) {
+		unmap();
+		name_ = std::move(other.name_);
+		owner_ = std::exchange(other.owner_, false);
+		hdr_ = std::exchange(other.hdr_, nullptr);
+		slots_ = std::exchange(other.slots_, nullptr);
+		data_ = std::exchange(other.data_, nullptr);
+		size_ = std::exchange(other.size_, 0);
+		map_ = std::exchange(other.map_, nullptr);
+		map_len_ = std::exchange(other.map_len_, 0);
+	}
+	return *this;
+}
+
+void shm_ring::unmap()
+{
+	if (map_)
+		munmap(map_, map_len_);
+	if (owner_)
+		shm_unlink(name_.c_str());
+	map_ = nullptr;
+	hdr_ = nullptr;
+	slots_ = nullptr;
+	data_ = nullptr;
+	owner_ = false;
+}
+
+void shm_ring::publish(uint64_t write)
+{
+	hdr_->write.store(write, std::memory_order_release);
+	hdr_->seq.fetch_add(1, std::memory_order_release);
+	syscall(SYS_futex, reinterpret_cast<uint32_t *>(&hdr_->seq), FUTEX_WAKE, INT_MAX,
+		nullptr, nullptr, 0);
+}
+
+bool shm_ring::wait(uint32_t seq, unsigned int timeout_ms) const
+{
+	struct timespec ts = { static_cast<time_t>(timeout_ms / 1000),
+			       static_cast<long>(timeout_ms % 1000) * 1000000 };
+	long ret;
+
+	ret = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&hdr_->seq), FUTEX_WAIT, seq,
+		      &ts, nullptr, 0);
+	return !(ret < 0 && errno == ETIMEDOUT);
+}
+
+static int control_connect(const std::string &socket_path)
+{
+	struct sockaddr_un addr = {};
+	int fd;
+
+	if (socket_path.size() >= sizeof(addr.sun_path))
+		throw std::system_error(ENAMETOOLONG, std::generic_category(), socket_path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		throw sys_error("socket");
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path.c_str());
+	if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+		std::system_error e = sys_error("connect " + socket_path);
+
+		::close(fd);
+		throw e;
+	}
+	return fd;
+}
+
+/* Complete once the last line is "ok" or "err <msg>", last is without '\n' */
+static bool control_reply_done(const std::string &reply, std::string &last)
+{
+	size_t start;
+
+	if (reply.empty() || reply.back() != '\n')
+		return false;
+	start = (reply.size() < 2) ? std::string::npos : reply.rfind('\n', reply.size() - 2);
+	start = (start == std::string::npos) ? 0 : start + 1;
+	last = reply.substr(start, reply.size() - start - 1);
+	return last == "ok" || last.compare(0, 4, "err ") == 0;
+}
+
+/* Send one command line, return the reply lines before "ok" */
+static std::string control_transact(int fd, const std::string &line)
+{
+	std::string cmd = line + "\n", reply, last;
+	size_t done = 0;
+	char buf[4096];
+
+	while (done < cmd.size()) {
+		ssize_t ret = send(fd, cmd.data() + done, cmd.size() - done, MSG_NOSIGNAL);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			throw sys_error("cx88sdrd send");
+		done += static_cast<size_t>(ret);
+	}
+
+	while (!control_reply_done(reply, last)) {
+		ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			throw std::system_error(ret ? errno : ECONNRESET, std::generic_category(),
+						"cx88sdrd recv");
+		reply.append(buf, static_cast<size_t>(ret));
+	}
+
+	if (last != "ok")
+		throw std::runtime_error("cx88sdrd: " + last.substr(4));
+	reply.erase(reply.size() - last.size() - 1);
+	return reply;
+}
+
+std::string shm_command(const std::string &line, const std::string &socket_path)
+{
+	int fd = control_connect(socket_path);
+	std::string reply;
+
+	try {
+		reply = control_transact(fd, line);
+	} catch (...) {
+		::close(fd);
+		throw;
+	}
+	::close(fd);
+	return reply;
+}
+
+shm_reader::shm_reader(unsigned int card, size_t block_size, const std::string &socket_path)
+{
+	std::string kw, name;
+
+	fd_ = control_connect(socket_path);
+	try {
+		std::istringstream reply(control_transact(fd_, "attach " + std::to_string(card)));
+
+		if (!(reply >> kw >> name >> slot_) || kw != "shm" || slot_ >= shm_max_readers)
+			throw std::runtime_error("cx88sdrd: bad attach reply");
+		ring_ = shm_ring::open(name);
+	} catch (...) {
+		::close(fd_);
+		throw;
+	}
+
+	block_size_ = page_align(block_size);
+	if (block_size_ > ring_.size() / 4)
+		block_size_ = ring_.size() / 4;
+	pos_ = ring_.slots()[slot_].read.load(std::memory_order_relaxed);
+}
+
+shm_reader::~shm_reader()
+{
+	/* Closing the control connection frees the slot */
+	if (fd_ >= 0)
+		::close(fd_);
+}
+
+bool shm_reader::next(block &b, unsigned int timeout_ms)
+{
+	shm_header *h = ring_.header();
+	shm_slot &s = ring_.slots()[slot_];
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	uint64_t write, lost = 0;
+
+	/* The previous block is done with */
+	s.read.store(pos_, std::memory_order_release);
+
+	for (;;) {
+		uint32_t seq = h->seq.load(std::memory_order_acquire);
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+				deadline - std::chrono::steady_clock::now()).count();
+
+		write = h->write.load(std::memory_order_acquire);
+		if (write >= pos_ + block_size_)
+			break;
+		if (left <= 0 || !ring_.wait(seq, static_cast<unsigned int>(left)))
+			return false;
+	}
+
+	/* Lapped by the daemon, continue with the newest block */
+	if (h->fill.load(std::memory_order_acquire) > pos_ + ring_.size()) {
+		uint64_t restart = write - block_size_;
+
+		lost = restart - pos_;
+		pos_ = restart;
+		s.overruns.fetch_add(1, std::memory_order_relaxed);
+		s.lost.fetch_add(lost, std::memory_order_relaxed);
+		s.read.store(pos_, std::memory_order_release);
+	}
+
+	b.data = ring_.data() + (pos_ % ring_.size());
+	b.size = block_size_;
+	b.pos = pos_;
+	b.lost = lost;
+	pos_ += block_size_;
+	return true;
+}
+
+bool shm_reader::valid(const block &b) const
+{
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return b.pos + ring_.size() >= ring_.header()->fill.load(std::memory_order_relaxed);
+}
+
+}
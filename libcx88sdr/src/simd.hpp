@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Kernels are plain loops or GCC vector extensions, CX88SDR_SIMD builds an
+ * x86-64-v3 (AVX2, FMA) and a baseline copy of each and the dynamic loader
+ * picks one per host. v8f maps to one AVX2 register, or two SSE registers
+ * on the baseline copy.
+ */
+
+#ifndef CX88SDR_SIMD_HPP
+#define CX88SDR_SIMD_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CX88SDR_SIMD	__attribute__((target_clones("arch=x86-64-v3", "default")))
+#else
+#define CX88SDR_SIMD
+#endif
+
+namespace cx88sdr {
+
+typedef float v8f __attribute__((vector_size(32)));
+typedef uint8_t v32u8 __attribute__((vector_size(32)));
+typedef int8_t v32i8 __attribute__((vector_size(32)));	/* Compare results */
+
+/* By reference, passing vectors by value changes the ABI between the clones */
+static inline void v8f_load(v8f &v, const float *p)
+{
+	memcpy(&v, p, sizeof(v));
+}
+
+static inline void v8f_store(float *p, const v8f &v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline float v8f_sum(const v8f &v)
+{
+	return ((v[0] + v[4]) + (v[1] + v[5])) + ((v[2] + v[6]) + (v[3] + v[7]));
+}
+
+static inline void v32u8_load(v32u8 &v, const uint8_t *p)
+{
+	memcpy(&v, p, sizeof(v));
+}
+
+static inline void v32u8_store(uint8_t *p, const v32u8 &v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+/* Any lane of a compare result set */
+static inline bool v32i8_any(const v32i8 &m)
+{
+	uint64_t w[4];
+
+	memcpy(w, &m, sizeof(w));
+	return (w[0] | w[1] | w[2] | w[3]) != 0;
+}
+
+}
+
+#endif
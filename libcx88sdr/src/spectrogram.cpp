@@ -0,0 +1,572 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Two real frames a and b go through one complex FFT as z = a + j b. With
+ * A and B their spectra, Z[k] = A[k] + j B[k] and, both being real,
+ * |A[k]|^2 + |B[k]|^2 = (|Z[k]|^2 + |Z[N - k]|^2) / 2. Power only adds up,
+ * so |Z|^2 is summed over the frames of a line and folded once at its end.
+ * A lone frame (b = 0) folds to the same.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cx88sdr/convert.hpp"
+#include "cx88sdr/fft.hpp"
+#include "cx88sdr/spectrogram.hpp"
+#include "simd.hpp"
+#include "workers.hpp"
+
+namespace cx88sdr {
+
+/* Input samples per task, small enough to balance, large enough to amortise */
+static constexpr size_t task_inputs = 65536;
+/* Bins per width field of the compressed lines */
+static constexpr unsigned int group = 32;
+
+static std::system_error sys_error(const std::string &what)
+{
+	return std::system_error(errno, std::generic_category(), what);
+}
+
+static void write_all(int fd, const void *data, size_t len, const std::string &what)
+{
+	const uint8_t *p = static_cast<const uint8_t *>(data);
+
+	while (len) {
+		ssize_t ret = ::write(fd, p, len);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			throw sys_error(what);
+		p += ret;
+		len -= static_cast<size_t>(ret);
+	}
+}
+
+spectrum_analyzer::spectrum_analyzer(const spectrum_options &opts)
+	: n_(opts.fft_size), avg_(opts.average), rate_(opts.in_rate)
+{
+	double sum = 0;
+
+	if (n_ < 64 || n_ > 65536 || (n_ & (n_ - 1)))
+		throw std::invalid_argument("spectrum_analyzer: fft_size must be a power of two, 64 to 65536");
+	if (!avg_)
+		throw std::invalid_argument("spectrum_analyzer: average must be positive");
+	if (!(rate_ > 0))
+		throw std::invalid_argument("spectrum_analyzer: bad input rate");
+
+	/* Periodic Hann, its frames overlapping by half sum to a constant */
+	win_.resize(n_);
+	for (unsigned int i = 0; i < n_; i++) {
+		double w = 0.5 - 0.5 * std::cos(2 * M_PI * i / n_);
+
+		win_[i] = static_cast<float>(w);
+		sum += w;
+	}
+	/* A full-scale sine on a bin has |X| = sum / 2 */
+	scale_ = static_cast<float>(4 / (sum * sum));
+
+	fft_ = std::make_unique<fft>(n_);
+	acc_.assign(n_, 0.0f);
+	pool_ = std::make_unique<workers>(opts.threads);
+}
+
+spectrum_analyzer::~spectrum_analyzer() = default;
+
+CX88SDR_SIMD
+static void power_add(const float *re, const float *im, float *acc, unsigned int n)
+{
+	for (unsigned int i = 0; i < n; i += 8) {
+		v8f r, m, a;
+
+		v8f_load(r, re + i);
+		v8f_load(m, im + i);
+		v8f_load(a, acc + i);
+		a += r * r + m * m;
+		v8f_store(acc + i, a);
+	}
+}
+
+CX88SDR_SIMD
+static void sum_add(const float *in, float *acc, unsigned int n)
+{
+	for (unsigned int i = 0; i < n; i += 8) {
+		v8f x, a;
+
+		v8f_load(x, in + i);
+		v8f_load(a, acc + i);
+		a += x;
+		v8f_store(acc + i, a);
+	}
+}
+
+size_t spectrum_analyzer::run(std::vector<float> &out, std::vector<uint64_t> &starts)
+{
+	struct segment {
+		uint64_t	first, count;
+	};
+	unsigned int hop = n_ / 2, mask = n_ - 1;
+	uint64_t avail = base_ + buf_.size(), end, per_task;
+	std::vector<segment> segs;
+	std::vector<float> part;
+	size_t done = 0;
+
+	if (avail < origin_ + n_)
+		return 0;
+	/* Frame f covers inputs origin_ + f * hop to origin_ + f * hop + n_ - 1 */
+	end = (avail - origin_ - n_) / hop + 1;
+	if (end <= frames_)
+		return 0;
+
+	/* Tasks of whole pairs where they can, never across a line */
+	per_task = std::max<uint64_t>(2, (task_inputs / hop) & ~static_cast<uint64_t>(1));
+	for (uint64_t f = frames_; f < end;) {
+		uint64_t line_end = (f / avg_ + 1) * avg_;
+		uint64_t stop = std::min({ end, line_end, f + per_task });
+
+		segs.push_back({ f, stop - f });
+		f = stop;
+	}
+	part.assign(segs.size() * n_, 0.0f);
+
+	pool_->run(segs.size(), [&](size_t task) {
+		std::vector<float> re(n_), im(n_);
+		const segment &s = segs[task];
+		float *sum = &part[task * n_];
+
+		for (uint64_t f = s.first; f < s.first + s.count; f += 2) {
+			const float *x = &buf_[origin_ + f * hop - base_];
+			bool pair = f + 1 < s.first + s.count;
+
+			for (unsigned int i = 0; i < n_; i++) {
+				unsigned int p = fft_->perm(i);
+
+				re[p] = x[i] * win_[i];
+				im[p] = pair ? x[i + hop] * win_[i] : 0.0f;
+			}
+			fft_->forward_permuted(re.data(), im.data());
+			power_add(re.data(), im.data(), sum, n_);
+		}
+	});
+
+	for (size_t i = 0; i < segs.size(); i++) {
+		sum_add(&part[i * n_], acc_.data(), n_);
+		frames_ += segs[i].count;
+		if (frames_ % avg_)
+			continue;
+
+		/* Line complete: fold, average, dB */
+		float k = scale_ / (2.0f * avg_);
+		size_t o = out.size();
+
+		out.resize(o + bins());
+		for (unsigned int b = 0; b < bins(); b++) {
+			float p = k * (acc_[b] + acc_[(n_ - b) & mask]);
+
+			out[o + b] = 10.0f * std::log10(std::max(p, 1e-30f));
+		}
+		starts.push_back(origin_ + (frames_ - avg_) * hop);
+		std::fill(acc_.begin(), acc_.end(), 0.0f);
+		lines_++;
+		done++;
+	}
+
+	/* Keep what the next frame needs */
+	uint64_t keep = origin_ + frames_ * hop;
+
+	buf_.erase(buf_.begin(), buf_.begin() + static_cast<ptrdiff_t>(keep - base_));
+	base_ = keep;
+	return done;
+}
+
+void spectrum_analyzer::reset()
+{
+	buf_.clear();
+	base_ = origin_ = inputs_;
+	frames_ = 0;
+	std::fill(acc_.begin(), acc_.end(), 0.0f);
+}
+
+size_t spectrum_analyzer::process(const float *in, size_t n, std::vector<float> &out,
+				  std::vector<uint64_t> &starts)
+{
+	buf_.insert(buf_.end(), in, in + n);
+	inputs_ += n;
+	return run(out, starts);
+}
+
+size_t spectrum_analyzer::process(const uint8_t *in, size_t n, std::vector<float> &out,
+				  std::vector<uint64_t> &starts)
+{
+	size_t old = buf_.size();
+
+	buf_.resize(old + n);
+	convert::ru8_to_f32(in, &buf_[old], n);
+	inputs_ += n;
+	return run(out, starts);
+}
+
+size_t spectrum_analyzer::process(const uint16_t *in, size_t n, std::vector<float> &out,
+				  std::vector<uint64_t> &starts)
+{
+	size_t old = buf_.size();
+
+	buf_.resize(old + n);
+	convert::ru16_to_f32(in, &buf_[old], n);
+	inputs_ += n;
+	return run(out, starts);
+}
+
+/* LSB first, as the file format says */
+struct bit_writer {
+	std::vector<uint8_t>	&out;
+	uint64_t		acc = 0;
+	unsigned int		n = 0;
+
+	void put(uint32_t v, unsigned int bits)
+	{
+		acc |= static_cast<uint64_t>(v) << n;
+		n += bits;
+		while (n >= 8) {
+			out.push_back(static_cast<uint8_t>(acc));
+			acc >>= 8;
+			n -= 8;
+		}
+	}
+
+	void flush()
+	{
+		if (n)
+			out.push_back(static_cast<uint8_t>(acc));
+		acc = 0;
+		n = 0;
+	}
+};
+
+struct bit_reader {
+	const uint8_t		*p, *end;
+	uint64_t		acc = 0;
+	unsigned int		n = 0;
+
+	uint32_t get(unsigned int bits)
+	{
+		uint32_t v;
+
+		while (n < bits) {
+			if (p == end)
+				throw std::runtime_error("spectrogram: truncated block");
+			acc |= static_cast<uint64_t>(*p++) << n;
+			n += 8;
+		}
+		v = static_cast<uint32_t>(acc) & ((1U << bits) - 1);
+		acc >>= bits;
+		n -= bits;
+		return v;
+	}
+};
+
+/* Zigzag codes of q - prev per bin, and the bits each group of 32 needs */
+CX88SDR_SIMD
+static void zigzag_delta(const uint8_t *q, const uint8_t *prev, uint8_t *z, uint8_t *width,
+			 unsigned int groups)
+{
+	for (unsigned int g = 0; g < groups; g++) {
+		v32u8 a, b, d, s;
+		uint8_t any = 0;
+
+		v32u8_load(a, q + g * group);
+		v32u8_load(b, prev + g * group);
+		d = a - b;
+		s = (v32u8)((v32i8)d >> 7);
+		d = (d << 1) ^ s;
+		v32u8_store(z + g * group, d);
+		for (unsigned int i = 0; i < group; i++)
+			any |= d[i];
+		width[g] = any ? static_cast<uint8_t>(32 - __builtin_clz(any)) : 0;
+	}
+}
+
+spectrogram_writer::spectrogram_writer(const std::string &base, const spectrum_analyzer &an,
+				       const spectrogram_options &opts, const recording_ctrl &ctrl,
+				       const std::string &bus_info)
+	: base_(base)
+{
+	if (!(opts.db_step > 0) || !opts.block_lines || opts.block_lines > 65536)
+		throw std::invalid_argument("spectrogram_writer: bad quantisation or block size");
+
+	memcpy(hdr_.magic, spectrogram_magic, sizeof(hdr_.magic));
+	hdr_.version = spectrogram_version;
+	hdr_.header_size = sizeof(spectrogram_header);
+	hdr_.record_size = sizeof(spectrogram_block);
+	hdr_.bins = an.bins();
+	hdr_.fft_size = an.fft_size();
+	hdr_.average = an.average();
+	hdr_.hop = an.hop();
+	hdr_.block_lines = opts.block_lines;
+	hdr_.sample_rate = an.in_rate();
+	hdr_.db_min = opts.db_min;
+	hdr_.db_step = opts.db_step;
+	hdr_.ctrl = ctrl;
+	strncpy(hdr_.bus_info, bus_info.c_str(), sizeof(hdr_.bus_info) - 1);
+
+	data_fd_ = ::open((base + ".cx88spg").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (data_fd_ < 0)
+		throw sys_error("open " + base + ".cx88spg");
+	idx_fd_ = ::open((base + ".cx88spgidx").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (idx_fd_ < 0) {
+		std::system_error e = sys_error("open " + base + ".cx88spgidx");
+
+		::close(data_fd_);
+		throw e;
+	}
+	write_all(idx_fd_, &hdr_, sizeof(hdr_), base_ + ".cx88spgidx");
+}
+
+spectrogram_writer::~spectrogram_writer()
+{
+	try {
+		close();
+	} catch (...) {
+	}
+}
+
+void spectrogram_writer::add(const float *db, int64_t time_ns, uint64_t global)
+{
+	size_t o = codes_.size();
+	float inv = 1 / hdr_.db_step;
+
+	if (data_fd_ < 0)
+		throw std::logic_error("spectrogram_writer: closed");
+
+	codes_.resize(o + hdr_.bins);
+	for (unsigned int b = 0; b < hdr_.bins; b++) {
+		float c = std::nearbyint((db[b] - hdr_.db_min) * inv);
+
+		codes_[o + b] = static_cast<uint8_t>(std::min(std::max(c, 0.0f), 255.0f));
+	}
+	if (!hdr_.lines)
+		hdr_.start_ns = time_ns;
+	meta_.push_back({ time_ns, global });
+	hdr_.lines++;
+	if (meta_.size() == hdr_.block_lines)
+		flush();
+}
+
+void spectrogram_writer::flush()
+{
+	unsigned int bins = hdr_.bins, groups = bins / group;
+	std::vector<uint8_t> prev(bins, 0), z(bins), width(groups);
+	bit_writer bw{ out_ };
+	spectrogram_block r;
+
+	if (meta_.empty())
+		return;
+
+	out_.assign(reinterpret_cast<const uint8_t *>(meta_.data()),
+		    reinterpret_cast<const uint8_t *>(meta_.data() + meta_.size()));
+	for (size_t l = 0; l < meta_.size(); l++) {
+		const uint8_t *q = &codes_[l * bins];
+
+		zigzag_delta(q, prev.data(), z.data(), width.data(), groups);
+		for (unsigned int g = 0; g < groups; g++) {
+			bw.put(width[g], 4);
+			if (!width[g])
+				continue;
+			for (unsigned int i = 0; i < group; i++)
+				bw.put(z[g * group + i], width[g]);
+		}
+		memcpy(prev.data(), q, bins);
+	}
+	bw.flush();
+
+	r.offset = offset_;
+	r.first_line = hdr_.lines - meta_.size();
+	r.first_ns = meta_.front().time_ns;
+	r.last_ns = meta_.back().time_ns;
+	r.size = static_cast<uint32_t>(out_.size());
+	r.lines = static_cast<uint32_t>(meta_.size());
+
+	/* Data first, an index record never points past the data */
+	write_all(data_fd_, out_.data(), out_.size(), base_ + ".cx88spg");
+	write_all(idx_fd_, &r, sizeof(r), base_ + ".cx88spgidx");
+	offset_ += out_.size();
+	hdr_.count++;
+	codes_.clear();
+	meta_.clear();
+}
+
+void spectrogram_writer::close()
+{
+	if (data_fd_ < 0)
+		return;
+
+	try {
+		flush();
+	} catch (...) {
+		::close(data_fd_);
+		::close(idx_fd_);
+		data_fd_ = idx_fd_ = -1;
+		throw;
+	}
+	if (pwrite(idx_fd_, &hdr_, sizeof(hdr_), 0) != sizeof(hdr_) ||
+	    fsync(data_fd_) < 0 || fsync(idx_fd_) < 0) {
+		std::system_error e = sys_error(base_);
+
+		::close(data_fd_);
+		::close(idx_fd_);
+		data_fd_ = idx_fd_ = -1;
+		throw e;
+	}
+	::close(data_fd_);
+	::close(idx_fd_);
+	data_fd_ = idx_fd_ = -1;
+}
+
+static void *map_file(const std::string &path, size_t &len)
+{
+	struct stat st;
+	void *p = nullptr;
+	int fd;
+
+	fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw sys_error("open " + path);
+	if (fstat(fd, &st) < 0) {
+		std::system_error e = sys_error("stat " + path);
+
+		::close(fd);
+		throw e;
+	}
+	len = static_cast<size_t>(st.st_size);
+	if (len)
+		p = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED)
+		throw sys_error("mmap " + path);
+	return p;
+}
+
+spectrogram::spectrogram(const std::string &base)
+{
+	idx_map_ = map_file(base + ".cx88spgidx", idx_len_);
+	hdr_ = static_cast<const spectrogram_header *>(idx_map_);
+	if (idx_len_ < sizeof(spectrogram_header) ||
+	    memcmp(hdr_->magic, spectrogram_magic, sizeof(spectrogram_magic)) ||
+	    hdr_->version != spectrogram_version || hdr_->record_size != sizeof(spectrogram_block) ||
+	    hdr_->header_size < sizeof(spectrogram_header) || hdr_->header_size > idx_len_ ||
+	    !hdr_->bins || hdr_->bins % group || !hdr_->average || !hdr_->hop ||
+	    !(hdr_->sample_rate > 0) || !(hdr_->db_step > 0)) {
+		if (idx_map_)
+			munmap(idx_map_, idx_len_);
+		throw std::runtime_error(base + ".cx88spgidx: not a cx88sdr spectrogram index");
+	}
+	blocks_ = reinterpret_cast<const spectrogram_block *>(static_cast<const uint8_t *>(idx_map_) +
+							      hdr_->header_size);
+	count_ = (idx_len_ - hdr_->header_size) / sizeof(spectrogram_block);
+
+	try {
+		data_map_ = map_file(base + ".cx88spg", data_len_);
+	} catch (...) {
+		munmap(idx_map_, idx_len_);
+		throw;
+	}
+	data_ = static_cast<const uint8_t *>(data_map_);
+}
+
+spectrogram::~spectrogram()
+{
+	if (data_map_)
+		munmap(data_map_, data_len_);
+	munmap(idx_map_, idx_len_);
+}
+
+int64_t spectrogram::line_ns() const
+{
+	return std::llround(static_cast<double>(hdr_->average) * hdr_->hop * 1e9 / hdr_->sample_rate);
+}
+
+uint64_t spectrogram::lines() const
+{
+	return count_ ? blocks_[count_ - 1].first_line + blocks_[count_ - 1].lines : 0;
+}
+
+void spectrogram::decode(uint64_t i, std::vector<uint8_t> &codes,
+			 std::vector<spectrogram_line> &meta) const
+{
+	const spectrogram_block &r = blocks_[i];
+	unsigned int bins = hdr_->bins, groups = bins / group;
+	size_t head = static_cast<size_t>(r.lines) * sizeof(spectrogram_line), o;
+
+	if (r.offset > data_len_ || r.size > data_len_ - r.offset || head > r.size)
+		throw std::runtime_error("spectrogram: block past the end of the data");
+
+	const uint8_t *p = data_ + r.offset;
+	bit_reader br{ p + head, p + r.size };
+	size_t m = meta.size();
+
+	meta.resize(m + r.lines);
+	memcpy(&meta[m], p, head);
+
+	o = codes.size();
+	codes.resize(o + static_cast<size_t>(r.lines) * bins);
+	for (uint32_t l = 0; l < r.lines; l++) {
+		uint8_t *q = &codes[o + static_cast<size_t>(l) * bins];
+		const uint8_t *prev = l ? q - bins : nullptr;
+
+		for (unsigned int g = 0; g < groups; g++) {
+			unsigned int w = br.get(4);
+
+			if (w > 8)
+				throw std::runtime_error("spectrogram: corrupt block");
+			for (unsigned int k = g * group; k < (g + 1) * group; k++) {
+				uint8_t z = static_cast<uint8_t>(w ? br.get(w) : 0);
+				uint8_t d = static_cast<uint8_t>((z >> 1) ^ -(z & 1));
+
+				q[k] = static_cast<uint8_t>((prev ? prev[k] : 0) + d);
+			}
+		}
+	}
+}
+
+size_t spectrogram::read(int64_t t0_ns, int64_t t1_ns, std::vector<uint8_t> &codes,
+			 std::vector<spectrogram_line> &meta) const
+{
+	/* First block whose last line is not before t0 */
+	const spectrogram_block *b = std::lower_bound(blocks_, blocks_ + count_, t0_ns,
+						      [](const spectrogram_block &a, int64_t t) {
+							      return a.last_ns < t;
+						      });
+	std::vector<uint8_t> c;
+	std::vector<spectrogram_line> m;
+	unsigned int bins = hdr_->bins;
+	size_t n = 0;
+
+	for (; b != blocks_ + count_ && b->first_ns < t1_ns; b++) {
+		c.clear();
+		m.clear();
+		decode(static_cast<uint64_t>(b - blocks_), c, m);
+		for (size_t l = 0; l < m.size(); l++) {
+			if (m[l].time_ns < t0_ns || m[l].time_ns >= t1_ns)
+				continue;
+			meta.push_back(m[l]);
+			codes.insert(codes.end(), c.begin() + static_cast<ptrdiff_t>(l * bins),
+				     c.begin() + static_cast<ptrdiff_t>((l + 1) * bins));
+			n++;
+		}
+	}
+	return n;
+}
+
+}
@@ -0,0 +1,472 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "cx88sdr/tbc.hpp"
+#include "simd.hpp"
+#include "workers.hpp"
+
+namespace cx88sdr {
+
+/* Lines held back before resampling, enough to number those ahead of the vsync */
+static constexpr size_t keep_lines = 8;
+/* Lines per worker task */
+static constexpr size_t task_lines = 32;
+/* Consecutive missing syncs before the lock is dropped */
+static constexpr unsigned int max_miss = 16;
+
+struct tbc::frame {
+	std::vector<uint8_t>	data;
+	unsigned int		pending = 0;	/* Lines bound, not yet resampled */
+	bool			fields[2] = {};
+	bool			closed = false;
+};
+
+tbc::tbc(const tbc_options &opts)
+{
+	bool ntsc = opts.standard == video_standard::ntsc;
+	double line_rate = ntsc ? 4500000.0 / 286 : 15625.0;
+
+	if (!(opts.in_rate > 0))
+		throw std::invalid_argument("tbc: input rate must be positive");
+
+	width_ = opts.width ? opts.width : (ntsc ? 910 : 1135);
+	if (width_ < 16)
+		throw std::invalid_argument("tbc: width must be at least 16");
+	/* Line 1 to the line the second field's vsync starts in, then the rest */
+	field_lines_[0] = ntsc ? 262 : 312;
+	field_lines_[1] = ntsc ? 263 : 313;
+	vsync_line_ = ntsc ? 3 : 0;
+	height_ = field_lines_[0] + field_lines_[1];
+	rate_num_ = ntsc ? 30000 : 25;
+	rate_den_ = ntsc ? 1001 : 1;
+	weave_ = opts.weave;
+	top_ = ntsc ? 1 : 0;
+
+	us_ = opts.in_rate / 1e6;
+	h_nom_ = opts.in_rate / line_rate;
+	h_ = h_nom_;
+	if (h_nom_ < 64)
+		throw std::invalid_argument("tbc: input rate too low for video");
+
+	pool_ = std::make_unique<workers>(opts.threads);
+}
+
+tbc::~tbc() = default;
+
+/* Index of the first sample below t, or n */
+CX88SDR_SIMD
+static size_t find_below(const uint8_t *p, size_t n, uint8_t t)
+{
+	v32u8 vt = {};
+	size_t i = 0;
+
+	vt += t;
+	for (; i + 32 <= n; i += 32) {
+		v32u8 v;
+
+		v32u8_load(v, p + i);
+		if (v32i8_any(v < vt))
+			break;
+	}
+	for (; i < n; i++)
+		if (p[i] < t)
+			return i;
+	return n;
+}
+
+/* Index of the first sample at or above t, or n */
+CX88SDR_SIMD
+static size_t find_at_least(const uint8_t *p, size_t n, uint8_t t)
+{
+	v32u8 vt = {};
+	size_t i = 0;
+
+	vt += t;
+	for (; i + 32 <= n; i += 32) {
+		v32u8 v;
+
+		v32u8_load(v, p + i);
+		if (v32i8_any(v >= vt))
+			break;
+	}
+	for (; i < n; i++)
+		if (p[i] >= t)
+			return i;
+	return n;
+}
+
+/* Catmull-Rom interpolation of width pixels from x = start in steps of step */
+CX88SDR_SIMD
+static void resample_line(const uint8_t *src, double start, double step, unsigned int width,
+			  uint8_t *dst)
+{
+	for (unsigned int j = 0; j < width; j++) {
+		double x = start + j * step;
+		size_t i = static_cast<size_t>(x);
+		float t = static_cast<float>(x - i);
+		float p0 = src[i - 1], p1 = src[i], p2 = src[i + 1], p3 = src[i + 2];
+		float v = p1 + 0.5f * t * (p2 - p0 + t * (2 * p0 - 5 * p1 + 4 * p2 - p3 +
+							t * (3 * (p1 - p2) + p3 - p0)));
+
+		dst[j] = static_cast<uint8_t>(std::min(std::max(v + 0.5f, 0.0f), 255.0f));
+	}
+}
+
+size_t tbc::process(const uint8_t *in, size_t n, std::vector<uint8_t> &out)
+{
+	buf_.insert(buf_.end(), in, in + n);
+	return run(out);
+}
+
+size_t tbc::process(const uint16_t *in, size_t n, std::vector<uint8_t> &out)
+{
+	size_t old = buf_.size();
+
+	buf_.resize(old + n);
+	for (size_t i = 0; i < n; i++)
+		buf_[old + i] = static_cast<uint8_t>(in[i] >> 8);
+	return run(out);
+}
+
+/* Sync tip at the 0.5th percentile, blanking assumed 40 IRE above it */
+void tbc::histogram_levels(const uint8_t *p, size_t n)
+{
+	size_t hist[256] = {}, acc = 0;
+	int tip = -1, peak = 255;
+
+	for (size_t i = 0; i < n; i++)
+		hist[p[i]]++;
+	for (int v = 0; v < 256; v++) {
+		acc += hist[v];
+		if (tip < 0 && acc > n / 200)
+			tip = v;
+		if (acc > n - n / 200) {
+			peak = v;
+			break;
+		}
+	}
+	tip_ = std::max(tip, 0);
+	blank_ = tip_ + (peak - tip_) * 40.0 / 140.0;
+	levels_ = true;
+	set_threshold();
+}
+
+/* Half way between sync tip and blanking, with hysteresis for the rising edge */
+void tbc::set_threshold()
+{
+	double hyst = std::max(2.0, (blank_ - tip_) / 8);
+
+	thr_ = (tip_ + blank_) / 2;
+	thr_lo_ = static_cast<uint8_t>(std::min(std::max(std::lround(thr_), 1L), 254L));
+	thr_hi_ = static_cast<uint8_t>(std::min(thr_lo_ + std::lround(hyst), 255L));
+}
+
+size_t tbc::run(std::vector<uint8_t> &out)
+{
+	size_t i = static_cast<size_t>(scan_ - base_), end = buf_.size(), done = 0;
+	const uint8_t *p = buf_.data();
+
+	if (!levels_ && end - i < 2 * h_nom_)
+		return 0;
+	if (!locked_)
+		histogram_levels(p + i, end - i);
+
+	while (i < end) {
+		size_t j;
+		double e;
+
+		if (!in_pulse_) {
+			j = i + find_below(p + i, end - i, thr_lo_);
+			if (j == end) {
+				i = end;
+				break;
+			}
+			/* Sub-sample crossing of the level between the two compares */
+			e = j;
+			if (j > 0 && p[j - 1] > p[j])
+				e = j - 1 + (p[j - 1] - (thr_lo_ - 0.5)) / (p[j - 1] - p[j]);
+			e += base_;
+			advance(e);
+			in_pulse_ = true;
+			pulse_start_ = e;
+		} else {
+			j = i + find_at_least(p + i, end - i, thr_hi_);
+			if (j == end) {
+				i = end;
+				break;
+			}
+			e = j;
+			if (j > 0 && p[j] > p[j - 1])
+				e = j - 1 + ((thr_hi_ - 0.5) - p[j - 1]) / (p[j] - p[j - 1]);
+			e += base_;
+			in_pulse_ = false;
+			pulse(pulse_start_, e - pulse_start_);
+		}
+		i = j + 1;
+	}
+	scan_ = base_ + static_cast<int64_t>(i);
+	if (!in_pulse_)
+		advance(static_cast<double>(scan_));
+
+	if (!jobs_.empty()) {
+		size_t tasks = (jobs_.size() + task_lines - 1) / task_lines;
+
+		pool_->run(tasks, [&](size_t t) {
+			size_t last = std::min(jobs_.size(), (t + 1) * task_lines);
+
+			for (size_t k = t * task_lines; k < last; k++) {
+				const job &jb = jobs_[k];
+
+				resample_line(p, jb.start - base_, jb.len / width_, width_, jb.dst);
+			}
+		});
+		jobs_.clear();
+	}
+
+	while (!frames_.empty() && frames_.front()->closed && !frames_.front()->pending) {
+		frame &f = *frames_.front();
+
+		if (f.fields[0] && f.fields[1]) {
+			out.insert(out.end(), f.data.begin(), f.data.end());
+			stats_.frames++;
+			done++;
+		} else {
+			stats_.dropped++;
+		}
+		frames_.pop_front();
+	}
+
+	/* Keep what the held lines and an open pulse still need, plus interpolator margin */
+	int64_t keep = scan_;
+
+	if (in_pulse_)
+		keep = std::min(keep, static_cast<int64_t>(std::floor(pulse_start_)) - 2);
+	if (!lines_.empty())
+		keep = std::min(keep, static_cast<int64_t>(std::floor(lines_.front().start)) - 2);
+	keep = std::max(keep, base_);
+	buf_.erase(buf_.begin(), buf_.begin() + (keep - base_));
+	base_ = keep;
+	return done;
+}
+
+/* Flywheel: lines whose sync window passed without a pulse start where predicted */
+void tbc::advance(double pos)
+{
+	while (locked_ && pos > next_ + 0.02 * h_) {
+		if (++miss_ > max_miss) {
+			unlock();
+			break;
+		}
+		stats_.flywheel++;
+		push_line(next_, false, false);
+	}
+}
+
+void tbc::pulse(double start, double width)
+{
+	double w = width / us_, tol = 0.02 * h_, d = start - next_;
+	bool hsync = w >= 3.5 && w < 8, eq = w >= 1.0 && w < 3.5, broad = w >= 18 && w < 35;
+
+	if (!hsync && !eq && !broad) {
+		/* Signal lost below the threshold, keep the flywheel going */
+		if (w >= 35)
+			advance(start + width);
+		return;
+	}
+
+	if (!locked_) {
+		if (hsync && last_hsync_ >= 0 && std::fabs(start - last_hsync_ - h_nom_) < 0.05 * h_nom_) {
+			locked_ = true;
+			h_ = start - last_hsync_;
+			miss_ = 0;
+			push_line(start, true, true);
+		}
+		if (hsync)
+			last_hsync_ = start;
+		return;
+	}
+
+	/* On the line grid: equalizing and broad pulses time their lines too */
+	if (std::fabs(d) < tol) {
+		push_line(start, true, hsync);
+		miss_ = 0;
+		if (broad && !in_vsync_)
+			vsync(false);
+		else if (hsync)
+			in_vsync_ = false;
+		return;
+	}
+
+	/* Half a line off the grid: vertical interval */
+	if (std::fabs(d + h_ / 2) < tol) {
+		if (broad && !in_vsync_)
+			vsync(true);
+		return;
+	}
+
+	/* A timebase jump (head switch): follow a normal sync that lands near the grid */
+	if (hsync) {
+		line &b = lines_.back();
+
+		if (!b.timed && std::fabs(start - b.start) < h_ / 4) {
+			b.start = start;
+			b.timed = b.hsync = true;
+			stats_.flywheel--;
+			stats_.lines++;
+		} else if (std::fabs(d) < h_ / 4) {
+			push_line(start, true, true);
+		} else {
+			return;
+		}
+		next_ = start + h_;
+		miss_ = 0;
+		in_vsync_ = false;
+	}
+}
+
+void tbc::push_line(double start, bool measured, bool hsync)
+{
+	line l;
+
+	l.start = start;
+	l.timed = measured;
+	l.hsync = hsync;
+	if (measured) {
+		stats_.lines++;
+		if (!lines_.empty() && lines_.back().timed) {
+			double len = start - lines_.back().start;
+
+			if (std::fabs(len - h_nom_) < 0.05 * h_nom_)
+				h_ += (len - h_) / 16;
+		}
+	}
+
+	if (field_ >= 0) {
+		bind(l, field_, next_number_++);
+		if (next_number_ == static_cast<int>(field_lines_[field_]))
+			close_field();
+	}
+	lines_.push_back(l);
+	next_ = start + h_;
+	while (lines_.size() > keep_lines)
+		retire();
+}
+
+void tbc::bind(line &l, int field, int number)
+{
+	if (l.fr)
+		l.fr->pending--;
+	l.field = field;
+	l.number = number;
+	l.fr = cur_;
+	if (cur_)
+		cur_->pending++;
+}
+
+/*
+ * First broad pulse of a vertical interval, in the last line. It falls in
+ * field line vsync_line_, so the lines before it are numbered afresh.
+ */
+void tbc::vsync(bool second)
+{
+	size_t g = lines_.size() - 1;
+	size_t first = (g >= vsync_line_) ? g - vsync_line_ : 0;
+
+	in_vsync_ = true;
+	close_field();
+	stats_.fields++;
+
+	if (!second) {
+		/* A frame still waiting for its second field never gets it */
+		if (cur_)
+			cur_->closed = true;
+		frames_.push_back(std::make_unique<frame>());
+		cur_ = frames_.back().get();
+		cur_->data.assign(frame_size(), 0);
+	}
+	if (cur_)
+		cur_->fields[second] = true;
+	else
+		stats_.dropped++;
+
+	field_ = second;
+	next_number_ = static_cast<int>(vsync_line_ - (g - first));
+	for (size_t k = first; k < lines_.size(); k++)
+		bind(lines_[k], field_, next_number_++);
+}
+
+void tbc::close_field()
+{
+	if (field_ == 1 && cur_) {
+		cur_->closed = true;
+		cur_ = nullptr;
+	}
+	field_ = -1;
+}
+
+void tbc::retire()
+{
+	line &l = lines_[0];
+	double len = lines_[1].start - l.start;
+
+	if (l.fr) {
+		unsigned int row = weave_ ? 2 * l.number + (l.field != top_) :
+					    (l.field ? field_lines_[0] : 0) + l.number;
+
+		/* Weaving drops the last line of the longer bottom field, it is blanking */
+		if (row < height_)
+			jobs_.push_back({ l.start, len, l.fr->data.data() + static_cast<size_t>(row) * width_ });
+		l.fr->pending--;
+	}
+
+	/* Sync tip inside the pulse, blanking on the back porch (burst averages out) */
+	if (l.hsync && len > 10 * us_) {
+		const uint8_t *s = buf_.data() + (std::lround(l.start) - base_);
+		size_t a0 = std::lround(1 * us_), a1 = std::lround(3.5 * us_);
+		size_t b0 = std::lround(5.5 * us_), b1 = std::lround(8.5 * us_);
+		double tip = 0, blank = 0;
+
+		for (size_t k = a0; k < a1; k++)
+			tip += s[k];
+		for (size_t k = b0; k < b1; k++)
+			blank += s[k];
+		tip /= (a1 - a0);
+		blank /= (b1 - b0);
+		if (blank - tip > 8) {
+			tip_ += (tip - tip_) / 32;
+			blank_ += (blank - blank_) / 32;
+			set_threshold();
+		}
+	}
+	lines_.pop_front();
+}
+
+void tbc::unlock()
+{
+	while (lines_.size() > 1)
+		retire();
+	if (!lines_.empty() && lines_.front().fr)
+		lines_.front().fr->pending--;
+	lines_.clear();
+
+	/* Whatever was being assembled ends here */
+	close_field();
+	if (cur_) {
+		cur_->closed = true;
+		cur_ = nullptr;
+	}
+	locked_ = false;
+	in_vsync_ = false;
+	miss_ = 0;
+	last_hsync_ = -1;
+	h_ = h_nom_;
+	stats_.relocks++;
+}
+
+}
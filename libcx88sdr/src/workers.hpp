@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library
+ *
+ * Persistent worker threads for block-parallel DSP: run() splits a job
+ * into tasks, the calling thread takes part and returns once all are done.
+ */
+
+#ifndef CX88SDR_WORKERS_HPP
+#define CX88SDR_WORKERS_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cx88sdr {
+
+class workers {
+public:
+	/* threads = 0: one per online CPU */
+	explicit workers(unsigned int threads)
+	{
+		if (!threads)
+			threads = std::max(1U, std::thread::hardware_concurrency());
+		for (unsigned int i = 1; i < threads; i++)
+			threads_.emplace_back(&workers::loop, this);
+		count_ = threads;
+	}
+
+	~workers()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			quit_ = true;
+		}
+		start_.notify_all();
+		for (auto &t : threads_)
+			t.join();
+	}
+
+	workers(const workers &) = delete;
+	workers &operator=(const workers &) = delete;
+
+	unsigned int size() const { return count_; }
+
+	/* fn(task) for task in [0, tasks), in parallel */
+	void run(size_t tasks, const std::function<void(size_t)> &fn)
+	{
+		if (threads_.empty() || tasks < 2) {
+			for (size_t i = 0; i < tasks; i++)
+				fn(i);
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		fn_ = &fn;
+		tasks_ = tasks;
+		next_ = 0;
+		pending_ = tasks;
+		gen_++;
+		start_.notify_all();
+		drain(lock);
+		done_.wait(lock, [this] { return !pending_; });
+		fn_ = nullptr;
+	}
+
+private:
+	/* Called locked, runs tasks until none are left to start */
+	void drain(std::unique_lock<std::mutex> &lock)
+	{
+		while (fn_ && next_ < tasks_) {
+			size_t task = next_++;
+			const std::function<void(size_t)> *fn = fn_;
+
+			lock.unlock();
+			(*fn)(task);
+			lock.lock();
+			if (!--pending_)
+				done_.notify_all();
+		}
+	}
+
+	void loop()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		unsigned long seen = 0;
+
+		for (;;) {
+			start_.wait(lock, [&] { return quit_ || gen_ != seen; });
+			if (quit_)
+				return;
+			seen = gen_;
+			drain(lock);
+		}
+	}
+
+	std::vector<std::thread>		threads_;
+	unsigned int				count_ = 1;
+	std::mutex				mutex_;
+	std::condition_variable			start_, done_;
+	const std::function<void(size_t)>	*fn_ = nullptr;
+	size_t					tasks_ = 0, next_ = 0, pending_ = 0;
+	unsigned long				gen_ = 0;
+	bool					quit_ = false;
+};
+
+}
+
+#endif
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library tests
+ *
+ * Level statistics of synthetic sines: the level reads the amplitude, the
+ * clip rate the share of the period past full scale, and RU16LE samples
+ * bin as their high byte. The controller, without a card, steps the gains
+ * in order after hold windows and settles, and finds which way DC Offset
+ * moves the mean whichever way the card responds.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "cx88sdr/agc.hpp"
+
+using namespace cx88sdr;
+
+static const size_t samples = 100000;
+
+/* Amplitude a (1: full scale) around mid-scale + offset (1: full scale), 8-bit codes */
+static std::vector<uint8_t> sine(double a, double offset = 0)
+{
+	std::vector<uint8_t> s(samples);
+
+	for (size_t i = 0; i < s.size(); i++) {
+		double x = 128 * (1 + offset + a * std::sin(2 * M_PI * i / 1000.0 + 0.3));
+
+		s[i] = static_cast<uint8_t>(std::min(std::max(std::floor(x), 0.0), 255.0));
+	}
+	return s;
+}
+
+static level_stats stats(double a, double offset = 0)
+{
+	std::vector<uint8_t> s = sine(a, offset);
+	level_stats st;
+
+	st.add(s.data(), s.size());
+	return st;
+}
+
+static void level_test()
+{
+	for (double a : { 0.1, 0.5, 0.9 }) {
+		std::vector<uint8_t> s = sine(a);
+		level_stats st = stats(a);
+
+		CHECK(std::fabs(st.level() - a) < 2.0 / 128, "a %.1f: level %.4f", a, st.level());
+		CHECK(std::fabs(st.mean() - 127.5) < 0.5, "a %.1f: mean %.2f", a, st.mean());
+		CHECK(st.clip_rate() == 0, "a %.1f: clip rate %.2e", a, st.clip_rate());
+		CHECK(st.min == *std::min_element(s.begin(), s.end()) &&
+		      st.max == *std::max_element(s.begin(), s.end()),
+		      "a %.1f: min %u max %u", a, st.min, st.max);
+		CHECK(st.count == samples && st.hist_count == samples / level_stats::hist_stride,
+		      "a %.1f: count %llu hist %llu", a, (unsigned long long)st.count,
+		      (unsigned long long)st.hist_count);
+	}
+
+	/* Past full scale for the share of the period where |sin| > 1 / a */
+	level_stats st = stats(1.5);
+	double clip = 1 - 2 / M_PI * std::asin(1 / 1.5);
+
+	CHECK(std::fabs(st.clip_rate() - clip) < 0.01, "clip rate %.4f, expected %.4f",
+	      st.clip_rate(), clip);
+	CHECK(st.level() > 0.99, "clipped level %.4f", st.level());
+
+	st = stats(0.3, 0.1);
+	CHECK(std::fabs((st.mean() - 127.5) / 128 - 0.1) < 0.01, "offset mean %.2f", st.mean());
+}
+
+/* Any low byte: RU16LE samples give the statistics of their high bytes */
+static void ru16_test()
+{
+	std::vector<uint8_t> s8 = sine(0.7, 0.05);
+	std::vector<uint16_t> s16(s8.size());
+	level_stats st8, st16;
+
+	for (size_t i = 0; i < s8.size(); i++)
+		s16[i] = static_cast<uint16_t>(s8[i] << 8 | ((i * 37) & 0xff));
+	st8.add(s8.data(), s8.size());
+	st16.add(s16.data(), s16.size());
+
+	CHECK(st8.count == st16.count && st8.sum == st16.sum, "sum %llu vs %llu",
+	      (unsigned long long)st8.sum, (unsigned long long)st16.sum);
+	CHECK(st8.min == st16.min && st8.max == st16.max, "min %u/%u max %u/%u",
+	      st8.min, st16.min, st8.max, st16.max);
+	CHECK(std::equal(st8.hist, st8.hist + 256, st16.hist), "histograms differ");
+}
+
+/* Feeds windows of s until a change, returns the window it came in (1-based), 0 if none */
+static unsigned int until_change(agc &ctl, const level_stats &s, unsigned int max,
+				 std::vector<agc_change> &out)
+{
+	for (unsigned int w = 1; w <= max; w++) {
+		out = ctl.update(s);
+		if (!out.empty())
+			return w;
+	}
+	return 0;
+}
+
+static void gain_test()
+{
+	agc_options opts;
+	agc_controls start;
+	std::vector<agc_change> out;
+
+	opts.dc = false;
+
+	/* In range: nothing moves */
+	start.gain = 10;
+	agc steady(start, opts);
+	CHECK(until_change(steady, stats(0.6), 50, out) == 0, "change in range");
+
+	/* Clipping: down after hold windows, then settle windows pass first */
+	agc hot(start, opts);
+	unsigned int w = until_change(hot, stats(1.5), 50, out);
+
+	CHECK(w == opts.hold, "first step in window %u", w);
+	CHECK(out.size() == 1 && out[0].control == "gain" && out[0].from == 10 &&
+	      out[0].to == 9 && out[0].sample == 0, "first step %s %d -> %d",
+	      out.empty() ? "none" : out[0].control.c_str(), out.empty() ? 0 : out[0].from,
+	      out.empty() ? 0 : out[0].to);
+	w = until_change(hot, stats(1.5), 50, out);
+	CHECK(w == opts.settle + opts.hold, "second step in window %u", w);
+	CHECK(hot.controls().gain == 8, "gain %d", hot.controls().gain);
+
+	/* Up: Gain to its top, +6dB, then Gain 2 */
+	start.gain = 30;
+	agc cold(start, opts);
+	std::vector<std::string> order;
+
+	for (unsigned int i = 0; i < 3; i++) {
+		if (until_change(cold, stats(0.2), 50, out))
+			order.push_back(out[0].control);
+	}
+	CHECK(order == std::vector<std::string>({ "gain", "gain_6db", "gain2" }),
+	      "up order %s ...", order.empty() ? "none" : order[0].c_str());
+
+	/* Down: Gain 2, Gain, +6dB, then nothing left to take off */
+	start.gain = 1;
+	start.gain_6db = 1;
+	start.gain2 = 1;
+	agc loud(start, opts);
+
+	order.clear();
+	for (unsigned int i = 0; i < 4; i++) {
+		if (until_change(loud, stats(0.95), 50, out))
+			order.push_back(out[0].control);
+	}
+	CHECK(order == std::vector<std::string>({ "gain2", "gain", "gain_6db" }),
+	      "down order %s ...", order.empty() ? "none" : order[0].c_str());
+	CHECK(loud.controls().gain == 0 && !loud.controls().gain_6db && !loud.controls().gain2,
+	      "down to %d/%d/%d", loud.controls().gain, loud.controls().gain_6db,
+	      loud.controls().gain2);
+}
+
+/* The mean moves by k of full scale per DC Offset step, either way */
+static void dc_test(double k)
+{
+	agc_options opts;
+	agc_controls start;
+	double offset = 0;
+
+	opts.gain = false;
+	start.dc = 32;
+	agc ctl(start, opts);
+
+	for (unsigned int w = 0; w < 200; w++) {
+		offset = 0.1 + k * (ctl.controls().dc - 32);
+		ctl.update(stats(0.3, offset));
+	}
+	CHECK(std::fabs(offset) <= opts.dc_max, "k %.3f: offset %.3f at DC Offset %d",
+	      k, offset, ctl.controls().dc);
+	CHECK(ctl.controls().gain == 0, "k %.3f: gain moved", k);
+}
+
+int main()
+{
+	level_test();
+	ru16_test();
+	gain_test();
+	dc_test(0.01);
+	dc_test(-0.01);
+	return check_result();
+}
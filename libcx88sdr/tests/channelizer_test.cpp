@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library tests
+ *
+ * Channelizer: a tone inside one channel comes out of it as the ideal
+ * complex baseband tone, amplitude and phase, with the prototype's group
+ * delay, and stays out of every other channel.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include "check.hpp"
+#include "cx88sdr/channelizer.hpp"
+
+using namespace cx88sdr;
+
+static double db(double p)
+{
+	return 10 * std::log10(std::max(p, 1e-30));
+}
+
+/*
+ * A cosine of amplitude a at (k + offset) channel spacings, fed in chunks,
+ * the worst error of channel k against a / 2 e^(j (dw (t - delay) + phi))
+ * and the loudest other channel, both in dB relative to the tone.
+ */
+static void tone_test(unsigned int m, unsigned int os, unsigned int k, double offset,
+		      size_t chunk, unsigned int threads, double &err_db, double &leak_db)
+{
+	channelizer_options opts;
+	const double a = 0.5, phi = 0.7;
+	double w = 2 * M_PI * (k + offset) / m, dw = 2 * M_PI * offset / m, delay;
+	std::vector<std::vector<std::complex<float>>> out;
+	size_t n = static_cast<size_t>(m) * 2048, skip;
+	std::vector<float> in(n);
+	double err = 0, leak = 0;
+	unsigned int self = 0;
+
+	opts.channels = m;
+	opts.oversample = os;
+	opts.threads = threads;
+	channelizer ch(opts);
+
+	for (size_t i = 0; i < n; i++)
+		in[i] = static_cast<float>(a * std::cos(w * i + phi));
+	for (size_t i = 0; i < n; i += chunk)
+		ch.process(in.data() + i, std::min(chunk, n - i), out);
+
+	CHECK(out.size() == ch.selected().size(), "%zu channels out", out.size());
+	CHECK(ch.outputs() == out[0].size(), "%zu outputs", out[0].size());
+	CHECK(out[0].size() + 2 >= n / ch.decimation(), "only %zu outputs", out[0].size());
+
+	delay = (static_cast<double>(m) * opts.taps - 1) / 2;
+	/* From the first frame whose filter sees only the tone */
+	skip = opts.taps * os;
+	for (size_t c = 0; c < out.size(); c++) {
+		unsigned int kc = ch.selected()[c];
+
+		for (size_t f = skip; f < out[c].size(); f++) {
+			double t = static_cast<double>(f) * ch.decimation();
+
+			if (kc == k) {
+				std::complex<double> want = std::polar(a / 2, dw * (t - delay) + phi);
+
+				/* Channel 0 also passes the negative frequency */
+				if (!k)
+					want += std::conj(want);
+
+				err = std::max(err, std::norm(std::complex<double>(out[c][f]) - want));
+				self++;
+			} else {
+				leak = std::max(leak, static_cast<double>(std::norm(out[c][f])));
+			}
+		}
+	}
+	CHECK(self > 0, "channel %u missing", k);
+	err_db = db(err) - db(a * a / 4);
+	leak_db = db(leak) - db(a * a / 4);
+}
+
+int main()
+{
+	double err, leak;
+
+	tone_test(64, 2, 5, 0.2, 1 << 20, 1, err, leak);
+	CHECK(err < -75, "M = 64, channel 5: error %.1f dB", err);
+	CHECK(leak < -75, "M = 64, channel 5: leak %.1f dB", leak);
+
+	/* Below the centre, in small blocks, on several threads */
+	tone_test(256, 4, 37, -0.25, 1000, 0, err, leak);
+	CHECK(err < -75, "M = 256, channel 37: error %.1f dB", err);
+	CHECK(leak < -75, "M = 256, channel 37: leak %.1f dB", leak);
+
+	/* Channel 0 holds the tone and its mirror image */
+	tone_test(64, 2, 0, 0.1, 1 << 20, 1, err, leak);
+	CHECK(err < -75, "M = 64, channel 0: error %.1f dB", err);
+	CHECK(leak < -75, "M = 64, channel 0: leak %.1f dB", leak);
+
+	return check_result();
+}
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library tests
+ *
+ * A failed CHECK() prints where and why and is counted, the test goes on
+ * so one run shows every failure. main() returns check_result().
+ */
+
+#ifndef CX88SDR_TESTS_CHECK_HPP
+#define CX88SDR_TESTS_CHECK_HPP
+
+#include <cstdio>
+
+static int check_failures;
+
+#define CHECK(cond, ...)							\
+	do {									\
+		if (!(cond)) {							\
+			fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);	\
+			fprintf(stderr, __VA_ARGS__);				\
+			fputc('\n', stderr);					\
+			check_failures++;					\
+		}								\
+	} while (0)
+
+static inline int check_result()
+{
+	if (check_failures)
+		fprintf(stderr, "%d checks failed\n", check_failures);
+	return check_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library tests
+ *
+ * FFT: every size against a direct DFT in double precision, both entry
+ * points, on the same pseudo-random input.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "check.hpp"
+#include "cx88sdr/fft.hpp"
+
+using namespace cx88sdr;
+
+/* Worst bin error relative to the RMS of the spectrum */
+static double fft_error(unsigned int n, bool permuted)
+{
+	std::vector<float> re(n), im(n), pre(n), pim(n);
+	std::vector<double> xr(n), xi(n);
+	uint32_t seed = n;
+	double err = 0, rms = 0;
+	fft f(n);
+
+	for (unsigned int i = 0; i < n; i++) {
+		seed = seed * 1664525 + 1013904223;
+		re[i] = static_cast<float>(seed >> 8) / (1 << 24) - 0.5f;
+		seed = seed * 1664525 + 1013904223;
+		im[i] = static_cast<float>(seed >> 8) / (1 << 24) - 0.5f;
+	}
+	for (unsigned int k = 0; k < n; k++) {
+		for (unsigned int i = 0; i < n; i++) {
+			double a = -2 * M_PI * (static_cast<uint64_t>(k) * i % n) / n;
+
+			xr[k] += re[i] * std::cos(a) - im[i] * std::sin(a);
+			xi[k] += re[i] * std::sin(a) + im[i] * std::cos(a);
+		}
+		rms += xr[k] * xr[k] + xi[k] * xi[k];
+	}
+	rms = std::sqrt(rms / n);
+
+	if (permuted) {
+		for (unsigned int i = 0; i < n; i++) {
+			pre[f.perm(i)] = re[i];
+			pim[f.perm(i)] = im[i];
+		}
+		f.forward_permuted(pre.data(), pim.data());
+	} else {
+		pre = re;
+		pim = im;
+		f.forward(pre.data(), pim.data());
+	}
+	for (unsigned int k = 0; k < n; k++)
+		err = std::max(err, std::hypot(pre[k] - xr[k], pim[k] - xi[k]));
+	return err / rms;
+}
+
+int main()
+{
+	for (unsigned int n = 16; n <= 4096; n *= 2) {
+		double e = fft_error(n, false), p = fft_error(n, true);
+
+		CHECK(e < 2e-6, "forward, N = %u: error %.3g", n, e);
+		CHECK(p < 2e-6, "forward_permuted, N = %u: error %.3g", n, p);
+	}
+	return check_result();
+}
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library tests
+ *
+ * Recording: what recording_writer writes, recording reads back. Samples,
+ * stream positions and times round trip across a gap, and configuration
+ * changes land on the sample they were made at, or after the gap when
+ * they fell in it.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "check.hpp"
+#include "cx88sdr/recording.hpp"
+
+using namespace cx88sdr;
+
+static const double rate = 1e6;			/* 1 us per sample */
+static const int64_t t0 = 1700000000000000000;	/* CLOCK_REALTIME of stream position 0 */
+static const uint64_t first = 1000;		/* Stream position of the first sample */
+static const uint64_t gap_at = 301000, gap = 5000;	/* At a block boundary */
+static const uint64_t change_at = 123456;
+static const size_t block = 10000, blocks = 60;
+
+static int64_t time_of_global(uint64_t g)
+{
+	return t0 + static_cast<int64_t>(g) * 1000;
+}
+
+static void write_recording(const std::string &base)
+{
+	recording_writer w(base, rate, 1, recording_ctrl(), "test");
+	std::vector<uint8_t> buf(block);
+	uint64_t pos = first;
+
+	w.set_index_interval(25000);
+	for (size_t b = 0; b < blocks; b++) {
+		if (pos == gap_at) {
+			/* A change inside the gap, reported before the data after it */
+			w.config(gap_at + gap / 2, CX88SDR_CONFIG_RATE, 2000000);
+			pos += gap;
+		}
+		if (pos <= change_at && change_at < pos + block)
+			w.config(change_at, V4L2_CID_GAIN, 7);
+		for (size_t i = 0; i < block; i++)
+			buf[i] = static_cast<uint8_t>((pos + i) * 7);
+		w.write(buf.data(), block, pos, time_of_global(pos + block));
+		pos += block;
+	}
+	CHECK(w.samples() == blocks * block, "writer has %llu samples",
+	      static_cast<unsigned long long>(w.samples()));
+	CHECK(w.gaps() == 1 && w.lost() == gap, "writer lost %llu in %llu gaps",
+	      static_cast<unsigned long long>(w.lost()), static_cast<unsigned long long>(w.gaps()));
+}
+
+static uint64_t global_of_sample(uint64_t s)
+{
+	uint64_t g = first + s;
+
+	return (g >= gap_at) ? g + gap : g;
+}
+
+int main()
+{
+	std::string base = "recording_test_" + std::to_string(getpid());
+	uint64_t after = gap_at - first;	/* First sample after the gap */
+
+	write_recording(base);
+	{
+		recording rec(base);
+		std::vector<index_record> ev = rec.events();
+		uint64_t bad = 0;
+
+		CHECK(rec.samples() == blocks * block, "%llu samples",
+		      static_cast<unsigned long long>(rec.samples()));
+		CHECK(rec.header().samples == rec.samples(), "header has %llu samples",
+		      static_cast<unsigned long long>(rec.header().samples));
+		CHECK(rec.header().start_ns == time_of_global(first), "starts at %lld",
+		      static_cast<long long>(rec.header().start_ns));
+
+		for (uint64_t s = 0; s < rec.samples(); s++) {
+			uint64_t g = global_of_sample(s);
+
+			bad += rec.data()[s] != static_cast<uint8_t>(g * 7) || rec.global_of(s) != g;
+		}
+		CHECK(!bad, "%llu samples with the wrong data or stream position",
+		      static_cast<unsigned long long>(bad));
+
+		/* Every record time, and times between them, both ways */
+		for (uint64_t s = 0; s < rec.samples(); s += 997) {
+			int64_t t = rec.time_of(s);
+
+			CHECK(t == time_of_global(global_of_sample(s)), "sample %llu at %lld",
+			      static_cast<unsigned long long>(s), static_cast<long long>(t));
+			CHECK(rec.sample_at(t) == s, "time of sample %llu gives %llu",
+			      static_cast<unsigned long long>(s),
+			      static_cast<unsigned long long>(rec.sample_at(t)));
+		}
+		CHECK(rec.sample_at(time_of_global(gap_at + gap / 3)) == after,
+		      "a time inside the gap gives sample %llu",
+		      static_cast<unsigned long long>(rec.sample_at(time_of_global(gap_at + gap / 3))));
+		CHECK(rec.sample_at(t0) == 0, "a time before the start");
+		CHECK(rec.sample_at(time_of_global(first + gap + blocks * block + 10)) == rec.samples(),
+		      "a time after the end");
+
+		CHECK(ev.size() == 3, "%zu events", ev.size());
+		if (ev.size() == 3) {
+			CHECK(ev[0].type == record_type::config && ev[0].id == V4L2_CID_GAIN &&
+			      ev[0].value == 7 && ev[0].sample == change_at - first,
+			      "gain change at sample %llu", static_cast<unsigned long long>(ev[0].sample));
+			CHECK(ev[0].time_ns == time_of_global(change_at), "gain change at %lld",
+			      static_cast<long long>(ev[0].time_ns));
+			CHECK(ev[1].type == record_type::config && ev[1].id == CX88SDR_CONFIG_RATE &&
+			      ev[1].sample == after, "rate change at sample %llu",
+			      static_cast<unsigned long long>(ev[1].sample));
+			CHECK(ev[2].type == record_type::gap && ev[2].value == static_cast<int64_t>(gap) &&
+			      ev[2].sample == after && ev[2].global == gap_at + gap,
+			      "gap of %lld at sample %llu", static_cast<long long>(ev[2].value),
+			      static_cast<unsigned long long>(ev[2].sample));
+		}
+	}
+
+	for (const char *ext : { ".sigmf-data", ".sigmf-meta", ".cx88idx" })
+		unlink((base + ext).c_str());
+	return check_result();
+}
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library tests
+ *
+ * Resampler: a sine in the passband comes out as the same sine at the
+ * output rate, with no delay, fed in one block or in small pieces.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "check.hpp"
+#include "cx88sdr/resampler.hpp"
+
+using namespace cx88sdr;
+
+/* Peak error against the ideal sine, dB relative to its amplitude */
+static double sine_error_db(double in_rate, double out_rate, double tone_hz, size_t chunk,
+			    unsigned int threads)
+{
+	resampler_options opts;
+	size_t n = 200000;
+	std::vector<float> in(n), out;
+	double err = 0;
+
+	opts.in_rate = in_rate;
+	opts.out_rate = out_rate;
+	opts.threads = threads;
+	resampler rs(opts);
+
+	for (size_t i = 0; i < n; i++)
+		in[i] = static_cast<float>(0.5 * std::sin(2 * M_PI * tone_hz * i / in_rate));
+	for (size_t i = 0; i < n; i += chunk)
+		rs.process(in.data() + i, std::min(chunk, n - i), out);
+
+	CHECK(rs.inputs() == n, "%llu inputs", static_cast<unsigned long long>(rs.inputs()));
+	CHECK(rs.outputs() == out.size(), "%llu outputs, %zu returned",
+	      static_cast<unsigned long long>(rs.outputs()), out.size());
+	CHECK(out.size() + 2 > n * out_rate / in_rate - rs.taps(), "only %zu outputs", out.size());
+
+	/* Skip the start, where the filter still sees the silence before the first sample */
+	for (size_t k = 2 * rs.taps(); k < out.size(); k++) {
+		double want = 0.5 * std::sin(2 * M_PI * tone_hz * k / out_rate);
+
+		err = std::max(err, std::fabs(out[k] - want));
+	}
+	return 20 * std::log10(err / 0.5);
+}
+
+int main()
+{
+	const double adc = 28636360;
+	double db;
+
+	/* Interpolating, decimating, and decimating by a ratio that isn't rational */
+	db = sine_error_db(48000, 44100, 3000, 200000, 1);
+	CHECK(db < -75, "48k to 44.1k: %.1f dB", db);
+	db = sine_error_db(adc, 2 * adc / 7, 1e6, 200000, 1);
+	CHECK(db < -75, "ADC / 3.5: %.1f dB", db);
+	db = sine_error_db(adc, 3e6, 500e3, 200000, 0);
+	CHECK(db < -75, "ADC to 3 MS/s: %.1f dB", db);
+
+	/* Block boundaries don't show */
+	db = sine_error_db(adc, 3e6, 500e3, 777, 1);
+	CHECK(db < -75, "ADC to 3 MS/s in 777 sample blocks: %.1f dB", db);
+
+	return check_result();
+}
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library tests
+ *
+ * Spectrogram: a full-scale sine reads 0 dBFS in its bin, and lines
+ * written with spectrogram_writer decode back to the same codes, whole
+ * and through time-range queries that cross block boundaries.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "check.hpp"
+#include "cx88sdr/spectrogram.hpp"
+
+using namespace cx88sdr;
+
+static const int64_t t0 = 1700000000000000000;
+static const unsigned int nlines = 203, block_lines = 16;
+
+static void sine_test()
+{
+	spectrum_options opts;
+	std::vector<float> in, out;
+	std::vector<uint64_t> starts;
+	unsigned int bin = 20;
+
+	opts.fft_size = 256;
+	opts.average = 8;
+	opts.in_rate = 1e6;
+	spectrum_analyzer an(opts);
+
+	in.resize(an.line_samples() * 3 + an.hop());
+	for (size_t i = 0; i < in.size(); i++)
+		in[i] = static_cast<float>(std::cos(2 * M_PI * bin * i / opts.fft_size));
+	CHECK(an.process(in.data(), in.size(), out, starts) == 3, "%zu lines", starts.size());
+	CHECK(out.size() == 3 * an.bins(), "%zu values", out.size());
+	for (size_t l = 0; l < starts.size(); l++) {
+		const float *line = &out[l * an.bins()];
+		unsigned int peak = static_cast<unsigned int>(std::max_element(line, line + an.bins()) - line);
+
+		CHECK(starts[l] == l * an.line_samples(), "line %zu starts at %llu", l,
+		      static_cast<unsigned long long>(starts[l]));
+		CHECK(peak == bin && std::fabs(line[bin]) < 0.05, "line %zu: %.2f dB at bin %u", l,
+		      line[peak], peak);
+		/* Hann sidelobes are gone 3 bins out */
+		CHECK(line[bin + 4] < -100 && line[bin - 4] < -100, "line %zu: %.1f, %.1f dB 4 bins out",
+		      l, line[bin + 4], line[bin - 4]);
+	}
+}
+
+/* Levels of line l: slow drift, jumps, and levels clipped at both ends */
+static std::vector<float> test_line(unsigned int l, unsigned int bins, uint32_t &seed)
+{
+	std::vector<float> db(bins);
+
+	for (unsigned int b = 0; b < bins; b++) {
+		seed = seed * 1664525 + 1013904223;
+		db[b] = -120 + 0.01f * l * b + static_cast<float>(seed >> 28) * 0.625f;
+		if (b % 37 == l % 37)
+			db[b] = (l & 1) ? -200 : 10;
+	}
+	return db;
+}
+
+static uint8_t code(float db, const spectrogram_options &o)
+{
+	return static_cast<uint8_t>(std::min(std::max(std::nearbyint((db - o.db_min) / o.db_step),
+						      0.0f), 255.0f));
+}
+
+int main()
+{
+	std::string base = "spectrogram_test_" + std::to_string(getpid());
+	spectrogram_options so;
+	spectrum_options ao;
+	std::vector<uint8_t> want;
+	int64_t line_ns;
+	uint32_t seed = 1;
+
+	sine_test();
+
+	ao.fft_size = 512;
+	ao.average = 16;
+	ao.in_rate = 28636360;
+	so.block_lines = block_lines;
+	spectrum_analyzer an(ao);
+	{
+		spectrogram_writer w(base, an, so);
+
+		line_ns = std::llround(an.line_samples() * 1e9 / ao.in_rate);
+		for (unsigned int l = 0; l < nlines; l++) {
+			std::vector<float> db = test_line(l, an.bins(), seed);
+
+			for (float v : db)
+				want.push_back(code(v, so));
+			w.add(db.data(), t0 + l * line_ns, l * an.line_samples());
+		}
+		CHECK(w.lines() == nlines, "writer has %llu lines",
+		      static_cast<unsigned long long>(w.lines()));
+	}
+
+	spectrogram spg(base);
+	std::vector<uint8_t> codes;
+	std::vector<spectrogram_line> meta;
+	unsigned int bins = spg.bins();
+
+	CHECK(bins == an.bins(), "%u bins", bins);
+	CHECK(spg.lines() == nlines, "%llu lines", static_cast<unsigned long long>(spg.lines()));
+	CHECK(spg.block_count() == (nlines + block_lines - 1) / block_lines, "%llu blocks",
+	      static_cast<unsigned long long>(spg.block_count()));
+	CHECK(spg.line_ns() == line_ns, "lines of %lld ns", static_cast<long long>(spg.line_ns()));
+	CHECK(spg.header().start_ns == t0, "starts at %lld", static_cast<long long>(spg.header().start_ns));
+
+	for (uint64_t i = 0; i < spg.block_count(); i++)
+		spg.decode(i, codes, meta);
+	CHECK(codes == want, "decoded codes differ");
+	CHECK(meta.size() == nlines, "%zu lines decoded", meta.size());
+	for (size_t l = 0; l < meta.size(); l++) {
+		CHECK(meta[l].time_ns == t0 + static_cast<int64_t>(l) * line_ns &&
+		      meta[l].global == l * an.line_samples(), "line %zu at %lld", l,
+		      static_cast<long long>(meta[l].time_ns));
+	}
+
+	/* [first, last) in lines, bounds inside lines so rounding can't matter */
+	static const unsigned int ranges[][2] = {
+		{ 0, nlines }, { 37, 101 }, { 16, 32 }, { 15, 17 }, { 200, nlines }, { 50, 50 },
+	};
+	for (const auto &r : ranges) {
+		size_t n;
+
+		codes.clear();
+		meta.clear();
+		n = spg.read(t0 + r[0] * line_ns - line_ns / 2, t0 + r[1] * line_ns - line_ns / 2,
+			     codes, meta);
+		CHECK(n == r[1] - r[0] && meta.size() == n, "lines %u to %u: %zu lines", r[0], r[1], n);
+		CHECK(std::equal(codes.begin(), codes.end(), want.begin() + r[0] * bins) &&
+		      codes.size() == n * bins, "lines %u to %u: codes differ", r[0], r[1]);
+		if (n)
+			CHECK(meta[0].time_ns == t0 + r[0] * line_ns, "lines %u to %u start at %lld",
+			      r[0], r[1], static_cast<long long>(meta[0].time_ns));
+	}
+	codes.clear();
+	meta.clear();
+	CHECK(!spg.read(t0 - 10 * line_ns, t0 - line_ns, codes, meta), "lines before the start");
+	CHECK(!spg.read(t0 + nlines * line_ns, t0 + 2 * nlines * line_ns, codes, meta),
+	      "lines after the end");
+
+	unlink((base + ".cx88spg").c_str());
+	unlink((base + ".cx88spgidx").c_str());
+	return check_result();
+}
@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library tests
+ *
+ * Time-base corrector on synthetic composite video: NTSC and PAL sync
+ * with equalizing and broad pulses, every line carrying a ramp across its
+ * whole length. The corrector locks to the lines, and the ramp must come
+ * out straight on every row, even with line lengths wandering like tape.
+ * Dropped syncs are coasted over by the flywheel, too many lose the lock.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "check.hpp"
+#include "cx88sdr/tbc.hpp"
+
+using namespace cx88sdr;
+
+static const double rate = 28636363;
+static const double tip = 16, blank = 64;
+
+/* Ramp level at fraction x of its line */
+static double ramp(double x)
+{
+	return 80 + 120 * x;
+}
+
+enum pulse_kind { none, hsync, eq, broad };
+
+struct standard {
+	video_standard	std;
+	double		line_rate;
+	unsigned int	half_lines;	/* Per frame */
+	double		broad_us;
+};
+
+static const standard ntsc = { video_standard::ntsc, 4500000.0 / 286, 1050, 27.1 };
+static const standard pal = { video_standard::pal, 15625.0, 1250, 27.3 };
+
+/*
+ * Pulse at the start of half-line h of a frame. NTSC: equalizing,
+ * broad, equalizing, six each from half-lines 0 and 525. PAL: broad and
+ * equalizing, five each from half-lines 0 and 625, five equalizing before.
+ */
+static pulse_kind pulse_at(const standard &s, unsigned int h)
+{
+	if (s.std == video_standard::ntsc) {
+		unsigned int f = (h >= 525) ? h - 525 : h;
+
+		if (f < 6 || (f >= 12 && f < 18))
+			return eq;
+		if (f < 12)
+			return broad;
+		return (h % 2) ? none : hsync;
+	}
+
+	unsigned int f = (h >= 625) ? h - 625 : h;
+
+	if (f < 5)
+		return broad;
+	if (f < 10 || h >= 1245 || (h >= 620 && h < 625))
+		return eq;
+	return (h % 2) ? none : hsync;
+}
+
+struct signal {
+	std::vector<uint8_t>	samples;
+	unsigned int		frames;
+};
+
+/*
+ * frames frames from line start, line lengths off by wander (a
+ * fraction) in a slow sine, no pulse on the lines in [drop, drop + drops)
+ * of every frame. Edges are box filtered to a sample, so the threshold
+ * crossing the corrector interpolates is the exact edge.
+ */
+static signal make(const standard &s, unsigned int frames, unsigned int start,
+		   double wander, unsigned int drop = 0, unsigned int drops = 0)
+{
+	double h = rate / s.line_rate, t = 0;
+	unsigned int lines = frames * s.half_lines / 2;
+	std::vector<double> starts, lens;
+	signal sig;
+
+	for (unsigned int l = 0; l <= lines; l++) {
+		double len = h * (1 + wander * std::sin(2 * M_PI * l / 37.0));
+
+		starts.push_back(t);
+		lens.push_back(len);
+		t += len;
+	}
+	sig.samples.resize(static_cast<size_t>(t));
+	sig.frames = frames;
+
+	for (unsigned int l = 0; l < lines; l++) {
+		unsigned int hl = 2 * (start + l) % s.half_lines;
+		double a = starts[l], len = lens[l], us = rate / 1e6;
+		size_t i0 = static_cast<size_t>(std::ceil(a)), i1 = static_cast<size_t>(a + len);
+		bool dropped = hl / 2 >= drop && hl / 2 < drop + drops;
+
+		for (size_t i = i0; i < i1 && i < sig.samples.size(); i++) {
+			double x = (i - a) / len, v = blank, c = 0;
+
+			if (pulse_at(s, hl) == hsync && x > 10.5 * us / len && x < 0.97)
+				v = ramp(x);
+			for (unsigned int half = 0; half < 2; half++) {
+				double p = a + half * len / 2, w = 0;
+
+				switch (pulse_at(s, (hl + half) % s.half_lines)) {
+				case hsync:
+					w = dropped ? 0 : 4.7 * us;
+					break;
+				case eq:
+					w = 2.3 * us;
+					break;
+				case broad:
+					w = s.broad_us * us;
+					break;
+				default:
+					break;
+				}
+				c += std::max(0.0, std::min(i + 0.5, p + w) - std::max(i - 0.5, p));
+			}
+			c = std::min(c, 1.0);
+			sig.samples[i] = static_cast<uint8_t>(std::lround(v * (1 - c) + tip * c));
+		}
+	}
+	return sig;
+}
+
+/* Feeds sig in chunks, as 8-bit or as RU16LE samples */
+static std::vector<uint8_t> run(tbc &t, const signal &sig, bool ru16)
+{
+	const size_t chunk = 100000;
+	std::vector<uint8_t> out;
+
+	for (size_t off = 0; off < sig.samples.size(); off += chunk) {
+		size_t n = std::min(chunk, sig.samples.size() - off);
+
+		if (ru16) {
+			std::vector<uint16_t> s(n);
+
+			for (size_t i = 0; i < n; i++)
+				s[i] = static_cast<uint16_t>(sig.samples[off + i] << 8 | (i & 0xff));
+			t.process(s.data(), n, out);
+		} else {
+			t.process(sig.samples.data() + off, n, out);
+		}
+	}
+	return out;
+}
+
+/* Worst error of the ramp over rows [first, last) of field 0 in every frame */
+static double ramp_error(const tbc &t, const std::vector<uint8_t> &out, unsigned int first,
+			 unsigned int last)
+{
+	double worst = 0;
+
+	for (size_t f = 0; f + t.frame_size() <= out.size(); f += t.frame_size()) {
+		for (unsigned int row = first; row < last; row++) {
+			const uint8_t *p = out.data() + f + static_cast<size_t>(row) * t.width();
+
+			for (double x : { 0.25, 0.5, 0.75, 0.9 }) {
+				unsigned int j = static_cast<unsigned int>(x * t.width());
+
+				worst = std::max(worst, std::fabs(p[j] - ramp(static_cast<double>(j) / t.width())));
+			}
+		}
+	}
+	return worst;
+}
+
+static void lock_test(const standard &s, const char *name, double wander, bool ru16)
+{
+	tbc_options opts;
+
+	opts.standard = s.std;
+	opts.in_rate = rate;
+	opts.threads = 2;
+	tbc t(opts);
+	signal sig = make(s, 5, 150, wander);
+	std::vector<uint8_t> out = run(t, sig, ru16);
+	const tbc_stats &st = t.stats();
+	unsigned int lines = s.half_lines / 2;
+
+	CHECK(t.height() == lines, "%s: height %u", name, t.height());
+	CHECK(st.frames >= sig.frames - 2 && out.size() == st.frames * t.frame_size(),
+	      "%s: %llu frames, %zu bytes", name, (unsigned long long)st.frames, out.size());
+	CHECK(st.relocks == 0 && st.flywheel == 0, "%s: %llu relocks, %llu flywheel lines",
+	      name, (unsigned long long)st.relocks, (unsigned long long)st.flywheel);
+	CHECK(st.lines >= (sig.frames - 1) * lines, "%s: %llu lines timed", name,
+	      (unsigned long long)st.lines);
+	/* Every row the same length in pixels, whatever the line's length in samples */
+	double err = ramp_error(t, out, 30, lines / 2 - 10);
+
+	CHECK(err < 1, "%s, wander %.3f: ramp off by %.1f", name, wander, err);
+}
+
+static void flywheel_test()
+{
+	tbc_options opts;
+
+	opts.in_rate = rate;
+	tbc coast(opts);
+	signal sig = make(ntsc, 5, 0, 0, 100, 5);
+	std::vector<uint8_t> out = run(coast, sig, false);
+	const tbc_stats &st = coast.stats();
+
+	CHECK(st.relocks == 0, "coast: %llu relocks", (unsigned long long)st.relocks);
+	CHECK(st.flywheel >= 5 * (sig.frames - 1) && st.flywheel <= 5 * sig.frames,
+	      "coast: %llu flywheel lines", (unsigned long long)st.flywheel);
+	CHECK(st.frames >= sig.frames - 2, "coast: %llu frames", (unsigned long long)st.frames);
+	double err = ramp_error(coast, out, 98, 108);
+
+	CHECK(err < 1, "coast: ramp off by %.1f over the dropped syncs", err);
+
+	/* More than the flywheel coasts over: the lock goes, and comes back */
+	tbc lose(opts);
+
+	sig = make(ntsc, 5, 0, 0, 100, 40);
+	out = run(lose, sig, false);
+	CHECK(lose.stats().relocks >= sig.frames - 1 && lose.stats().relocks <= sig.frames,
+	      "lose: %llu relocks", (unsigned long long)lose.stats().relocks);
+}
+
+int main()
+{
+	lock_test(ntsc, "ntsc", 0, false);
+	lock_test(ntsc, "ntsc", 0.005, false);
+	lock_test(pal, "pal", 0, true);
+	lock_test(pal, "pal", 0.005, true);
+	flywheel_test();
+	return check_result();
+}
@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR userspace client library tests
+ *
+ * Tone analyzer: an ideal b-bit quantiser fed a sine has SINAD
+ * 6.02 b + 1.76 dB for a full-scale tone, so enob_fs reads b, whatever
+ * the tone level. Clipping shows in the clip rate and the THD.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "check.hpp"
+#include "cx88sdr/tone.hpp"
+
+using namespace cx88sdr;
+
+static const double rate = 28636360, tone_hz = 1234567;
+static const unsigned int fft_size = 65536, frames = 8;
+
+/* A sine of amplitude a (1: full scale) quantised to b bits, in T-sized codes */
+template <typename T>
+static std::vector<T> quantised_sine(double a, unsigned int bits)
+{
+	const double mid = (sizeof(T) == 1) ? 128 : 32768, lsb = 2 * mid / (1U << bits);
+	std::vector<T> s(static_cast<size_t>(fft_size) * frames);
+
+	for (size_t i = 0; i < s.size(); i++) {
+		double x = a * mid * std::sin(2 * M_PI * tone_hz * i / rate + 0.3);
+		double q = mid + lsb * std::floor(x / lsb);
+
+		s[i] = static_cast<T>(std::min(std::max(q, 0.0), 2 * mid - 1));
+	}
+	return s;
+}
+
+static tone_result analyze(const std::vector<uint8_t> &s, tone_analyzer &an)
+{
+	return an.analyze(s.data(), s.size());
+}
+
+static tone_result analyze(const std::vector<uint16_t> &s, tone_analyzer &an)
+{
+	return an.analyze(s.data(), s.size());
+}
+
+template <typename T>
+static void enob_test(double a, unsigned int bits)
+{
+	tone_options opts;
+	tone_result r;
+
+	opts.fft_size = fft_size;
+	opts.in_rate = rate;
+	opts.tone_hz = tone_hz;
+	tone_analyzer an(opts);
+
+	r = analyze(quantised_sine<T>(a, bits), an);
+	CHECK(r.frames == frames, "%llu frames", static_cast<unsigned long long>(r.frames));
+	CHECK(std::fabs(r.tone_hz - tone_hz) < an.bin_hz() / 10, "%u bits at %.2f: tone at %.0f Hz",
+	      bits, a, r.tone_hz);
+	CHECK(std::fabs(r.tone_dbfs - 20 * std::log10(a)) < 0.05, "%u bits at %.2f: tone %.3f dBFS",
+	      bits, a, r.tone_dbfs);
+	CHECK(std::fabs(r.enob_fs - bits) < 0.1, "%u bits at %.2f: ENOB %.3f referred to full scale",
+	      bits, a, r.enob_fs);
+	CHECK(std::fabs(r.enob - r.enob_fs - r.tone_dbfs / 6.02) < 1e-9, "%u bits at %.2f: ENOB %.3f",
+	      bits, a, r.enob);
+	CHECK(r.clip_rate == 0, "%u bits at %.2f: clip rate %g", bits, a, r.clip_rate);
+}
+
+int main()
+{
+	enob_test<uint8_t>(0.98, 8);
+	enob_test<uint8_t>(0.5, 8);
+	enob_test<uint8_t>(0.95, 6);
+	enob_test<uint16_t>(0.98, 12);
+
+	/* Driven 2 dB past full scale the peaks flatten on the end codes */
+	tone_options opts;
+	opts.fft_size = fft_size;
+	opts.in_rate = rate;
+	opts.tone_hz = tone_hz;
+	tone_analyzer an(opts);
+	std::vector<uint8_t> s = quantised_sine<uint8_t>(1.26, 8);
+	tone_result r = an.analyze(s.data(), s.size());
+
+	CHECK(r.clip_rate > 0.1 && r.clip_rate < 0.5, "clipped: clip rate %g", r.clip_rate);
+	CHECK(r.thd_db > -40, "clipped: THD %.1f dB", r.thd_db);
+	CHECK(r.enob_fs < 6, "clipped: ENOB %.2f", r.enob_fs);
+
+	return check_result();
+}
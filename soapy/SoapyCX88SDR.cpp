@@ -0,0 +1,402 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SoapySDR module for the CX2388x SDR driver
+ *
+ * Streams straight out of the mmap()ed DMA ring, converting the real
+ * RU8/RU16LE samples to CS8/CS16/CF32 (I = sample, Q = 0) on the way.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include <SoapySDR/Device.hpp>
+#include <SoapySDR/Errors.hpp>
+#include <SoapySDR/Formats.hpp>
+#include <SoapySDR/Logger.hpp>
+#include <SoapySDR/Registry.hpp>
+#include <SoapySDR/Time.hpp>
+
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/convert.hpp"
+#include "cx88sdr/device.hpp"
+
+namespace {
+
+class SoapyCX88SDR : public SoapySDR::Device {
+public:
+	explicit SoapyCX88SDR(const SoapySDR::Kwargs &args)
+		: dev_(args.at("path"))
+	{
+		if (args.count("format"))
+			writeSetting("format", args.at("format"));
+	}
+
+	/* Identification */
+	std::string getDriverKey(void) const override { return "cx88sdr"; }
+	std::string getHardwareKey(void) const override { return "CX2388x"; }
+
+	SoapySDR::Kwargs getHardwareInfo(void) const override
+	{
+		return { { "path", dev_.path() }, { "bus_info", dev_.bus_info() } };
+	}
+
+	size_t getNumChannels(const int direction) const override
+	{
+		return (direction == SOAPY_SDR_RX) ? 1 : 0;
+	}
+
+	/* Stream */
+	std::vector<std::string> getStreamFormats(const int, const size_t) const override
+	{
+		return { SOAPY_SDR_CS8, SOAPY_SDR_CS16, SOAPY_SDR_CF32 };
+	}
+
+	std::string getNativeStreamFormat(const int, const size_t, double &fullScale) const override
+	{
+		if (dev_.get_format() == cx88sdr::format::ru16le) {
+			fullScale = 32768;
+			return SOAPY_SDR_CS16;
+		}
+		fullScale = 128;
+		return SOAPY_SDR_CS8;
+	}
+
+	SoapySDR::ArgInfoList getStreamArgsInfo(const int, const size_t) const override
+	{
+		SoapySDR::ArgInfo block;
+
+		block.key = "block_kb";
+		block.value = "256";
+		block.name = "Block size";
+		block.description = "Capture block size in KB, sets the latency";
+		block.units = "KB";
+		block.type = SoapySDR::ArgInfo::INT;
+		return { block };
+	}
+
+	SoapySDR::Stream *setupStream(const int direction, const std::string &format,
+				      const std::vector<size_t> &channels,
+				      const SoapySDR::Kwargs &args) override
+	{
+		size_t block_kb = 256;
+
+		if (direction != SOAPY_SDR_RX)
+			throw std::runtime_error("cx88sdr: RX only");
+		if (channels.size() > 1 || (channels.size() == 1 && channels[0] != 0))
+			throw std::runtime_error("cx88sdr: single channel only");
+		if (format != SOAPY_SDR_CS8 && format != SOAPY_SDR_CS16 && format != SOAPY_SDR_CF32)
+			throw std::runtime_error("cx88sdr: unsupported stream format " + format);
+		if (args.count("block_kb"))
+			block_kb = std::max(4, std::stoi(args.at("block_kb")));
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		stream_format_ = format;
+		block_size_ = block_kb << 10;
+		return reinterpret_cast<SoapySDR::Stream *>(this);
+	}
+
+	void closeStream(SoapySDR::Stream *) override
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		reader_.reset();
+	}
+
+	size_t getStreamMTU(SoapySDR::Stream *) const override
+	{
+		return block_size_ / sample_size_;
+	}
+
+	int activateStream(SoapySDR::Stream *, const int flags, const long long, const size_t) override
+	{
+		if (flags)
+			return SOAPY_SDR_NOT_SUPPORTED;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		sample_size_ = dev_.sample_size();
+		rate_ = dev_.sample_rate();
+		reader_ = std::make_unique<cx88sdr::reader>(dev_, block_size_);
+		left_ = 0;
+		overflow_ = false;
+		if (reader_->active_mode() != cx88sdr::reader::mode::mmap)
+			SoapySDR::log(SOAPY_SDR_WARNING, "cx88sdr: mmap unavailable, using read()");
+		return 0;
+	}
+
+	int deactivateStream(SoapySDR::Stream *, const int, const long long) override
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		reader_.reset();
+		return 0;
+	}
+
+	int readStream(SoapySDR::Stream *, void *const *buffs, const size_t numElems,
+		       int &flags, long long &timeNs, const long timeoutUs) override
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		size_t n;
+
+		if (!reader_)
+			return SOAPY_SDR_STREAM_ERROR;
+
+		if (!left_) {
+			/* The previous block may have been lapped while it was converted */
+			if (blk_.size && !reader_->valid(blk_))
+				overflow_ = true;
+			if (!reader_->next(blk_, std::max(1L, timeoutUs / 1000)))
+				return SOAPY_SDR_TIMEOUT;
+			if (blk_.lost)
+				overflow_ = true;
+			left_ = blk_.size / sample_size_;
+		}
+
+		if (overflow_) {
+			overflow_ = false;
+			return SOAPY_SDR_OVERFLOW;
+		}
+
+		n = std::min(numElems, left_);
+		const uint8_t *in = blk_.data + blk_.size - left_ * sample_size_;
+		uint64_t sample = (blk_.pos + blk_.size) / sample_size_ - left_;
+
+		convert(in, buffs[0], n);
+		left_ -= n;
+
+		flags = SOAPY_SDR_HAS_TIME;
+		timeNs = SoapySDR::ticksToTimeNs(static_cast<long long>(sample), rate_);
+		return static_cast<int>(n);
+	}
+
+	/* Antenna: the four video inputs */
+	std::vector<std::string> listAntennas(const int, const size_t) const override
+	{
+		return { "Input 1", "Input 2", "Input 3", "Input 4" };
+	}
+
+	void setAntenna(const int, const size_t, const std::string &name) override
+	{
+		auto ant = listAntennas(SOAPY_SDR_RX, 0);
+		auto it = std::find(ant.begin(), ant.end(), name);
+
+		if (it == ant.end())
+			throw std::runtime_error("cx88sdr: unknown antenna " + name);
+		dev_.set_input(static_cast<int>(it - ant.begin()));
+	}
+
+	std::string getAntenna(const int, const size_t) const override
+	{
+		return listAntennas(SOAPY_SDR_RX, 0).at(dev_.control(V4L2_CID_CX88SDR_INPUT));
+	}
+
+	/* Gain: GAIN (0..31), GAIN2 (AGC_ADJ3, 0..16), 6DB (Gain +6dB) */
+	std::vector<std::string> listGains(const int, const size_t) const override
+	{
+		return { "GAIN", "GAIN2", "6DB" };
+	}
+
+	void setGain(const int, const size_t, const std::string &name, const double value) override
+	{
+		int val = static_cast<int>(value + 0.5);
+
+		if (name == "GAIN")
+			dev_.set_gain(std::min(std::max(val, 0), 31));
+		else if (name == "GAIN2")
+			dev_.set_gain2(std::min(std::max(val, 0), 16));
+		else if (name == "6DB")
+			dev_.set_gain_6db(value >= 3.0);
+		else
+			throw std::runtime_error("cx88sdr: unknown gain " + name);
+	}
+
+	double getGain(const int, const size_t, const std::string &name) const override
+	{
+		if (name == "GAIN")
+			return dev_.control(V4L2_CID_GAIN);
+		if (name == "GAIN2")
+			return dev_.control(V4L2_CID_CX88SDR_AGC_ADJ3);
+		if (name == "6DB")
+			return dev_.control(V4L2_CID_CX88SDR_GAIN_6DB) ? 6.0 : 0.0;
+		throw std::runtime_error("cx88sdr: unknown gain " + name);
+	}
+
+	SoapySDR::Range getGainRange(const int, const size_t, const std::string &name) const override
+	{
+		if (name == "GAIN")
+			return SoapySDR::Range(0, 31, 1);
+		if (name == "GAIN2")
+			return SoapySDR::Range(0, 16, 1);
+		if (name == "6DB")
+			return SoapySDR::Range(0, 6, 6);
+		throw std::runtime_error("cx88sdr: unknown gain " + name);
+	}
+
+	/* Frequency: direct sampling, the baseband is the whole first Nyquist zone */
+	void setFrequency(const int, const size_t, const double, const SoapySDR::Kwargs &) override
+	{
+	}
+
+	double getFrequency(const int, const size_t) const override
+	{
+		return 0.0;
+	}
+
+	SoapySDR::RangeList getFrequencyRange(const int, const size_t) const override
+	{
+		return { SoapySDR::Range(0, 0) };
+	}
+
+	/* Sample rate */
+	void setSampleRate(const int, const size_t, const double rate) override
+	{
+		dev_.set_sample_rate(static_cast<uint32_t>(rate));
+		rate_ = dev_.sample_rate();
+	}
+
+	double getSampleRate(const int, const size_t) const override
+	{
+		return dev_.sample_rate();
+	}
+
+	SoapySDR::RangeList getSampleRateRange(const int, const size_t) const override
+	{
+		double div = (dev_.get_format() == cx88sdr::format::ru16le) ? 2 : 1;
+
+		return { SoapySDR::Range(12672000 / div, 36480000 / div, 1) };
+	}
+
+	std::vector<double> listSampleRates(const int, const size_t) const override
+	{
+		double div = (dev_.get_format() == cx88sdr::format::ru16le) ? 2 : 1;
+
+		return { 14318181 / div, 17897727 / div, 28636363 / div, 28800000 / div,
+			 35795454 / div };
+	}
+
+	/* Settings */
+	SoapySDR::ArgInfoList getSettingInfo(void) const override
+	{
+		SoapySDR::ArgInfo fmt, dc, irq;
+
+		fmt.key = "format";
+		fmt.value = "ru8";
+		fmt.name = "Sample format";
+		fmt.type = SoapySDR::ArgInfo::STRING;
+		fmt.options = { "ru8", "ru16le" };
+
+		dc.key = "dc_offset";
+		dc.value = "56";
+		dc.name = "DC Offset";
+		dc.description = "AGC sync tip adjust (AGC_TIP3)";
+		dc.type = SoapySDR::ArgInfo::INT;
+		dc.range = SoapySDR::Range(0, 64, 1);
+
+		irq.key = "irq_interval";
+		irq.value = "512";
+		irq.name = "IRQ Interval";
+		irq.description = "Ring pages per interrupt, lower is lower latency";
+		irq.type = SoapySDR::ArgInfo::INT;
+		irq.range = SoapySDR::Range(1, 512, 1);
+		return { fmt, dc, irq };
+	}
+
+	void writeSetting(const std::string &key, const std::string &value) override
+	{
+		if (key == "format")
+			dev_.set_format((value == "ru16le") ? cx88sdr::format::ru16le :
+							      cx88sdr::format::ru8);
+		else if (key == "dc_offset")
+			dev_.set_dc_offset(std::stoi(value));
+		else if (key == "irq_interval")
+			dev_.set_irq_interval(std::stoi(value));
+		else
+			throw std::runtime_error("cx88sdr: unknown setting " + key);
+	}
+
+	std::string readSetting(const std::string &key) const override
+	{
+		if (key == "format")
+			return (dev_.get_format() == cx88sdr::format::ru16le) ? "ru16le" : "ru8";
+		if (key == "dc_offset")
+			return std::to_string(dev_.control(V4L2_CID_CX88SDR_AGC_TIP3));
+		if (key == "irq_interval")
+			return std::to_string(dev_.control(V4L2_CID_CX88SDR_IRQ_PAGES));
+		throw std::runtime_error("cx88sdr: unknown setting " + key);
+	}
+
+private:
+	void convert(const uint8_t *in, void *out, size_t n)
+	{
+		namespace cv = cx88sdr::convert;
+		auto in16 = reinterpret_cast<const uint16_t *>(in);
+
+		if (stream_format_ == SOAPY_SDR_CF32) {
+			if (sample_size_ == 2)
+				cv::ru16_to_cf32(in16, static_cast<float *>(out), n);
+			else
+				cv::ru8_to_cf32(in, static_cast<float *>(out), n);
+		} else if (stream_format_ == SOAPY_SDR_CS16) {
+			if (sample_size_ == 2)
+				cv::ru16_to_cs16(in16, static_cast<int16_t *>(out), n);
+			else
+				cv::ru8_to_cs16(in, static_cast<int16_t *>(out), n);
+		} else {
+			if (sample_size_ == 2)
+				cv::ru16_to_cs8(in16, static_cast<int8_t *>(out), n);
+			else
+				cv::ru8_to_cs8(in, static_cast<int8_t *>(out), n);
+		}
+	}
+
+	cx88sdr::device				dev_;
+	std::mutex				mutex_;
+	std::unique_ptr<cx88sdr::reader>	reader_;
+	std::string				stream_format_ = SOAPY_SDR_CF32;
+	size_t					block_size_ = 256 << 10;
+	size_t					sample_size_ = 1;
+	double					rate_ = 28800000;
+	cx88sdr::block				blk_;
+	size_t					left_ = 0;
+	bool					overflow_ = false;
+};
+
+SoapySDR::KwargsList findCX88SDR(const SoapySDR::Kwargs &args)
+{
+	SoapySDR::KwargsList results;
+	std::vector<std::string> paths = cx88sdr::device::enumerate();
+
+	/* Replay cards last, their serial is their platform bus */
+	for (const auto &path : cx88sdr::device::enumerate_replay())
+		paths.push_back(path);
+	for (const auto &path : paths) {
+		SoapySDR::Kwargs dev;
+
+		if (args.count("path") && args.at("path") != path)
+			continue;
+		try {
+			cx88sdr::device d(path);
+
+			dev["driver"] = "cx88sdr";
+			dev["path"] = path;
+			dev["serial"] = d.bus_info();
+			dev["label"] = "CX2388x SDR " + path + " [" + d.bus_info() + "]";
+		} catch (const std::exception &e) {
+			SoapySDR::logf(SOAPY_SDR_DEBUG, "cx88sdr: %s", e.what());
+			continue;
+		}
+		if (args.count("serial") && args.at("serial") != dev["serial"])
+			continue;
+		results.push_back(dev);
+	}
+	return results;
+}
+
+SoapySDR::Device *makeCX88SDR(const SoapySDR::Kwargs &args)
+{
+	return new SoapyCX88SDR(args);
+}
+
+SoapySDR::Registry registerCX88SDR("cx88sdr", &findCX88SDR, &makeCX88SDR, SOAPY_SDR_ABI_VERSION);
+
+}
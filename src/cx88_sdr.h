@@ -20,25 +20,25 @@
 #ifndef CX88SDR_H
 #define CX88SDR_H
 
+#include <linux/hrtimer.h>
+#include <linux/kref.h>
+#include <linux/pci.h>
+#include <linux/percpu.h>
+#include <linux/scatterlist.h>
+#include <linux/vmalloc.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
 
+#include "cx88_sdr_uapi.h"
+
 #define CX88SDR_XTAL_FREQ		28636363 /* Xtal Frequency */
 #define CX88SDR_ADC_FREQ_MIN		12672000 /* Min ADC Frequency */
 #define CX88SDR_ADC_FREQ_DEF		28800000 /* Def ADC Frequency */
 #define CX88SDR_ADC_FREQ_MAX		36480000 /* Max ADC Frequency */
 
-/* Default values for raw video mode */
+/* Start in raw video mode (NTSC), it can also be selected with the Mode control */
 //#define CX88SDR_RAW_VIDEO_MODE
 
-/* Real formats */
-#ifndef V4L2_SDR_FMT_RU8
-#define V4L2_SDR_FMT_RU8		V4L2_SDR_FMT_CU8
-#endif
-#ifndef V4L2_SDR_FMT_RU16LE
-#define V4L2_SDR_FMT_RU16LE		V4L2_SDR_FMT_CU16LE
-#endif
-
 #define CX88SDR_DRV_NAME		"CX2388x SDR"
 #define CX88SDR_MAX_CARDS		32
 
@@ -46,15 +46,31 @@
 #define CX88SDR_PCI_INT_MSK		0x200040 /* PCI Interrupt Mask */
 #define CX88SDR_PCI_INT_MSK_CLEAR	0x000000 /* PCI Interrupt Mask Clear */
 #define CX88SDR_PCI_INT_MSK_VAL		0x000001 /* PCI Interrupt Mask Value */
+#define CX88SDR_PCI_INT_MSK_AUD		0x000002 /* PCI Interrupt Mask Audio */
 #define CX88SDR_VID_INT_MSK		0x200050 /* Video Interrupt Mask */
 #define CX88SDR_VID_INT_MSK_CLEAR	0x000000 /* Video Interrupt Mask Clear */
-#define CX88SDR_VID_INT_MSK_VAL		0x018888 /* Video Interrupt Mask Value */
+#define CX88SDR_VID_INT_MSK_VAL		0x0f8888 /* Video Interrupt Mask Value */
 #define CX88SDR_VID_INT_STAT		0x200054 /* Video Interrupt Status */
 #define CX88SDR_VID_INT_STAT_CLEAR	0x0fffff /* Video Interrupt Status Clear */
+#define CX88SDR_VID_INT_VBI_RISCI1	(1 << 3)  /* VBI RISC IRQ1 */
+#define CX88SDR_VID_INT_VBI_OFLOW	(1 << 11) /* VBI FIFO Overflow */
+#define CX88SDR_VID_INT_VBI_SYNC	(1 << 15) /* VBI Sync Error */
+#define CX88SDR_VID_INT_OPC_ERR		(1 << 16) /* RISC Opcode Error */
+#define CX88SDR_VID_INT_PAR_ERR		(1 << 17) /* PCI Parity Error */
+#define CX88SDR_VID_INT_RIP_ERR		(1 << 18) /* RISC Instruction Pointer Error */
+#define CX88SDR_VID_INT_PCI_ABORT	(1 << 19) /* PCI Master/Target Abort */
+#define CX88SDR_VID_INT_FAULTS		(CX88SDR_VID_INT_VBI_OFLOW | CX88SDR_VID_INT_VBI_SYNC | \
+					 CX88SDR_VID_INT_OPC_ERR | CX88SDR_VID_INT_PAR_ERR | \
+					 CX88SDR_VID_INT_RIP_ERR | CX88SDR_VID_INT_PCI_ABORT)
+#define CX88SDR_IRQ_AUDIO		(1U << 31) /* Audio node, IRQ thread only */
+#define CX88SDR_IRQ_AUDIO_PAGE		(1U << 30) /* Audio page done, take a cross-reference */
 
 #define CX88SDR_DMA24_PTR2		0x3000cc /* IPB DMAC Current Table Pointer */
 #define CX88SDR_DMA24_CNT1		0x30010c /* IPB DMAC Buffer Limit */
 #define CX88SDR_DMA24_CNT2		0x30014c /* IPB DMAC Table Size */
+#define CX88SDR_DMA25_PTR2		0x3000d0 /* IPB DMAC Current Table Pointer */
+#define CX88SDR_DMA25_CNT1		0x300110 /* IPB DMAC Buffer Limit */
+#define CX88SDR_DMA25_CNT2		0x300150 /* IPB DMAC Table Size */
 #define CX88SDR_VBI_GP_CNT		0x31c02c /* VBI General Purpose Counter */
 #define CX88SDR_VID_DMA_CNTRL		0x31c040 /* IPB DMA Control */
 #define CX88SDR_INPUT_FORMAT		0x310104 /* Input Format Register */
@@ -69,17 +85,33 @@
 #define CX88SDR_AGC_TIP3		0x310210 /* AGC Sync Tip Adjust 3 */
 #define CX88SDR_AGC_ADJ3		0x31021c /* AGC Gain Adjust 3 */
 #define CX88SDR_AGC_ADJ4		0x310220 /* AGC Gain Adjust 4 */
+#define CX88SDR_AUD_DMA_CNTRL		0x32005c /* Audio DMA Control */
+#define CX88SDR_AUD_INT_MSK		0x320060 /* Audio Interrupt Mask */
+#define CX88SDR_AUD_INT_MSK_CLEAR	0x000000 /* Audio Interrupt Mask Clear */
+#define CX88SDR_AUD_INT_MSK_VAL		0x011001 /* Audio Interrupt Mask Value */
+#define CX88SDR_AUD_INT_STAT		0x320064 /* Audio Interrupt Status */
+#define CX88SDR_AUD_INT_STAT_CLEAR	0x0fffff /* Audio Interrupt Status Clear */
+#define CX88SDR_AUD_INT_DN_RISCI1	(1 << 0)  /* Audio Downstream RISC IRQ1 */
+#define CX88SDR_AUD_INT_DN_SYNC		(1 << 12) /* Audio Downstream Sync Error */
+#define CX88SDR_AUD_INT_OPC_ERR		(1 << 16) /* Audio RISC Opcode Error */
+#define CX88SDR_AUDD_GP_CNT		0x32c020 /* Audio Downstream General Purpose Counter */
+#define CX88SDR_AUDD_GP_CNTRL		0x32c030 /* Audio Downstream GP Counter Control */
+#define CX88SDR_AUDD_LNGTH		0x32c170 /* Audio Downstream Line Length */
 #define CX88SDR_AFE_CFG_IO		0x35c04c /* ADC Mode Select */
+#define CX88SDR_AFE_AUD_PDOWN		((1 << 4) | (1 << 1)) /* Audio bandgap DAC+ADC off */
 
 #define CX88SDR_SRAM_ADDR		0x180000 /* 32 KByte SRAM */
 #define CX88SDR_DMA24_CMDS_ADDR		(CX88SDR_SRAM_ADDR + 0x0100) /* DMA #24 CMDS */
 #define CX88SDR_RISC_INST_QUEUE_ADDR	(CX88SDR_SRAM_ADDR + 0x0800) /* RISC Instruction Queue */
 #define CX88SDR_CDT_ADDR		(CX88SDR_SRAM_ADDR + 0x1000) /* Cluster Descriptor Table */
 #define CX88SDR_CLUSTER_BUF_ADDR	(CX88SDR_SRAM_ADDR + 0x4000) /* Cluster Buffers */
+#define CX88SDR_DMA25_CMDS_ADDR		(CX88SDR_SRAM_ADDR + 0x0140) /* DMA #25 CMDS */
+#define CX88SDR_AUD_INST_QUEUE_ADDR	(CX88SDR_SRAM_ADDR + 0x0900) /* Audio RISC Instruction Queue */
+#define CX88SDR_AUD_CDT_ADDR		(CX88SDR_SRAM_ADDR + 0x1100) /* Audio Cluster Descriptor Table */
+#define CX88SDR_AUD_CLUSTER_BUF_ADDR	(CX88SDR_SRAM_ADDR + 0x3000) /* Audio Cluster Buffers */
 
 #define CX88SDR_RISC_CNT_INCR		(1 << 16) /* Increment Counter */
 #define CX88SDR_RISC_CNT_RESET		(3 << 16) /* Reset Counter */
-#define CX88SDR_RISC_IRQ1_CNT_MASK	(512 - 1) /* PAGES per Interrupt - 1 */
 #define CX88SDR_RISC_IRQ1_NOOP		(0U << 24) /* No Change */
 #define CX88SDR_RISC_IRQ1_TRIG		(1U << 24) /* Trigger Interrupt */
 #define CX88SDR_RISC_EOL		(1U << 26) /* EOL */
@@ -93,12 +125,38 @@
 #define CX88SDR_VBI_PACKET_SIZE		SZ_2K
 #define CX88SDR_VBI_DMA_SIZE		SZ_64M
 #define CX88SDR_VBI_DMA_PAGES		(CX88SDR_VBI_DMA_SIZE >> PAGE_SHIFT)
+#define CX88SDR_RING_ORDER_MAX		(21 - PAGE_SHIFT) /* 2MB ring chunks */
+
+/* Audio: 1K RISC writes into a 4K FIFO, an interrupt per page (about 21ms) */
+#define CX88SDR_AUD_CDT_SIZE		4
+#define CX88SDR_AUD_PACKET_SIZE		SZ_1K
+#define CX88SDR_AUD_DMA_SIZE		SZ_4M
+#define CX88SDR_AUD_DMA_PAGES		(CX88SDR_AUD_DMA_SIZE >> PAGE_SHIFT)
+#define CX88SDR_AUD_RATE		48000
+#define CX88SDR_GP_CNT_RESET		0x3 /* GP Counter Control Reset */
+
+#define CX88SDR_IRQ_PAGES_MIN		1   /* Min PAGES per Interrupt */
+#define CX88SDR_IRQ_PAGES_DEF		512 /* Def PAGES per Interrupt */
+#define CX88SDR_IRQ_PAGES_MAX		512 /* Max PAGES per Interrupt */
+
+#define CX88SDR_PCI_LAT_MIN		32  /* Min PCI Latency Timer */
+#define CX88SDR_PCI_LAT_MAX		248 /* Max PCI Latency Timer */
+
+#define CX88SDR_POS_POLL_MIN		100    /* Min position poll period, us */
+#define CX88SDR_POS_POLL_MAX		100000 /* Max position poll period, us */
+
+#define CX88SDR_HOLDOFF_MAX		1000000 /* Max configuration hold-off, us */
 
 /* 2 RISC WRITE Instructions per PAGE + one PAGE for SYNC and JUMP */
 #define CX88SDR_RISC_BUF_SIZE		(PAGE_ALIGN((CX88SDR_VBI_DMA_PAGES * 16) + \
 					 PAGE_SIZE))
 #define CX88SDR_RISC_WRITE_VBI_PACKET	(CX88SDR_RISC_WRITE | CX88SDR_VBI_PACKET_SIZE | \
 					 CX88SDR_RISC_SOL | CX88SDR_RISC_EOL)
+/* Same for audio, one RISC WRITE Instruction per packet */
+#define CX88SDR_AUD_RISC_BUF_SIZE	(PAGE_ALIGN((CX88SDR_AUD_DMA_PAGES * 8 * \
+					 (PAGE_SIZE / CX88SDR_AUD_PACKET_SIZE)) + PAGE_SIZE))
+#define CX88SDR_RISC_WRITE_AUD_PACKET	(CX88SDR_RISC_WRITE | CX88SDR_AUD_PACKET_SIZE | \
+					 CX88SDR_RISC_SOL | CX88SDR_RISC_EOL)
 
 enum {
 	CX88SDR_INPUT_00, /* Pin 145 */
@@ -119,11 +177,13 @@ enum {
 #define CX88SDR_AGC_TIP3_DEFVAL		0x38
 #define CX88SDR_ADC_FREQ_DEFVAL		CX88SDR_ADC_FREQ_DEF
 #define CX88SDR_HTOTAL_DEFVAL		(CX88SDR_ADC_FREQ_DEFVAL / 60 / 525) /* NTSC */
+#define CX88SDR_MODE_DEFVAL		CX88SDR_MODE_SDR
 #else					/* Raw video mode default values */
 #define CX88SDR_GAIN_6DB_DEFVAL		0x00
 #define CX88SDR_AGC_TIP3_DEFVAL		0x00
 #define CX88SDR_HTOTAL_DEFVAL		910
 #define CX88SDR_ADC_FREQ_DEFVAL		(CX88SDR_HTOTAL_DEFVAL * 525 * 60) /* NTSC */
+#define CX88SDR_MODE_DEFVAL		CX88SDR_MODE_NTSC
 #endif
 
 struct cx88sdr_ctrl {
@@ -135,14 +195,55 @@ struct cx88sdr_ctrl {
 	u32				agc_tip3;
 	u32				input;
 	u32				htotal;
+	u32				irq_pages;
+	u32				pos_poll;
+	u32				holdoff;
+	u32				mode;
 	bool				gain_6db;
 	bool				afc_pll;
 	bool				input_vsync;
 };
 
+struct cx88sdr_stats {
+	u64				irqs;
+	u64				irqs_risci1;
+	u64				irq_rate;
+	u64				irq_rate_cnt;
+	u64				irq_rate_ts;
+	atomic64_t			mmio_reads;
+	/* Syscalls answered from dma_head without reading the card, per CPU */
+	u64 __percpu			*mmio_reads_saved;
+	atomic64_t			timer_polls;
+	/* Faults decoded from the video interrupt status, IRQ thread only */
+	u64				fifo_overflows;
+	u64				sync_errors;
+	u64				risc_errors;
+	u64				pci_errors;
+	u64				fault_pos;
+};
+
+/* Last self-test of a card, see cx88_sdr_selftest.c */
+struct cx88sdr_selftest {
+	u32				window_ms;
+	u32				latency;
+	/* Latency timer the last tuning picked, 0 if never tuned */
+	u32				tuned;
+	/* Configured and measured DMA rate in B/s, faults within the window */
+	u64				expected;
+	u64				rate;
+	u64				overflows;
+	u64				errors;
+};
+
+struct cx88sdr_audio;
+struct cx88sdr_replay;
+
 struct cx88sdr_dev {
 	int				nr;
 	char				name[32];
+	struct	list_head		list;
+	/* Held by remove and by group file handles, the last put frees the card */
+	struct	kref			ref;
 
 	/* IO */
 	struct	pci_dev			*pdev;
@@ -151,34 +252,192 @@ struct cx88sdr_dev {
 	uint32_t	__iomem		*ctrl;
 	uint32_t			*risc_buf;
 	void				**dma_buf_pages;
+	/* Ring pages mapped through the IOMMU, sgl is NULL for coherent and replay pages */
+	struct	sg_table		ring_sgt;
+	/* Ring mapped twice back to back, NULL if vmap() failed */
+	u8				*ring;
 	unsigned int			irq;
+	atomic_t			irq_status;
 	int				pci_lat;
+	u64				byte_rate;
+	/* Time probe took, and the DMA ring allocation within it */
+	u64				probe_ns;
+	u64				ring_ns;
+
+	/* DMA position */
+	spinlock_t			dma_lock;
+	wait_queue_head_t		dma_wq;
+	u32				dma_cnt;
+	u64				dma_pages;
+	atomic64_t			dma_head;
+	/* CLOCK_REALTIME and CLOCK_MONOTONIC of the last head advance, under dma_lock */
+	u64				head_ns;
+	u64				head_mono_ns;
+	/* First byte DMA wrote since it last restarted, the ring before it is stale */
+	u64				valid_start;
+	/* Hold-off window in bytes, and mid-scale pages: RU8 then RU16LE */
+	u64				mask_start;
+	u64				mask_end;
+	u8				*mask_fill;
+	struct	hrtimer			pos_timer;
+	/* Set first thing in remove: nothing may arm the timer or wait on dma_wq after it */
+	bool				removing;
+	struct	cx88sdr_stats		stats;
+	struct	cx88sdr_selftest	selftest;
+	/* Audio node, NULL unless enabled with the audio parameter */
+	struct	cx88sdr_audio		*audio;
+	/* Replay card: no PCI device, the ring is filled by write() */
+	struct	cx88sdr_replay		*replay;
 
 	/* V4L2 */
 	struct	v4l2_device		v4l2_dev;
 	struct	v4l2_ctrl_handler	ctrl_handler;
+	/* Controls a Mode preset sets */
+	struct	v4l2_ctrl		*ctrl_gain_6db;
+	struct	v4l2_ctrl		*ctrl_agc_tip3;
+	struct	v4l2_ctrl		*ctrl_htotal;
 	struct	video_device		vdev;
 	struct	mutex			vdev_mlock;
-	struct	mutex			vopen_mlock;
 	struct	cx88sdr_ctrl		vctrl;
-	u32				vopen;
 };
 
-/* Helpers */
+/* Helpers, replay cards have no registers: writes are dropped, reads return 0 */
 static inline uint32_t ctrl_ioread32(struct cx88sdr_dev *dev, uint32_t reg)
 {
+	if (!dev->ctrl)
+		return 0;
 	return ioread32(dev->ctrl + ((reg) >> 2));
 }
 
 static inline void ctrl_iowrite32(struct cx88sdr_dev *dev, uint32_t reg, uint32_t val)
 {
-	iowrite32((val), dev->ctrl + ((reg) >> 2));
+	if (dev->ctrl)
+		iowrite32((val), dev->ctrl + ((reg) >> 2));
+}
+
+/* First ring page that may still be in flight, as of the last IRQ or timer poll */
+static inline u64 cx88sdr_dma_head(struct cx88sdr_dev *dev)
+{
+	return atomic64_read(&dev->dma_head);
+}
+
+/* Counted once per read(), poll() or position ioctl, not per cx88sdr_dma_head() */
+static inline void cx88sdr_dma_head_saved(struct cx88sdr_dev *dev)
+{
+	this_cpu_inc(*dev->stats.mmio_reads_saved);
+}
+
+/* Hold-off window in pages, read after the head it applies to */
+static inline void cx88sdr_mask_get(struct cx88sdr_dev *dev, u64 *start, u64 *end)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->dma_lock, flags);
+	*start = dev->mask_start >> PAGE_SHIFT;
+	*end = dev->mask_end >> PAGE_SHIFT;
+	spin_unlock_irqrestore(&dev->dma_lock, flags);
+}
+
+/* What read() returns for absolute page: settling samples of a change read as mid-scale */
+static inline void *cx88sdr_page_src(struct cx88sdr_dev *dev, u64 page, u64 mask_start,
+				     u64 mask_end)
+{
+	if (page >= mask_start && page < mask_end)
+		return dev->mask_fill +
+		       ((dev->vctrl.pixelformat == V4L2_SDR_FMT_RU16LE) ? PAGE_SIZE : 0);
+	return dev->dma_buf_pages[page & (CX88SDR_VBI_DMA_PAGES - 1)];
+}
+
+/*
+ * Like cx88sdr_page_src(), for a run of pages starting at page and ending
+ * before end: *pages is how many of them are contiguous at the address
+ * returned, up to a ring size thanks to the double mapping.
+ */
+static inline void *cx88sdr_span_src(struct cx88sdr_dev *dev, u64 page, u64 end,
+				     u64 mask_start, u64 mask_end, u64 *pages)
+{
+	if (!dev->ring || (page >= mask_start && page < mask_end)) {
+		*pages = 1;
+		return cx88sdr_page_src(dev, page, mask_start, mask_end);
+	}
+	if (page < mask_start && end > mask_start)
+		end = mask_start;
+	*pages = min_t(u64, end - page, CX88SDR_VBI_DMA_PAGES);
+	return dev->ring + ((page & (CX88SDR_VBI_DMA_PAGES - 1)) << PAGE_SHIFT);
+}
+
+static inline struct page *cx88sdr_ring_page(struct cx88sdr_dev *dev, u32 page)
+{
+	void *addr = dev->dma_buf_pages[page];
+
+	return (is_vmalloc_addr(addr)) ? vmalloc_to_page(addr) : virt_to_page(addr);
+}
+
+static inline const char *cx88sdr_dev_name(struct cx88sdr_dev *dev)
+{
+	return (dev->pdev) ? pci_name(dev->pdev) : dev->name;
 }
 
 #define cx88sdr_pr_info(fmt, ...)	pr_info(KBUILD_MODNAME " %s: " fmt,		\
-						pci_name(dev->pdev), ##__VA_ARGS__)
+						cx88sdr_dev_name(dev), ##__VA_ARGS__)
+#define cx88sdr_pr_warn(fmt, ...)	pr_warn(KBUILD_MODNAME " %s: " fmt,		\
+						cx88sdr_dev_name(dev), ##__VA_ARGS__)
+#define cx88sdr_pr_warn_ratelimited(fmt, ...)						\
+					pr_warn_ratelimited(KBUILD_MODNAME " %s: " fmt,	\
+						cx88sdr_dev_name(dev), ##__VA_ARGS__)
 #define cx88sdr_pr_err(fmt, ...)	pr_err(KBUILD_MODNAME " %s: " fmt,		\
-						pci_name(dev->pdev), ##__VA_ARGS__)
+						cx88sdr_dev_name(dev), ##__VA_ARGS__)
+
+/* cx88_sdr_audio.c */
+void cx88sdr_audio_init(struct cx88sdr_dev *dev);
+void cx88sdr_audio_setup(struct cx88sdr_dev *dev);
+void cx88sdr_audio_register(struct cx88sdr_dev *dev);
+void cx88sdr_audio_exit(struct cx88sdr_dev *dev);
+u32 cx88sdr_audio_irq(struct cx88sdr_dev *dev);
+void cx88sdr_audio_xref(struct cx88sdr_dev *dev);
+void cx88sdr_audio_wake(struct cx88sdr_dev *dev);
+
+/* cx88_sdr_core.c */
+int cx88sdr_dev_init(struct cx88sdr_dev *dev);
+void cx88sdr_dev_get(struct cx88sdr_dev *dev);
+void cx88sdr_dev_put(struct cx88sdr_dev *dev);
+int cx88sdr_ctrl_init(struct cx88sdr_dev *dev);
+int cx88sdr_alloc_dma_buffer(struct cx88sdr_dev *dev);
+void cx88sdr_free_dma_buffer(struct cx88sdr_dev *dev);
+void cx88sdr_risc_irq_set(struct cx88sdr_dev *dev);
+u64 cx88sdr_dma_update(struct cx88sdr_dev *dev);
+u64 cx88sdr_dma_mask(struct cx88sdr_dev *dev, u64 len);
+void cx88sdr_dma_set_head(struct cx88sdr_dev *dev, u64 head);
+u64 cx88sdr_dma_head_time(struct cx88sdr_dev *dev, u64 *head_ns);
+u64 cx88sdr_dma_head_mono(struct cx88sdr_dev *dev, u64 *head_ns);
+void cx88sdr_pos_timer_set(struct cx88sdr_dev *dev);
+u64 cx88sdr_bus_budget(void);
+u64 cx88sdr_bus_load(struct cx88sdr_dev *dev, u32 *cards);
+int cx88sdr_bus_admit(struct cx88sdr_dev *dev, u64 byte_rate, bool user);
+u32 cx88sdr_bus_peers_get(struct cx88sdr_dev *dev, struct cx88sdr_dev **cards);
+void cx88sdr_bus_peers_put(struct cx88sdr_dev **cards, u32 n);
+void cx88sdr_pci_lat_set(struct cx88sdr_dev *dev, int val);
+
+/* cx88_sdr_group.c */
+void cx88sdr_group_add(struct cx88sdr_dev *dev);
+void cx88sdr_group_del(struct cx88sdr_dev *dev);
+
+/* cx88_sdr_replay.c */
+extern const struct v4l2_ctrl_config cx88sdr_ctrl_replay_speed;
+int cx88sdr_replay_init(void);
+void cx88sdr_replay_exit(void);
+ssize_t cx88sdr_replay_write(struct cx88sdr_dev *dev, const char __user *buf, size_t size,
+			     bool nonblock);
+void cx88sdr_replay_speed_set(struct cx88sdr_dev *dev, u32 speed);
+
+/* cx88_sdr_selftest.c */
+int cx88sdr_selftest_run(struct cx88sdr_dev *dev, u32 ms);
+int cx88sdr_selftest_tune(struct cx88sdr_dev *dev, u32 ms);
+int cx88sdr_selftest_lat_set(struct cx88sdr_dev *dev, u32 val);
+
+/* cx88_sdr_sysfs.c */
+int cx88sdr_sysfs_init(struct cx88sdr_dev *dev);
+void cx88sdr_sysfs_exit(struct cx88sdr_dev *dev);
 
 /* cx88_sdr_v4l2.c */
 extern const struct v4l2_ctrl_ops cx88sdr_ctrl_ops;
@@ -189,10 +448,27 @@ extern const struct v4l2_ctrl_config cx88sdr_ctrl_input;
 extern const struct v4l2_ctrl_config cx88sdr_ctrl_afc_pll;
 extern const struct v4l2_ctrl_config cx88sdr_ctrl_input_vsync;
 extern const struct v4l2_ctrl_config cx88sdr_ctrl_htotal;
+extern const struct v4l2_ctrl_config cx88sdr_ctrl_irq_pages;
+extern const struct v4l2_ctrl_config cx88sdr_ctrl_pos_poll;
+extern const struct v4l2_ctrl_config cx88sdr_ctrl_holdoff;
+extern const struct v4l2_ctrl_config cx88sdr_ctrl_mode;
 extern const struct video_device cx88sdr_template;
 
-int cx88sdr_adc_fmt_set(struct cx88sdr_dev *dev);
+int cx88sdr_enum_fmt_sdr(struct file *file, void *priv, struct v4l2_fmtdesc *f);
+int cx88sdr_try_fmt_sdr(struct file *file, void *priv, struct v4l2_format *f);
+int cx88sdr_g_fmt_sdr(struct file *file, void *priv, struct v4l2_format *f);
+int cx88sdr_g_tuner(struct file *file, void *priv, struct v4l2_tuner *t);
+int cx88sdr_s_tuner(struct file *file, void *priv, const struct v4l2_tuner *t);
+int cx88sdr_enum_freq_bands(struct file *file, void *priv, struct v4l2_frequency_band *band);
+int cx88sdr_g_frequency(struct file *file, void *priv, struct v4l2_frequency *f);
+int cx88sdr_fmt_set(struct cx88sdr_dev *dev, u32 pixelformat);
+int cx88sdr_freq_set(struct cx88sdr_dev *dev, u32 freq);
+int cx88sdr_adc_fmt_set(struct cx88sdr_dev *dev, bool user);
+#ifdef CONFIG_COMPAT
+long cx88sdr_compat_ioctl32(struct file *file, unsigned int cmd, unsigned long arg);
+#endif
 void cx88sdr_gain_set(struct cx88sdr_dev *dev);
 void cx88sdr_input_set(struct cx88sdr_dev *dev);
+void cx88sdr_config_mark(struct cx88sdr_dev *dev, u32 id, s32 value);
 
 #endif
@@ -0,0 +1,641 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * CX2388x SDR audio node: the audio ADC of a card, through the audio
+ * decoder's downstream DMA channel (#25), read from one more swradio node
+ * next to the main one. It runs its own RISC program and ring, from the
+ * same crystal as the main stream, and every audio page interrupt samples
+ * both DMA positions so the two streams can be lined up. The audio ADC is
+ * powered and its DMA runs only while the node is open.
+ */
+
+#include <linux/module.h>
+#include <linux/pci.h>
+#include <linux/rwsem.h>
+#include <linux/videodev2.h>
+#include <media/v4l2-dev.h>
+#include <media/v4l2-event.h>
+#include <media/v4l2-ioctl.h>
+
+#include "cx88_sdr.h"
+
+#define CX88SDR_AUDIO_NAME		"CX2388x SDR Audio"
+
+static bool audio[CX88SDR_MAX_CARDS];
+module_param_array(audio, bool, NULL, 0);
+MODULE_PARM_DESC(audio, "Add an audio ADC capture node per card, e.g. audio=1,1");
+
+struct cx88sdr_audio {
+	struct	cx88sdr_dev		*dev;
+	struct	video_device		vdev;
+	struct	mutex			vdev_mlock;
+	/* Open handles, under vdev_mlock: the first starts DMA, the last stops it */
+	unsigned int			users;
+	/* Held shared around ring copies, remove waits them out before freeing it */
+	struct	rw_semaphore		ring_rwsem;
+
+	/* IO */
+	dma_addr_t			risc_buf_addr;
+	dma_addr_t			*dma_pages_addr;
+	uint32_t			*risc_buf;
+	void				**dma_buf_pages;
+
+	/* DMA position, as the main stream's */
+	spinlock_t			lock;
+	wait_queue_head_t		wq;
+	u32				cnt;
+	u64				pages;
+	atomic64_t			head;
+	u64				errors;
+
+	/* Cross-references, the next one goes to xref[seq % CX88SDR_XREF_MAX] */
+	struct	cx88sdr_xref		xref[CX88SDR_XREF_MAX];
+	u64				seq;
+};
+
+struct cx88sdr_audio_fh {
+	struct v4l2_fh fh;
+	struct cx88sdr_audio *aud;
+	u64 spage;
+};
+
+static u64 cx88sdr_audio_head(struct cx88sdr_audio *aud)
+{
+	return atomic64_read(&aud->head);
+}
+
+/* Called with aud->lock held */
+static void cx88sdr_audio_fold(struct cx88sdr_audio *aud)
+{
+	struct cx88sdr_dev *dev = aud->dev;
+	u32 cnt;
+
+	cnt = ctrl_ioread32(dev, CX88SDR_AUDD_GP_CNT) & (CX88SDR_AUD_DMA_PAGES - 1);
+	aud->pages += (cnt - aud->cnt) & (CX88SDR_AUD_DMA_PAGES - 1);
+	aud->cnt = cnt;
+	atomic64_set(&aud->head, (aud->pages) ? (aud->pages - 1) : 0);
+}
+
+static void cx88sdr_audio_make_risc_instructions(struct cx88sdr_audio *aud)
+{
+	uint32_t *risc_buf = aud->risc_buf;
+	uint32_t risc_loop_addr = aud->risc_buf_addr + sizeof(uint32_t);
+	uint32_t page, off;
+
+	*risc_buf++ = CX88SDR_RISC_SYNC | CX88SDR_RISC_CNT_RESET;
+
+	for (page = 0; page < CX88SDR_AUD_DMA_PAGES; page++) {
+		uint32_t dma_addr = aud->dma_pages_addr[page];
+
+		for (off = 0; off < PAGE_SIZE - CX88SDR_AUD_PACKET_SIZE;
+		     off += CX88SDR_AUD_PACKET_SIZE) {
+			*risc_buf++ = CX88SDR_RISC_WRITE_AUD_PACKET;
+			*risc_buf++ = dma_addr + off;
+		}
+		/* Every page interrupts, each one is a cross-reference */
+		*risc_buf++ = CX88SDR_RISC_WRITE_AUD_PACKET | CX88SDR_RISC_IRQ1_TRIG |
+			      ((page < CX88SDR_AUD_DMA_PAGES - 1) ?
+			      CX88SDR_RISC_CNT_INCR : CX88SDR_RISC_CNT_RESET);
+		*risc_buf++ = dma_addr + off;
+	}
+	*risc_buf++ = CX88SDR_RISC_JUMP;
+	*risc_buf++ = risc_loop_addr;
+}
+
+/* The ring and the RISC program, the struct stays for handles still open */
+static void cx88sdr_audio_free_dma(struct cx88sdr_audio *aud)
+{
+	struct device *d = &aud->dev->pdev->dev;
+	u32 page;
+
+	for (page = 0; aud->dma_buf_pages && page < CX88SDR_AUD_DMA_PAGES; page++)
+		if (aud->dma_buf_pages[page])
+			dma_free_coherent(d, PAGE_SIZE, aud->dma_buf_pages[page],
+					  aud->dma_pages_addr[page]);
+	kfree(aud->dma_buf_pages);
+	kfree(aud->dma_pages_addr);
+	if (aud->risc_buf)
+		dma_free_coherent(d, CX88SDR_AUD_RISC_BUF_SIZE, aud->risc_buf,
+				  aud->risc_buf_addr);
+	aud->dma_buf_pages = NULL;
+	aud->dma_pages_addr = NULL;
+	aud->risc_buf = NULL;
+}
+
+/* Allocates the audio ring and its RISC program, before the SRAM is set up */
+void cx88sdr_audio_init(struct cx88sdr_dev *dev)
+{
+	struct cx88sdr_audio *aud;
+	struct device *d = &dev->pdev->dev;
+	int node = dev_to_node(d);
+	u32 page;
+
+	if (!audio[dev->nr])
+		return;
+
+	aud = kzalloc_node(sizeof(*aud), GFP_KERNEL, node);
+	if (!aud)
+		goto err;
+	aud->dev = dev;
+	mutex_init(&aud->vdev_mlock);
+	init_rwsem(&aud->ring_rwsem);
+	spin_lock_init(&aud->lock);
+	init_waitqueue_head(&aud->wq);
+
+	aud->risc_buf = dma_alloc_coherent(d, CX88SDR_AUD_RISC_BUF_SIZE,
+					   &aud->risc_buf_addr, GFP_KERNEL | __GFP_ZERO);
+	aud->dma_pages_addr = kcalloc_node(CX88SDR_AUD_DMA_PAGES, sizeof(dma_addr_t),
+					   GFP_KERNEL, node);
+	aud->dma_buf_pages = kcalloc_node(CX88SDR_AUD_DMA_PAGES, sizeof(void *),
+					  GFP_KERNEL, node);
+	if (!aud->risc_buf || !aud->dma_pages_addr || !aud->dma_buf_pages)
+		goto free_aud;
+
+	for (page = 0; page < CX88SDR_AUD_DMA_PAGES; page++) {
+		aud->dma_buf_pages[page] = dma_alloc_coherent(d, PAGE_SIZE,
+							      &aud->dma_pages_addr[page],
+							      GFP_KERNEL | __GFP_ZERO);
+		if (!aud->dma_buf_pages[page])
+			goto free_aud;
+	}
+
+	cx88sdr_audio_make_risc_instructions(aud);
+	dev->audio = aud;
+	return;
+
+free_aud:
+	cx88sdr_audio_free_dma(aud);
+	kfree(aud);
+err:
+	cx88sdr_pr_err("can't alloc audio buffers, audio node disabled\n");
+}
+
+/* Power up the audio ADC and start the audio RISC program from ring page 0 */
+static void cx88sdr_audio_start(struct cx88sdr_audio *aud)
+{
+	struct cx88sdr_dev *dev = aud->dev;
+	unsigned long flags;
+
+	/* Power up audio bandgap DAC+ADC */
+	ctrl_iowrite32(dev, CX88SDR_AFE_CFG_IO, 0);
+
+	/* The RISC program restarts at ring page 0 */
+	spin_lock_irqsave(&aud->lock, flags);
+	aud->pages = round_up(aud->pages, CX88SDR_AUD_DMA_PAGES);
+	aud->cnt = 0;
+	atomic64_set(&aud->head, (aud->pages) ? (aud->pages - 1) : 0);
+	spin_unlock_irqrestore(&aud->lock, flags);
+
+	/* Start DMA, downstream FIFO and RISC */
+	ctrl_iowrite32(dev, CX88SDR_AUDD_GP_CNTRL, CX88SDR_GP_CNT_RESET);
+	ctrl_iowrite32(dev, CX88SDR_AUD_INT_STAT, CX88SDR_AUD_INT_STAT_CLEAR);
+	ctrl_iowrite32(dev, CX88SDR_AUD_DMA_CNTRL, (1 << 4) | (1 << 0));
+	ctrl_iowrite32(dev, CX88SDR_AUD_INT_MSK, CX88SDR_AUD_INT_MSK_VAL);
+}
+
+/* Stop the audio DMA and power the audio ADC back down, as cx88sdr_adc_setup() left it */
+static void cx88sdr_audio_stop(struct cx88sdr_audio *aud)
+{
+	struct cx88sdr_dev *dev = aud->dev;
+
+	ctrl_iowrite32(dev, CX88SDR_AUD_INT_MSK, CX88SDR_AUD_INT_MSK_CLEAR);
+	ctrl_iowrite32(dev, CX88SDR_AUD_DMA_CNTRL, 0);
+	ctrl_iowrite32(dev, CX88SDR_AFE_CFG_IO, CX88SDR_AFE_AUD_PDOWN);
+}
+
+/*
+ * Program DMA channel #25 like the main channel, in its own part of the
+ * SRAM. Called after cx88sdr_adc_setup(), at probe and resume; DMA starts
+ * again if the node was open.
+ */
+void cx88sdr_audio_setup(struct cx88sdr_dev *dev)
+{
+	struct cx88sdr_audio *aud = dev->audio;
+	u32 i;
+
+	if (!aud)
+		return;
+
+	/* Write CDT */
+	for (i = 0; i < CX88SDR_AUD_CDT_SIZE; i++)
+		ctrl_iowrite32(dev, CX88SDR_AUD_CDT_ADDR + 16 * i,
+			       CX88SDR_AUD_CLUSTER_BUF_ADDR + CX88SDR_AUD_PACKET_SIZE * i);
+
+	/* Write CMDS */
+	ctrl_iowrite32(dev, CX88SDR_DMA25_CMDS_ADDR +  0, aud->risc_buf_addr);
+	ctrl_iowrite32(dev, CX88SDR_DMA25_CMDS_ADDR +  4, CX88SDR_AUD_CDT_ADDR);
+	ctrl_iowrite32(dev, CX88SDR_DMA25_CMDS_ADDR +  8, (CX88SDR_AUD_CDT_SIZE * 16) >> 3);
+	ctrl_iowrite32(dev, CX88SDR_DMA25_CMDS_ADDR + 12, CX88SDR_AUD_INST_QUEUE_ADDR);
+	ctrl_iowrite32(dev, CX88SDR_DMA25_CMDS_ADDR + 16, CX88SDR_RISC_INST_QUEUE_SIZE);
+
+	/* Fill registers */
+	ctrl_iowrite32(dev, CX88SDR_DMA25_PTR2, CX88SDR_AUD_CDT_ADDR);
+	ctrl_iowrite32(dev, CX88SDR_DMA25_CNT1, (CX88SDR_AUD_PACKET_SIZE >> 3) - 1);
+	ctrl_iowrite32(dev, CX88SDR_DMA25_CNT2, (CX88SDR_AUD_CDT_SIZE * 16) >> 3);
+	ctrl_iowrite32(dev, CX88SDR_AUDD_LNGTH, CX88SDR_AUD_PACKET_SIZE);
+
+	mutex_lock(&aud->vdev_mlock);
+	if (aud->users)
+		cx88sdr_audio_start(aud);
+	mutex_unlock(&aud->vdev_mlock);
+}
+
+/*
+ * From the hard IRQ: acknowledges the audio interrupts. Returns the
+ * CX88SDR_IRQ_AUDIO bits for the IRQ thread, 0 if the audio channel did
+ * not interrupt.
+ */
+u32 cx88sdr_audio_irq(struct cx88sdr_dev *dev)
+{
+	struct cx88sdr_audio *aud = READ_ONCE(dev->audio);
+	uint32_t status;
+
+	if (!aud)
+		return 0;
+
+	status = ctrl_ioread32(dev, CX88SDR_AUD_INT_STAT);
+	if ((status & CX88SDR_AUD_INT_MSK_VAL) == 0)
+		return 0;
+	ctrl_iowrite32(dev, CX88SDR_AUD_INT_STAT, status);
+
+	if (status & (CX88SDR_AUD_INT_DN_SYNC | CX88SDR_AUD_INT_OPC_ERR))
+		aud->errors++;
+	return CX88SDR_IRQ_AUDIO |
+	       ((status & CX88SDR_AUD_INT_DN_RISCI1) ? CX88SDR_IRQ_AUDIO_PAGE : 0);
+}
+
+/*
+ * From the IRQ thread after an audio page interrupt: take a cross-reference.
+ * The main counter is read first, it moves every page of the main stream
+ * while the audio one moves every 21 ms, so the thread's latency costs
+ * nothing as long as it stays under an audio page.
+ */
+void cx88sdr_audio_xref(struct cx88sdr_dev *dev)
+{
+	struct cx88sdr_audio *aud = READ_ONCE(dev->audio);
+	struct cx88sdr_xref *x;
+	unsigned long flags;
+	u64 head;
+
+	if (!aud)
+		return;
+
+	head = cx88sdr_dma_update(dev);
+	spin_lock_irqsave(&aud->lock, flags);
+	cx88sdr_audio_fold(aud);
+	x = &aud->xref[aud->seq % CX88SDR_XREF_MAX];
+	x->audio = aud->pages << PAGE_SHIFT;
+	x->main = (head + 1) << PAGE_SHIFT;
+	x->ts_ns = ktime_get_ns();
+	aud->seq++;
+	spin_unlock_irqrestore(&aud->lock, flags);
+}
+
+void cx88sdr_audio_wake(struct cx88sdr_dev *dev)
+{
+	struct cx88sdr_audio *aud = READ_ONCE(dev->audio);
+
+	if (aud)
+		wake_up_interruptible(&aud->wq);
+}
+
+static int cx88sdr_audio_open(struct file *file)
+{
+	struct video_device *vdev = video_devdata(file);
+	struct cx88sdr_audio *aud = container_of(vdev, struct cx88sdr_audio, vdev);
+	struct cx88sdr_audio_fh *fh;
+
+	fh = kzalloc(sizeof(*fh), GFP_KERNEL);
+	if (!fh)
+		return -ENOMEM;
+
+	mutex_lock(&aud->vdev_mlock);
+	if (READ_ONCE(aud->dev->removing)) {
+		mutex_unlock(&aud->vdev_mlock);
+		kfree(fh);
+		return -ENODEV;
+	}
+	/* The card outlives remove while the handle is open */
+	cx88sdr_dev_get(aud->dev);
+	if (!aud->users++)
+		cx88sdr_audio_start(aud);
+	fh->spage = cx88sdr_audio_head(aud);
+	mutex_unlock(&aud->vdev_mlock);
+
+	v4l2_fh_init(&fh->fh, vdev);
+	fh->aud = aud;
+	file->private_data = &fh->fh;
+	v4l2_fh_add(&fh->fh);
+	return 0;
+}
+
+static int cx88sdr_audio_release(struct file *file)
+{
+	struct v4l2_fh *vfh = file->private_data;
+	struct cx88sdr_audio_fh *fh = container_of(vfh, struct cx88sdr_audio_fh, fh);
+	struct cx88sdr_audio *aud = fh->aud;
+
+	struct cx88sdr_dev *dev = aud->dev;
+
+	/* Remove has stopped the hardware already */
+	mutex_lock(&aud->vdev_mlock);
+	if (!--aud->users && !READ_ONCE(dev->removing))
+		cx88sdr_audio_stop(aud);
+	mutex_unlock(&aud->vdev_mlock);
+
+	v4l2_fh_del(&fh->fh);
+	v4l2_fh_exit(&fh->fh);
+	kfree(fh);
+	cx88sdr_dev_put(dev);
+	return 0;
+}
+
+static ssize_t cx88sdr_audio_read(struct file *file, char __user *buf, size_t size,
+				  loff_t *pos)
+{
+	struct v4l2_fh *vfh = file->private_data;
+	struct cx88sdr_audio_fh *fh = container_of(vfh, struct cx88sdr_audio_fh, fh);
+	struct cx88sdr_audio *aud = fh->aud;
+	ssize_t result = 0;
+	int ret;
+
+	while (size) {
+		u64 page = fh->spage + (*pos >> PAGE_SHIFT);
+		size_t len;
+
+		if (READ_ONCE(aud->dev->removing))
+			return -ENODEV;
+		if (cx88sdr_audio_head(aud) <= page) {
+			if (file->f_flags & O_NONBLOCK)
+				break;
+			ret = wait_event_interruptible(aud->wq, cx88sdr_audio_head(aud) > page ||
+						       READ_ONCE(aud->dev->removing));
+			if (ret)
+				return (result) ? result : ret;
+			continue;
+		}
+
+		len = PAGE_SIZE - (*pos % PAGE_SIZE);
+		if (len > size)
+			len = size;
+
+		down_read(&aud->ring_rwsem);
+		if (READ_ONCE(aud->dev->removing)) {
+			up_read(&aud->ring_rwsem);
+			return -ENODEV;
+		}
+		ret = copy_to_user(buf, aud->dma_buf_pages[page & (CX88SDR_AUD_DMA_PAGES - 1)] +
+				   (*pos % PAGE_SIZE), len);
+		up_read(&aud->ring_rwsem);
+		if (ret)
+			return -EFAULT;
+
+		result += len;
+		buf    += len;
+		*pos   += len;
+		size   -= len;
+	}
+
+	if (!result && size)
+		return -EAGAIN;
+
+	return result;
+}
+
+static __poll_t cx88sdr_audio_poll(struct file *file, struct poll_table_struct *wait)
+{
+	struct v4l2_fh *vfh = file->private_data;
+	struct cx88sdr_audio_fh *fh = container_of(vfh, struct cx88sdr_audio_fh, fh);
+	struct cx88sdr_audio *aud = fh->aud;
+	__poll_t res = 0;
+
+	poll_wait(file, &aud->wq, wait);
+	if (cx88sdr_audio_head(aud) > fh->spage + (file->f_pos >> PAGE_SHIFT))
+		res |= EPOLLIN | EPOLLRDNORM;
+	if (READ_ONCE(aud->dev->removing))
+		res = EPOLLERR | EPOLLHUP;
+	return res;
+}
+
+static long cx88sdr_audio_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct v4l2_fh *vfh = file->private_data;
+	struct cx88sdr_audio_fh *fh = container_of(vfh, struct cx88sdr_audio_fh, fh);
+	struct cx88sdr_audio *aud = fh->aud;
+	void __user *uarg = (void __user *)arg;
+
+	switch (cmd) {
+	case CX88SDR_IOC_G_POS: {
+		struct cx88sdr_pos p = {
+			.read	= (fh->spage << PAGE_SHIFT) + file->f_pos,
+			.write	= cx88sdr_audio_head(aud) << PAGE_SHIFT,
+			.size	= CX88SDR_AUD_DMA_SIZE,
+		};
+
+		return (copy_to_user(uarg, &p, sizeof(p))) ? -EFAULT : 0;
+	}
+	case CX88SDR_IOC_G_XREF: {
+		struct cx88sdr_xrefs *x;
+		unsigned long flags;
+		long ret = 0;
+		u32 i;
+
+		x = kzalloc(sizeof(*x), GFP_KERNEL);
+		if (!x)
+			return -ENOMEM;
+
+		spin_lock_irqsave(&aud->lock, flags);
+		x->seq = aud->seq;
+		x->count = min_t(u64, aud->seq, CX88SDR_XREF_MAX);
+		for (i = 0; i < x->count; i++)
+			x->xref[i] = aud->xref[(x->seq - x->count + i) % CX88SDR_XREF_MAX];
+		spin_unlock_irqrestore(&aud->lock, flags);
+
+		if (copy_to_user(uarg, x, sizeof(*x)))
+			ret = -EFAULT;
+		kfree(x);
+		return ret;
+	}
+	default:
+		return video_ioctl2(file, cmd, arg);
+	}
+}
+
+static const struct v4l2_file_operations cx88sdr_audio_fops = {
+	.owner		= THIS_MODULE,
+	.open		= cx88sdr_audio_open,
+	.release	= cx88sdr_audio_release,
+	.read		= cx88sdr_audio_read,
+	.poll		= cx88sdr_audio_poll,
+	.unlocked_ioctl	= cx88sdr_audio_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl32	= cx88sdr_compat_ioctl32,
+#endif
+};
+
+static int cx88sdr_audio_querycap(struct file *file, void __always_unused *priv,
+				  struct v4l2_capability *cap)
+{
+	struct cx88sdr_dev *dev = video_drvdata(file);
+
+	snprintf(cap->bus_info, sizeof(cap->bus_info), "PCI:%s", pci_name(dev->pdev));
+	strscpy(cap->card, CX88SDR_AUDIO_NAME, sizeof(cap->card));
+	strscpy(cap->driver, KBUILD_MODNAME, sizeof(cap->driver));
+	return 0;
+}
+
+static int cx88sdr_audio_enum_fmt_sdr(struct file __always_unused *file,
+				      void __always_unused *priv,
+				      struct v4l2_fmtdesc *f)
+{
+	if (f->index > 0)
+		return -EINVAL;
+
+	f->pixelformat = CX88SDR_FMT_AUDIO;
+	return 0;
+}
+
+/* One fixed format, set and try return it */
+static int cx88sdr_audio_g_fmt_sdr(struct file __always_unused *file,
+				   void __always_unused *priv,
+				   struct v4l2_format *f)
+{
+	memset(f->fmt.sdr.reserved, 0, sizeof(f->fmt.sdr.reserved));
+	f->fmt.sdr.pixelformat = CX88SDR_FMT_AUDIO;
+	f->fmt.sdr.buffersize = PAGE_SIZE;
+	return 0;
+}
+
+static int cx88sdr_audio_g_tuner(struct file __always_unused *file,
+				 void __always_unused *priv,
+				 struct v4l2_tuner *t)
+{
+	if (t->index > 0)
+		return -EINVAL;
+
+	strscpy(t->name, "ADC: CX2388x SDR Audio", sizeof(t->name));
+	t->type = V4L2_TUNER_SDR;
+	t->capability = (V4L2_TUNER_CAP_1HZ | V4L2_TUNER_CAP_FREQ_BANDS);
+	t->rangelow = CX88SDR_AUD_RATE;
+	t->rangehigh = CX88SDR_AUD_RATE;
+	return 0;
+}
+
+static int cx88sdr_audio_enum_freq_bands(struct file __always_unused *file,
+					 void __always_unused *priv,
+					 struct v4l2_frequency_band *band)
+{
+	if (band->tuner > 0 || band->index > 0)
+		return -EINVAL;
+
+	band->type = V4L2_TUNER_SDR;
+	band->capability = (V4L2_TUNER_CAP_1HZ | V4L2_TUNER_CAP_FREQ_BANDS);
+	band->rangelow = CX88SDR_AUD_RATE;
+	band->rangehigh = CX88SDR_AUD_RATE;
+	return 0;
+}
+
+static int cx88sdr_audio_g_frequency(struct file __always_unused *file,
+				     void __always_unused *priv,
+				     struct v4l2_frequency *f)
+{
+	if (f->tuner > 0)
+		return -EINVAL;
+
+	f->frequency = CX88SDR_AUD_RATE;
+	f->type = V4L2_TUNER_SDR;
+	return 0;
+}
+
+static int cx88sdr_audio_log_status(struct file *file, void __always_unused *priv)
+{
+	struct cx88sdr_dev *dev = video_drvdata(file);
+	struct cx88sdr_audio *aud = container_of(video_devdata(file),
+						 struct cx88sdr_audio, vdev);
+
+	v4l2_info(&dev->v4l2_dev, "Audio pages: %llu, cross-references: %llu, DMA errors: %llu\n",
+		  cx88sdr_audio_head(aud), READ_ONCE(aud->seq), READ_ONCE(aud->errors));
+	return 0;
+}
+
+static const struct v4l2_ioctl_ops cx88sdr_audio_ioctl_ops = {
+	.vidioc_querycap		= cx88sdr_audio_querycap,
+	.vidioc_enum_fmt_sdr_cap	= cx88sdr_audio_enum_fmt_sdr,
+	.vidioc_try_fmt_sdr_cap		= cx88sdr_audio_g_fmt_sdr,
+	.vidioc_g_fmt_sdr_cap		= cx88sdr_audio_g_fmt_sdr,
+	.vidioc_s_fmt_sdr_cap		= cx88sdr_audio_g_fmt_sdr,
+	.vidioc_g_tuner			= cx88sdr_audio_g_tuner,
+	.vidioc_s_tuner			= cx88sdr_s_tuner,
+	.vidioc_enum_freq_bands		= cx88sdr_audio_enum_freq_bands,
+	.vidioc_g_frequency		= cx88sdr_audio_g_frequency,
+	.vidioc_log_status		= cx88sdr_audio_log_status,
+};
+
+/* The last handle is gone after remove */
+static void cx88sdr_audio_vdev_release(struct video_device *vdev)
+{
+	kfree(container_of(vdev, struct cx88sdr_audio, vdev));
+}
+
+static const struct video_device cx88sdr_audio_template = {
+	.device_caps	= (V4L2_CAP_SDR_CAPTURE | V4L2_CAP_TUNER |
+			   V4L2_CAP_READWRITE),
+	.fops		= &cx88sdr_audio_fops,
+	.ioctl_ops	= &cx88sdr_audio_ioctl_ops,
+	.name		= CX88SDR_AUDIO_NAME,
+	.release	= cx88sdr_audio_vdev_release,
+};
+
+/* After the main node, on the same V4L2 device; a failure only loses the audio node */
+void cx88sdr_audio_register(struct cx88sdr_dev *dev)
+{
+	struct cx88sdr_audio *aud = dev->audio;
+	int ret;
+
+	if (!aud)
+		return;
+
+	aud->vdev = cx88sdr_audio_template;
+	aud->vdev.lock = &aud->vdev_mlock;
+	aud->vdev.v4l2_dev = &dev->v4l2_dev;
+	video_set_drvdata(&aud->vdev, dev);
+
+	ret = video_register_device(&aud->vdev, VFL_TYPE_SDR, -1);
+	if (ret) {
+		cx88sdr_pr_err("can't register audio node: %d\n", ret);
+		cx88sdr_audio_exit(dev);
+		return;
+	}
+	cx88sdr_pr_info("audio registered as %s\n", video_device_node_name(&aud->vdev));
+}
+
+void cx88sdr_audio_exit(struct cx88sdr_dev *dev)
+{
+	struct cx88sdr_audio *aud = dev->audio;
+
+	if (!aud)
+		return;
+
+	mutex_lock(&aud->vdev_mlock);
+	cx88sdr_audio_stop(aud);
+	mutex_unlock(&aud->vdev_mlock);
+
+	/* dev->removing is set: readers give up, copies started before are done after this */
+	wake_up_interruptible_all(&aud->wq);
+	down_write(&aud->ring_rwsem);
+	up_write(&aud->ring_rwsem);
+
+	/* No interrupt handler may still be looking at it */
+	WRITE_ONCE(dev->audio, NULL);
+	synchronize_irq(dev->irq);
+	cx88sdr_audio_free_dma(aud);
+
+	/* Open handles keep the struct until the last one is closed */
+	if (video_is_registered(&aud->vdev)) {
+		cx88sdr_pr_info("removing %s\n", video_device_node_name(&aud->vdev));
+		video_unregister_device(&aud->vdev);
+	} else {
+		kfree(aud);
+	}
+}
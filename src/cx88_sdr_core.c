@@ -17,10 +17,13 @@
  * Copyright (c) 2013-2015 Chad Page <Chad.Page@gmail.com>
  */
 
+#include <linux/bitmap.h>
 #include <linux/delay.h>
 #include <linux/interrupt.h>
+#include <linux/iommu.h>
 #include <linux/module.h>
 #include <linux/pci.h>
+#include <linux/version.h>
 #include <linux/videodev2.h>
 #include <media/v4l2-dev.h>
 #include <media/v4l2-event.h>
@@ -36,18 +39,184 @@ static int latency = 248;
 module_param(latency, int, 0);
 MODULE_PARM_DESC(latency, "Set PCI latency timer");
 
-static int cx88sdr_devcount;
+static int irq_cpu[CX88SDR_MAX_CARDS] = { [0 ... (CX88SDR_MAX_CARDS - 1)] = -1 };
+module_param_array(irq_cpu, int, NULL, 0);
+MODULE_PARM_DESC(irq_cpu, "Set IRQ CPU per card, default: CPUs of the card's NUMA node");
 
-static void cx88sdr_pci_lat_set(struct cx88sdr_dev *dev)
+static int bus_budget = 120;
+module_param(bus_budget, int, 0644);
+MODULE_PARM_DESC(bus_budget, "Set DMA budget per PCI bus segment in MB/s, 0 = unlimited");
+
+static bool bus_refuse;
+module_param(bus_refuse, bool, 0644);
+MODULE_PARM_DESC(bus_refuse, "Refuse sample rates exceeding the PCI bus budget");
+
+static bool iommu_ring = true;
+module_param(iommu_ring, bool, 0444);
+MODULE_PARM_DESC(iommu_ring, "Build the ring from ordinary pages mapped through the IOMMU, if one translates");
+
+/* Card numbers in use, under cx88sdr_dev_mlock */
+static DECLARE_BITMAP(cx88sdr_cards, CX88SDR_MAX_CARDS);
+
+static LIST_HEAD(cx88sdr_dev_list);
+static DEFINE_MUTEX(cx88sdr_dev_mlock);
+
+/*
+ * Cards probe in parallel and in any order, but the per-card parameters
+ * go by card number: a card takes its place among the CX2388x video
+ * functions in PCI order, as a serial probe would give it, or the first
+ * free number if another card holds that one.
+ */
+static int cx88sdr_nr_get(struct pci_dev *pdev)
+{
+	struct pci_dev *p = NULL;
+	int nr = 0;
+
+	while ((p = pci_get_device(pdev->vendor, pdev->device, p)) && p != pdev)
+		nr++;
+	pci_dev_put(p);
+
+	mutex_lock(&cx88sdr_dev_mlock);
+	if (nr >= CX88SDR_MAX_CARDS || test_bit(nr, cx88sdr_cards))
+		nr = find_first_zero_bit(cx88sdr_cards, CX88SDR_MAX_CARDS);
+	if (nr < CX88SDR_MAX_CARDS)
+		set_bit(nr, cx88sdr_cards);
+	else
+		nr = -ENODEV;
+	mutex_unlock(&cx88sdr_dev_mlock);
+	return nr;
+}
+
+static void cx88sdr_nr_put(int nr)
+{
+	mutex_lock(&cx88sdr_dev_mlock);
+	clear_bit(nr, cx88sdr_cards);
+	mutex_unlock(&cx88sdr_dev_mlock);
+}
+
+/* The self-test and tuning set cards one by one, the parameter sets them all at probe */
+void cx88sdr_pci_lat_set(struct cx88sdr_dev *dev, int val)
 {
 	u8 lat;
 
-	latency = clamp(latency, 32, 248);
-	pci_write_config_byte(dev->pdev, PCI_LATENCY_TIMER, latency);
+	val = clamp(val, CX88SDR_PCI_LAT_MIN, CX88SDR_PCI_LAT_MAX);
+
+	pci_write_config_byte(dev->pdev, PCI_LATENCY_TIMER, val);
 	pci_read_config_byte(dev->pdev, PCI_LATENCY_TIMER, &lat);
 	dev->pci_lat = lat;
 }
 
+u64 cx88sdr_bus_budget(void)
+{
+	return (u64)max(READ_ONCE(bus_budget), 0) * 1000000;
+}
+
+/* Cards behind the same bridge share one conventional PCI bus segment */
+static u64 cx88sdr_bus_load_locked(struct cx88sdr_dev *dev, u32 *cards)
+{
+	struct cx88sdr_dev *d;
+	u64 load = 0;
+	u32 n = 0;
+
+	list_for_each_entry(d, &cx88sdr_dev_list, list) {
+		if (d->pdev->bus != dev->pdev->bus)
+			continue;
+		load += d->byte_rate;
+		n++;
+	}
+	if (cards)
+		*cards = n;
+	return load;
+}
+
+u64 cx88sdr_bus_load(struct cx88sdr_dev *dev, u32 *cards)
+{
+	u64 load;
+
+	mutex_lock(&cx88sdr_dev_mlock);
+	load = cx88sdr_bus_load_locked(dev, cards);
+	mutex_unlock(&cx88sdr_dev_mlock);
+	return load;
+}
+
+/*
+ * Fill cards (CX88SDR_MAX_CARDS long) with the registered cards sharing
+ * dev's bus segment, dev first, and return how many. Each is held until
+ * cx88sdr_bus_peers_put(), but may be removed meanwhile: users check
+ * removing before touching one.
+ */
+u32 cx88sdr_bus_peers_get(struct cx88sdr_dev *dev, struct cx88sdr_dev **cards)
+{
+	struct cx88sdr_dev *d;
+	u32 n = 1, i;
+
+	mutex_lock(&cx88sdr_dev_mlock);
+	cards[0] = dev;
+	list_for_each_entry(d, &cx88sdr_dev_list, list) {
+		if (d != dev && d->pdev->bus == dev->pdev->bus && !READ_ONCE(d->removing) &&
+		    video_is_registered(&d->vdev) && n < CX88SDR_MAX_CARDS)
+			cards[n++] = d;
+	}
+	for (i = 0; i < n; i++) {
+		cx88sdr_dev_get(cards[i]);
+		pci_dev_get(cards[i]->pdev);
+	}
+	mutex_unlock(&cx88sdr_dev_mlock);
+	return n;
+}
+
+void cx88sdr_bus_peers_put(struct cx88sdr_dev **cards, u32 n)
+{
+	u32 i;
+
+	for (i = 0; i < n; i++) {
+		pci_dev_put(cards[i]->pdev);
+		cx88sdr_dev_put(cards[i]);
+	}
+}
+
+/*
+ * Account a new DMA byte rate for dev against the budget of its bus
+ * segment. Only user changes are refused: a card coming up at probe or
+ * resume is accounted and warned about, never lost to the budget.
+ */
+int cx88sdr_bus_admit(struct cx88sdr_dev *dev, u64 byte_rate, bool user)
+{
+	u64 load, budget = cx88sdr_bus_budget();
+	bool refuse = user && READ_ONCE(bus_refuse);
+	u32 cards;
+	int ret = 0;
+
+	/* Replay cards take no bus time */
+	if (!dev->pdev) {
+		dev->byte_rate = byte_rate;
+		return 0;
+	}
+
+	mutex_lock(&cx88sdr_dev_mlock);
+	load = cx88sdr_bus_load_locked(dev, &cards) - dev->byte_rate + byte_rate;
+	if (budget && load > budget) {
+		cx88sdr_pr_warn("PCI bus %04x:%02x over budget: %llu/%llu B/s, %u cards%s\n",
+				pci_domain_nr(dev->pdev->bus), dev->pdev->bus->number,
+				load, budget, cards, (refuse) ? ", refused" : "");
+		if (refuse)
+			ret = -ENOSPC;
+	}
+	if (!ret)
+		dev->byte_rate = byte_rate;
+	mutex_unlock(&cx88sdr_dev_mlock);
+	return ret;
+}
+
+static void cx88sdr_bus_topology_show(struct cx88sdr_dev *dev)
+{
+	struct pci_dev *bridge = pci_upstream_bridge(dev->pdev);
+
+	cx88sdr_pr_info("PCI bus %04x:%02x, upstream bridge: %s\n",
+			pci_domain_nr(dev->pdev->bus), dev->pdev->bus->number,
+			(bridge) ? pci_name(bridge) : "none");
+}
+
 static void cx88sdr_shutdown(struct cx88sdr_dev *dev)
 {
 	/* Disable RISC Controller and IRQs */
@@ -55,15 +224,26 @@ static void cx88sdr_shutdown(struct cx88sdr_dev *dev)
 
 	/* Stop DMA transfers */
 	ctrl_iowrite32(dev, CX88SDR_VID_DMA_CNTRL, 0);
+	ctrl_iowrite32(dev, CX88SDR_AUD_DMA_CNTRL, 0);
 
 	/* Stop interrupts */
 	ctrl_iowrite32(dev, CX88SDR_PCI_INT_MSK, CX88SDR_PCI_INT_MSK_CLEAR);
 	ctrl_iowrite32(dev, CX88SDR_VID_INT_MSK, CX88SDR_VID_INT_MSK_CLEAR);
+	ctrl_iowrite32(dev, CX88SDR_AUD_INT_MSK, CX88SDR_AUD_INT_MSK_CLEAR);
 
 	/* Stop capturing */
 	ctrl_iowrite32(dev, CX88SDR_CAPTURE_CTRL, 0);
 
 	ctrl_iowrite32(dev, CX88SDR_VID_INT_STAT, CX88SDR_VID_INT_STAT_CLEAR);
+	ctrl_iowrite32(dev, CX88SDR_AUD_INT_STAT, CX88SDR_AUD_INT_STAT_CLEAR);
+}
+
+/* Interrupts stay enabled, the IRQ thread must see every ring pass */
+static void cx88sdr_irq_unmask(struct cx88sdr_dev *dev)
+{
+	ctrl_iowrite32(dev, CX88SDR_VID_INT_MSK, CX88SDR_VID_INT_MSK_VAL);
+	ctrl_iowrite32(dev, CX88SDR_PCI_INT_MSK, CX88SDR_PCI_INT_MSK_VAL |
+		       ((dev->audio) ? CX88SDR_PCI_INT_MSK_AUD : 0));
 }
 
 static void cx88sdr_sram_setup(struct cx88sdr_dev *dev)
@@ -88,6 +268,155 @@ static void cx88sdr_sram_setup(struct cx88sdr_dev *dev)
 	ctrl_iowrite32(dev, CX88SDR_DMA24_CNT2, (CX88SDR_CDT_SIZE * 16) >> 3);
 }
 
+static void cx88sdr_dma_head_publish(struct cx88sdr_dev *dev)
+{
+	u64 head = (dev->dma_pages) ? (dev->dma_pages - 1) : 0;
+
+	if (head != atomic64_read(&dev->dma_head)) {
+		dev->head_ns = ktime_get_real_ns();
+		dev->head_mono_ns = ktime_get_ns();
+	}
+	atomic64_set(&dev->dma_head, head);
+}
+
+/* Called with dma_lock held */
+static u64 cx88sdr_dma_fold(struct cx88sdr_dev *dev)
+{
+	u32 cnt;
+
+	cnt = ctrl_ioread32(dev, CX88SDR_VBI_GP_CNT) & (CX88SDR_VBI_DMA_PAGES - 1);
+	dev->dma_pages += (cnt - dev->dma_cnt) & (CX88SDR_VBI_DMA_PAGES - 1);
+	dev->dma_cnt = cnt;
+	cx88sdr_dma_head_publish(dev);
+	atomic64_inc(&dev->stats.mmio_reads);
+	return atomic64_read(&dev->dma_head);
+}
+
+/*
+ * Fold the VBI GP counter (pages written in the current ring pass) into
+ * the absolute page count, and publish the first page that may still be
+ * in flight. Pages below it are complete and safe to read, the ring page
+ * of absolute page n is (n % CX88SDR_VBI_DMA_PAGES).
+ *
+ * With cx88sdr_dma_mask() this is the only place the counter is read: it
+ * runs from the IRQ thread, the position poll timer and group node opens,
+ * readers use cx88sdr_dma_head().
+ */
+u64 cx88sdr_dma_update(struct cx88sdr_dev *dev)
+{
+	unsigned long flags;
+	u64 head;
+
+	spin_lock_irqsave(&dev->dma_lock, flags);
+	head = cx88sdr_dma_fold(dev);
+	spin_unlock_irqrestore(&dev->dma_lock, flags);
+	return head;
+}
+
+/*
+ * As cx88sdr_dma_update(), for a configuration change: masks len bytes
+ * from the head page and returns it. The head and the mask are published
+ * together, so a reader that sees a page past the head also sees its mask.
+ */
+u64 cx88sdr_dma_mask(struct cx88sdr_dev *dev, u64 len)
+{
+	unsigned long flags;
+	u64 head;
+
+	spin_lock_irqsave(&dev->dma_lock, flags);
+	head = cx88sdr_dma_fold(dev);
+	if (len) {
+		/* A change inside a running hold-off extends it */
+		if ((head << PAGE_SHIFT) > dev->mask_end)
+			dev->mask_start = head << PAGE_SHIFT;
+		dev->mask_end = max(dev->mask_end, (head << PAGE_SHIFT) + len);
+	}
+	spin_unlock_irqrestore(&dev->dma_lock, flags);
+	return head;
+}
+
+/* The head and when it last advanced, now if it never has */
+u64 cx88sdr_dma_head_time(struct cx88sdr_dev *dev, u64 *head_ns)
+{
+	unsigned long flags;
+	u64 head;
+
+	spin_lock_irqsave(&dev->dma_lock, flags);
+	head = atomic64_read(&dev->dma_head);
+	*head_ns = (dev->head_ns) ? dev->head_ns : ktime_get_real_ns();
+	spin_unlock_irqrestore(&dev->dma_lock, flags);
+	return head;
+}
+
+/* As cx88sdr_dma_head_time(), on the monotonic clock for rates */
+u64 cx88sdr_dma_head_mono(struct cx88sdr_dev *dev, u64 *head_ns)
+{
+	unsigned long flags;
+	u64 head;
+
+	spin_lock_irqsave(&dev->dma_lock, flags);
+	head = atomic64_read(&dev->dma_head);
+	*head_ns = (dev->head_mono_ns) ? dev->head_mono_ns : ktime_get_ns();
+	spin_unlock_irqrestore(&dev->dma_lock, flags);
+	return head;
+}
+
+/* Replay cards: write() completed the pages below head, as DMA would have */
+void cx88sdr_dma_set_head(struct cx88sdr_dev *dev, u64 head)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->dma_lock, flags);
+	dev->dma_pages = head + 1;
+	cx88sdr_dma_head_publish(dev);
+	spin_unlock_irqrestore(&dev->dma_lock, flags);
+}
+
+/*
+ * The RISC program restarts at ring page 0, keep absolute pages aligned to
+ * it. On resume the pages skipped to get there still hold data from the
+ * last lap: they are masked, and nothing before the restart can be sought.
+ */
+static void cx88sdr_dma_reset(struct cx88sdr_dev *dev)
+{
+	unsigned long flags;
+	u64 start;
+
+	spin_lock_irqsave(&dev->dma_lock, flags);
+	start = dev->dma_pages << PAGE_SHIFT;
+	dev->dma_pages = round_up(dev->dma_pages, CX88SDR_VBI_DMA_PAGES);
+	dev->dma_cnt = 0;
+	dev->valid_start = dev->dma_pages << PAGE_SHIFT;
+	if (dev->valid_start > start) {
+		if (start > dev->mask_end)
+			dev->mask_start = start;
+		dev->mask_end = max(dev->mask_end, dev->valid_start);
+	}
+	cx88sdr_dma_head_publish(dev);
+	spin_unlock_irqrestore(&dev->dma_lock, flags);
+}
+
+static enum hrtimer_restart cx88sdr_pos_timer(struct hrtimer *timer)
+{
+	struct cx88sdr_dev *dev = container_of(timer, struct cx88sdr_dev, pos_timer);
+	u64 head = atomic64_read(&dev->dma_head);
+
+	atomic64_inc(&dev->stats.timer_polls);
+	if (cx88sdr_dma_update(dev) != head)
+		wake_up_interruptible(&dev->dma_wq);
+
+	hrtimer_forward_now(timer, us_to_ktime(READ_ONCE(dev->vctrl.pos_poll)));
+	return HRTIMER_RESTART;
+}
+
+void cx88sdr_pos_timer_set(struct cx88sdr_dev *dev)
+{
+	hrtimer_cancel(&dev->pos_timer);
+	if (dev->vctrl.pos_poll && !READ_ONCE(dev->removing))
+		hrtimer_start(&dev->pos_timer, us_to_ktime(dev->vctrl.pos_poll),
+			      HRTIMER_MODE_REL);
+}
+
 static void cx88sdr_adc_setup(struct cx88sdr_dev *dev)
 {
 	ctrl_iowrite32(dev, CX88SDR_VID_INT_STAT, ctrl_ioread32(dev, CX88SDR_VID_INT_STAT));
@@ -96,10 +425,11 @@ static void cx88sdr_adc_setup(struct cx88sdr_dev *dev)
 	ctrl_iowrite32(dev, CX88SDR_COLOR_CTRL, (0xe << 4) | 0xe);
 	ctrl_iowrite32(dev, CX88SDR_VBI_PACKET, (CX88SDR_VBI_PACKET_SIZE << 17) | (2 << 11));
 
-	/* Power down audio bandgap DAC+ADC */
-	ctrl_iowrite32(dev, CX88SDR_AFE_CFG_IO, (1 << 4) | (1 << 1));
+	/* Power down audio bandgap DAC+ADC, the audio node powers them up while open */
+	ctrl_iowrite32(dev, CX88SDR_AFE_CFG_IO, CX88SDR_AFE_AUD_PDOWN);
 
 	/* Start DMA */
+	cx88sdr_dma_reset(dev);
 	ctrl_iowrite32(dev, CX88SDR_DEV_CNTRL2, (1 << 5));
 	ctrl_iowrite32(dev, CX88SDR_VID_DMA_CNTRL, (1 << 7) | (1 << 3));
 }
@@ -125,19 +455,170 @@ static void cx88sdr_free_risc_inst_buffer(struct cx88sdr_dev *dev)
 	}
 }
 
-static int cx88sdr_alloc_dma_buffer(struct cx88sdr_dev *dev)
+/*
+ * Map the ring twice back to back in kernel space, so read() can copy any
+ * run of pages, wrap included, in one go. Only done when the pages come
+ * from the linear map: a remapped (uncached) coherent buffer must not get
+ * a cached alias. Without it read() copies page by page.
+ */
+static void cx88sdr_map_ring(struct cx88sdr_dev *dev)
+{
+	struct page **pages;
+	u32 page;
+
+	for (page = 0; page < CX88SDR_VBI_DMA_PAGES; page++)
+		if (is_vmalloc_addr(dev->dma_buf_pages[page]))
+			return;
+
+	pages = kvmalloc_array(2 * CX88SDR_VBI_DMA_PAGES, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return;
+	for (page = 0; page < CX88SDR_VBI_DMA_PAGES; page++)
+		pages[page] = pages[page + CX88SDR_VBI_DMA_PAGES] =
+			virt_to_page(dev->dma_buf_pages[page]);
+	dev->ring = vmap(pages, 2 * CX88SDR_VBI_DMA_PAGES, VM_MAP, PAGE_KERNEL);
+	kvfree(pages);
+	if (!dev->ring)
+		cx88sdr_pr_warn("ring vmap failed, read() copies page by page\n");
+}
+
+/* The DMA API goes through a translating IOMMU, not dma-direct */
+static bool cx88sdr_iommu_translates(struct cx88sdr_dev *dev)
+{
+	struct iommu_domain *domain = iommu_get_domain_for_dev(&dev->pdev->dev);
+
+#ifdef __IOMMU_DOMAIN_DMA_API
+	return domain && (domain->type & __IOMMU_DOMAIN_DMA_API);
+#else
+	return domain && domain->type == IOMMU_DOMAIN_DMA;
+#endif
+}
+
+/*
+ * Build the ring from ordinary pages of the card's NUMA node, up to 2MB
+ * at a time, and map them through the IOMMU into one 32-bit IOVA range,
+ * leaving ZONE_DMA32 alone. The device writes the ring for as long as it
+ * runs, so a mapping that needs syncing (bouncing) is refused and the
+ * caller falls back to coherent pages. Replay cards take the same pages,
+ * left unmapped: only the CPU writes them.
+ */
+static int cx88sdr_alloc_ring_pages(struct cx88sdr_dev *dev)
+{
+	struct device *d = (dev->pdev) ? &dev->pdev->dev : NULL;
+	int node = (d) ? dev_to_node(d) : NUMA_NO_NODE;
+	struct sg_dma_page_iter iter;
+	struct page **pages;
+	unsigned int order = CX88SDR_RING_ORDER_MAX, chunks = 0;
+	u32 page = 0, i;
+	int ret = -ENOMEM;
+
+	pages = kvmalloc_array(CX88SDR_VBI_DMA_PAGES, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+	while (page < CX88SDR_VBI_DMA_PAGES) {
+		struct page *p;
+
+		order = min_t(unsigned int, order, ilog2(CX88SDR_VBI_DMA_PAGES - page));
+		p = alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN |
+				     ((order) ? __GFP_NORETRY : 0), order);
+		if (!p) {
+			if (!order)
+				goto free_pages;
+			order--;
+			continue;
+		}
+		/* Order-0 pages from here on, for vm_insert_page() and freeing */
+		split_page(p, order);
+		for (i = 0; i < (1U << order); i++)
+			pages[page++] = p + i;
+		chunks++;
+	}
+	if (!d)
+		goto kernel_addr;
+
+	ret = sg_alloc_table_from_pages(&dev->ring_sgt, pages, CX88SDR_VBI_DMA_PAGES, 0,
+					CX88SDR_VBI_DMA_SIZE, GFP_KERNEL);
+	if (ret)
+		goto free_pages;
+	ret = dma_map_sgtable(d, &dev->ring_sgt, DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+	if (ret)
+		goto free_table;
+	if (dma_need_sync(d, sg_dma_address(dev->ring_sgt.sgl))) {
+		ret = -EOPNOTSUPP;
+		goto unmap;
+	}
+
+	i = 0;
+	for_each_sgtable_dma_page(&dev->ring_sgt, &iter, 0)
+		dev->dma_pages_addr[i++] = sg_page_iter_dma_address(&iter);
+kernel_addr:
+	for (i = 0; i < CX88SDR_VBI_DMA_PAGES; i++)
+		dev->dma_buf_pages[i] = page_address(pages[i]);
+	kvfree(pages);
+
+	if (d)
+		cx88sdr_pr_info("DMA ring: %u chunks of node %d, %u IOVA segments\n",
+				chunks, node, dev->ring_sgt.nents);
+	return 0;
+
+unmap:
+	dma_unmap_sgtable(d, &dev->ring_sgt, DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+free_table:
+	sg_free_table(&dev->ring_sgt);
+	dev->ring_sgt.sgl = NULL;
+free_pages:
+	while (page)
+		__free_page(pages[--page]);
+	kvfree(pages);
+	return ret;
+}
+
+static void cx88sdr_free_ring_pages(struct cx88sdr_dev *dev)
 {
 	u32 page;
 
-	dev->dma_pages_addr = kcalloc(CX88SDR_VBI_DMA_PAGES, sizeof(dma_addr_t), GFP_KERNEL);
+	if (dev->ring_sgt.sgl) {
+		dma_unmap_sgtable(&dev->pdev->dev, &dev->ring_sgt, DMA_FROM_DEVICE,
+				  DMA_ATTR_SKIP_CPU_SYNC);
+		sg_free_table(&dev->ring_sgt);
+		dev->ring_sgt.sgl = NULL;
+	}
+	for (page = 0; page < CX88SDR_VBI_DMA_PAGES; page++) {
+		__free_page(virt_to_page(dev->dma_buf_pages[page]));
+		dev->dma_buf_pages[page] = NULL;
+		dev->dma_pages_addr[page] = (dma_addr_t)0;
+	}
+}
+
+int cx88sdr_alloc_dma_buffer(struct cx88sdr_dev *dev)
+{
+	__le16 *fill16;
+	u32 page = 0, i;
+
+	int node = (dev->pdev) ? dev_to_node(&dev->pdev->dev) : NUMA_NO_NODE;
+
+	dev->dma_pages_addr = kcalloc_node(CX88SDR_VBI_DMA_PAGES, sizeof(dma_addr_t),
+					   GFP_KERNEL, node);
 	if (!dev->dma_pages_addr)
 		return -ENOMEM;
 
-	dev->dma_buf_pages = kcalloc(CX88SDR_VBI_DMA_PAGES, sizeof(void *), GFP_KERNEL);
+	dev->dma_buf_pages = kcalloc_node(CX88SDR_VBI_DMA_PAGES, sizeof(void *),
+					  GFP_KERNEL, node);
 	if (!dev->dma_buf_pages)
 		goto free_dma_pages_addr;
 
-	for (page = 0; page < CX88SDR_VBI_DMA_PAGES; page++) {
+	if (!dev->pdev) {
+		if (cx88sdr_alloc_ring_pages(dev))
+			goto free_dma_buf_pages;
+		page = CX88SDR_VBI_DMA_PAGES;
+	} else if (iommu_ring && cx88sdr_iommu_translates(dev) &&
+		   !cx88sdr_alloc_ring_pages(dev)) {
+		page = CX88SDR_VBI_DMA_PAGES;
+	}
+
+	/* Otherwise coherent pages, allocated from the device's NUMA node */
+	for (; page < CX88SDR_VBI_DMA_PAGES; page++) {
 		dma_addr_t dma_handle;
 
 		dev->dma_buf_pages[page] = dma_alloc_coherent(&dev->pdev->dev,
@@ -147,8 +628,23 @@ static int cx88sdr_alloc_dma_buffer(struct cx88sdr_dev *dev)
 			goto free_dma_buf_pages;
 		dev->dma_pages_addr[page] = dma_handle;
 	}
+
+	dev->mask_fill = kmalloc_node(2 * PAGE_SIZE, GFP_KERNEL, node);
+	if (!dev->mask_fill)
+		goto free_ring;
+	/* Mid-scale samples returned by read() during a configuration hold-off */
+	memset(dev->mask_fill, 0x80, PAGE_SIZE);
+	fill16 = (__le16 *)(dev->mask_fill + PAGE_SIZE);
+	for (i = 0; i < PAGE_SIZE / 2; i++)
+		fill16[i] = cpu_to_le16(0x8000);
+	cx88sdr_map_ring(dev);
 	return 0;
 
+free_ring:
+	if (dev->ring_sgt.sgl || !dev->pdev) {
+		cx88sdr_free_ring_pages(dev);
+		page = 0;
+	}
 free_dma_buf_pages:
 	while (page) {
 		page--;
@@ -166,10 +662,18 @@ free_dma_pages_addr:
 	return -ENOMEM;
 }
 
-static void cx88sdr_free_dma_buffer(struct cx88sdr_dev *dev)
+void cx88sdr_free_dma_buffer(struct cx88sdr_dev *dev)
 {
 	u32 page;
 
+	if (dev->ring) {
+		vunmap(dev->ring);
+		dev->ring = NULL;
+	}
+	kfree(dev->mask_fill);
+	dev->mask_fill = NULL;
+	if (dev->ring_sgt.sgl || !dev->pdev)
+		cx88sdr_free_ring_pages(dev);
 	for (page = 0; page < CX88SDR_VBI_DMA_PAGES; page++) {
 		if (dev->dma_buf_pages[page]) {
 			dma_free_coherent(&dev->pdev->dev, PAGE_SIZE,
@@ -185,25 +689,27 @@ static void cx88sdr_free_dma_buffer(struct cx88sdr_dev *dev)
 	dev->dma_pages_addr = NULL;
 }
 
+static uint32_t cx88sdr_risc_irq1(struct cx88sdr_dev *dev, uint32_t page)
+{
+	return ((page + 1) % dev->vctrl.irq_pages) ?
+		CX88SDR_RISC_IRQ1_NOOP : CX88SDR_RISC_IRQ1_TRIG;
+}
+
 static void cx88sdr_make_risc_instructions(struct cx88sdr_dev *dev)
 {
 	uint32_t *risc_buf = dev->risc_buf;
 	uint32_t risc_loop_addr = dev->risc_buf_addr + sizeof(uint32_t);
-	uint32_t page, irq_cnt = 0;
+	uint32_t page;
 
 	*risc_buf++ = CX88SDR_RISC_SYNC | CX88SDR_RISC_CNT_RESET;
 
 	for (page = 0; page < CX88SDR_VBI_DMA_PAGES; page++) {
 		uint32_t dma_addr = dev->dma_pages_addr[page];
 
-		irq_cnt++;
-		irq_cnt &= CX88SDR_RISC_IRQ1_CNT_MASK;
-
 		*risc_buf++ = CX88SDR_RISC_WRITE_VBI_PACKET;
 		*risc_buf++ = dma_addr;
 
-		*risc_buf++ = CX88SDR_RISC_WRITE_VBI_PACKET | ((irq_cnt) ?
-			      CX88SDR_RISC_IRQ1_NOOP : CX88SDR_RISC_IRQ1_TRIG) |
+		*risc_buf++ = CX88SDR_RISC_WRITE_VBI_PACKET | cx88sdr_risc_irq1(dev, page) |
 			      ((page < CX88SDR_VBI_DMA_PAGES - 1) ?
 			      CX88SDR_RISC_CNT_INCR : CX88SDR_RISC_CNT_RESET);
 		*risc_buf++ = dma_addr + CX88SDR_VBI_PACKET_SIZE;
@@ -216,21 +722,228 @@ static void cx88sdr_make_risc_instructions(struct cx88sdr_dev *dev)
 		       CX88SDR_RISC_BUF_SIZE / SZ_1K, CX88SDR_VBI_DMA_SIZE / SZ_1M);
 }
 
+/* Rewrite the IRQ1 flags in place, the RISC controller picks them up on its next pass */
+void cx88sdr_risc_irq_set(struct cx88sdr_dev *dev)
+{
+	uint32_t *risc_inst = dev->risc_buf + 3;
+	uint32_t page;
+
+	/* Replay cards publish on their own schedule, see cx88sdr_replay_write() */
+	if (!dev->risc_buf)
+		return;
+	for (page = 0; page < CX88SDR_VBI_DMA_PAGES; page++, risc_inst += 4)
+		WRITE_ONCE(*risc_inst, (*risc_inst & ~CX88SDR_RISC_IRQ1_TRIG) |
+			   cx88sdr_risc_irq1(dev, page));
+}
+
+/*
+ * Hard IRQ: a single status read tells a shared line whether the card is
+ * interrupting (two with the audio node), everything else is deferred to
+ * cx88sdr_irq_thread().
+ */
 static irqreturn_t cx88sdr_irq(int __always_unused irq, void *dev_id)
 {
 	struct cx88sdr_dev *dev = dev_id;
-	int i, handled = 0;
-	uint32_t mask, status;
-
-	for (i = 0; i < 10; i++) {
-		status = ctrl_ioread32(dev, CX88SDR_VID_INT_STAT);
-		mask = ctrl_ioread32(dev, CX88SDR_VID_INT_MSK);
-		if ((status & mask) == 0)
-			break;
+	uint32_t status;
+	u32 audio;
+
+	audio = cx88sdr_audio_irq(dev);
+	status = ctrl_ioread32(dev, CX88SDR_VID_INT_STAT);
+	if ((status & CX88SDR_VID_INT_MSK_VAL) == 0 && !audio)
+		return IRQ_NONE;
+	if (status & CX88SDR_VID_INT_MSK_VAL)
 		ctrl_iowrite32(dev, CX88SDR_VID_INT_STAT, status);
-		handled = 1;
+	atomic_or((status & CX88SDR_VID_INT_MSK_VAL) | audio, &dev->irq_status);
+	return IRQ_WAKE_THREAD;
+}
+
+/*
+ * Count the faults in a video interrupt status and queue a
+ * CX88SDR_EVENT_FAULT for them. The fault bits interrupt on their own, so
+ * the write position taken here is within an interrupt latency of where
+ * an overflow dropped its samples.
+ */
+static void cx88sdr_fault(struct cx88sdr_dev *dev, u32 status)
+{
+	struct v4l2_event ev = { .type = CX88SDR_EVENT_FAULT };
+	struct cx88sdr_event_fault *f = (void *)ev.u.data;
+	struct cx88sdr_stats *st = &dev->stats;
+
+	BUILD_BUG_ON(sizeof(*f) > sizeof(ev.u.data));
+
+	f->pos = cx88sdr_dma_update(dev) << PAGE_SHIFT;
+	f->status = status;
+	if (status & CX88SDR_VID_INT_VBI_OFLOW) {
+		f->faults |= CX88SDR_FAULT_OVERFLOW;
+		st->fifo_overflows++;
+	}
+	if (status & CX88SDR_VID_INT_VBI_SYNC) {
+		f->faults |= CX88SDR_FAULT_SYNC;
+		st->sync_errors++;
+	}
+	if (status & (CX88SDR_VID_INT_OPC_ERR | CX88SDR_VID_INT_RIP_ERR)) {
+		f->faults |= CX88SDR_FAULT_RISC;
+		st->risc_errors++;
+	}
+	if (status & (CX88SDR_VID_INT_PAR_ERR | CX88SDR_VID_INT_PCI_ABORT)) {
+		f->faults |= CX88SDR_FAULT_PCI;
+		st->pci_errors++;
+	}
+	st->fault_pos = f->pos;
+	f->fifo_overflows = st->fifo_overflows;
+	f->sync_errors = st->sync_errors;
+	f->risc_errors = st->risc_errors;
+	f->pci_errors = st->pci_errors;
+
+	cx88sdr_pr_warn_ratelimited("fault 0x%05x at byte %llu: %llu overflows, %llu sync, "
+				    "%llu RISC, %llu PCI errors\n", status, f->pos,
+				    st->fifo_overflows, st->sync_errors, st->risc_errors,
+				    st->pci_errors);
+	if (video_is_registered(&dev->vdev))
+		v4l2_event_queue(&dev->vdev, &ev);
+}
+
+static irqreturn_t cx88sdr_irq_thread(int __always_unused irq, void *dev_id)
+{
+	struct cx88sdr_dev *dev = dev_id;
+	uint32_t status = atomic_xchg(&dev->irq_status, 0);
+
+	u64 now = ktime_get_ns();
+
+	dev->stats.irqs++;
+	if (now - dev->stats.irq_rate_ts >= NSEC_PER_SEC) {
+		dev->stats.irq_rate = div64_u64((dev->stats.irqs - dev->stats.irq_rate_cnt) *
+						NSEC_PER_SEC, now - dev->stats.irq_rate_ts);
+		dev->stats.irq_rate_cnt = dev->stats.irqs;
+		dev->stats.irq_rate_ts = now;
+	}
+
+	if (status & CX88SDR_VID_INT_VBI_RISCI1) {
+		dev->stats.irqs_risci1++;
+		cx88sdr_dma_update(dev);
+		wake_up_interruptible(&dev->dma_wq);
 	}
-	return IRQ_RETVAL(handled);
+	if (status & CX88SDR_VID_INT_FAULTS)
+		cx88sdr_fault(dev, status & CX88SDR_VID_INT_FAULTS);
+	if (status & CX88SDR_IRQ_AUDIO_PAGE)
+		cx88sdr_audio_xref(dev);
+	if (status & CX88SDR_IRQ_AUDIO)
+		cx88sdr_audio_wake(dev);
+	return IRQ_HANDLED;
+}
+
+/* Applies the mask and publishes it as the hint, irq_set_affinity_hint() did both before 5.17 */
+static void cx88sdr_irq_affinity_apply(unsigned int irq, const struct cpumask *m)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+	irq_set_affinity_and_hint(irq, m);
+#else
+	irq_set_affinity_hint(irq, m);
+#endif
+}
+
+static void cx88sdr_irq_affinity_clear(unsigned int irq)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+	irq_update_affinity_hint(irq, NULL);
+#else
+	irq_set_affinity_hint(irq, NULL);
+#endif
+}
+
+static void cx88sdr_irq_affinity_set(struct cx88sdr_dev *dev)
+{
+	int cpu = irq_cpu[dev->nr];
+	int node = dev_to_node(&dev->pdev->dev);
+
+	if (cpu >= 0 && cpu < nr_cpu_ids && cpu_online(cpu))
+		cx88sdr_irq_affinity_apply(dev->irq, cpumask_of(cpu));
+	else if (node != NUMA_NO_NODE)
+		cx88sdr_irq_affinity_apply(dev->irq, cpumask_of_node(node));
+}
+
+/* State and initial values shared by PCI and replay cards, put the card on failure */
+int cx88sdr_dev_init(struct cx88sdr_dev *dev)
+{
+	kref_init(&dev->ref);
+	dev->stats.mmio_reads_saved = alloc_percpu(u64);
+	if (!dev->stats.mmio_reads_saved)
+		return -ENOMEM;
+	mutex_init(&dev->vdev_mlock);
+	spin_lock_init(&dev->dma_lock);
+	init_waitqueue_head(&dev->dma_wq);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(&dev->pos_timer, cx88sdr_pos_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+#else
+	hrtimer_init(&dev->pos_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->pos_timer.function = cx88sdr_pos_timer;
+#endif
+
+	/* Set initial values */
+	dev->vctrl.gain        = CX88SDR_GAIN_DEFVAL;
+	dev->vctrl.gain_6db    = CX88SDR_GAIN_6DB_DEFVAL;
+	dev->vctrl.agc_adj3    = CX88SDR_AGC_ADJ3_DEFVAL;
+	dev->vctrl.agc_tip3    = CX88SDR_AGC_TIP3_DEFVAL;
+	dev->vctrl.input       = CX88SDR_INPUT_DEFVAL;
+	dev->vctrl.irq_pages   = CX88SDR_IRQ_PAGES_DEF;
+
+	/* Options for Raw Video (UltraLock ON, HLOCK = 1) */
+	dev->vctrl.afc_pll     = CX88SDR_AFC_PLL_DEFVAL;
+	dev->vctrl.input_vsync = CX88SDR_INPUT_VSYNC_DEFVAL;
+	dev->vctrl.htotal      = CX88SDR_HTOTAL_DEFVAL;
+	dev->vctrl.mode        = CX88SDR_MODE_DEFVAL;
+
+	dev->vctrl.freq        = CX88SDR_ADC_FREQ_DEFVAL;
+	dev->vctrl.pixelformat = V4L2_SDR_FMT_RU8;
+	dev->vctrl.buffersize  = PAGE_SIZE;
+	return 0;
+}
+
+/*
+ * The struct outlives remove while a group handle holds the card: only
+ * the fields remove leaves alone (DMA position, wait queue, flags) may be
+ * touched through such a reference, and only after checking removing.
+ */
+void cx88sdr_dev_get(struct cx88sdr_dev *dev)
+{
+	kref_get(&dev->ref);
+}
+
+static void cx88sdr_dev_release(struct kref *ref)
+{
+	struct cx88sdr_dev *dev = container_of(ref, struct cx88sdr_dev, ref);
+
+	free_percpu(dev->stats.mmio_reads_saved);
+	kfree(dev);
+}
+
+void cx88sdr_dev_put(struct cx88sdr_dev *dev)
+{
+	kref_put(&dev->ref, cx88sdr_dev_release);
+}
+
+/* The controls of a card, and the pacing of a replay card */
+int cx88sdr_ctrl_init(struct cx88sdr_dev *dev)
+{
+	struct v4l2_ctrl_handler *hdl = &dev->ctrl_handler;
+
+	v4l2_ctrl_handler_init(hdl, 13);
+	v4l2_ctrl_new_std(hdl, &cx88sdr_ctrl_ops, V4L2_CID_GAIN, 0, 31, 1, dev->vctrl.gain);
+	dev->ctrl_gain_6db = v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_gain_6db, NULL);
+	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_agc_adj3, NULL);
+	dev->ctrl_agc_tip3 = v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_agc_tip3, NULL);
+	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_input, NULL);
+	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_afc_pll, NULL);
+	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_input_vsync, NULL);
+	dev->ctrl_htotal = v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_htotal, NULL);
+	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_irq_pages, NULL);
+	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_pos_poll, NULL);
+	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_holdoff, NULL);
+	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_mode, NULL);
+	if (dev->replay)
+		v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_replay_speed, NULL);
+	dev->v4l2_dev.ctrl_handler = hdl;
+	return hdl->error;
 }
 
 static int cx88sdr_probe(struct pci_dev *pdev,
@@ -239,14 +952,16 @@ static int cx88sdr_probe(struct pci_dev *pdev,
 	struct cx88sdr_dev *dev;
 	struct v4l2_device *v4l2_dev;
 	struct v4l2_ctrl_handler *hdl;
-	int ret;
+	u64 start = ktime_get_ns();
+	int nr, ret;
 
-	if (cx88sdr_devcount >= CX88SDR_MAX_CARDS)
-		return -ENODEV;
+	nr = cx88sdr_nr_get(pdev);
+	if (nr < 0)
+		return nr;
 
 	ret = pci_enable_device(pdev);
 	if (ret)
-		return ret;
+		goto put_nr;
 
 	pci_set_master(pdev);
 
@@ -256,22 +971,30 @@ static int cx88sdr_probe(struct pci_dev *pdev,
 		goto disable_device;
 	}
 
-	dev = devm_kzalloc(&pdev->dev, sizeof(*dev), GFP_KERNEL);
+	dev = kzalloc_node(sizeof(*dev), GFP_KERNEL, dev_to_node(&pdev->dev));
 	if (!dev) {
 		ret = -ENOMEM;
 		dev_err(&pdev->dev, "can't allocate memory\n");
 		goto disable_device;
 	}
 
-	dev->nr = cx88sdr_devcount;
+	dev->nr = nr;
 	dev->pdev = pdev;
 
-	cx88sdr_pci_lat_set(dev);
+	mutex_lock(&cx88sdr_dev_mlock);
+	list_add_tail(&dev->list, &cx88sdr_dev_list);
+	mutex_unlock(&cx88sdr_dev_mlock);
+	ret = cx88sdr_dev_init(dev);
+	if (ret)
+		goto free_dev;
+
+	cx88sdr_pci_lat_set(dev, READ_ONCE(latency));
+	cx88sdr_bus_topology_show(dev);
 
 	ret = pci_request_regions(pdev, KBUILD_MODNAME);
 	if (ret) {
 		cx88sdr_pr_err("can't request memory regions\n");
-		goto disable_device;
+		goto free_dev;
 	}
 
 	ret = cx88sdr_alloc_risc_inst_buffer(dev);
@@ -280,11 +1003,13 @@ static int cx88sdr_probe(struct pci_dev *pdev,
 		goto free_pci_regions;
 	}
 
+	dev->ring_ns = ktime_get_ns();
 	ret = cx88sdr_alloc_dma_buffer(dev);
 	if (ret) {
 		cx88sdr_pr_err("can't alloc DMA buffers\n");
 		goto free_risc_inst_buffer;
 	}
+	dev->ring_ns = ktime_get_ns() - dev->ring_ns;
 
 	cx88sdr_make_risc_instructions(dev);
 
@@ -299,46 +1024,32 @@ static int cx88sdr_probe(struct pci_dev *pdev,
 
 	cx88sdr_sram_setup(dev);
 
-	ret = request_irq(pdev->irq, cx88sdr_irq, IRQF_SHARED, KBUILD_MODNAME, dev);
+	ret = request_threaded_irq(pdev->irq, cx88sdr_irq, cx88sdr_irq_thread,
+				   IRQF_SHARED, KBUILD_MODNAME, dev);
 	if (ret) {
 		cx88sdr_pr_err("failed to request IRQ\n");
 		goto free_ctrl;
 	}
 
 	dev->irq = pdev->irq;
+	cx88sdr_irq_affinity_set(dev);
 	synchronize_irq(dev->irq);
 
-	/* Set initial values */
-	dev->vctrl.gain        = CX88SDR_GAIN_DEFVAL;
-	dev->vctrl.gain_6db    = CX88SDR_GAIN_6DB_DEFVAL;
-	dev->vctrl.agc_adj3    = CX88SDR_AGC_ADJ3_DEFVAL;
-	dev->vctrl.agc_tip3    = CX88SDR_AGC_TIP3_DEFVAL;
-	dev->vctrl.input       = CX88SDR_INPUT_DEFVAL;
-
-	/* Options for Raw Video (UltraLock ON, HLOCK = 1) */
-	dev->vctrl.afc_pll     = CX88SDR_AFC_PLL_DEFVAL;
-	dev->vctrl.input_vsync = CX88SDR_INPUT_VSYNC_DEFVAL;
-	dev->vctrl.htotal      = CX88SDR_HTOTAL_DEFVAL;
-
-	dev->vctrl.freq        = CX88SDR_ADC_FREQ_DEFVAL;
-	dev->vctrl.pixelformat = V4L2_SDR_FMT_RU8;
-	dev->vctrl.buffersize  = PAGE_SIZE;
-
 	snprintf(dev->name, sizeof(dev->name), CX88SDR_DRV_NAME " [%d]", dev->nr);
 
+	cx88sdr_audio_init(dev);
 	cx88sdr_adc_setup(dev);
-	ret = cx88sdr_adc_fmt_set(dev);
+	cx88sdr_audio_setup(dev);
+	ret = cx88sdr_adc_fmt_set(dev, false);
 	if (ret) {
 		cx88sdr_pr_err("failed to config ADC\n");
+		cx88sdr_shutdown(dev);
 		goto free_irq;
 	}
 
 	cx88sdr_gain_set(dev);
 	cx88sdr_input_set(dev);
 
-	mutex_init(&dev->vdev_mlock);
-	mutex_init(&dev->vopen_mlock);
-
 	v4l2_dev = &dev->v4l2_dev;
 	ret = v4l2_device_register(&pdev->dev, v4l2_dev);
 	if (ret) {
@@ -347,18 +1058,8 @@ static int cx88sdr_probe(struct pci_dev *pdev,
 	}
 
 	hdl = &dev->ctrl_handler;
-	v4l2_ctrl_handler_init(hdl, 8);
-	v4l2_ctrl_new_std(hdl, &cx88sdr_ctrl_ops, V4L2_CID_GAIN, 0, 31, 1, dev->vctrl.gain);
-	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_gain_6db, NULL);
-	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_agc_adj3, NULL);
-	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_agc_tip3, NULL);
-	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_input, NULL);
-	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_afc_pll, NULL);
-	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_input_vsync, NULL);
-	v4l2_ctrl_new_custom(hdl, &cx88sdr_ctrl_htotal, NULL);
-	v4l2_dev->ctrl_handler = hdl;
-	if (hdl->error) {
-		ret = hdl->error;
+	ret = cx88sdr_ctrl_init(dev);
+	if (ret) {
 		v4l2_err(v4l2_dev, "can't register V4L2 controls\n");
 		goto free_v4l2;
 	}
@@ -371,23 +1072,38 @@ static int cx88sdr_probe(struct pci_dev *pdev,
 	dev->vdev.v4l2_dev = v4l2_dev;
 	video_set_drvdata(&dev->vdev, dev);
 
-	ret = video_register_device(&dev->vdev, VFL_TYPE_SDR, -1);
+	ret = cx88sdr_sysfs_init(dev);
 	if (ret)
 		goto free_v4l2;
 
+	ret = video_register_device(&dev->vdev, VFL_TYPE_SDR, -1);
+	if (ret)
+		goto free_sysfs;
+
 	cx88sdr_pr_info("IRQ: %u, Control MMIO: 0x%p, PCI latency: %d, Xtal: %uHz\n",
 			dev->pdev->irq, dev->ctrl, dev->pci_lat, (u32)CX88SDR_XTAL_FREQ);
+	cx88sdr_pr_info("NUMA node: %d, IRQ CPU: %d\n",
+			dev_to_node(&pdev->dev), irq_cpu[dev->nr]);
 	cx88sdr_pr_info("registered as %s\n",
 			video_device_node_name(&dev->vdev));
+	cx88sdr_audio_register(dev);
 
-	ctrl_iowrite32(dev, CX88SDR_VID_INT_MSK, CX88SDR_VID_INT_MSK_VAL);
-	cx88sdr_devcount++;
+	cx88sdr_irq_unmask(dev);
+	cx88sdr_group_add(dev);
+
+	dev->probe_ns = ktime_get_ns() - start;
+	cx88sdr_pr_info("probed in %llu ms, DMA ring %llu ms\n",
+			div_u64(dev->probe_ns, NSEC_PER_MSEC), div_u64(dev->ring_ns, NSEC_PER_MSEC));
 	return 0;
 
+free_sysfs:
+	cx88sdr_sysfs_exit(dev);
 free_v4l2:
 	v4l2_ctrl_handler_free(hdl);
 	v4l2_device_unregister(v4l2_dev);
 free_irq:
+	cx88sdr_audio_exit(dev);
+	cx88sdr_irq_affinity_clear(dev->irq);
 	free_irq(dev->irq, dev);
 free_ctrl:
 	iounmap(dev->ctrl);
@@ -397,8 +1113,15 @@ free_risc_inst_buffer:
 	cx88sdr_free_risc_inst_buffer(dev);
 free_pci_regions:
 	pci_release_regions(pdev);
+free_dev:
+	mutex_lock(&cx88sdr_dev_mlock);
+	list_del(&dev->list);
+	mutex_unlock(&cx88sdr_dev_mlock);
+	cx88sdr_dev_put(dev);
 disable_device:
 	pci_disable_device(pdev);
+put_nr:
+	cx88sdr_nr_put(nr);
 	return ret;
 }
 
@@ -407,23 +1130,36 @@ static void cx88sdr_remove(struct pci_dev *pdev)
 	struct v4l2_device *v4l2_dev = pci_get_drvdata(pdev);
 	struct cx88sdr_dev *dev = container_of(v4l2_dev, struct cx88sdr_dev, v4l2_dev);
 
+	WRITE_ONCE(dev->removing, true);
+	/* Group readers asleep on this card see the flag and give up */
+	wake_up_interruptible_all(&dev->dma_wq);
 	cx88sdr_shutdown(dev);
 
 	cx88sdr_pr_info("removing %s\n", video_device_node_name(&dev->vdev));
 
-	cx88sdr_devcount--;
-
+	cx88sdr_group_del(dev);
+	cx88sdr_audio_exit(dev);
 	video_unregister_device(&dev->vdev);
+	cx88sdr_sysfs_exit(dev);
+	/* Takes the handler lock: a Position Poll change in flight has armed the timer by now */
 	v4l2_ctrl_handler_free(&dev->ctrl_handler);
 	v4l2_device_unregister(&dev->v4l2_dev);
+	hrtimer_cancel(&dev->pos_timer);
 
 	/* Release resources */
+	cx88sdr_irq_affinity_clear(dev->irq);
 	free_irq(dev->irq, dev);
 	iounmap(dev->ctrl);
 	cx88sdr_free_dma_buffer(dev);
 	cx88sdr_free_risc_inst_buffer(dev);
 	pci_release_regions(pdev);
 	pci_disable_device(pdev);
+
+	mutex_lock(&cx88sdr_dev_mlock);
+	list_del(&dev->list);
+	clear_bit(dev->nr, cx88sdr_cards);
+	mutex_unlock(&cx88sdr_dev_mlock);
+	cx88sdr_dev_put(dev);
 }
 
 static int __maybe_unused cx88sdr_suspend(struct device *dev_d)
@@ -431,6 +1167,7 @@ static int __maybe_unused cx88sdr_suspend(struct device *dev_d)
 	struct v4l2_device *v4l2_dev = dev_get_drvdata(dev_d);
 	struct cx88sdr_dev *dev = container_of(v4l2_dev, struct cx88sdr_dev, v4l2_dev);
 
+	hrtimer_cancel(&dev->pos_timer);
 	cx88sdr_shutdown(dev);
 	return 0;
 }
@@ -444,17 +1181,14 @@ static int __maybe_unused cx88sdr_resume(struct device *dev_d)
 	cx88sdr_shutdown(dev);
 	cx88sdr_sram_setup(dev);
 	cx88sdr_adc_setup(dev);
-	ret = cx88sdr_adc_fmt_set(dev);
+	cx88sdr_audio_setup(dev);
+	ret = cx88sdr_adc_fmt_set(dev, false);
 	if (ret)
 		return ret;
 	cx88sdr_gain_set(dev);
 	cx88sdr_input_set(dev);
-	ctrl_iowrite32(dev, CX88SDR_VID_INT_MSK, CX88SDR_VID_INT_MSK_VAL);
-
-	mutex_lock(&dev->vopen_mlock);
-	if (dev->vopen)
-		ctrl_iowrite32(dev, CX88SDR_PCI_INT_MSK, CX88SDR_PCI_INT_MSK_VAL);
-	mutex_unlock(&dev->vopen_mlock);
+	cx88sdr_irq_unmask(dev);
+	cx88sdr_pos_timer_set(dev);
 	return 0;
 }
 
@@ -472,6 +1206,28 @@ static struct pci_driver cx88sdr_pci_driver = {
 	.probe		= cx88sdr_probe,
 	.remove		= cx88sdr_remove,
 	.driver.pm	= &cx88sdr_pm_ops,
+	/* Cards set up independently, a many-card host need not wait on each in turn */
+	.driver.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 };
 
-module_pci_driver(cx88sdr_pci_driver);
+static int __init cx88sdr_init(void)
+{
+	int ret;
+
+	ret = pci_register_driver(&cx88sdr_pci_driver);
+	if (ret)
+		return ret;
+	ret = cx88sdr_replay_init();
+	if (ret)
+		pci_unregister_driver(&cx88sdr_pci_driver);
+	return ret;
+}
+
+static void __exit cx88sdr_exit(void)
+{
+	cx88sdr_replay_exit();
+	pci_unregister_driver(&cx88sdr_pci_driver);
+}
+
+module_init(cx88sdr_init);
+module_exit(cx88sdr_exit);
@@ -0,0 +1,503 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * CX2388x SDR group node: the cards listed in the group parameter are also
+ * read through one more swradio node, one page of every card per frame.
+ * The node appears when the last card of the group is probed and goes away
+ * with the first one removed. Each handle holds a reference on the cards
+ * it was opened with, and reads and settings fail with ENODEV once one of
+ * them is being removed.
+ */
+
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/pci.h>
+#include <linux/rwsem.h>
+#include <linux/videodev2.h>
+#include <media/v4l2-dev.h>
+#include <media/v4l2-event.h>
+#include <media/v4l2-ioctl.h>
+
+#include "cx88_sdr.h"
+
+#define CX88SDR_GROUP_NAME		"CX2388x SDR Group"
+
+/* Lag from a card's DMA head past which its pages are dropped, one IRQ interval short of the ring */
+#define CX88SDR_GROUP_LAG_MAX		(CX88SDR_VBI_DMA_PAGES - CX88SDR_IRQ_PAGES_MAX)
+
+static int group[CX88SDR_MAX_CARDS];
+static unsigned int group_cards;
+
+/* A card listed twice would be read twice per frame, refuse to load */
+static int cx88sdr_group_set(const char *val, const struct kernel_param *kp)
+{
+	unsigned int i, j;
+	int ret;
+
+	ret = param_array_ops.set(val, kp);
+	if (ret)
+		return ret;
+	for (i = 0; i < group_cards; i++) {
+		for (j = 0; j < i; j++) {
+			if (group[i] == group[j]) {
+				pr_err(KBUILD_MODNAME ": card %d is in the group twice\n", group[i]);
+				group_cards = 0;
+				return -EINVAL;
+			}
+		}
+	}
+	return 0;
+}
+
+static int cx88sdr_group_get(char *buffer, const struct kernel_param *kp)
+{
+	return param_array_ops.get(buffer, kp);
+}
+
+static const struct kernel_param_ops cx88sdr_group_ops = {
+	.set	= cx88sdr_group_set,
+	.get	= cx88sdr_group_get,
+};
+
+static struct kparam_array cx88sdr_group_arr = {
+	.max		= CX88SDR_MAX_CARDS,
+	.elemsize	= sizeof(group[0]),
+	.num		= &group_cards,
+	.ops		= &param_ops_int,
+	.elem		= group,
+};
+module_param_cb(group, &cx88sdr_group_ops, &cx88sdr_group_arr, 0);
+__MODULE_PARM_TYPE(group, "array of int");
+MODULE_PARM_DESC(group, "Cards (in probe order) also read through one interleaved node, e.g. group=0,1");
+
+struct cx88sdr_group {
+	struct	v4l2_device		v4l2_dev;
+	struct	video_device		vdev;
+	struct	mutex			vdev_mlock;
+	struct	cx88sdr_dev		*cards[CX88SDR_MAX_CARDS];
+	u32				present;
+	/* Registered, or unregistered with handles still open */
+	bool				busy;
+};
+
+struct cx88sdr_group_fh {
+	struct v4l2_fh fh;
+	struct cx88sdr_dev *cards[CX88SDR_MAX_CARDS];
+	u64 spage[CX88SDR_MAX_CARDS];
+	u64 lost;
+};
+
+static struct cx88sdr_group cx88sdr_group;
+static DEFINE_MUTEX(cx88sdr_group_mlock);
+/* Held shared around ring copies and settings, a removed card waits them out */
+static DECLARE_RWSEM(cx88sdr_group_rwsem);
+
+static struct cx88sdr_group_fh *cx88sdr_group_fh(struct file *file)
+{
+	return container_of(file->private_data, struct cx88sdr_group_fh, fh);
+}
+
+/* One of the cards the handle was opened with is being removed */
+static bool cx88sdr_group_gone(struct cx88sdr_group_fh *fh)
+{
+	u32 i;
+
+	for (i = 0; i < group_cards; i++) {
+		if (READ_ONCE(fh->cards[i]->removing))
+			return true;
+	}
+	return false;
+}
+
+static int cx88sdr_group_open(struct file *file)
+{
+	struct video_device *vdev = video_devdata(file);
+	struct cx88sdr_group *grp = container_of(vdev, struct cx88sdr_group, vdev);
+	struct cx88sdr_group_fh *fh;
+	unsigned long flags;
+	u32 i;
+
+	fh = kzalloc(sizeof(*fh), GFP_KERNEL);
+	if (!fh)
+		return -ENOMEM;
+
+	mutex_lock(&cx88sdr_group_mlock);
+	if (!video_is_registered(vdev)) {
+		mutex_unlock(&cx88sdr_group_mlock);
+		kfree(fh);
+		return -ENODEV;
+	}
+	for (i = 0; i < group_cards; i++) {
+		fh->cards[i] = grp->cards[i];
+		cx88sdr_dev_get(fh->cards[i]);
+	}
+
+	/* Fold every counter back to back, frame 0 is where each card is now */
+	local_irq_save(flags);
+	for (i = 0; i < group_cards; i++)
+		fh->spage[i] = cx88sdr_dma_update(fh->cards[i]);
+	local_irq_restore(flags);
+	mutex_unlock(&cx88sdr_group_mlock);
+
+	v4l2_fh_init(&fh->fh, vdev);
+	file->private_data = &fh->fh;
+	v4l2_fh_add(&fh->fh);
+	return 0;
+}
+
+static int cx88sdr_group_release(struct file *file)
+{
+	struct cx88sdr_group_fh *fh = cx88sdr_group_fh(file);
+	u32 i;
+
+	v4l2_fh_del(&fh->fh);
+	v4l2_fh_exit(&fh->fh);
+	for (i = 0; i < group_cards; i++)
+		cx88sdr_dev_put(fh->cards[i]);
+	kfree(fh);
+	return 0;
+}
+
+/*
+ * Checked at every frame start: when any card is about to lap the reader,
+ * skip whole frames on all of them so they stay aligned.
+ */
+static void cx88sdr_group_catch_up(struct cx88sdr_group_fh *fh, u64 frame)
+{
+	s64 lag, lag_max = 0;
+	u64 skip;
+	u32 i;
+
+	for (i = 0; i < group_cards; i++) {
+		lag = cx88sdr_dma_head(fh->cards[i]) - (fh->spage[i] + frame);
+		lag_max = max(lag_max, lag);
+	}
+	if (lag_max <= CX88SDR_GROUP_LAG_MAX)
+		return;
+
+	skip = lag_max - CX88SDR_IRQ_PAGES_MAX;
+	for (i = 0; i < group_cards; i++)
+		fh->spage[i] += skip;
+	fh->lost += skip;
+}
+
+static ssize_t cx88sdr_group_read(struct file *file, char __user *buf, size_t size,
+				  loff_t *pos)
+{
+	struct cx88sdr_group_fh *fh = cx88sdr_group_fh(file);
+	ssize_t result = 0;
+	int ret;
+
+	while (size) {
+		struct cx88sdr_dev *dev;
+		u64 frame, page, mask_start, mask_end;
+		u32 card, len;
+
+		if (cx88sdr_group_gone(fh))
+			return -ENODEV;
+
+		frame = div_u64_rem(*pos >> PAGE_SHIFT, group_cards, &card);
+		if (!card && !(*pos % PAGE_SIZE))
+			cx88sdr_group_catch_up(fh, frame);
+
+		dev = fh->cards[card];
+		page = fh->spage[card] + frame;
+		cx88sdr_dma_head_saved(dev);
+		if (cx88sdr_dma_head(dev) <= page) {
+			if (file->f_flags & O_NONBLOCK)
+				break;
+			ret = wait_event_interruptible(dev->dma_wq, cx88sdr_dma_head(dev) > page ||
+						       READ_ONCE(dev->removing));
+			if (ret)
+				return (result) ? result : ret;
+			continue;
+		}
+
+		len = PAGE_SIZE - (*pos % PAGE_SIZE);
+		if (len > size)
+			len = size;
+
+		/* The ring is freed after remove has taken the lock for writing */
+		down_read(&cx88sdr_group_rwsem);
+		if (cx88sdr_group_gone(fh)) {
+			up_read(&cx88sdr_group_rwsem);
+			return -ENODEV;
+		}
+		cx88sdr_mask_get(dev, &mask_start, &mask_end);
+		ret = copy_to_user(buf, cx88sdr_page_src(dev, page, mask_start, mask_end) +
+				   (*pos % PAGE_SIZE), len);
+		up_read(&cx88sdr_group_rwsem);
+		if (ret)
+			return -EFAULT;
+
+		result += len;
+		buf    += len;
+		*pos   += len;
+		size   -= len;
+	}
+
+	if (!result && size)
+		return -EAGAIN;
+
+	return result;
+}
+
+/* Readable when every card has the current frame, hung up once one is removed */
+static __poll_t cx88sdr_group_poll(struct file *file, struct poll_table_struct *wait)
+{
+	struct cx88sdr_group_fh *fh = cx88sdr_group_fh(file);
+	u64 frame = div_u64(file->f_pos >> PAGE_SHIFT, group_cards);
+	__poll_t res = EPOLLIN | EPOLLRDNORM;
+	u32 i;
+
+	for (i = 0; i < group_cards; i++) {
+		poll_wait(file, &fh->cards[i]->dma_wq, wait);
+		cx88sdr_dma_head_saved(fh->cards[i]);
+		if (cx88sdr_dma_head(fh->cards[i]) <= fh->spage[i] + frame)
+			res = 0;
+	}
+	if (cx88sdr_group_gone(fh))
+		res = EPOLLERR | EPOLLHUP;
+	return res;
+}
+
+static long cx88sdr_group_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct cx88sdr_group_fh *fh = cx88sdr_group_fh(file);
+	void __user *uarg = (void __user *)arg;
+
+	switch (cmd) {
+	case CX88SDR_IOC_G_GROUP: {
+		struct cx88sdr_group_pos *p;
+		u64 frame;
+		u32 card, i;
+		long ret = 0;
+
+		BUILD_BUG_ON(CX88SDR_MAX_CARDS > CX88SDR_GROUP_MAX);
+
+		p = kzalloc(sizeof(*p), GFP_KERNEL);
+		if (!p)
+			return -ENOMEM;
+
+		frame = div_u64_rem(file->f_pos >> PAGE_SHIFT, group_cards, &card);
+		p->cards = group_cards;
+		p->frame = frame;
+		p->lost = fh->lost;
+		for (i = 0; i < group_cards; i++) {
+			/* Cards before the current one in this frame have been read */
+			p->card[i].read = (fh->spage[i] + frame + (i < card)) << PAGE_SHIFT;
+			if (i == card)
+				p->card[i].read += file->f_pos % PAGE_SIZE;
+			p->card[i].write = cx88sdr_dma_head(fh->cards[i]) << PAGE_SHIFT;
+			cx88sdr_dma_head_saved(fh->cards[i]);
+			p->card[i].size = CX88SDR_VBI_DMA_SIZE;
+		}
+		if (copy_to_user(uarg, p, sizeof(*p)))
+			ret = -EFAULT;
+		kfree(p);
+		return ret;
+	}
+	default:
+		return video_ioctl2(file, cmd, arg);
+	}
+}
+
+static const struct v4l2_file_operations cx88sdr_group_fops = {
+	.owner		= THIS_MODULE,
+	.open		= cx88sdr_group_open,
+	.release	= cx88sdr_group_release,
+	.read		= cx88sdr_group_read,
+	.poll		= cx88sdr_group_poll,
+	.unlocked_ioctl	= cx88sdr_group_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl32	= cx88sdr_compat_ioctl32,
+#endif
+};
+
+static int cx88sdr_group_querycap(struct file __always_unused *file,
+				  void __always_unused *priv,
+				  struct v4l2_capability *cap)
+{
+	strscpy(cap->bus_info, "platform:" KBUILD_MODNAME "-group", sizeof(cap->bus_info));
+	strscpy(cap->card, CX88SDR_GROUP_NAME, sizeof(cap->card));
+	strscpy(cap->driver, KBUILD_MODNAME, sizeof(cap->driver));
+	return 0;
+}
+
+/* One frame of whole pages, the format and the rate are the first card's */
+static int cx88sdr_group_g_fmt_sdr(struct file *file, void *priv, struct v4l2_format *f)
+{
+	int ret = cx88sdr_g_fmt_sdr(file, priv, f);
+
+	f->fmt.sdr.buffersize = group_cards * PAGE_SIZE;
+	return ret;
+}
+
+static int cx88sdr_group_try_fmt_sdr(struct file *file, void *priv, struct v4l2_format *f)
+{
+	int ret = cx88sdr_try_fmt_sdr(file, priv, f);
+
+	f->fmt.sdr.buffersize = group_cards * PAGE_SIZE;
+	return ret;
+}
+
+/* Settings go to every card, each under its own node's lock */
+static int cx88sdr_group_s_fmt_sdr(struct file *file, void *priv, struct v4l2_format *f)
+{
+	struct cx88sdr_group_fh *fh = cx88sdr_group_fh(file);
+	int ret = 0;
+	u32 i;
+
+	cx88sdr_group_try_fmt_sdr(file, priv, f);
+	down_read(&cx88sdr_group_rwsem);
+	if (cx88sdr_group_gone(fh))
+		ret = -ENODEV;
+	for (i = 0; i < group_cards && !ret; i++) {
+		struct cx88sdr_dev *dev = fh->cards[i];
+
+		mutex_lock(&dev->vdev_mlock);
+		ret = cx88sdr_fmt_set(dev, f->fmt.sdr.pixelformat);
+		mutex_unlock(&dev->vdev_mlock);
+	}
+	up_read(&cx88sdr_group_rwsem);
+	return ret;
+}
+
+static int cx88sdr_group_s_frequency(struct file *file, void __always_unused *priv,
+				     const struct v4l2_frequency *f)
+{
+	struct cx88sdr_group_fh *fh = cx88sdr_group_fh(file);
+	int ret = 0;
+	u32 i;
+
+	if (f->tuner > 0 || f->type != V4L2_TUNER_SDR)
+		return -EINVAL;
+
+	down_read(&cx88sdr_group_rwsem);
+	if (cx88sdr_group_gone(fh))
+		ret = -ENODEV;
+	for (i = 0; i < group_cards && !ret; i++) {
+		struct cx88sdr_dev *dev = fh->cards[i];
+
+		mutex_lock(&dev->vdev_mlock);
+		ret = cx88sdr_freq_set(dev, f->frequency);
+		mutex_unlock(&dev->vdev_mlock);
+	}
+	up_read(&cx88sdr_group_rwsem);
+	return ret;
+}
+
+static const struct v4l2_ioctl_ops cx88sdr_group_ioctl_ops = {
+	.vidioc_querycap		= cx88sdr_group_querycap,
+	.vidioc_enum_fmt_sdr_cap	= cx88sdr_enum_fmt_sdr,
+	.vidioc_try_fmt_sdr_cap		= cx88sdr_group_try_fmt_sdr,
+	.vidioc_g_fmt_sdr_cap		= cx88sdr_group_g_fmt_sdr,
+	.vidioc_s_fmt_sdr_cap		= cx88sdr_group_s_fmt_sdr,
+	.vidioc_g_tuner			= cx88sdr_g_tuner,
+	.vidioc_s_tuner			= cx88sdr_s_tuner,
+	.vidioc_enum_freq_bands		= cx88sdr_enum_freq_bands,
+	.vidioc_g_frequency		= cx88sdr_g_frequency,
+	.vidioc_s_frequency		= cx88sdr_group_s_frequency,
+};
+
+/* The last handle is gone, may run under cx88sdr_group_mlock */
+static void cx88sdr_group_vdev_release(struct video_device *vdev)
+{
+	struct cx88sdr_group *grp = container_of(vdev, struct cx88sdr_group, vdev);
+
+	WRITE_ONCE(grp->busy, false);
+}
+
+static const struct video_device cx88sdr_group_template = {
+	.device_caps	= (V4L2_CAP_SDR_CAPTURE | V4L2_CAP_TUNER |
+			   V4L2_CAP_READWRITE),
+	.fops		= &cx88sdr_group_fops,
+	.ioctl_ops	= &cx88sdr_group_ioctl_ops,
+	.name		= CX88SDR_GROUP_NAME,
+	.release	= cx88sdr_group_vdev_release,
+};
+
+/* Called with cx88sdr_group_mlock held */
+static void cx88sdr_group_register(struct cx88sdr_group *grp)
+{
+	int ret;
+
+	/* The node is static, it can't come back before the last old handle is closed */
+	if (READ_ONCE(grp->busy)) {
+		pr_warn(KBUILD_MODNAME ": group node still open, not registered again\n");
+		return;
+	}
+
+	strscpy(grp->v4l2_dev.name, CX88SDR_GROUP_NAME, sizeof(grp->v4l2_dev.name));
+	ret = v4l2_device_register(NULL, &grp->v4l2_dev);
+	if (ret)
+		goto err;
+
+	mutex_init(&grp->vdev_mlock);
+	grp->vdev = cx88sdr_group_template;
+	grp->vdev.lock = &grp->vdev_mlock;
+	grp->vdev.v4l2_dev = &grp->v4l2_dev;
+	/* The shared format and tuner ioctls report the first card */
+	video_set_drvdata(&grp->vdev, grp->cards[0]);
+
+	ret = video_register_device(&grp->vdev, VFL_TYPE_SDR, -1);
+	if (ret) {
+		v4l2_device_unregister(&grp->v4l2_dev);
+		goto err;
+	}
+	WRITE_ONCE(grp->busy, true);
+	pr_info(KBUILD_MODNAME ": group of %u cards registered as %s\n",
+		group_cards, video_device_node_name(&grp->vdev));
+	return;
+err:
+	pr_err(KBUILD_MODNAME ": can't register group node: %d\n", ret);
+}
+
+void cx88sdr_group_add(struct cx88sdr_dev *dev)
+{
+	struct cx88sdr_group *grp = &cx88sdr_group;
+	bool member = false;
+	u32 i;
+
+	if (group_cards < 2)
+		return;
+
+	mutex_lock(&cx88sdr_group_mlock);
+	for (i = 0; i < group_cards; i++) {
+		if (group[i] == dev->nr && !grp->cards[i]) {
+			grp->cards[i] = dev;
+			grp->present++;
+			member = true;
+		}
+	}
+	if (member && grp->present == group_cards)
+		cx88sdr_group_register(grp);
+	mutex_unlock(&cx88sdr_group_mlock);
+}
+
+void cx88sdr_group_del(struct cx88sdr_dev *dev)
+{
+	struct cx88sdr_group *grp = &cx88sdr_group;
+	bool member = false;
+	u32 i;
+
+	mutex_lock(&cx88sdr_group_mlock);
+	for (i = 0; i < group_cards; i++)
+		member |= (grp->cards[i] == dev);
+	if (member && video_is_registered(&grp->vdev)) {
+		cx88sdr_pr_info("removing group node %s\n", video_device_node_name(&grp->vdev));
+		video_unregister_device(&grp->vdev);
+		v4l2_device_unregister(&grp->v4l2_dev);
+		/* dev->removing is set: copies and settings started before are done after this */
+		down_write(&cx88sdr_group_rwsem);
+		up_write(&cx88sdr_group_rwsem);
+	}
+	for (i = 0; i < group_cards; i++) {
+		if (grp->cards[i] == dev) {
+			grp->cards[i] = NULL;
+			grp->present--;
+		}
+	}
+	mutex_unlock(&cx88sdr_group_mlock);
+}
@@ -0,0 +1,287 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Replay cards: swradio nodes with the formats, controls, ring, read(),
+ * poll(), mmap() and private ioctls of a card, whose samples come from
+ * write() instead of DMA. A recording written back plays to any client as
+ * if it were captured live, paced at its sample rate or as fast as the
+ * writer goes.
+ */
+
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/sched/signal.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <media/v4l2-dev.h>
+#include <media/v4l2-ioctl.h>
+
+#include "cx88_sdr.h"
+
+#define CX88SDR_REPLAY_NAME		"CX2388x SDR Replay"
+#define CX88SDR_REPLAY_MAX		4
+#define CX88SDR_REPLAY_SPEED_DEF	100	/* Percent of the sample rate */
+#define CX88SDR_REPLAY_SPEED_MAX	10000
+/* A writer this far behind its schedule starts a new one rather than catch up */
+#define CX88SDR_REPLAY_LATE_NS		(100 * NSEC_PER_MSEC)
+
+static unsigned int replay;
+module_param(replay, uint, 0444);
+MODULE_PARM_DESC(replay, "Number of replay cards, fed by write(), up to 4");
+
+struct cx88sdr_replay {
+	/* Serialises writers */
+	struct	mutex			lock;
+	/* Stream position of the next byte written, and pages published */
+	u64				pos;
+	u64				head;
+	/* Speed control, and the schedule: pos0 is due at t0, then byte_rate * speed */
+	u32				speed;
+	u32				sched_speed;
+	u64				sched_rate;
+	u64				pos0;
+	u64				t0;
+};
+
+static struct cx88sdr_dev *cx88sdr_replay_cards[CX88SDR_REPLAY_MAX];
+
+const struct v4l2_ctrl_config cx88sdr_ctrl_replay_speed = {
+	.ops	= &cx88sdr_ctrl_ops,
+	.id	= V4L2_CID_CX88SDR_REPLAY_SPEED,
+	.name	= "Replay Speed %",
+	.type	= V4L2_CTRL_TYPE_INTEGER,
+	.min	= 0,
+	.max	= CX88SDR_REPLAY_SPEED_MAX,
+	.step	= 1,
+	.def	= CX88SDR_REPLAY_SPEED_DEF,
+};
+
+/* Called from s_ctrl, the next write() starts a new schedule */
+void cx88sdr_replay_speed_set(struct cx88sdr_dev *dev, u32 speed)
+{
+	WRITE_ONCE(dev->replay->speed, speed);
+}
+
+/*
+ * Sleep until the stream position end is due. Returns -EAGAIN if it isn't
+ * yet and the file is non-blocking, -ERESTARTSYS on a signal.
+ */
+static int cx88sdr_replay_pace(struct cx88sdr_dev *dev, u64 end, bool nonblock)
+{
+	struct cx88sdr_replay *rp = dev->replay;
+	u32 speed = READ_ONCE(rp->speed);
+	u64 byte_rate = READ_ONCE(dev->byte_rate);
+	u64 now = ktime_get_ns(), due, rate, secs, rem;
+	ktime_t expires;
+
+	if (!speed || !byte_rate)
+		return 0;
+
+	if (speed != rp->sched_speed || byte_rate != rp->sched_rate) {
+		rp->sched_speed = speed;
+		rp->sched_rate = byte_rate;
+		rp->pos0 = rp->pos;
+		rp->t0 = now;
+	}
+
+	/* In two steps: (end - pos0) * NSEC_PER_SEC overflows after a few hundred MB */
+	rate = div_u64(byte_rate * speed, CX88SDR_REPLAY_SPEED_DEF);
+	secs = div64_u64_rem(end - rp->pos0, rate, &rem);
+	due = rp->t0 + secs * NSEC_PER_SEC + div64_u64(rem * NSEC_PER_SEC, rate);
+
+	if (now > due + CX88SDR_REPLAY_LATE_NS) {
+		rp->pos0 = rp->pos;
+		rp->t0 = now;
+		return 0;
+	}
+	if (due <= now)
+		return 0;
+	if (nonblock)
+		return -EAGAIN;
+
+	expires = ns_to_ktime(due);
+	while (ktime_get_ns() < due) {
+		if (signal_pending(current))
+			return -ERESTARTSYS;
+		set_current_state(TASK_INTERRUPTIBLE);
+		schedule_hrtimeout_range(&expires, 50 * NSEC_PER_USEC, HRTIMER_MODE_ABS);
+	}
+	return 0;
+}
+
+/* Complete pages become readable, as on a RISC interrupt */
+static void cx88sdr_replay_publish(struct cx88sdr_dev *dev)
+{
+	struct cx88sdr_replay *rp = dev->replay;
+	u64 head = rp->pos >> PAGE_SHIFT;
+
+	if (head == rp->head)
+		return;
+	rp->head = head;
+	cx88sdr_dma_set_head(dev, head);
+	wake_up_interruptible(&dev->dma_wq);
+}
+
+/*
+ * Copy samples into the ring at the stream position, publishing every
+ * irq_pages pages like the RISC program would, and what is left at the
+ * end of the call. The stream carries on across opens; as with DMA,
+ * writers never wait for readers.
+ */
+ssize_t cx88sdr_replay_write(struct cx88sdr_dev *dev, const char __user *buf, size_t size,
+			     bool nonblock)
+{
+	struct cx88sdr_replay *rp = dev->replay;
+	ssize_t done = 0;
+	int ret = 0;
+
+	if (mutex_lock_interruptible(&rp->lock))
+		return -ERESTARTSYS;
+
+	while (size) {
+		u64 end = (rp->head + READ_ONCE(dev->vctrl.irq_pages)) << PAGE_SHIFT;
+		size_t len = min_t(u64, size, end - rp->pos);
+
+		ret = cx88sdr_replay_pace(dev, rp->pos + len, nonblock);
+		if (ret)
+			break;
+
+		while (len) {
+			u32 page = (rp->pos >> PAGE_SHIFT) & (CX88SDR_VBI_DMA_PAGES - 1);
+			size_t off = rp->pos % PAGE_SIZE;
+			size_t n = min_t(size_t, len, PAGE_SIZE - off);
+
+			if (copy_from_user(dev->dma_buf_pages[page] + off, buf, n)) {
+				ret = -EFAULT;
+				goto out;
+			}
+			rp->pos += n;
+			buf     += n;
+			len     -= n;
+			size    -= n;
+			done    += n;
+		}
+		if (rp->pos >= end)
+			cx88sdr_replay_publish(dev);
+	}
+out:
+	cx88sdr_replay_publish(dev);
+	mutex_unlock(&rp->lock);
+	return (done) ? done : ret;
+}
+
+static int cx88sdr_replay_add(int nr)
+{
+	struct cx88sdr_dev *dev;
+	int ret = -ENOMEM;
+
+	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+	if (!dev)
+		return -ENOMEM;
+	if (cx88sdr_dev_init(dev))
+		goto free_dev;
+	dev->replay = kzalloc(sizeof(*dev->replay), GFP_KERNEL);
+	if (!dev->replay)
+		goto free_dev;
+
+	dev->nr = nr;
+	INIT_LIST_HEAD(&dev->list);
+	mutex_init(&dev->replay->lock);
+	dev->replay->speed = CX88SDR_REPLAY_SPEED_DEF;
+	snprintf(dev->name, sizeof(dev->name), CX88SDR_REPLAY_NAME " [%d]", nr);
+
+	ret = cx88sdr_alloc_dma_buffer(dev);
+	if (ret) {
+		cx88sdr_pr_err("can't alloc ring\n");
+		goto free_dev;
+	}
+	/* Sets the byte rate write() is paced at */
+	ret = cx88sdr_adc_fmt_set(dev, false);
+	if (ret)
+		goto free_ring;
+
+	strscpy(dev->v4l2_dev.name, dev->name, sizeof(dev->v4l2_dev.name));
+	ret = v4l2_device_register(NULL, &dev->v4l2_dev);
+	if (ret)
+		goto free_ring;
+
+	ret = cx88sdr_ctrl_init(dev);
+	if (ret) {
+		v4l2_err(&dev->v4l2_dev, "can't register V4L2 controls\n");
+		goto free_v4l2;
+	}
+
+	dev->vdev = cx88sdr_template;
+	strscpy(dev->vdev.name, CX88SDR_REPLAY_NAME, sizeof(dev->vdev.name));
+	dev->vdev.ctrl_handler = &dev->ctrl_handler;
+	dev->vdev.lock = &dev->vdev_mlock;
+	dev->vdev.v4l2_dev = &dev->v4l2_dev;
+	video_set_drvdata(&dev->vdev, dev);
+
+	ret = video_register_device(&dev->vdev, VFL_TYPE_SDR, -1);
+	if (ret)
+		goto free_v4l2;
+
+	cx88sdr_pr_info("registered as %s\n", video_device_node_name(&dev->vdev));
+	cx88sdr_replay_cards[nr] = dev;
+	return 0;
+
+free_v4l2:
+	v4l2_ctrl_handler_free(&dev->ctrl_handler);
+	v4l2_device_unregister(&dev->v4l2_dev);
+free_ring:
+	cx88sdr_free_dma_buffer(dev);
+free_dev:
+	kfree(dev->replay);
+	cx88sdr_dev_put(dev);
+	return ret;
+}
+
+static void cx88sdr_replay_del(struct cx88sdr_dev *dev)
+{
+	WRITE_ONCE(dev->removing, true);
+	cx88sdr_pr_info("removing %s\n", video_device_node_name(&dev->vdev));
+
+	video_unregister_device(&dev->vdev);
+	v4l2_ctrl_handler_free(&dev->ctrl_handler);
+	v4l2_device_unregister(&dev->v4l2_dev);
+	hrtimer_cancel(&dev->pos_timer);
+	cx88sdr_free_dma_buffer(dev);
+	kfree(dev->replay);
+	/* A group handle may still hold the card */
+	cx88sdr_dev_put(dev);
+}
+
+int cx88sdr_replay_init(void)
+{
+	unsigned int i, n = min_t(unsigned int, replay, CX88SDR_REPLAY_MAX);
+	int ret;
+
+	if (replay > n)
+		pr_warn(KBUILD_MODNAME ": %u replay cards requested, %u made\n", replay, n);
+
+	for (i = 0; i < n; i++) {
+		ret = cx88sdr_replay_add(i);
+		if (ret) {
+			pr_err(KBUILD_MODNAME ": can't add replay card %u: %d\n", i, ret);
+			cx88sdr_replay_exit();
+			return ret;
+		}
+	}
+	return 0;
+}
+
+void cx88sdr_replay_exit(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < CX88SDR_REPLAY_MAX; i++) {
+		if (cx88sdr_replay_cards[i]) {
+			cx88sdr_replay_del(cx88sdr_replay_cards[i]);
+			cx88sdr_replay_cards[i] = NULL;
+		}
+	}
+}
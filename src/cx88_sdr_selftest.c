@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * PCI DMA self-test and latency timer tuning, run from selftest/ in sysfs.
+ * A test watches DMA for a window: the rate the ring fills at against the
+ * configured one, and the FIFO overflows and errors meanwhile. It only
+ * reads what the IRQ thread keeps, so every card on the bus is measured
+ * at once while the others go on streaming. The card list is not locked
+ * meanwhile: a card removed during a test ends it with ENODEV.
+ */
+
+#include <linux/delay.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/pci.h>
+#include <linux/slab.h>
+
+#include "cx88_sdr.h"
+
+#define CX88SDR_SELFTEST_MS_DEF		1000
+#define CX88SDR_SELFTEST_MS_MAX		60000
+#define CX88SDR_TUNE_MS_DEF		250
+/* Sleep slice between checks for a removed card */
+#define CX88SDR_SELFTEST_SLICE_MS	100
+/* A card short of its configured rate by more than 1/200 lost samples */
+#define CX88SDR_SELFTEST_SHORT		200
+
+static const u8 cx88sdr_lat_steps[] = { 32, 64, 96, 128, 160, 192, 224, 248 };
+
+/* One test or tuning at a time, they would skew each other's windows */
+static DEFINE_MUTEX(cx88sdr_selftest_mlock);
+
+struct cx88sdr_snap {
+	u64	head;
+	u64	head_ns;
+	u64	overflows;
+	u64	errors;
+};
+
+static u64 cx88sdr_errors(struct cx88sdr_dev *dev)
+{
+	return READ_ONCE(dev->stats.sync_errors) + READ_ONCE(dev->stats.risc_errors) +
+	       READ_ONCE(dev->stats.pci_errors);
+}
+
+/*
+ * Head and head time both come from the last interrupt or position poll,
+ * the rate between two of them is exact to the interrupt latency. The
+ * time is monotonic, a clock step can't skew the rate.
+ */
+static void cx88sdr_snap(struct cx88sdr_dev *dev, struct cx88sdr_snap *s)
+{
+	s->head = cx88sdr_dma_head_mono(dev, &s->head_ns);
+	s->overflows = READ_ONCE(dev->stats.fifo_overflows);
+	s->errors = cx88sdr_errors(dev);
+}
+
+static bool cx88sdr_any_removing(struct cx88sdr_dev **cards, u32 n)
+{
+	u32 i;
+
+	for (i = 0; i < n; i++) {
+		if (READ_ONCE(cards[i]->removing))
+			return true;
+	}
+	return false;
+}
+
+/* Sleep ms, or less when a card is being removed or a signal comes */
+static int cx88sdr_window(struct cx88sdr_dev **cards, u32 n, u32 ms)
+{
+	u32 slice;
+
+	while (ms) {
+		if (cx88sdr_any_removing(cards, n))
+			return -ENODEV;
+		slice = min_t(u32, ms, CX88SDR_SELFTEST_SLICE_MS);
+		if (msleep_interruptible(slice))
+			return -EINTR;
+		ms -= slice;
+	}
+	return (cx88sdr_any_removing(cards, n)) ? -ENODEV : 0;
+}
+
+/* Watch cards for ms, the results go to each card's selftest */
+static int cx88sdr_measure(struct cx88sdr_dev **cards, u32 n, u32 ms)
+{
+	struct cx88sdr_snap *s0, s1;
+	u32 i;
+	int ret;
+
+	s0 = kcalloc(n, sizeof(*s0), GFP_KERNEL);
+	if (!s0)
+		return -ENOMEM;
+
+	for (i = 0; i < n; i++)
+		cx88sdr_snap(cards[i], &s0[i]);
+	ret = cx88sdr_window(cards, n, ms);
+	if (ret) {
+		kfree(s0);
+		return ret;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct cx88sdr_selftest *t = &cards[i]->selftest;
+
+		cx88sdr_snap(cards[i], &s1);
+		t->window_ms = ms;
+		t->latency = cards[i]->pci_lat;
+		t->expected = cards[i]->byte_rate;
+		t->rate = (s1.head_ns > s0[i].head_ns) ?
+			  div64_u64((s1.head - s0[i].head) * PAGE_SIZE * NSEC_PER_SEC,
+				    s1.head_ns - s0[i].head_ns) : 0;
+		t->overflows = s1.overflows - s0[i].overflows;
+		t->errors = s1.errors - s0[i].errors;
+	}
+	kfree(s0);
+	return 0;
+}
+
+static bool cx88sdr_short(const struct cx88sdr_selftest *t)
+{
+	return t->rate + div_u64(t->expected, CX88SDR_SELFTEST_SHORT) < t->expected;
+}
+
+/* Faults, and cards short of their rate, across the bus in the last window */
+static u64 cx88sdr_bus_faults(struct cx88sdr_dev **cards, u32 n)
+{
+	u64 faults = 0;
+	u32 i;
+
+	for (i = 0; i < n; i++)
+		faults += cards[i]->selftest.overflows + cards[i]->selftest.errors +
+			  cx88sdr_short(&cards[i]->selftest);
+	return faults;
+}
+
+/*
+ * Measure the sustained DMA rate and the faults of one card over ms, 0 for
+ * the default window.
+ */
+int cx88sdr_selftest_run(struct cx88sdr_dev *dev, u32 ms)
+{
+	struct cx88sdr_selftest *t = &dev->selftest;
+	int ret;
+
+	ms = (ms) ? min_t(u32, ms, CX88SDR_SELFTEST_MS_MAX) : CX88SDR_SELFTEST_MS_DEF;
+	if (mutex_lock_interruptible(&cx88sdr_selftest_mlock))
+		return -EINTR;
+	ret = cx88sdr_measure(&dev, 1, ms);
+	mutex_unlock(&cx88sdr_selftest_mlock);
+	if (ret)
+		return ret;
+
+	cx88sdr_pr_info("self-test: %llu of %llu B/s in %u ms, %llu FIFO overflows, "
+			"%llu errors, latency timer %u\n", t->rate, t->expected, t->window_ms,
+			t->overflows, t->errors, t->latency);
+	return 0;
+}
+
+/*
+ * Pick a latency timer for card i with the others held: every step is
+ * measured across the bus. Of the steps without faults the one farthest
+ * from a step with faults leaves the most headroom, larger on a tie. With
+ * no faults at any step there is nothing to go by and the value stays.
+ */
+static int cx88sdr_tune_card(struct cx88sdr_dev **cards, u32 n, u32 i, u32 ms)
+{
+	struct cx88sdr_dev *dev = cards[i];
+	u64 faults[ARRAY_SIZE(cx88sdr_lat_steps)];
+	int orig = dev->pci_lat, best = -1, best_dist = -1;
+	u32 k, j;
+	int ret;
+
+	for (k = 0; k < ARRAY_SIZE(cx88sdr_lat_steps); k++) {
+		cx88sdr_pci_lat_set(dev, cx88sdr_lat_steps[k]);
+		ret = cx88sdr_measure(cards, n, ms);
+		if (ret) {
+			/* Leave a card on its way out alone */
+			if (!READ_ONCE(dev->removing))
+				cx88sdr_pci_lat_set(dev, orig);
+			return ret;
+		}
+		faults[k] = cx88sdr_bus_faults(cards, n);
+		cx88sdr_pr_info("tune: latency timer %u, %llu faults on the bus\n",
+				dev->pci_lat, faults[k]);
+	}
+
+	for (k = 0; k < ARRAY_SIZE(cx88sdr_lat_steps); k++) {
+		int dist = ARRAY_SIZE(cx88sdr_lat_steps);
+
+		if (faults[k])
+			continue;
+		for (j = 0; j < ARRAY_SIZE(cx88sdr_lat_steps); j++) {
+			if (faults[j])
+				dist = min_t(int, dist, abs((int)j - (int)k));
+		}
+		if (dist >= best_dist) {
+			best_dist = dist;
+			best = k;
+		}
+	}
+	if (best_dist == ARRAY_SIZE(cx88sdr_lat_steps)) {
+		cx88sdr_pci_lat_set(dev, orig);
+	} else if (best >= 0) {
+		cx88sdr_pci_lat_set(dev, cx88sdr_lat_steps[best]);
+	} else {
+		/* Faults at every step, the fewest then */
+		for (k = best = 0; k < ARRAY_SIZE(cx88sdr_lat_steps); k++) {
+			if (faults[k] <= faults[best])
+				best = k;
+		}
+		cx88sdr_pci_lat_set(dev, cx88sdr_lat_steps[best]);
+	}
+	dev->selftest.tuned = dev->pci_lat;
+	cx88sdr_pr_info("tune: latency timer %u%s\n", dev->pci_lat,
+			(best_dist == ARRAY_SIZE(cx88sdr_lat_steps)) ? ", no faults at any value" : "");
+	return 0;
+}
+
+static int cx88sdr_tune_bus(struct cx88sdr_dev **cards, u32 n, u32 ms)
+{
+	u32 i;
+	int ret;
+
+	for (i = 0; i < n; i++) {
+		ret = cx88sdr_tune_card(cards, n, i, ms);
+		if (ret)
+			return ret;
+	}
+
+	/* What the chosen values give, in every card's selftest/ */
+	ret = cx88sdr_measure(cards, n, ms);
+	if (ret)
+		return ret;
+	for (i = 0; i < n; i++) {
+		struct cx88sdr_dev *dev = cards[i];
+		struct cx88sdr_selftest *t = &dev->selftest;
+
+		cx88sdr_pr_info("tuned: latency timer %u, %llu of %llu B/s, %llu FIFO overflows, "
+				"%llu errors\n", t->latency, t->rate, t->expected, t->overflows,
+				t->errors);
+	}
+	return 0;
+}
+
+/* Set a latency timer from userspace, not while a test is measuring or tuning it */
+int cx88sdr_selftest_lat_set(struct cx88sdr_dev *dev, u32 val)
+{
+	if (mutex_lock_interruptible(&cx88sdr_selftest_mlock))
+		return -EINTR;
+	cx88sdr_pci_lat_set(dev, val);
+	mutex_unlock(&cx88sdr_selftest_mlock);
+	return 0;
+}
+
+/*
+ * Tune the latency timers of every card on dev's bus segment one card at a
+ * time, ms per step (0 for the default). Takes steps * cards + 1 windows.
+ */
+int cx88sdr_selftest_tune(struct cx88sdr_dev *dev, u32 ms)
+{
+	struct cx88sdr_dev **cards;
+	u32 n;
+	int ret;
+
+	ms = (ms) ? min_t(u32, ms, CX88SDR_SELFTEST_MS_MAX) : CX88SDR_TUNE_MS_DEF;
+	cards = kcalloc(CX88SDR_MAX_CARDS, sizeof(*cards), GFP_KERNEL);
+	if (!cards)
+		return -ENOMEM;
+	if (mutex_lock_interruptible(&cx88sdr_selftest_mlock)) {
+		kfree(cards);
+		return -EINTR;
+	}
+
+	n = cx88sdr_bus_peers_get(dev, cards);
+	ret = cx88sdr_tune_bus(cards, n, ms);
+	cx88sdr_bus_peers_put(cards, n);
+
+	mutex_unlock(&cx88sdr_selftest_mlock);
+	kfree(cards);
+	return ret;
+}
@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * CX2388x SDR driver statistics, exported under the PCI device:
+ * /sys/bus/pci/devices/<slot>/stats/
+ * /sys/bus/pci/devices/<slot>/pci_bus/
+ * /sys/bus/pci/devices/<slot>/selftest/
+ */
+
+#include <linux/pci.h>
+#include <linux/sysfs.h>
+
+#include "cx88_sdr.h"
+
+static struct cx88sdr_dev *to_cx88sdr_dev(struct device *d)
+{
+	struct v4l2_device *v4l2_dev = dev_get_drvdata(d);
+
+	return container_of(v4l2_dev, struct cx88sdr_dev, v4l2_dev);
+}
+
+static u64 cx88sdr_percpu_sum(u64 __percpu *cnt)
+{
+	u64 sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		sum += *per_cpu_ptr(cnt, cpu);
+	return sum;
+}
+
+#define CX88SDR_STAT_ATTR(_name, _val)						\
+static ssize_t _name##_show(struct device *d,					\
+			    struct device_attribute __always_unused *attr,	\
+			    char *buf)						\
+{										\
+	struct cx88sdr_dev *dev = to_cx88sdr_dev(d);				\
+										\
+	return sprintf(buf, "%llu\n", (unsigned long long)(_val));		\
+}										\
+static DEVICE_ATTR_RO(_name)
+
+CX88SDR_STAT_ATTR(irqs, dev->stats.irqs);
+CX88SDR_STAT_ATTR(irq_rate, dev->stats.irq_rate);
+CX88SDR_STAT_ATTR(risc_irqs, dev->stats.irqs_risci1);
+CX88SDR_STAT_ATTR(timer_polls, atomic64_read(&dev->stats.timer_polls));
+CX88SDR_STAT_ATTR(mmio_reads, atomic64_read(&dev->stats.mmio_reads));
+CX88SDR_STAT_ATTR(mmio_reads_saved, cx88sdr_percpu_sum(dev->stats.mmio_reads_saved));
+CX88SDR_STAT_ATTR(fifo_overflows, dev->stats.fifo_overflows);
+CX88SDR_STAT_ATTR(sync_errors, dev->stats.sync_errors);
+CX88SDR_STAT_ATTR(risc_errors, dev->stats.risc_errors);
+CX88SDR_STAT_ATTR(pci_errors, dev->stats.pci_errors);
+CX88SDR_STAT_ATTR(fault_position, dev->stats.fault_pos);
+CX88SDR_STAT_ATTR(dma_position, atomic64_read(&dev->dma_head) << PAGE_SHIFT);
+CX88SDR_STAT_ATTR(probe_us, div_u64(dev->probe_ns, NSEC_PER_USEC));
+CX88SDR_STAT_ATTR(ring_alloc_us, div_u64(dev->ring_ns, NSEC_PER_USEC));
+
+static struct attribute *cx88sdr_stats_attrs[] = {
+	&dev_attr_irqs.attr,
+	&dev_attr_irq_rate.attr,
+	&dev_attr_risc_irqs.attr,
+	&dev_attr_timer_polls.attr,
+	&dev_attr_mmio_reads.attr,
+	&dev_attr_mmio_reads_saved.attr,
+	&dev_attr_fifo_overflows.attr,
+	&dev_attr_sync_errors.attr,
+	&dev_attr_risc_errors.attr,
+	&dev_attr_pci_errors.attr,
+	&dev_attr_fault_position.attr,
+	&dev_attr_dma_position.attr,
+	&dev_attr_probe_us.attr,
+	&dev_attr_ring_alloc_us.attr,
+	NULL,
+};
+
+static const struct attribute_group cx88sdr_stats_group = {
+	.name	= "stats",
+	.attrs	= cx88sdr_stats_attrs,
+};
+
+static ssize_t bus_cards_show(struct device *d,
+			      struct device_attribute __always_unused *attr, char *buf)
+{
+	struct cx88sdr_dev *dev = to_cx88sdr_dev(d);
+	u32 cards;
+
+	cx88sdr_bus_load(dev, &cards);
+	return sprintf(buf, "%u\n", cards);
+}
+static DEVICE_ATTR_RO(bus_cards);
+
+static ssize_t bus_budget_show(struct device __always_unused *d,
+			       struct device_attribute __always_unused *attr, char *buf)
+{
+	return sprintf(buf, "%llu\n", cx88sdr_bus_budget());
+}
+static DEVICE_ATTR_RO(bus_budget);
+
+static ssize_t latency_timer_show(struct device *d,
+				  struct device_attribute __always_unused *attr, char *buf)
+{
+	struct cx88sdr_dev *dev = to_cx88sdr_dev(d);
+
+	return sprintf(buf, "%d\n", dev->pci_lat);
+}
+
+static ssize_t latency_timer_store(struct device *d,
+				   struct device_attribute __always_unused *attr,
+				   const char *buf, size_t count)
+{
+	struct cx88sdr_dev *dev = to_cx88sdr_dev(d);
+	u32 val;
+	int ret;
+
+	ret = kstrtou32(buf, 0, &val);
+	if (ret)
+		return ret;
+	ret = cx88sdr_selftest_lat_set(dev, val);
+	return (ret) ? ret : count;
+}
+static DEVICE_ATTR_RW(latency_timer);
+
+CX88SDR_STAT_ATTR(byte_rate, dev->byte_rate);
+CX88SDR_STAT_ATTR(bus_load, cx88sdr_bus_load(dev, NULL));
+
+static struct attribute *cx88sdr_bus_attrs[] = {
+	&dev_attr_byte_rate.attr,
+	&dev_attr_bus_load.attr,
+	&dev_attr_bus_budget.attr,
+	&dev_attr_bus_cards.attr,
+	&dev_attr_latency_timer.attr,
+	NULL,
+};
+
+static const struct attribute_group cx88sdr_bus_group = {
+	.name	= "pci_bus",
+	.attrs	= cx88sdr_bus_attrs,
+};
+
+/* Writing a window in ms (0 = default) runs it, the write returns when done */
+#define CX88SDR_SELFTEST_ATTR(_name, _fn)					\
+static ssize_t _name##_store(struct device *d,					\
+			     struct device_attribute __always_unused *attr,	\
+			     const char *buf, size_t count)			\
+{										\
+	struct cx88sdr_dev *dev = to_cx88sdr_dev(d);				\
+	u32 ms;									\
+	int ret;								\
+										\
+	ret = kstrtou32(buf, 0, &ms);						\
+	if (ret)								\
+		return ret;							\
+	ret = _fn(dev, ms);							\
+	return (ret) ? ret : count;						\
+}										\
+static DEVICE_ATTR_WO(_name)
+
+CX88SDR_SELFTEST_ATTR(run, cx88sdr_selftest_run);
+CX88SDR_SELFTEST_ATTR(tune, cx88sdr_selftest_tune);
+CX88SDR_STAT_ATTR(window_ms, dev->selftest.window_ms);
+CX88SDR_STAT_ATTR(test_latency_timer, dev->selftest.latency);
+CX88SDR_STAT_ATTR(tuned_latency_timer, dev->selftest.tuned);
+CX88SDR_STAT_ATTR(expected_rate, dev->selftest.expected);
+CX88SDR_STAT_ATTR(dma_rate, dev->selftest.rate);
+CX88SDR_STAT_ATTR(overflows, dev->selftest.overflows);
+CX88SDR_STAT_ATTR(errors, dev->selftest.errors);
+
+static struct attribute *cx88sdr_selftest_attrs[] = {
+	&dev_attr_run.attr,
+	&dev_attr_tune.attr,
+	&dev_attr_window_ms.attr,
+	&dev_attr_test_latency_timer.attr,
+	&dev_attr_tuned_latency_timer.attr,
+	&dev_attr_expected_rate.attr,
+	&dev_attr_dma_rate.attr,
+	&dev_attr_overflows.attr,
+	&dev_attr_errors.attr,
+	NULL,
+};
+
+static const struct attribute_group cx88sdr_selftest_group = {
+	.name	= "selftest",
+	.attrs	= cx88sdr_selftest_attrs,
+};
+
+static const struct attribute_group *cx88sdr_groups[] = {
+	&cx88sdr_stats_group,
+	&cx88sdr_bus_group,
+	&cx88sdr_selftest_group,
+	NULL,
+};
+
+int cx88sdr_sysfs_init(struct cx88sdr_dev *dev)
+{
+	return sysfs_create_groups(&dev->pdev->dev.kobj, cx88sdr_groups);
+}
+
+void cx88sdr_sysfs_exit(struct cx88sdr_dev *dev)
+{
+	sysfs_remove_groups(&dev->pdev->dev.kobj, cx88sdr_groups);
+}
@@ -0,0 +1,240 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later WITH Linux-syscall-note */
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * CX2388x SDR driver private userspace API, shared with userspace tools.
+ */
+
+#ifndef CX88SDR_UAPI_H
+#define CX88SDR_UAPI_H
+
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+/* Real formats */
+#ifndef V4L2_SDR_FMT_RU8
+#define V4L2_SDR_FMT_RU8		V4L2_SDR_FMT_CU8
+#endif
+#ifndef V4L2_SDR_FMT_RU16LE
+#define V4L2_SDR_FMT_RU16LE		V4L2_SDR_FMT_CU16LE
+#endif
+
+/* Reserve 16 controls for this driver */
+#ifndef V4L2_CID_USER_CX88SDR_BASE
+#define V4L2_CID_USER_CX88SDR_BASE	(V4L2_CID_USER_BASE + 0x1f10)
+#endif
+
+enum {
+	/* +6dB gain control (INIT_6DB_VAL) */
+	V4L2_CID_CX88SDR_GAIN_6DB	= (V4L2_CID_USER_CX88SDR_BASE + 0),
+	/* AGC Gain Adjust 3 */
+	V4L2_CID_CX88SDR_AGC_ADJ3,
+	/* AGC Sync Tip Adjust 3 */
+	V4L2_CID_CX88SDR_AGC_TIP3,
+	/* Pin input select (YADC_SEL) */
+	V4L2_CID_CX88SDR_INPUT,
+	/* PLL AFC (PLL_ADJ_EN) */
+	V4L2_CID_CX88SDR_AFC_PLL,
+	/* Enable vertical sync detection (VERTEN) */
+	V4L2_CID_CX88SDR_INPUT_VSYNC,
+	/* Total number of pixels per line */
+	V4L2_CID_CX88SDR_HTOTAL,
+	/* Ring pages per RISC interrupt */
+	V4L2_CID_CX88SDR_IRQ_PAGES,
+	/* DMA position poll period in us, 0 = IRQ only */
+	V4L2_CID_CX88SDR_POS_POLL,
+	/* Samples masked after a configuration change, in us */
+	V4L2_CID_CX88SDR_HOLDOFF,
+	/* Preset for SDR or line-locked raw video, CX88SDR_MODE_* */
+	V4L2_CID_CX88SDR_MODE,
+	/* Replay cards only: pace of write() in percent of the sample rate, 0 = unpaced */
+	V4L2_CID_CX88SDR_REPLAY_SPEED,
+};
+
+/*
+ * Raw video modes sample at twice 4fsc (approximately) with HTOTAL at 4fsc
+ * pixels per line: 910 for NTSC, 1135 for PAL. Their rates are only in the
+ * RU8 band: selecting NTSC or PAL in RU16LE, or RU16LE in either of them,
+ * fails with EBUSY. Go back to CX88SDR_MODE_SDR to change the format.
+ */
+#define CX88SDR_MODE_SDR		0
+#define CX88SDR_MODE_NTSC		1
+#define CX88SDR_MODE_PAL		2
+
+/*
+ * mmap() at offset 0 maps the DMA ring read-only, up to two ring sizes:
+ * the second half aliases the first. Absolute byte position n is at ring
+ * offset (n % size).
+ */
+
+/*
+ * Stream positions, all in bytes counted from the start of DMA.
+ * read:  next byte returned by read() on this file handle
+ * write: end of the data completely written by DMA
+ * size:  ring size, data older than (write - size) has been overwritten
+ */
+struct cx88sdr_pos {
+	__u64	read;
+	__u64	write;
+	__u64	size;
+	__u64	reserved[5];
+};
+
+/*
+ * Wait until DMA has written up to pos (absolute byte position), at most
+ * timeout_ms milliseconds, 0 waits forever (or not at all with O_NONBLOCK).
+ * write returns the current write position.
+ */
+struct cx88sdr_wait {
+	__u64	pos;
+	__u32	timeout_ms;
+	__u32	reserved0;
+	__u64	write;
+	__u64	reserved[5];
+};
+
+/*
+ * Configuration change marker, subscribe to CX88SDR_EVENT_CONFIG and read
+ * it from v4l2_event.u.data. Every change of the sample rate, the format
+ * or a control that touches the ADC path queues one.
+ * pos:     first byte that may have been sampled with the new setting, the
+ *          change takes effect within the page that starts there
+ * settled: first byte past the hold-off, read() returns mid-scale samples
+ *          in [pos, settled), equals pos when the hold-off is 0
+ * id:      control ID, CX88SDR_CONFIG_RATE or CX88SDR_CONFIG_FORMAT
+ * value:   new value, Hz for the rate, fourcc for the format
+ */
+#define CX88SDR_EVENT_CONFIG	(V4L2_EVENT_PRIVATE_START + 1)
+
+#define CX88SDR_CONFIG_RATE	1
+#define CX88SDR_CONFIG_FORMAT	2
+
+struct cx88sdr_event_config {
+	__u64	pos;
+	__u64	settled;
+	__u32	id;
+	__s32	value;
+	__u32	reserved[10];
+};
+
+/*
+ * Hardware fault, subscribe to CX88SDR_EVENT_FAULT: one per interrupt that
+ * reports any. Overflows are the chip's cluster FIFO filling up because
+ * the PCI bus didn't take the samples in time, they are dropped and the
+ * stream closes up over them.
+ * pos:    write position when the fault was seen, samples went missing
+ *         within an interrupt latency before it
+ * faults: CX88SDR_FAULT_* bits
+ * status: video interrupt status as read from the chip
+ * counts: faults of each kind on the card so far, as in sysfs stats/
+ */
+#define CX88SDR_EVENT_FAULT	(V4L2_EVENT_PRIVATE_START + 2)
+
+#define CX88SDR_FAULT_OVERFLOW	(1 << 0) /* Cluster FIFO overflow, samples lost */
+#define CX88SDR_FAULT_SYNC	(1 << 1) /* Sync error */
+#define CX88SDR_FAULT_RISC	(1 << 2) /* RISC opcode or instruction pointer error */
+#define CX88SDR_FAULT_PCI	(1 << 3) /* PCI parity error or abort */
+
+struct cx88sdr_event_fault {
+	__u64	pos;
+	__u32	faults;
+	__u32	status;
+	__u64	fifo_overflows;
+	__u64	sync_errors;
+	__u64	risc_errors;
+	__u64	pci_errors;
+	__u32	reserved[4];
+};
+
+/*
+ * Group node, see the group module parameter: read() returns frames of one
+ * page (PAGE_SIZE bytes) from every card of the group, in group order.
+ * Page k of each card goes to frame k, counted from the pages the cards
+ * were filling when the file was opened, so frames line up to within a page.
+ * cards:   cards in the group
+ * frame:   frame the next read() starts in
+ * lost:    frames skipped because a card's ring was about to be overwritten
+ * card[i]: positions of card i as in CX88SDR_IOC_G_POS, write - read is how
+ *          far its DMA is ahead of this reader, a card that falls behind the
+ *          others shows a smaller lead
+ */
+#define CX88SDR_GROUP_MAX	32
+
+struct cx88sdr_group_pos {
+	__u32			cards;
+	__u32			reserved0;
+	__u64			frame;
+	__u64			lost;
+	__u64			reserved[5];
+	struct cx88sdr_pos	card[CX88SDR_GROUP_MAX];
+};
+
+/*
+ * Audio node, see the audio module parameter: the card's audio ADC through
+ * its audio decoder, 48 kHz interleaved stereo, signed 16-bit little endian
+ * (CX88SDR_FMT_AUDIO). It runs from the same crystal as the main stream.
+ * CX88SDR_IOC_G_POS works on it in its own byte positions, and
+ * CX88SDR_IOC_G_XREF ties them to the main stream, the latest count
+ * cross-references, oldest first, one per audio page:
+ * audio: audio bytes written by DMA when the page completed
+ * main:  main stream bytes written by DMA at that moment, to within a page
+ * ts_ns: CLOCK_MONOTONIC time of the interrupt
+ * seq:   cross-references taken so far, the last one is number seq - 1
+ */
+#define CX88SDR_FMT_AUDIO	v4l2_fourcc('C', 'X', 'A', '2')
+#define CX88SDR_XREF_MAX	64
+
+struct cx88sdr_xref {
+	__u64	audio;
+	__u64	main;
+	__u64	ts_ns;
+	__u64	reserved;
+};
+
+struct cx88sdr_xrefs {
+	__u32			count;
+	__u32			reserved0;
+	__u64			seq;
+	__u64			reserved[6];
+	struct cx88sdr_xref	xref[CX88SDR_XREF_MAX];
+};
+
+/*
+ * Position this file handle's read() at data still in the ring, so a
+ * restarted reader carries on without a gap. The next read() starts at the
+ * new position, which CX88SDR_IOC_G_POS also reports as read.
+ * whence:  CX88SDR_SEEK_SET: absolute byte position pos
+ *          CX88SDR_SEEK_OLDEST: pos bytes past the oldest data, whose ring
+ *          pages DMA can't reach for another CX88SDR_SEEK_MARGIN bytes,
+ *          and written since DMA last restarted
+ *          CX88SDR_SEEK_TIME: the byte sampled at time_ns, CLOCK_REALTIME,
+ *          from the time of the last write position update at the current
+ *          rate, good to about a position update interval
+ * pos:     returns the position set, rounded down to a sample. Positions
+ *          older than the oldest data move up to it, later ones than the
+ *          write position are kept, read() waits for them
+ * lost:    returns how far the position was moved up
+ * Not for a handle another thread is reading from at the same time.
+ */
+#define CX88SDR_SEEK_SET	0
+#define CX88SDR_SEEK_OLDEST	1
+#define CX88SDR_SEEK_TIME	2
+#define CX88SDR_SEEK_MARGIN	(4 << 20)
+
+struct cx88sdr_seek {
+	__u64	pos;
+	__s64	time_ns;
+	__u32	whence;
+	__u32	reserved0;
+	__u64	lost;
+	__u64	reserved[4];
+};
+
+/* No implicit padding: 32-bit processes use the same layouts */
+#define CX88SDR_IOC_G_POS	_IOR('V', BASE_VIDIOC_PRIVATE + 0, struct cx88sdr_pos)
+#define CX88SDR_IOC_WAIT	_IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct cx88sdr_wait)
+#define CX88SDR_IOC_G_GROUP	_IOR('V', BASE_VIDIOC_PRIVATE + 2, struct cx88sdr_group_pos)
+#define CX88SDR_IOC_G_XREF	_IOR('V', BASE_VIDIOC_PRIVATE + 3, struct cx88sdr_xrefs)
+#define CX88SDR_IOC_SEEK	_IOWR('V', BASE_VIDIOC_PRIVATE + 4, struct cx88sdr_seek)
+
+#endif
@@ -17,8 +17,11 @@
  * Copyright (c) 2013-2015 Chad Page <Chad.Page@gmail.com>
  */
 
+#include <linux/compat.h>
 #include <linux/math64.h>
+#include <linux/mm.h>
 #include <linux/pci.h>
+#include <linux/version.h>
 #include <linux/videodev2.h>
 #include <media/v4l2-dev.h>
 #include <media/v4l2-event.h>
@@ -28,28 +31,6 @@
 
 #define CX88SDR_V4L2_NAME		"CX2388x SDR V4L2"
 
-/* Reserve 16 controls for this driver */
-#ifndef V4L2_CID_USER_CX88SDR_BASE
-#define V4L2_CID_USER_CX88SDR_BASE	(V4L2_CID_USER_BASE + 0x1f10)
-#endif
-
-enum {
-	/* +6dB gain control (INIT_6DB_VAL) */
-	V4L2_CID_CX88SDR_GAIN_6DB	= (V4L2_CID_USER_CX88SDR_BASE + 0),
-	/* AGC Gain Adjust 3 */
-	V4L2_CID_CX88SDR_AGC_ADJ3,
-	/* AGC Sync Tip Adjust 3 */
-	V4L2_CID_CX88SDR_AGC_TIP3,
-	/* Pin input select (YADC_SEL) */
-	V4L2_CID_CX88SDR_INPUT,
-	/* PLL AFC (PLL_ADJ_EN) */
-	V4L2_CID_CX88SDR_AFC_PLL,
-	/* Enable vertical sync detection (VERTEN) */
-	V4L2_CID_CX88SDR_INPUT_VSYNC,
-	/* Total number of pixels per line */
-	V4L2_CID_CX88SDR_HTOTAL,
-};
-
 enum {
 	CX88SDR_BAND_RU08,
 	CX88SDR_BAND_RU16,
@@ -58,7 +39,7 @@ enum {
 struct cx88sdr_fh {
 	struct v4l2_fh fh;
 	struct cx88sdr_dev *dev;
-	uint32_t spage;
+	u64 spage;
 };
 
 static const struct v4l2_frequency_band cx88sdr_bands[] = {
@@ -81,7 +62,6 @@ static int cx88sdr_open(struct file *file)
 	struct video_device *vdev = video_devdata(file);
 	struct cx88sdr_dev *dev = container_of(vdev, struct cx88sdr_dev, vdev);
 	struct cx88sdr_fh *fh;
-	uint32_t cpage;
 
 	fh = kzalloc(sizeof(*fh), GFP_KERNEL);
 	if (!fh)
@@ -93,14 +73,7 @@ static int cx88sdr_open(struct file *file)
 	file->private_data = &fh->fh;
 	v4l2_fh_add(&fh->fh);
 
-	cpage = ctrl_ioread32(dev, CX88SDR_VBI_GP_CNT);
-	cpage = (!cpage) ? (CX88SDR_VBI_DMA_PAGES - 1) : (cpage - 1);
-	fh->spage = cpage;
-
-	mutex_lock(&dev->vopen_mlock);
-	if (!dev->vopen++)
-		ctrl_iowrite32(dev, CX88SDR_PCI_INT_MSK, CX88SDR_PCI_INT_MSK_VAL);
-	mutex_unlock(&dev->vopen_mlock);
+	fh->spage = cx88sdr_dma_head(dev);
 	return 0;
 }
 
@@ -108,12 +81,6 @@ static int cx88sdr_release(struct file *file)
 {
 	struct v4l2_fh *vfh = file->private_data;
 	struct cx88sdr_fh *fh = container_of(vfh, struct cx88sdr_fh, fh);
-	struct cx88sdr_dev *dev = fh->dev;
-
-	mutex_lock(&dev->vopen_mlock);
-	if (!--dev->vopen)
-		ctrl_iowrite32(dev, CX88SDR_PCI_INT_MSK, CX88SDR_PCI_INT_MSK_CLEAR);
-	mutex_unlock(&dev->vopen_mlock);
 
 	v4l2_fh_del(&fh->fh);
 	v4l2_fh_exit(&fh->fh);
@@ -127,56 +94,266 @@ static ssize_t cx88sdr_read(struct file *file, char __user *buf, size_t size,
 	struct v4l2_fh *vfh = file->private_data;
 	struct cx88sdr_fh *fh = container_of(vfh, struct cx88sdr_fh, fh);
 	struct cx88sdr_dev *dev = fh->dev;
+	u64 head, page, mask_start, mask_end;
 	ssize_t result = 0;
-	uint32_t cpage, page;
-
-	page = (fh->spage + ((*pos % CX88SDR_VBI_DMA_SIZE) >> PAGE_SHIFT)) %
-		CX88SDR_VBI_DMA_PAGES;
-
-retry:
-	cpage = ctrl_ioread32(dev, CX88SDR_VBI_GP_CNT);
-	cpage = (!cpage) ? (CX88SDR_VBI_DMA_PAGES - 1) : (cpage - 1);
-
-	if ((page == cpage) && (file->f_flags & O_NONBLOCK))
-		return -EAGAIN;
-
-	while (size && (page != cpage)) {
-		u32 len;
-
-		/* Handle partial pages */
-		len = (*pos % PAGE_SIZE) ? (PAGE_SIZE - (*pos % PAGE_SIZE)) : PAGE_SIZE;
-		if (len > size)
-			len = size;
-
-		if (copy_to_user(buf, dev->dma_buf_pages[page] + (*pos % PAGE_SIZE), len))
+	void *src;
+	int ret;
+
+	page = fh->spage + (*pos >> PAGE_SHIFT);
+	head = cx88sdr_dma_head(dev);
+	cx88sdr_dma_head_saved(dev);
+	cx88sdr_mask_get(dev, &mask_start, &mask_end);
+
+	while (size) {
+		u64 span;
+		size_t len;
+
+		if (page >= head) {
+			if (file->f_flags & O_NONBLOCK)
+				break;
+			ret = wait_event_interruptible(dev->dma_wq,
+						       (head = cx88sdr_dma_head(dev)) > page);
+			if (ret)
+				return (result) ? result : ret;
+			cx88sdr_mask_get(dev, &mask_start, &mask_end);
+			continue;
+		}
+
+		/* Everything DMA has completed, in one copy unless masked or unmapped */
+		src = cx88sdr_span_src(dev, page, head, mask_start, mask_end, &span);
+		len = min_t(u64, size, (span << PAGE_SHIFT) - (*pos % PAGE_SIZE));
+
+		if (copy_to_user(buf, src + (*pos % PAGE_SIZE), len))
 			return -EFAULT;
 
 		result += len;
 		buf    += len;
 		*pos   += len;
 		size   -= len;
-		page    = (fh->spage + ((*pos % CX88SDR_VBI_DMA_SIZE) >> PAGE_SHIFT)) %
-			   CX88SDR_VBI_DMA_PAGES;
+		page    = fh->spage + (*pos >> PAGE_SHIFT);
 	}
 
-	if (size && !(file->f_flags & O_NONBLOCK))
-		goto retry;
+	if (!result && size)
+		return -EAGAIN;
 
 	return result;
 }
 
+/* Replay cards take their samples from write(), see cx88_sdr_replay.c */
+static ssize_t cx88sdr_write(struct file *file, const char __user *buf, size_t size,
+			     loff_t __always_unused *pos)
+{
+	struct v4l2_fh *vfh = file->private_data;
+	struct cx88sdr_fh *fh = container_of(vfh, struct cx88sdr_fh, fh);
+
+	if (!fh->dev->replay)
+		return -EINVAL;
+	return cx88sdr_replay_write(fh->dev, buf, size, file->f_flags & O_NONBLOCK);
+}
+
 static __poll_t cx88sdr_poll(struct file *file, struct poll_table_struct *wait)
 {
-	return (EPOLLIN | EPOLLRDNORM | v4l2_ctrl_poll(file, wait));
+	struct v4l2_fh *vfh = file->private_data;
+	struct cx88sdr_fh *fh = container_of(vfh, struct cx88sdr_fh, fh);
+	struct cx88sdr_dev *dev = fh->dev;
+	__poll_t res = v4l2_ctrl_poll(file, wait);
+
+	poll_wait(file, &dev->dma_wq, wait);
+	cx88sdr_dma_head_saved(dev);
+	if (cx88sdr_dma_head(dev) > fh->spage + (file->f_pos >> PAGE_SHIFT))
+		res |= EPOLLIN | EPOLLRDNORM;
+	return res;
+}
+
+/*
+ * Read-only mapping of the DMA ring. Up to two ring sizes can be mapped,
+ * the second copy aliases the first so a block that wraps around the end
+ * of the ring is still contiguous in userspace.
+ */
+static int cx88sdr_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct v4l2_fh *vfh = file->private_data;
+	struct cx88sdr_fh *fh = container_of(vfh, struct cx88sdr_fh, fh);
+	struct cx88sdr_dev *dev = fh->dev;
+	unsigned long addr = vma->vm_start;
+	u32 page, npages = vma_pages(vma);
+	int ret;
+
+	if (vma->vm_pgoff || npages > 2 * CX88SDR_VBI_DMA_PAGES)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	vm_flags_mod(vma, VM_DONTEXPAND | VM_DONTDUMP, VM_MAYWRITE);
+#else
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+	for (page = 0; page < npages; page++, addr += PAGE_SIZE) {
+		ret = vm_insert_page(vma, addr, cx88sdr_ring_page(dev,
+				     page & (CX88SDR_VBI_DMA_PAGES - 1)));
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+/* Byte sampled at time_ns, counted at the current rate from the head and its time */
+static u64 cx88sdr_time_pos(struct cx88sdr_dev *dev, u64 head, u64 head_ns, s64 time_ns)
+{
+	u64 rate = READ_ONCE(dev->byte_rate), delta, bytes;
+	bool back = time_ns < (s64)head_ns;
+	u32 rem;
+
+	delta = (back) ? head_ns - time_ns : time_ns - head_ns;
+	bytes = div_u64_rem(delta, NSEC_PER_SEC, &rem) * rate +
+		div_u64((u64)rem * rate, NSEC_PER_SEC);
+	if (!back)
+		return head + bytes;
+	return (bytes < head) ? head - bytes : 0;
+}
+
+static int cx88sdr_seek(struct file *file, struct cx88sdr_fh *fh, struct cx88sdr_seek *s)
+{
+	struct cx88sdr_dev *dev = fh->dev;
+	u64 head, head_ns, oldest, pos;
+	u32 ss = (dev->vctrl.pixelformat == V4L2_SDR_FMT_RU16LE) ? 2 : 1;
+
+	head = cx88sdr_dma_head_time(dev, &head_ns) << PAGE_SHIFT;
+	/* DMA may be up to an IRQ interval past the head, and goes on from there */
+	oldest = head + ((u64)CX88SDR_IRQ_PAGES_MAX << PAGE_SHIFT) + CX88SDR_SEEK_MARGIN;
+	oldest = (oldest > CX88SDR_VBI_DMA_SIZE) ? oldest - CX88SDR_VBI_DMA_SIZE : 0;
+	oldest = max(oldest, READ_ONCE(dev->valid_start));
+
+	switch (s->whence) {
+	case CX88SDR_SEEK_SET:
+		pos = s->pos;
+		break;
+	case CX88SDR_SEEK_OLDEST:
+		pos = oldest + s->pos;
+		break;
+	case CX88SDR_SEEK_TIME:
+		pos = cx88sdr_time_pos(dev, head, head_ns, s->time_ns);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	s->lost = (pos < oldest) ? oldest - pos : 0;
+	pos = max(pos, oldest) & ~(u64)(ss - 1);
+	fh->spage = pos >> PAGE_SHIFT;
+	file->f_pos = pos & (PAGE_SIZE - 1);
+	s->pos = pos;
+	return 0;
+}
+
+static long cx88sdr_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct v4l2_fh *vfh = file->private_data;
+	struct cx88sdr_fh *fh = container_of(vfh, struct cx88sdr_fh, fh);
+	struct cx88sdr_dev *dev = fh->dev;
+	void __user *uarg = (void __user *)arg;
+
+	/* Private ioctls don't take the V4L2 lock, CX88SDR_IOC_WAIT sleeps */
+	switch (cmd) {
+	case CX88SDR_IOC_G_POS: {
+		struct cx88sdr_pos p = {
+			.read	= (fh->spage << PAGE_SHIFT) + file->f_pos,
+			.write	= cx88sdr_dma_head(dev) << PAGE_SHIFT,
+			.size	= CX88SDR_VBI_DMA_SIZE,
+		};
+
+		cx88sdr_dma_head_saved(dev);
+		return (copy_to_user(uarg, &p, sizeof(p))) ? -EFAULT : 0;
+	}
+	case CX88SDR_IOC_WAIT: {
+		struct cx88sdr_wait w;
+		long ret = 1;
+
+		if (copy_from_user(&w, uarg, sizeof(w)))
+			return -EFAULT;
+
+		cx88sdr_dma_head_saved(dev);
+		if (w.timeout_ms)
+			ret = wait_event_interruptible_timeout(dev->dma_wq,
+				(cx88sdr_dma_head(dev) << PAGE_SHIFT) >= w.pos,
+				msecs_to_jiffies(w.timeout_ms));
+		else if (!(file->f_flags & O_NONBLOCK))
+			ret = wait_event_interruptible(dev->dma_wq,
+				(cx88sdr_dma_head(dev) << PAGE_SHIFT) >= w.pos);
+		if (ret < 0)
+			return ret;
+
+		w.write = cx88sdr_dma_head(dev) << PAGE_SHIFT;
+		if (copy_to_user(uarg, &w, sizeof(w)))
+			return -EFAULT;
+		if (w.write >= w.pos)
+			return 0;
+		return (w.timeout_ms) ? -ETIMEDOUT : -EAGAIN;
+	}
+	case CX88SDR_IOC_SEEK: {
+		struct cx88sdr_seek s;
+		long ret;
+
+		if (copy_from_user(&s, uarg, sizeof(s)))
+			return -EFAULT;
+		ret = cx88sdr_seek(file, fh, &s);
+		if (ret)
+			return ret;
+		return (copy_to_user(uarg, &s, sizeof(s))) ? -EFAULT : 0;
+	}
+	default:
+		return video_ioctl2(file, cmd, arg);
+	}
+}
+
+#ifdef CONFIG_COMPAT
+/*
+ * V4L2 translates its own ioctls for 32-bit processes, private ones come
+ * here. The uapi structs have no implicit padding, so with __u64 aligned
+ * to 4 bytes on i386 they are laid out the same and the ioctl numbers
+ * match: only the pointer needs converting.
+ */
+long cx88sdr_compat_ioctl32(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct video_device *vdev = video_devdata(file);
+
+	BUILD_BUG_ON(sizeof(struct cx88sdr_pos) != 8 * 8);
+	BUILD_BUG_ON(sizeof(struct cx88sdr_wait) != 8 * 8);
+	BUILD_BUG_ON(sizeof(struct cx88sdr_seek) != 8 * 8);
+	BUILD_BUG_ON(sizeof(struct cx88sdr_group_pos) !=
+		     8 * 8 + CX88SDR_GROUP_MAX * sizeof(struct cx88sdr_pos));
+	BUILD_BUG_ON(sizeof(struct cx88sdr_xref) != 4 * 8);
+	BUILD_BUG_ON(sizeof(struct cx88sdr_xrefs) !=
+		     8 * 8 + CX88SDR_XREF_MAX * sizeof(struct cx88sdr_xref));
+
+	switch (cmd) {
+	case CX88SDR_IOC_G_POS:
+	case CX88SDR_IOC_WAIT:
+	case CX88SDR_IOC_G_GROUP:
+	case CX88SDR_IOC_G_XREF:
+	case CX88SDR_IOC_SEEK:
+		return vdev->fops->unlocked_ioctl(file, cmd, (unsigned long)compat_ptr(arg));
+	default:
+		return -ENOIOCTLCMD;
+	}
 }
+#endif
 
 static const struct v4l2_file_operations cx88sdr_fops = {
 	.owner		= THIS_MODULE,
 	.open		= cx88sdr_open,
 	.release	= cx88sdr_release,
 	.read		= cx88sdr_read,
+	.write		= cx88sdr_write,
 	.poll		= cx88sdr_poll,
-	.unlocked_ioctl	= video_ioctl2,
+	.mmap		= cx88sdr_mmap,
+	.unlocked_ioctl	= cx88sdr_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl32	= cx88sdr_compat_ioctl32,
+#endif
 };
 
 static int cx88sdr_querycap(struct file *file, void __always_unused *priv,
@@ -184,15 +361,19 @@ static int cx88sdr_querycap(struct file *file, void __always_unused *priv,
 {
 	struct cx88sdr_dev *dev = video_drvdata(file);
 
-	snprintf(cap->bus_info, sizeof(cap->bus_info), "PCI:%s", pci_name(dev->pdev));
+	if (dev->pdev)
+		snprintf(cap->bus_info, sizeof(cap->bus_info), "PCI:%s", pci_name(dev->pdev));
+	else
+		snprintf(cap->bus_info, sizeof(cap->bus_info), "platform:%s-replay%d",
+			 KBUILD_MODNAME, dev->nr);
 	strscpy(cap->card, CX88SDR_DRV_NAME, sizeof(cap->card));
 	strscpy(cap->driver, KBUILD_MODNAME, sizeof(cap->driver));
 	return 0;
 }
 
-static int cx88sdr_enum_fmt_sdr(struct file __always_unused *file,
-				void __always_unused *priv,
-				struct v4l2_fmtdesc *f)
+int cx88sdr_enum_fmt_sdr(struct file __always_unused *file,
+			 void __always_unused *priv,
+			 struct v4l2_fmtdesc *f)
 {
 	switch (f->index) {
 	case 0:
@@ -207,8 +388,8 @@ static int cx88sdr_enum_fmt_sdr(struct file __always_unused *file,
 	return 0;
 }
 
-static int cx88sdr_try_fmt_sdr(struct file *file, void __always_unused *priv,
-			       struct v4l2_format *f)
+int cx88sdr_try_fmt_sdr(struct file *file, void __always_unused *priv,
+			struct v4l2_format *f)
 {
 	struct cx88sdr_dev *dev = video_drvdata(file);
 
@@ -220,8 +401,8 @@ static int cx88sdr_try_fmt_sdr(struct file *file, void __always_unused *priv,
 	return 0;
 }
 
-static int cx88sdr_g_fmt_sdr(struct file *file, void __always_unused *priv,
-			     struct v4l2_format *f)
+int cx88sdr_g_fmt_sdr(struct file *file, void __always_unused *priv,
+		      struct v4l2_format *f)
 {
 	struct cx88sdr_dev *dev = video_drvdata(file);
 
@@ -231,6 +412,25 @@ static int cx88sdr_g_fmt_sdr(struct file *file, void __always_unused *priv,
 	return 0;
 }
 
+/* Also used by the group node, called with the card's vdev_mlock held */
+int cx88sdr_fmt_set(struct cx88sdr_dev *dev, u32 pixelformat)
+{
+	u32 old = dev->vctrl.pixelformat;
+	int ret;
+
+	/* Raw video modes are line-locked at RU8 rates only, see cx88sdr_mode_set() */
+	if (pixelformat != V4L2_SDR_FMT_RU8 && dev->vctrl.mode != CX88SDR_MODE_SDR)
+		return -EBUSY;
+
+	dev->vctrl.pixelformat = pixelformat;
+	ret = cx88sdr_adc_fmt_set(dev, true);
+	if (ret)
+		dev->vctrl.pixelformat = old;
+	else if (pixelformat != old)
+		cx88sdr_config_mark(dev, CX88SDR_CONFIG_FORMAT, pixelformat);
+	return ret;
+}
+
 static int cx88sdr_s_fmt_sdr(struct file *file, void __always_unused *priv,
 			     struct v4l2_format *f)
 {
@@ -240,13 +440,12 @@ static int cx88sdr_s_fmt_sdr(struct file *file, void __always_unused *priv,
 	if (f->fmt.sdr.pixelformat != V4L2_SDR_FMT_RU8 &&
 	    f->fmt.sdr.pixelformat != V4L2_SDR_FMT_RU16LE)
 		f->fmt.sdr.pixelformat = V4L2_SDR_FMT_RU8;
-	dev->vctrl.pixelformat = f->fmt.sdr.pixelformat;
 	f->fmt.sdr.buffersize = dev->vctrl.buffersize;
-	return cx88sdr_adc_fmt_set(dev);
+	return cx88sdr_fmt_set(dev, f->fmt.sdr.pixelformat);
 }
 
-static int cx88sdr_g_tuner(struct file *file, void __always_unused *priv,
-			   struct v4l2_tuner *t)
+int cx88sdr_g_tuner(struct file *file, void __always_unused *priv,
+		    struct v4l2_tuner *t)
 {
 	struct cx88sdr_dev *dev = video_drvdata(file);
 
@@ -271,9 +470,9 @@ static int cx88sdr_g_tuner(struct file *file, void __always_unused *priv,
 	return 0;
 }
 
-static int cx88sdr_s_tuner(struct file __always_unused *file,
-			   void __always_unused *priv,
-			   const struct v4l2_tuner *t)
+int cx88sdr_s_tuner(struct file __always_unused *file,
+		    void __always_unused *priv,
+		    const struct v4l2_tuner *t)
 {
 	if (t->index > 0)
 		return -EINVAL;
@@ -281,8 +480,8 @@ static int cx88sdr_s_tuner(struct file __always_unused *file,
 	return 0;
 }
 
-static int cx88sdr_enum_freq_bands(struct file *file, void __always_unused *priv,
-				   struct v4l2_frequency_band *band)
+int cx88sdr_enum_freq_bands(struct file *file, void __always_unused *priv,
+			    struct v4l2_frequency_band *band)
 {
 	struct cx88sdr_dev *dev = video_drvdata(file);
 
@@ -302,8 +501,8 @@ static int cx88sdr_enum_freq_bands(struct file *file, void __always_unused *priv
 	return 0;
 }
 
-static int cx88sdr_g_frequency(struct file *file, void __always_unused *priv,
-			       struct v4l2_frequency *f)
+int cx88sdr_g_frequency(struct file *file, void __always_unused *priv,
+			struct v4l2_frequency *f)
 {
 	struct cx88sdr_dev *dev = video_drvdata(file);
 
@@ -323,6 +522,21 @@ static int cx88sdr_g_frequency(struct file *file, void __always_unused *priv,
 	return 0;
 }
 
+/* Also used by the group node, called with the card's vdev_mlock held */
+int cx88sdr_freq_set(struct cx88sdr_dev *dev, u32 freq)
+{
+	u32 old = dev->vctrl.freq;
+	int ret;
+
+	dev->vctrl.freq = freq;
+	ret = cx88sdr_adc_fmt_set(dev, true);
+	if (ret)
+		dev->vctrl.freq = old;
+	else if (dev->vctrl.freq != old)
+		cx88sdr_config_mark(dev, CX88SDR_CONFIG_RATE, dev->vctrl.freq);
+	return ret;
+}
+
 static int cx88sdr_s_frequency(struct file *file, void __always_unused *priv,
 			       const struct v4l2_frequency *f)
 {
@@ -331,8 +545,32 @@ static int cx88sdr_s_frequency(struct file *file, void __always_unused *priv,
 	if (f->tuner > 0 || f->type != V4L2_TUNER_SDR)
 		return -EINVAL;
 
-	dev->vctrl.freq = f->frequency;
-	return cx88sdr_adc_fmt_set(dev);
+	return cx88sdr_freq_set(dev, f->frequency);
+}
+
+static int cx88sdr_log_status(struct file *file, void *priv)
+{
+	struct cx88sdr_dev *dev = video_drvdata(file);
+
+	v4l2_info(&dev->v4l2_dev, "IRQs: %llu, RISC IRQs: %llu\n",
+		  dev->stats.irqs, dev->stats.irqs_risci1);
+	v4l2_info(&dev->v4l2_dev, "FIFO overflows: %llu, sync errors: %llu, RISC errors: %llu, "
+		  "PCI errors: %llu, last at byte %llu\n", dev->stats.fifo_overflows,
+		  dev->stats.sync_errors, dev->stats.risc_errors, dev->stats.pci_errors,
+		  dev->stats.fault_pos);
+	return v4l2_ctrl_log_status(file, priv);
+}
+
+static int cx88sdr_subscribe_event(struct v4l2_fh *fh,
+				   const struct v4l2_event_subscription *sub)
+{
+	switch (sub->type) {
+	case CX88SDR_EVENT_CONFIG:
+	case CX88SDR_EVENT_FAULT:
+		return v4l2_event_subscribe(fh, sub, 32, NULL);
+	default:
+		return v4l2_ctrl_subscribe_event(fh, sub);
+	}
 }
 
 #ifdef CONFIG_VIDEO_ADV_DEBUG
@@ -368,8 +606,8 @@ static const struct v4l2_ioctl_ops cx88sdr_ioctl_ops = {
 	.vidioc_enum_freq_bands		= cx88sdr_enum_freq_bands,
 	.vidioc_g_frequency		= cx88sdr_g_frequency,
 	.vidioc_s_frequency		= cx88sdr_s_frequency,
-	.vidioc_log_status		= v4l2_ctrl_log_status,
-	.vidioc_subscribe_event		= v4l2_ctrl_subscribe_event,
+	.vidioc_log_status		= cx88sdr_log_status,
+	.vidioc_subscribe_event		= cx88sdr_subscribe_event,
 	.vidioc_unsubscribe_event	= v4l2_event_unsubscribe,
 #ifdef CONFIG_VIDEO_ADV_DEBUG
 	.vidioc_g_register		= cx88sdr_g_register,
@@ -407,27 +645,30 @@ void cx88sdr_input_set(struct cx88sdr_dev *dev)
 						  (1 << 4) | 0x1);
 }
 
-int cx88sdr_adc_fmt_set(struct cx88sdr_dev *dev)
+/*
+ * user: a change asked for through the node, which bus_refuse may turn
+ * down; probe and resume bring the card up at its rate regardless.
+ */
+int cx88sdr_adc_fmt_set(struct cx88sdr_dev *dev, bool user)
 {
 	s64 pll_frac, sconv_val, freq = dev->vctrl.freq;
-	u32 pll_int, pll_freq;
+	u32 pll_int, pll_freq, capture_ctrl;
+	int ret;
 
 	switch (dev->vctrl.pixelformat) {
 	case V4L2_SDR_FMT_RU8:
 		freq = clamp_t(s64, freq,
 			       cx88sdr_bands[CX88SDR_BAND_RU08].rangelow,
 			       cx88sdr_bands[CX88SDR_BAND_RU08].rangehigh);
-		dev->vctrl.freq = (u32)freq;
-		pll_freq = dev->vctrl.freq;
-		ctrl_iowrite32(dev, CX88SDR_CAPTURE_CTRL, (1 << 6) | (3 << 1));
+		pll_freq = (u32)freq;
+		capture_ctrl = (1 << 6) | (3 << 1);
 		break;
 	case V4L2_SDR_FMT_RU16LE:
 		freq = clamp_t(s64, freq,
 			       cx88sdr_bands[CX88SDR_BAND_RU16].rangelow,
 			       cx88sdr_bands[CX88SDR_BAND_RU16].rangehigh);
-		dev->vctrl.freq = (u32)freq;
-		pll_freq = dev->vctrl.freq * 2;
-		ctrl_iowrite32(dev, CX88SDR_CAPTURE_CTRL, (1 << 6) | (1 << 5) | (3 << 1));
+		pll_freq = (u32)freq * 2;
+		capture_ctrl = (1 << 6) | (1 << 5) | (3 << 1);
 		break;
 	default:
 		return -EINVAL;
@@ -454,11 +695,84 @@ int cx88sdr_adc_fmt_set(struct cx88sdr_dev *dev)
 		return -EINVAL;
 	}
 
+	/* One byte per 8-bit sample, two per 16-bit sample: the PLL rate */
+	ret = cx88sdr_bus_admit(dev, pll_freq, user);
+	if (ret)
+		return ret;
+
+	dev->vctrl.freq = (u32)freq;
+	ctrl_iowrite32(dev, CX88SDR_CAPTURE_CTRL, capture_ctrl);
 	ctrl_iowrite32(dev, CX88SDR_SCONV_REG, (u32)sconv_val);
 	ctrl_iowrite32(dev, CX88SDR_PLL_REG, (2U << 26) | (pll_int << 20) | (u32)pll_frac);
 	return 0;
 }
 
+/*
+ * Queue a CX88SDR_EVENT_CONFIG for a change just written to the chip, and
+ * mask the hold-off that follows it from read(). The register write lands
+ * in the page DMA is filling or shortly after, behind the samples already
+ * buffered in SRAM, so pos is the earliest byte it can affect.
+ */
+void cx88sdr_config_mark(struct cx88sdr_dev *dev, u32 id, s32 value)
+{
+	struct v4l2_event ev = { .type = CX88SDR_EVENT_CONFIG };
+	struct cx88sdr_event_config *cfg = (void *)ev.u.data;
+	u64 holdoff;
+
+	BUILD_BUG_ON(sizeof(*cfg) > sizeof(ev.u.data));
+
+	/* Nothing is streaming before the node exists */
+	if (!video_is_registered(&dev->vdev))
+		return;
+
+	holdoff = round_up(div_u64((u64)dev->vctrl.holdoff * dev->byte_rate, USEC_PER_SEC),
+			   PAGE_SIZE);
+	cfg->pos = cx88sdr_dma_mask(dev, holdoff) << PAGE_SHIFT;
+	cfg->settled = cfg->pos + holdoff;
+	cfg->id = id;
+	cfg->value = value;
+	v4l2_event_queue(&dev->vdev, &ev);
+	wake_up_interruptible(&dev->dma_wq);
+}
+
+/* Mode presets: the ADC rate, the line length and the input level */
+struct cx88sdr_mode {
+	u32	freq;
+	u32	htotal;
+	bool	gain_6db;
+	u32	agc_tip3;
+};
+
+static const struct cx88sdr_mode cx88sdr_modes[] = {
+	[CX88SDR_MODE_SDR]	= { CX88SDR_ADC_FREQ_DEF, CX88SDR_ADC_FREQ_DEF / 60 / 525, 1, 0x38 },
+	[CX88SDR_MODE_NTSC]	= { 910 * 525 * 60, 910, 0, 0 },
+	[CX88SDR_MODE_PAL]	= { 1135 * 625 * 50, 1135, 0, 0 },
+};
+
+/*
+ * The preset controls go through the control framework, so they read back
+ * right and each queues its own configuration event. Called from s_ctrl,
+ * with the handler lock held.
+ */
+static int cx88sdr_mode_set(struct cx88sdr_dev *dev, u32 mode)
+{
+	const struct cx88sdr_mode *m = &cx88sdr_modes[mode];
+	int ret;
+
+	/* RU16LE tops out at half the line-locked rates, the lines would not lock */
+	if (mode != CX88SDR_MODE_SDR && dev->vctrl.pixelformat != V4L2_SDR_FMT_RU8)
+		return -EBUSY;
+
+	ret = cx88sdr_freq_set(dev, m->freq);
+	if (ret)
+		return ret;
+	dev->vctrl.mode = mode;
+	__v4l2_ctrl_s_ctrl(dev->ctrl_gain_6db, m->gain_6db);
+	__v4l2_ctrl_s_ctrl(dev->ctrl_agc_tip3, m->agc_tip3);
+	__v4l2_ctrl_s_ctrl(dev->ctrl_htotal, m->htotal);
+	return 0;
+}
+
 static int cx88sdr_s_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct cx88sdr_dev *dev = container_of(ctrl->handler,
@@ -497,9 +811,28 @@ static int cx88sdr_s_ctrl(struct v4l2_ctrl *ctrl)
 		dev->vctrl.htotal = ctrl->val;
 		cx88sdr_input_set(dev);
 		break;
+	case V4L2_CID_CX88SDR_IRQ_PAGES:
+		dev->vctrl.irq_pages = ctrl->val;
+		cx88sdr_risc_irq_set(dev);
+		return 0;
+	case V4L2_CID_CX88SDR_POS_POLL:
+		dev->vctrl.pos_poll = (ctrl->val) ? max(ctrl->val, CX88SDR_POS_POLL_MIN) : 0;
+		cx88sdr_pos_timer_set(dev);
+		return 0;
+	case V4L2_CID_CX88SDR_HOLDOFF:
+		dev->vctrl.holdoff = ctrl->val;
+		return 0;
+	case V4L2_CID_CX88SDR_MODE:
+		return cx88sdr_mode_set(dev, ctrl->val);
+	case V4L2_CID_CX88SDR_REPLAY_SPEED:
+		cx88sdr_replay_speed_set(dev, ctrl->val);
+		return 0;
 	default:
 		return -EINVAL;
 	}
+
+	/* Everything above changes the samples */
+	cx88sdr_config_mark(dev, ctrl->id, ctrl->val);
 	return 0;
 }
 
@@ -594,3 +927,54 @@ const struct v4l2_ctrl_config cx88sdr_ctrl_htotal = {
 	.def	= CX88SDR_HTOTAL_DEFVAL,
 	.flags	= V4L2_CTRL_FLAG_SLIDER,
 };
+
+const struct v4l2_ctrl_config cx88sdr_ctrl_irq_pages = {
+	.ops	= &cx88sdr_ctrl_ops,
+	.id	= V4L2_CID_CX88SDR_IRQ_PAGES,
+	.name	= "IRQ Interval",
+	.type	= V4L2_CTRL_TYPE_INTEGER,
+	.min	= CX88SDR_IRQ_PAGES_MIN,
+	.max	= CX88SDR_IRQ_PAGES_MAX,
+	.step	= 1,
+	.def	= CX88SDR_IRQ_PAGES_DEF,
+};
+
+const struct v4l2_ctrl_config cx88sdr_ctrl_pos_poll = {
+	.ops	= &cx88sdr_ctrl_ops,
+	.id	= V4L2_CID_CX88SDR_POS_POLL,
+	.name	= "Position Poll us",
+	.type	= V4L2_CTRL_TYPE_INTEGER,
+	.min	= 0,
+	.max	= CX88SDR_POS_POLL_MAX,
+	.step	= 1,
+	.def	= 0,
+};
+
+const struct v4l2_ctrl_config cx88sdr_ctrl_holdoff = {
+	.ops	= &cx88sdr_ctrl_ops,
+	.id	= V4L2_CID_CX88SDR_HOLDOFF,
+	.name	= "Hold-off us",
+	.type	= V4L2_CTRL_TYPE_INTEGER,
+	.min	= 0,
+	.max	= CX88SDR_HOLDOFF_MAX,
+	.step	= 1,
+	.def	= 0,
+};
+
+static const char * const cx88sdr_ctrl_mode_menu_strings[] = {
+	"SDR",
+	"Raw Video NTSC",
+	"Raw Video PAL",
+	NULL,
+};
+
+const struct v4l2_ctrl_config cx88sdr_ctrl_mode = {
+	.ops	= &cx88sdr_ctrl_ops,
+	.id	= V4L2_CID_CX88SDR_MODE,
+	.name	= "Mode",
+	.type	= V4L2_CTRL_TYPE_MENU,
+	.min	= CX88SDR_MODE_SDR,
+	.max	= CX88SDR_MODE_PAL,
+	.def	= CX88SDR_MODE_DEFVAL,
+	.qmenu	= cx88sdr_ctrl_mode_menu_strings,
+};
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR closed-loop gain and DC offset control
+ *
+ * Watches a card through the read-only ring mapping, so it costs no copy
+ * and does not disturb other readers, and keeps Gain, Gain +6dB, Gain 2
+ * and DC Offset where the signal neither clips nor wastes ADC range.
+ * Every change is logged with its sample index, one line per change:
+ *
+ *   <sample> <control> <from> <to> level=<peak> clip=<rate> mean=<code>
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <system_error>
+
+#include <getopt.h>
+
+#include "cx88sdr/agc.hpp"
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/device.hpp"
+
+using namespace cx88sdr;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int)
+{
+	running = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -d DEV    capture device (default: /dev/swradio0)\n"
+		"  -w MS     statistics window in ms (default: 100)\n"
+		"  -L LOW    step gain up below this peak level, 0..1 (default: 0.45)\n"
+		"  -H HIGH   step gain down above this peak level, 0..1 (default: 0.85)\n"
+		"  -c RATE   step gain down above this clip rate (default: 1e-5)\n"
+		"  -G        leave the gain controls alone\n"
+		"  -D        leave DC Offset alone\n"
+		"  -o FILE   change log (default: stdout)\n"
+		"  -v        print the statistics of every window on stderr\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = "/dev/swradio0", *log_path = nullptr;
+	unsigned int window_ms = 100;
+	bool verbose = false;
+	agc_options opts;
+	FILE *log = stdout;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:w:L:H:c:GDo:vh")) != -1) {
+		switch (opt) {
+		case 'd':
+			path = optarg;
+			break;
+		case 'w':
+			window_ms = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'L':
+			opts.level_low = atof(optarg);
+			break;
+		case 'H':
+			opts.level_high = atof(optarg);
+			break;
+		case 'c':
+			opts.clip_max = atof(optarg);
+			break;
+		case 'G':
+			opts.gain = false;
+			break;
+		case 'D':
+			opts.dc = false;
+			break;
+		case 'o':
+			log_path = optarg;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	try {
+		device dev(path);
+		size_t ss = dev.sample_size();
+		uint64_t window = static_cast<uint64_t>(dev.sample_rate()) * window_ms / 1000;
+		reader rd(dev, 256 << 10);
+		agc ctl(dev, opts);
+		level_stats st;
+
+		if (log_path && !(log = fopen(log_path, "a")))
+			throw std::system_error(errno, std::generic_category(), log_path);
+		setvbuf(log, nullptr, _IOLBF, 0);
+
+		while (running) {
+			block b;
+
+			if (!rd.next(b, 1000))
+				continue;
+			if (b.lost)
+				st.reset();
+			if (ss == 2)
+				st.add(reinterpret_cast<const uint16_t *>(b.data), b.size / 2);
+			else
+				st.add(b.data, b.size);
+			/* Overwritten under us, the statistics would mix old and new data */
+			if (!rd.valid(b)) {
+				st.reset();
+				continue;
+			}
+			if (st.count < window)
+				continue;
+
+			if (verbose)
+				fprintf(stderr, "%llu: min %u max %u mean %.2f level %.3f clip %.2e\n",
+					(unsigned long long)((b.pos + b.size) / ss), st.min, st.max,
+					st.mean(), st.level(), st.clip_rate());
+			for (auto &c : ctl.update(st))
+				fprintf(log, "%llu %s %d %d level=%.3f clip=%.2e mean=%.2f\n",
+					(unsigned long long)c.sample, c.control.c_str(), c.from, c.to,
+					c.level, c.clip_rate, c.mean);
+			st.reset();
+		}
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR audio recorder
+ *
+ * Records the audio node of a card (module parameter audio=1,...) to
+ * NAME.wav, and its cross-references to the main stream to NAME.xref, one
+ * "audio_sample main_sample ts_ns" line each. Main samples are stream
+ * positions in samples, the "global" positions of a cx88sdr_record index,
+ * so both recordings of a session line up.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <getopt.h>
+
+#include "cx88sdr/audio.hpp"
+#include "cx88sdr/device.hpp"
+
+using namespace cx88sdr;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int)
+{
+	running = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] NAME\n"
+		"  -d DEV    main device of the card (default: /dev/swradio0)\n"
+		"  -a DEV    audio node (default: the card's, found in sysfs)\n"
+		"  -s SECS   stop after SECS seconds (default: until interrupted)\n"
+		"Writes NAME.wav and NAME.xref\n",
+		prog);
+}
+
+static void put_le(uint8_t *p, uint32_t v, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+		p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+/* 16-bit stereo PCM, sizes patched on close */
+static void wav_header(uint8_t *h, uint32_t data_len)
+{
+	memcpy(h, "RIFF", 4);
+	put_le(h + 4, 36 + data_len, 4);
+	memcpy(h + 8, "WAVEfmt ", 8);
+	put_le(h + 16, 16, 4);
+	put_le(h + 20, 1, 2);
+	put_le(h + 22, audio_device::channels, 2);
+	put_le(h + 24, audio_device::rate, 4);
+	put_le(h + 28, audio_device::rate * audio_device::frame_size, 4);
+	put_le(h + 32, audio_device::frame_size, 2);
+	put_le(h + 34, 16, 2);
+	memcpy(h + 36, "data", 4);
+	put_le(h + 40, data_len, 4);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev_path = "/dev/swradio0", *audio_path = nullptr;
+	double secs = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:a:s:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev_path = optarg;
+			break;
+		case 'a':
+			audio_path = optarg;
+			break;
+		case 's':
+			secs = atof(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	FILE *wav = nullptr, *xref = nullptr;
+
+	try {
+		device dev(dev_path);
+		std::string path = (audio_path) ? audio_path : audio_device::find(dev);
+		std::string name = argv[optind];
+
+		if (path.empty())
+			throw std::runtime_error(std::string(dev_path) +
+						 ": no audio node, load the module with audio=1");
+
+		audio_device aud(path);
+		/* Main positions go by the format when recording starts */
+		uint64_t ss = dev.sample_size(), limit = UINT64_MAX, frames = 0;
+		uint64_t seq = 0, last = 0, missed = 0;
+		std::vector<int16_t> buf(4096 * audio_device::channels);
+		std::vector<audio_xref> all;
+		uint8_t hdr[44];
+
+		if (!(wav = fopen((name + ".wav").c_str(), "wb")))
+			throw std::system_error(errno, std::generic_category(), name + ".wav");
+		if (!(xref = fopen((name + ".xref").c_str(), "w")))
+			throw std::system_error(errno, std::generic_category(), name + ".xref");
+		wav_header(hdr, 0);
+		fwrite(hdr, sizeof(hdr), 1, wav);
+
+		if (secs > 0)
+			limit = static_cast<uint64_t>(secs * audio_device::rate);
+		/* Cross-references from before the first audio byte read are skipped */
+		aud.xrefs(&last);
+
+		fprintf(stderr, "%s: %u Hz stereo, cross-referenced to %s, recording to %s.wav\n",
+			path.c_str(), audio_device::rate, dev.path().c_str(), name.c_str());
+
+		while (running && frames < limit) {
+			size_t n = aud.read(buf.data(), std::min<uint64_t>(
+				buf.size() / audio_device::channels, limit - frames));
+
+			if (fwrite(buf.data(), audio_device::frame_size, n, wav) != n)
+				throw std::system_error(errno, std::generic_category(), "write");
+			frames += n;
+
+			std::vector<audio_xref> x = aud.xrefs(&seq);
+
+			if (seq - last > x.size())
+				missed += seq - last - x.size();
+			for (size_t i = 0; i < x.size(); i++) {
+				if (seq - x.size() + i < last)
+					continue;
+				fprintf(xref, "%llu %llu %llu\n",
+					(unsigned long long)(x[i].audio / audio_device::frame_size),
+					(unsigned long long)(x[i].main / ss),
+					(unsigned long long)x[i].ts_ns);
+				all.push_back(x[i]);
+			}
+			last = seq;
+		}
+
+		wav_header(hdr, static_cast<uint32_t>(frames * audio_device::frame_size));
+		fseek(wav, 0, SEEK_SET);
+		fwrite(hdr, sizeof(hdr), 1, wav);
+
+		audio_clock c = audio_device::fit(all);
+
+		fprintf(stderr, "%llu frames, %zu cross-references",
+			(unsigned long long)frames, all.size());
+		if (missed)
+			fprintf(stderr, ", %llu missed", (unsigned long long)missed);
+		if (c.ratio > 0)
+			fprintf(stderr, ", %.6f main samples per audio sample",
+				c.ratio * audio_device::frame_size / static_cast<double>(ss));
+		fputc('\n', stderr);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		if (wav)
+			fclose(wav);
+		if (xref)
+			fclose(xref);
+		return 1;
+	}
+	fclose(wav);
+	fclose(xref);
+	return 0;
+}
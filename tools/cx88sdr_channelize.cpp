@@ -0,0 +1,289 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR polyphase channelizer
+ *
+ * Splits a live card or a raw RU8/RU16LE capture into M uniform channels
+ * and writes the selected ones to one file each, as interleaved complex
+ * float32 or int16 at in_rate * oversample / M.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/channelizer.hpp"
+#include "cx88sdr/device.hpp"
+
+using namespace cx88sdr;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int)
+{
+	running = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -d DEV    capture live from a card\n"
+		"  -i FILE   raw capture, - for stdin (default)\n"
+		"  -f FMT    ru8 or ru16le, file input only (default: ru8)\n"
+		"  -r RATE   input rate in Hz, file input only (default: achieved rate of 28.8M)\n"
+		"  -M N      channels, power of two (default: 64)\n"
+		"  -O N      oversampling, 1 = critically sampled (default: 2)\n"
+		"  -T N      prototype taps per channel (default: 16)\n"
+		"  -c LIST   channels to write, e.g. 3,5,10-20 (default: 0 to M/2)\n"
+		"  -t N      worker threads, 0 = one per CPU (default: 1)\n"
+		"  -F FMT    output cf32 or cs16 (default: cf32)\n"
+		"  -o PAT    output file name, printf pattern of the channel\n"
+		"            (default: ch%%04u.cf32 or ch%%04u.cs16)\n",
+		prog);
+}
+
+/* "3,5,10-20" */
+static std::vector<unsigned int> parse_list(const char *s)
+{
+	std::vector<unsigned int> list;
+
+	while (*s) {
+		char *end;
+		unsigned long a = strtoul(s, &end, 0), b = a;
+
+		if (*end == '-')
+			b = strtoul(end + 1, &end, 0);
+		for (unsigned long k = a; k <= b; k++)
+			list.push_back(static_cast<unsigned int>(k));
+		s = (*end == ',') ? end + 1 : end;
+		if (*end && *end != ',')
+			break;
+	}
+	return list;
+}
+
+static double cpu_seconds()
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+	       (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static bool write_all(int fd, const void *data, size_t len)
+{
+	const uint8_t *p = static_cast<const uint8_t *>(data);
+
+	while (len) {
+		ssize_t ret = write(fd, p, len);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		p += ret;
+		len -= static_cast<size_t>(ret);
+	}
+	return true;
+}
+
+static bool emit(int fd, std::vector<std::complex<float>> &out, bool s16,
+		 std::vector<int16_t> &tmp)
+{
+	const float *f = reinterpret_cast<const float *>(out.data());
+	size_t n = out.size() * 2;
+	bool ok;
+
+	if (s16) {
+		tmp.resize(n);
+		for (size_t i = 0; i < n; i++)
+			tmp[i] = static_cast<int16_t>(std::lrint(std::min(std::max(f[i] * 32768.0f,
+								-32768.0f), 32767.0f)));
+		ok = write_all(fd, tmp.data(), n * sizeof(int16_t));
+	} else {
+		ok = write_all(fd, f, n * sizeof(float));
+	}
+	out.clear();
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev_path = nullptr, *in_path = "-", *pattern = nullptr;
+	format fmt = format::ru8;
+	channelizer_options opts;
+	double in_rate = 0;
+	bool s16 = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:i:f:r:M:O:T:c:t:F:o:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev_path = optarg;
+			break;
+		case 'i':
+			in_path = optarg;
+			break;
+		case 'f':
+			fmt = strcmp(optarg, "ru16le") ? format::ru8 : format::ru16le;
+			break;
+		case 'r':
+			in_rate = atof(optarg);
+			break;
+		case 'M':
+			opts.channels = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'O':
+			opts.oversample = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'T':
+			opts.taps = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'c':
+			opts.select = parse_list(optarg);
+			break;
+		case 't':
+			opts.threads = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'F':
+			s16 = !strcmp(optarg, "cs16");
+			break;
+		case 'o':
+			pattern = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!pattern)
+		pattern = s16 ? "ch%04u.cs16" : "ch%04u.cf32";
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	try {
+		std::unique_ptr<device> dev;
+		std::unique_ptr<reader> rd;
+		std::vector<uint8_t> buf(1 << 20);
+		std::vector<std::vector<std::complex<float>>> out;
+		std::vector<int16_t> tmp;
+		std::vector<int> fds;
+		int in_fd = STDIN_FILENO;
+		uint64_t lost = 0;
+		size_t pending = 0;
+
+		if (dev_path) {
+			dev = std::make_unique<device>(dev_path);
+			fmt = dev->get_format();
+			in_rate = dev->achieved_rate();
+			rd = std::make_unique<reader>(*dev, buf.size());
+		} else {
+			if (!(in_rate > 0))
+				in_rate = device::achieved_rate(28800000, fmt);
+			if (strcmp(in_path, "-") && (in_fd = open(in_path, O_RDONLY | O_CLOEXEC)) < 0)
+				throw std::system_error(errno, std::generic_category(), in_path);
+		}
+
+		channelizer ch(opts);
+		size_t ss = (fmt == format::ru16le) ? 2 : 1;
+		unsigned int m = ch.channels();
+
+		for (unsigned int k : ch.selected()) {
+			char name[4096];
+			int fd;
+
+			snprintf(name, sizeof(name), pattern, k);
+			fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			if (fd < 0)
+				throw std::system_error(errno, std::generic_category(), name);
+			fds.push_back(fd);
+		}
+
+		fprintf(stderr, "%.3f Hz, %u channels of %.3f Hz at %.3f S/s, %zu selected, %u threads\n",
+			in_rate, m, in_rate / m, in_rate / ch.decimation(), ch.selected().size(),
+			opts.threads ? opts.threads : std::max(1U, std::thread::hardware_concurrency()));
+
+		auto t0 = std::chrono::steady_clock::now();
+		double cpu0 = cpu_seconds();
+
+		while (running) {
+			const uint8_t *data;
+			size_t len;
+
+			if (rd) {
+				block b;
+
+				if (!rd->next(b, 1000))
+					continue;
+				lost += b.lost;
+				data = b.data;
+				len = b.size;
+			} else {
+				ssize_t ret = read(in_fd, buf.data() + pending, buf.size() - pending);
+
+				if (ret < 0 && errno == EINTR)
+					continue;
+				if (ret <= 0)
+					break;
+				data = buf.data();
+				len = pending + static_cast<size_t>(ret);
+				/* Keep a split 16-bit sample for the next read */
+				pending = len % ss;
+				len -= pending;
+			}
+
+			if (ss == 2)
+				ch.process(reinterpret_cast<const uint16_t *>(data), len / 2, out);
+			else
+				ch.process(data, len, out);
+			if (pending)
+				memmove(buf.data(), data + len, pending);
+
+			bool ok = true;
+
+			for (size_t c = 0; c < out.size() && ok; c++)
+				ok = emit(fds[c], out[c], s16, tmp);
+			if (!ok)
+				break;
+		}
+
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		double cpu = cpu_seconds() - cpu0;
+
+		fprintf(stderr, "%llu in, %llu out per channel, %.1f MS/s in, %.2fx realtime, "
+			"%.1f MS/s per core",
+			(unsigned long long)ch.inputs(), (unsigned long long)ch.outputs(),
+			ch.inputs() / secs / 1e6, ch.inputs() / secs / in_rate,
+			(cpu > 0) ? ch.inputs() / cpu / 1e6 : 0.0);
+		if (rd)
+			fprintf(stderr, ", %llu bytes lost", (unsigned long long)lost);
+		fputc('\n', stderr);
+		for (int fd : fds)
+			close(fd);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR recording inspector
+ *
+ * Prints what cx88sdr_record captured, its gaps and configuration
+ * changes, and cuts out a time range through the index.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "cx88sdr/recording.hpp"
+
+using namespace cx88sdr;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] NAME\n"
+		"  -e        list gaps, configuration changes and hardware faults\n"
+		"  -s SECS   cut from SECS after the start of the recording\n"
+		"  -l SECS   cut length (default: to the end)\n"
+		"  -o FILE   write the cut raw samples to FILE, - for stdout\n",
+		prog);
+}
+
+static std::string timestamp(int64_t ns)
+{
+	time_t secs = static_cast<time_t>(ns / 1000000000);
+	char buf[64], out[80];
+	struct tm tm;
+
+	gmtime_r(&secs, &tm);
+	strftime(buf, sizeof(buf), "%F %T", &tm);
+	snprintf(out, sizeof(out), "%s.%06lld", buf, (long long)(ns % 1000000000) / 1000);
+	return out;
+}
+
+static bool write_all(int fd, const void *data, size_t len)
+{
+	const uint8_t *p = static_cast<const uint8_t *>(data);
+
+	while (len) {
+		ssize_t ret = write(fd, p, len);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		p += ret;
+		len -= static_cast<size_t>(ret);
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const char *out_path = nullptr;
+	double start = 0, length = -1;
+	bool list = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "es:l:o:h")) != -1) {
+		switch (opt) {
+		case 'e':
+			list = true;
+			break;
+		case 's':
+			start = atof(optarg);
+			break;
+		case 'l':
+			length = atof(optarg);
+			break;
+		case 'o':
+			out_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		recording rec(argv[optind]);
+		const recording_header &h = rec.header();
+		const recording_ctrl &c = h.ctrl;
+		uint64_t gaps = 0, lost = 0, configs = 0, faults = 0;
+
+		for (const index_record &r : rec.events()) {
+			if (r.type == record_type::gap) {
+				gaps++;
+				lost += static_cast<uint64_t>(r.value);
+			} else if (r.type == record_type::fault) {
+				faults++;
+			} else {
+				configs++;
+			}
+		}
+
+		printf("card:     %s\n", h.bus_info);
+		printf("format:   %s at %.3f Hz (requested %u)\n",
+		       h.sample_size == 2 ? "RU16LE" : "RU8", h.sample_rate, c.freq);
+		printf("controls: gain %u%s, agc_adj3 %u, agc_tip3 %u, input %u, htotal %u,"
+		       " afc_pll %u, input_vsync %u\n",
+		       c.gain, c.gain_6db ? " +6 dB" : "", c.agc_adj3, c.agc_tip3, c.input,
+		       c.htotal, c.afc_pll, c.input_vsync);
+		printf("driver:   irq_pages %u, pos_poll %u us, holdoff %u us, buffer %u bytes\n",
+		       c.irq_pages, c.pos_poll, c.holdoff, c.buffersize);
+		printf("start:    %s UTC\n", timestamp(h.start_ns).c_str());
+		if (rec.samples())
+			printf("end:      %s UTC\n", timestamp(rec.time_of(rec.samples() - 1)).c_str());
+		printf("samples:  %llu (%.3f s)%s\n", (unsigned long long)rec.samples(),
+		       rec.samples() / h.sample_rate, h.count ? "" : ", not closed");
+		printf("index:    %llu records, %llu gaps losing %llu samples, %llu config changes, "
+		       "%llu hardware faults\n",
+		       (unsigned long long)rec.record_count(), (unsigned long long)gaps,
+		       (unsigned long long)lost, (unsigned long long)configs,
+		       (unsigned long long)faults);
+
+		if (list) {
+			for (const index_record &r : rec.events()) {
+				printf("%12llu  %s  ", (unsigned long long)r.sample,
+				       timestamp(r.time_ns).c_str());
+				if (r.type == record_type::gap)
+					printf("gap, %lld samples lost\n", (long long)r.value);
+				else if (r.type == record_type::fault)
+					printf("%s, status 0x%05llx\n", fault_names(r.id).c_str(),
+					       (unsigned long long)r.value);
+				else
+					printf("control 0x%08x = %lld\n", r.id, (long long)r.value);
+			}
+		}
+
+		if (out_path) {
+			int64_t t0 = h.start_ns + static_cast<int64_t>(start * 1e9);
+			uint64_t first = rec.sample_at(t0), last = rec.samples();
+			int fd = STDOUT_FILENO;
+
+			if (length >= 0)
+				last = rec.sample_at(t0 + static_cast<int64_t>(length * 1e9));
+			if (strcmp(out_path, "-") &&
+			    (fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+				throw std::system_error(errno, std::generic_category(), out_path);
+			if (!write_all(fd, rec.data() + first * rec.sample_size(),
+				       (last - first) * rec.sample_size()))
+				throw std::system_error(errno, std::generic_category(), out_path);
+			if (fd != STDOUT_FILENO)
+				close(fd);
+			fprintf(stderr, "samples %llu to %llu, %s to %s\n",
+				(unsigned long long)first, (unsigned long long)last,
+				timestamp(rec.time_of(first)).c_str(),
+				timestamp(rec.time_of(last)).c_str());
+		}
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR recorder
+ *
+ * Records a card to NAME.sigmf-data with SigMF metadata and a timestamp,
+ * gap, configuration change and hardware fault index, see
+ * cx88sdr/recording.hpp. A change
+ * of sample rate or format ends the recording at the change. It can start
+ * from data still in the ring, so a restarted recorder leaves no gap.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <string>
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/device.hpp"
+#include "cx88sdr/recording.hpp"
+
+using namespace cx88sdr;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int)
+{
+	running = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] NAME\n"
+		"  -d DEV    device (default: /dev/swradio0)\n"
+		"  -s SECS   stop after SECS seconds (default: until interrupted)\n"
+		"  -b BYTES  read block size (default: 1048576)\n"
+		"  -i MS     time index interval (default: 100)\n"
+		"  -o        start from the oldest data in the ring\n"
+		"  -p POS    start at stream byte position POS, as printed when a recording ends\n"
+		"  -B SECS   start SECS back in the ring\n"
+		"Writes NAME.sigmf-data, NAME.sigmf-meta and NAME.cx88idx\n",
+		prog);
+}
+
+static int64_t realtime_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev_path = "/dev/swradio0";
+	size_t block_size = 1 << 20;
+	double secs = 0, interval_ms = 100, back = 0;
+	uint64_t start = 0;
+	bool oldest = false, at = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:s:b:i:op:B:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev_path = optarg;
+			break;
+		case 's':
+			secs = atof(optarg);
+			break;
+		case 'b':
+			block_size = strtoul(optarg, nullptr, 0);
+			break;
+		case 'i':
+			interval_ms = atof(optarg);
+			break;
+		case 'o':
+			oldest = true;
+			break;
+		case 'p':
+			start = strtoull(optarg, nullptr, 0);
+			at = true;
+			break;
+		case 'B':
+			back = atof(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1 || !block_size || !(interval_ms > 0)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	try {
+		device dev(dev_path);
+
+		/* Before the reader starts, so no change in the first block is missed */
+		dev.subscribe_config();
+		dev.subscribe_faults();
+
+		if (oldest || at || back > 0) {
+			seek_result r = (at) ? dev.seek(start) : (oldest) ? dev.seek_oldest() :
+					dev.seek_time(realtime_ns() - static_cast<int64_t>(back * 1e9));
+			uint64_t write = dev.pos().write;
+
+			fprintf(stderr, "%s: starting at byte %llu, %.3f s back", dev.path().c_str(),
+				(unsigned long long)r.pos, (write - std::min(r.pos, write)) /
+				(dev.achieved_rate() * dev.sample_size()));
+			if (r.lost)
+				fprintf(stderr, ", %llu bytes already overwritten", (unsigned long long)r.lost);
+			fputc('\n', stderr);
+		}
+
+		reader rd(dev, block_size);
+		recording_writer rec(argv[optind], dev);
+		uint64_t limit = UINT64_MAX, stop = UINT64_MAX, torn = 0, end = rd.position();
+		size_t ss = dev.sample_size();
+		double byte_rate = dev.achieved_rate() * ss;
+		config_change c;
+		fault_event f;
+		uint64_t overflows = 0, faults = 0;
+
+		rec.set_index_interval(std::max<uint64_t>(1, static_cast<uint64_t>(
+			dev.achieved_rate() * interval_ms / 1000)));
+		if (secs > 0)
+			limit = static_cast<uint64_t>(dev.achieved_rate() * secs);
+
+		fprintf(stderr, "%s: %.3f Hz, %zu bit, recording to %s.sigmf-data\n",
+			dev.path().c_str(), dev.achieved_rate(), 8 * ss, argv[optind]);
+
+		while (running && rec.samples() < limit) {
+			block b;
+			uint64_t write;
+			int64_t now;
+
+			if (!rd.next(b, 1000))
+				continue;
+			/* Catching up on older data: when its last sample was taken */
+			write = dev.pos().write;
+			now = realtime_ns() - static_cast<int64_t>(
+				(write - std::min(write, b.pos + b.size)) * 1e9 / byte_rate);
+
+			/* Every change before the end of b is queued by now */
+			while (dev.next_config(c, 0)) {
+				rec.config(c.pos, c.id, c.value);
+				if ((c.id == CX88SDR_CONFIG_RATE || c.id == CX88SDR_CONFIG_FORMAT) &&
+				    c.pos < stop)
+					stop = c.pos;
+			}
+			while (dev.next_fault(f, 0)) {
+				rec.fault(f.pos, f.faults, f.status);
+				faults++;
+				if (f.faults & CX88SDR_FAULT_OVERFLOW)
+					overflows++;
+			}
+
+			size_t len = b.size;
+
+			if (b.pos >= stop)
+				break;
+			len = static_cast<size_t>(std::min<uint64_t>(len, stop - b.pos));
+			len = static_cast<size_t>(std::min<uint64_t>(len, (limit - rec.samples()) * ss));
+			rec.write(b.data, len, b.pos, now);
+			end = b.pos + len;
+			if (!rd.valid(b))
+				torn++;
+		}
+		rec.close();
+
+		fprintf(stderr, "%llu samples, %llu gaps, %llu samples lost",
+			(unsigned long long)rec.samples(), (unsigned long long)rec.gaps(),
+			(unsigned long long)rec.lost());
+		if (stop != UINT64_MAX)
+			fprintf(stderr, ", stopped by a rate or format change");
+		fprintf(stderr, ", next byte %llu\n", (unsigned long long)end);
+		if (faults)
+			fprintf(stderr, "warning: %llu hardware faults, %llu FIFO overflows losing samples "
+				"on the PCI bus, see cx88sdr_recinfo -e\n", (unsigned long long)faults,
+				(unsigned long long)overflows);
+		if (torn)
+			fprintf(stderr, "warning: %llu blocks overwritten by DMA while being written, "
+				"use a smaller -b\n", (unsigned long long)torn);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
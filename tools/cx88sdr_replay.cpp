@@ -0,0 +1,248 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR recording player
+ *
+ * Plays a recording, or a raw RU8/RU16LE capture, into a replay card
+ * (cx88_sdr replay=N), where any client reads it as if it came from a
+ * card. The card takes the recording's format, rate and controls, and
+ * every configuration change at the sample it was recorded at; gaps are
+ * closed up. The driver paces write() at the sample rate times the -x
+ * speed.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cx88sdr/device.hpp"
+#include "cx88sdr/recording.hpp"
+
+using namespace cx88sdr;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int)
+{
+	running = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] NAME\n"
+		"  -d DEV    replay card (default: the first one)\n"
+		"  -i        NAME is a raw capture file, not a recording\n"
+		"  -f FMT    ru8 or ru16le, raw input only (default: ru8)\n"
+		"  -r RATE   sample rate in Hz, raw input only (default: 28800000)\n"
+		"  -x PCT    pace in percent of the sample rate, 0 = as fast as possible (default: 100)\n"
+		"  -s SECS   start SECS into the input\n"
+		"  -l N      play N times, 0 = until interrupted (default: 1)\n",
+		prog);
+}
+
+static std::system_error sys_error(const std::string &what)
+{
+	return std::system_error(errno, std::generic_category(), what);
+}
+
+/* Everything a client could read back, as it was when recording started */
+static void apply_ctrl(device &dev, const recording_ctrl &c)
+{
+	dev.set_format((c.pixelformat == V4L2_SDR_FMT_RU16LE) ? format::ru16le : format::ru8);
+	dev.set_sample_rate(c.freq);
+	dev.set_gain(static_cast<int>(c.gain));
+	dev.set_gain_6db(c.gain_6db);
+	dev.set_gain2(static_cast<int>(c.agc_adj3));
+	dev.set_dc_offset(static_cast<int>(c.agc_tip3));
+	dev.set_input(static_cast<int>(c.input));
+	dev.set_afc_pll(c.afc_pll);
+	dev.set_input_vsync(c.input_vsync);
+	dev.set_htotal(static_cast<int>(c.htotal));
+	dev.set_holdoff(static_cast<int>(c.holdoff));
+}
+
+static void apply_change(device &dev, const index_record &r)
+{
+	try {
+		if (r.id == CX88SDR_CONFIG_RATE)
+			dev.set_sample_rate(static_cast<uint32_t>(r.value));
+		else if (r.id == CX88SDR_CONFIG_FORMAT)
+			dev.set_format(static_cast<format>(r.value));
+		else
+			dev.set_control(r.id, static_cast<int32_t>(r.value));
+	} catch (const std::exception &e) {
+		fprintf(stderr, "warning: sample %llu: %s\n", (unsigned long long)r.sample, e.what());
+	}
+}
+
+static void write_all(int fd, const uint8_t *p, size_t n)
+{
+	while (n && running) {
+		ssize_t ret = write(fd, p, n);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			throw sys_error("write");
+		p += ret;
+		n -= static_cast<size_t>(ret);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	std::string dev_path;
+	format fmt = format::ru8;
+	uint32_t rate = 28800000;
+	double start = 0;
+	bool raw = false;
+	int speed = 100, loops = 1, opt;
+
+	while ((opt = getopt(argc, argv, "d:if:r:x:s:l:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev_path = optarg;
+			break;
+		case 'i':
+			raw = true;
+			break;
+		case 'f':
+			fmt = strcmp(optarg, "ru16le") ? format::ru8 : format::ru16le;
+			break;
+		case 'r':
+			rate = static_cast<uint32_t>(atol(optarg));
+			break;
+		case 'x':
+			speed = atoi(optarg);
+			break;
+		case 's':
+			start = atof(optarg);
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1 || speed < 0 || loops < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	try {
+		std::unique_ptr<recording> rec;
+		std::vector<index_record> changes;
+		const uint8_t *data;
+		void *map = nullptr;
+		uint64_t samples, first, written = 0;
+		size_t ss, map_len = 0;
+		double sample_rate;
+
+		if (dev_path.empty()) {
+			std::vector<std::string> nodes = device::enumerate_replay();
+
+			if (nodes.empty())
+				throw std::runtime_error("no replay card, load cx88_sdr with replay=1");
+			dev_path = nodes[0];
+		}
+		device dev(dev_path);
+
+		if (!dev.replay())
+			throw std::runtime_error(dev_path + " is not a replay card");
+
+		if (raw) {
+			struct stat st;
+			int fd = open(argv[optind], O_RDONLY | O_CLOEXEC);
+
+			if (fd < 0 || fstat(fd, &st) < 0)
+				throw sys_error(argv[optind]);
+			map_len = static_cast<size_t>(st.st_size);
+			map = map_len ? mmap(nullptr, map_len, PROT_READ, MAP_SHARED, fd, 0) : nullptr;
+			::close(fd);
+			if (map == MAP_FAILED)
+				throw sys_error(argv[optind]);
+			dev.set_format(fmt);
+			dev.set_sample_rate(rate);
+			data = static_cast<const uint8_t *>(map);
+			ss = dev.sample_size();
+			samples = map_len / ss;
+		} else {
+			rec = std::make_unique<recording>(argv[optind]);
+			apply_ctrl(dev, rec->header().ctrl);
+			for (const index_record &r : rec->events())
+				if (r.type == record_type::config)
+					changes.push_back(r);
+			data = rec->data();
+			ss = rec->sample_size();
+			samples = rec->samples();
+		}
+		dev.set_control(V4L2_CID_CX88SDR_REPLAY_SPEED, speed);
+		sample_rate = dev.achieved_rate();
+		first = std::min<uint64_t>(samples, static_cast<uint64_t>(start * sample_rate));
+
+		int out = open(dev_path.c_str(), O_WRONLY | O_CLOEXEC);
+		if (out < 0)
+			throw sys_error(dev_path);
+
+		fprintf(stderr, "%s: %llu samples (%.3f s) at %.3f Hz, %d%% speed\n", dev_path.c_str(),
+			(unsigned long long)(samples - first), (samples - first) / sample_rate,
+			sample_rate, speed);
+
+		auto t0 = std::chrono::steady_clock::now();
+
+		for (int pass = 0; running && (!loops || pass < loops); pass++) {
+			uint64_t s = first;
+			size_t next = 0;
+
+			/* A later pass starts where the recording did */
+			if (pass && rec)
+				apply_ctrl(dev, rec->header().ctrl);
+			while (next < changes.size() && changes[next].sample <= s)
+				apply_change(dev, changes[next++]);
+
+			while (running && s < samples) {
+				uint64_t end = std::min<uint64_t>(samples, s + (1 << 20) / ss);
+
+				if (next < changes.size())
+					end = std::min<uint64_t>(end, changes[next].sample);
+				write_all(out, data + s * ss, (end - s) * ss);
+				written += end - s;
+				s = end;
+				while (next < changes.size() && changes[next].sample <= s)
+					apply_change(dev, changes[next++]);
+			}
+		}
+		::close(out);
+		if (map)
+			munmap(map, map_len);
+
+		double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+		fprintf(stderr, "%llu samples in %.3f s, %.2fx realtime\n", (unsigned long long)written,
+			wall, (wall > 0) ? written / wall / sample_rate : 0.0);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR streaming resampler
+ *
+ * Resamples a live card or a raw RU8/RU16LE capture from the exact ADC
+ * rate to any output rate, writing real float32 or int16 samples.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/device.hpp"
+#include "cx88sdr/resampler.hpp"
+
+using namespace cx88sdr;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int)
+{
+	running = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s -o RATE [options]\n"
+		"  -d DEV    capture live from a card\n"
+		"  -i FILE   raw capture, - for stdin (default)\n"
+		"  -f FMT    ru8 or ru16le, file input only (default: ru8)\n"
+		"  -r RATE   input rate, file input only (default: achieved rate of 28.8M)\n"
+		"  -o RATE   output rate, Hz with optional k/M suffix, or Nfsc (N x NTSC fsc)\n"
+		"  -q QUAL   fast, normal or high (default: normal)\n"
+		"  -t N      worker threads, 0 = one per CPU (default: 1)\n"
+		"  -F FMT    output f32 or s16 (default: f32)\n"
+		"  -w FILE   output file (default: stdout)\n",
+		prog);
+}
+
+/* "40M", "14318181.818", "4fsc" */
+static double parse_rate(const char *s)
+{
+	char *end;
+	double v = strtod(s, &end);
+
+	if (!strcmp(end, "fsc"))
+		return v * 315e6 / 88;
+	if (*end == 'k' || *end == 'K')
+		return v * 1e3;
+	if (*end == 'M' || *end == 'm')
+		return v * 1e6;
+	return v;
+}
+
+static bool write_all(int fd, const void *data, size_t len)
+{
+	const uint8_t *p = static_cast<const uint8_t *>(data);
+
+	while (len) {
+		ssize_t ret = write(fd, p, len);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		p += ret;
+		len -= static_cast<size_t>(ret);
+	}
+	return true;
+}
+
+static bool emit(int fd, std::vector<float> &out, bool s16, std::vector<int16_t> &tmp)
+{
+	bool ok;
+
+	if (s16) {
+		tmp.resize(out.size());
+		for (size_t i = 0; i < out.size(); i++)
+			tmp[i] = static_cast<int16_t>(std::lrint(std::min(std::max(out[i] * 32768.0f,
+								-32768.0f), 32767.0f)));
+		ok = write_all(fd, tmp.data(), tmp.size() * sizeof(int16_t));
+	} else {
+		ok = write_all(fd, out.data(), out.size() * sizeof(float));
+	}
+	out.clear();
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev_path = nullptr, *in_path = "-", *out_path = nullptr;
+	format fmt = format::ru8;
+	resampler_options opts;
+	bool s16 = false;
+	int opt;
+
+	opts.in_rate = 0;
+	while ((opt = getopt(argc, argv, "d:i:f:r:o:q:t:F:w:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev_path = optarg;
+			break;
+		case 'i':
+			in_path = optarg;
+			break;
+		case 'f':
+			fmt = strcmp(optarg, "ru16le") ? format::ru8 : format::ru16le;
+			break;
+		case 'r':
+			opts.in_rate = parse_rate(optarg);
+			break;
+		case 'o':
+			opts.out_rate = parse_rate(optarg);
+			break;
+		case 'q':
+			if (!strcmp(optarg, "fast")) {
+				opts.taps = 16;
+				opts.atten_db = 60;
+			} else if (!strcmp(optarg, "high")) {
+				opts.taps = 64;
+				opts.atten_db = 100;
+				opts.bandwidth = 0.95;
+			}
+			break;
+		case 't':
+			opts.threads = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'F':
+			s16 = !strcmp(optarg, "s16");
+			break;
+		case 'w':
+			out_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!(opts.out_rate > 0)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	try {
+		std::unique_ptr<device> dev;
+		std::unique_ptr<reader> rd;
+		std::vector<uint8_t> buf(1 << 20);
+		std::vector<float> out;
+		std::vector<int16_t> tmp;
+		int in_fd = STDIN_FILENO, out_fd = STDOUT_FILENO;
+		uint64_t lost = 0;
+		size_t pending = 0;
+
+		if (dev_path) {
+			dev = std::make_unique<device>(dev_path);
+			fmt = dev->get_format();
+			opts.in_rate = dev->achieved_rate();
+			rd = std::make_unique<reader>(*dev, buf.size());
+		} else {
+			if (!(opts.in_rate > 0))
+				opts.in_rate = device::achieved_rate(28800000, fmt);
+			if (strcmp(in_path, "-") && (in_fd = open(in_path, O_RDONLY | O_CLOEXEC)) < 0)
+				throw std::system_error(errno, std::generic_category(), in_path);
+		}
+		if (out_path && (out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+						0644)) < 0)
+			throw std::system_error(errno, std::generic_category(), out_path);
+
+		resampler rs(opts);
+		size_t ss = (fmt == format::ru16le) ? 2 : 1;
+		auto t0 = std::chrono::steady_clock::now();
+
+		fprintf(stderr, "%.3f Hz -> %.3f Hz, %u taps\n", opts.in_rate, opts.out_rate,
+			rs.taps());
+
+		while (running) {
+			const uint8_t *data;
+			size_t len;
+
+			if (rd) {
+				block b;
+
+				if (!rd->next(b, 1000))
+					continue;
+				lost += b.lost;
+				data = b.data;
+				len = b.size;
+			} else {
+				ssize_t ret = read(in_fd, buf.data() + pending, buf.size() - pending);
+
+				if (ret < 0 && errno == EINTR)
+					continue;
+				if (ret <= 0)
+					break;
+				data = buf.data();
+				len = pending + static_cast<size_t>(ret);
+				/* Keep a split 16-bit sample for the next read */
+				pending = len % ss;
+				len -= pending;
+			}
+
+			if (ss == 2)
+				rs.process(reinterpret_cast<const uint16_t *>(data), len / 2, out);
+			else
+				rs.process(data, len, out);
+			if (pending)
+				memmove(buf.data(), data + len, pending);
+			if (!emit(out_fd, out, s16, tmp))
+				break;
+		}
+
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+		fprintf(stderr, "%llu in, %llu out, %.1f MS/s in, %.2fx realtime",
+			(unsigned long long)rs.inputs(), (unsigned long long)rs.outputs(),
+			rs.inputs() / secs / 1e6, rs.inputs() / secs / opts.in_rate);
+		if (rd)
+			fprintf(stderr, ", %llu bytes lost", (unsigned long long)lost);
+		fputc('\n', stderr);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR spectrogram inspector
+ *
+ * Prints what cx88sdr_spectrogram logged, and cuts out a time range
+ * through the index, as an 8-bit PGM image (a row per line, a column per
+ * bin, the codes as grey levels) or as CSV in dB.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <getopt.h>
+
+#include "cx88sdr/spectrogram.hpp"
+
+using namespace cx88sdr;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] NAME\n"
+		"  -s SECS   cut from SECS after the start of the log\n"
+		"  -l SECS   cut length (default: to the end)\n"
+		"  -b A-B    cut bins A to B (default: all)\n"
+		"  -o FILE   write the cut to FILE, - for stdout\n"
+		"  -F FMT    pgm, or csv: time, then dB per bin (default: pgm)\n",
+		prog);
+}
+
+static std::string timestamp(int64_t ns)
+{
+	time_t secs = static_cast<time_t>(ns / 1000000000);
+	char buf[64], out[80];
+	struct tm tm;
+
+	gmtime_r(&secs, &tm);
+	strftime(buf, sizeof(buf), "%F %T", &tm);
+	snprintf(out, sizeof(out), "%s.%06lld", buf, (long long)(ns % 1000000000) / 1000);
+	return out;
+}
+
+int main(int argc, char **argv)
+{
+	const char *out_path = nullptr;
+	double start = 0, length = -1;
+	unsigned long lo = 0, hi = ~0UL;
+	bool csv = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:l:b:o:F:h")) != -1) {
+		switch (opt) {
+		case 's':
+			start = atof(optarg);
+			break;
+		case 'l':
+			length = atof(optarg);
+			break;
+		case 'b': {
+			char *end;
+
+			lo = hi = strtoul(optarg, &end, 0);
+			if (*end == '-')
+				hi = strtoul(end + 1, nullptr, 0);
+			break;
+		}
+		case 'o':
+			out_path = optarg;
+			break;
+		case 'F':
+			csv = !strcmp(optarg, "csv");
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1 || lo > hi) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		spectrogram spg(argv[optind]);
+		const spectrogram_header &h = spg.header();
+		const spectrogram_block *blk = spg.blocks();
+		uint64_t n = spg.block_count(), bytes = n ? blk[n - 1].offset + blk[n - 1].size : 0;
+
+		printf("card:     %s\n", h.bus_info[0] ? h.bus_info : "(file)");
+		printf("input:    %.3f Hz, FFT %u, %u bins of %.3f Hz\n",
+		       h.sample_rate, h.fft_size, h.bins, spg.bin_hz());
+		printf("lines:    %llu, %u frames (%.3f s) each%s\n", (unsigned long long)spg.lines(),
+		       h.average, spg.line_ns() / 1e9, h.count ? "" : ", not closed");
+		printf("levels:   %.2f to %.2f dBFS in steps of %.3f dB\n",
+		       h.db_min, spg.db(255), h.db_step);
+		if (n) {
+			printf("start:    %s UTC\n", timestamp(blk[0].first_ns).c_str());
+			printf("end:      %s UTC\n", timestamp(blk[n - 1].last_ns + spg.line_ns()).c_str());
+		}
+		printf("storage:  %llu blocks, %llu bytes, %.2f bits per bin\n",
+		       (unsigned long long)n, (unsigned long long)bytes,
+		       spg.lines() ? 8.0 * bytes / (spg.lines() * h.bins) : 0.0);
+
+		if (out_path) {
+			int64_t t0 = (n ? blk[0].first_ns : 0) + static_cast<int64_t>(start * 1e9);
+			int64_t t1 = (length >= 0) ? t0 + static_cast<int64_t>(length * 1e9) : INT64_MAX;
+			std::vector<uint8_t> codes;
+			std::vector<spectrogram_line> meta;
+			size_t lines = spg.read(t0, t1, codes, meta);
+			unsigned long last = std::min<unsigned long>(hi, h.bins - 1);
+			FILE *f = stdout;
+
+			if (lo > last)
+				throw std::runtime_error("bins out of range");
+			if (strcmp(out_path, "-") && !(f = fopen(out_path, "wb")))
+				throw std::system_error(errno, std::generic_category(), out_path);
+			if (!csv)
+				fprintf(f, "P5\n%lu %zu\n255\n", last - lo + 1, lines);
+			for (size_t l = 0; l < lines; l++) {
+				const uint8_t *q = &codes[l * h.bins];
+
+				if (!csv) {
+					fwrite(q + lo, 1, last - lo + 1, f);
+					continue;
+				}
+				fprintf(f, "%s", timestamp(meta[l].time_ns).c_str());
+				for (unsigned long k = lo; k <= last; k++)
+					fprintf(f, ",%.3f", spg.db(q[k]));
+				fputc('\n', f);
+			}
+			if (ferror(f) || (f != stdout && fclose(f)))
+				throw std::system_error(errno, std::generic_category(), out_path);
+			fprintf(stderr, "%zu lines, bins %lu to %lu (%.3f to %.3f Hz)", lines, lo, last,
+				lo * spg.bin_hz(), last * spg.bin_hz());
+			if (lines)
+				fprintf(stderr, ", %s to %s", timestamp(meta[0].time_ns).c_str(),
+					timestamp(meta[lines - 1].time_ns).c_str());
+			fputc('\n', stderr);
+		}
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
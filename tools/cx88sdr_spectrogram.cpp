@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR spectrogram logger
+ *
+ * Logs averaged power spectra of a card, or of a raw RU8/RU16LE capture,
+ * to NAME.cx88spg and NAME.cx88spgidx, see cx88sdr/spectrogram.hpp. Meant
+ * to run unattended: a few bytes per bin and line instead of the raw
+ * samples. A change of sample rate or format ends the log at the change.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/device.hpp"
+#include "cx88sdr/spectrogram.hpp"
+
+using namespace cx88sdr;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int)
+{
+	running = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options] NAME\n"
+		"  -d DEV    capture live from a card (default: /dev/swradio0)\n"
+		"  -i FILE   raw capture instead, - for stdin\n"
+		"  -f FMT    ru8 or ru16le, file input only (default: ru8)\n"
+		"  -r RATE   input rate in Hz, file input only (default: achieved rate of 28.8M)\n"
+		"  -n N      FFT size, power of two, bins are N/2 (default: 4096)\n"
+		"  -I SECS   integration per line (default: 1)\n"
+		"  -a N      frames per line instead of -I\n"
+		"  -L DB     level of the lowest code (default: -150)\n"
+		"  -S DB     dB per code (default: 0.625)\n"
+		"  -B N      lines per compressed block (default: 64)\n"
+		"  -t N      worker threads, 0 = one per CPU (default: 1)\n"
+		"  -s SECS   stop after SECS seconds of input (default: until interrupted)\n"
+		"Writes NAME.cx88spg and NAME.cx88spgidx\n",
+		prog);
+}
+
+static int64_t realtime_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static double cpu_seconds()
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+	       (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev_path = "/dev/swradio0", *in_path = nullptr;
+	format fmt = format::ru8;
+	spectrum_options opts;
+	spectrogram_options sopts;
+	double integration = 1, secs = 0;
+	int opt;
+
+	opts.average = 0;
+	while ((opt = getopt(argc, argv, "d:i:f:r:n:I:a:L:S:B:t:s:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev_path = optarg;
+			break;
+		case 'i':
+			in_path = optarg;
+			break;
+		case 'f':
+			fmt = strcmp(optarg, "ru16le") ? format::ru8 : format::ru16le;
+			break;
+		case 'r':
+			opts.in_rate = atof(optarg);
+			break;
+		case 'n':
+			opts.fft_size = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'I':
+			integration = atof(optarg);
+			break;
+		case 'a':
+			opts.average = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'L':
+			sopts.db_min = static_cast<float>(atof(optarg));
+			break;
+		case 'S':
+			sopts.db_step = static_cast<float>(atof(optarg));
+			break;
+		case 'B':
+			sopts.block_lines = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 't':
+			opts.threads = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 's':
+			secs = atof(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1 || !(integration > 0)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	try {
+		std::unique_ptr<device> dev;
+		std::unique_ptr<reader> rd;
+		std::vector<uint8_t> buf(1 << 20);
+		std::vector<float> out;
+		std::vector<uint64_t> starts;
+		recording_ctrl ctrl = {};
+		std::string bus_info;
+		int in_fd = STDIN_FILENO;
+		uint64_t limit = UINT64_MAX, stop = UINT64_MAX, expect = 0, gaps = 0, torn = 0;
+		int64_t file_t0 = 0;
+		size_t pending = 0;
+
+		if (!in_path) {
+			dev = std::make_unique<device>(dev_path);
+			fmt = dev->get_format();
+			opts.in_rate = dev->achieved_rate();
+			ctrl = recording_ctrl::from(*dev);
+			bus_info = dev->bus_info();
+			/* Before the reader starts, so no change in the first block is missed */
+			dev->subscribe_config();
+			rd = std::make_unique<reader>(*dev, buf.size());
+			expect = rd->position();
+		} else {
+			if (!(opts.in_rate > 0))
+				opts.in_rate = device::achieved_rate(28800000, fmt);
+			if (strcmp(in_path, "-") && (in_fd = open(in_path, O_RDONLY | O_CLOEXEC)) < 0)
+				throw std::system_error(errno, std::generic_category(), in_path);
+			/* File lines are timed from now, as if captured live */
+			file_t0 = realtime_ns();
+		}
+		if (!opts.average)
+			opts.average = std::max(1U, static_cast<unsigned int>(std::lround(
+				integration * opts.in_rate / (opts.fft_size / 2))));
+
+		spectrum_analyzer an(opts);
+		spectrogram_writer log(argv[optind], an, sopts, ctrl, bus_info);
+		size_t ss = (fmt == format::ru16le) ? 2 : 1;
+
+		if (secs > 0)
+			limit = static_cast<uint64_t>(secs * opts.in_rate);
+
+		fprintf(stderr, "%.3f Hz, %u bins of %.3f Hz, %u frames (%.3f s) per line, %u threads\n",
+			opts.in_rate, an.bins(), opts.in_rate / an.fft_size(), an.average(),
+			an.line_samples() / opts.in_rate,
+			opts.threads ? opts.threads : std::max(1U, std::thread::hardware_concurrency()));
+
+		auto t0 = std::chrono::steady_clock::now();
+		double cpu0 = cpu_seconds();
+
+		while (running && an.inputs() < limit) {
+			const uint8_t *data;
+			uint64_t global;
+			int64_t now = 0;
+			size_t len;
+			block b;
+
+			if (rd) {
+				config_change c;
+
+				if (!rd->next(b, 1000))
+					continue;
+				now = realtime_ns();
+				while (dev->next_config(c, 0)) {
+					if ((c.id == CX88SDR_CONFIG_RATE || c.id == CX88SDR_CONFIG_FORMAT) &&
+					    c.pos < stop)
+						stop = c.pos;
+				}
+				if (b.pos >= stop)
+					break;
+				/* Lost data: the line in progress would mix both sides of the gap */
+				if (b.pos != expect) {
+					an.reset();
+					gaps++;
+				}
+				data = b.data;
+				len = static_cast<size_t>(std::min<uint64_t>(b.size, stop - b.pos));
+				len -= len % ss;
+				expect = b.pos + b.size;
+				global = b.pos / ss;
+			} else {
+				ssize_t ret = read(in_fd, buf.data() + pending, buf.size() - pending);
+
+				if (ret < 0 && errno == EINTR)
+					continue;
+				if (ret <= 0)
+					break;
+				data = buf.data();
+				len = pending + static_cast<size_t>(ret);
+				/* Keep a split 16-bit sample for the next read */
+				pending = len % ss;
+				len -= pending;
+				global = an.inputs();
+			}
+
+			uint64_t before = an.inputs();
+			size_t n = len / ss;
+
+			n = static_cast<size_t>(std::min<uint64_t>(n, limit - before));
+			out.clear();
+			starts.clear();
+			if (ss == 2)
+				an.process(reinterpret_cast<const uint16_t *>(data), n, out, starts);
+			else
+				an.process(data, n, out, starts);
+			if (rd && !rd->valid(b))
+				torn++;
+			if (pending)
+				memmove(buf.data(), data + len, pending);
+
+			for (size_t l = 0; l < starts.size(); l++) {
+				/* Lines never span a gap, positions count on from this block */
+				uint64_t g = global + starts[l] - before;
+				int64_t t = rd ? now - std::llround((an.inputs() - starts[l]) * 1e9 / opts.in_rate)
+					       : file_t0 + std::llround(starts[l] * 1e9 / opts.in_rate);
+
+				log.add(&out[l * an.bins()], t, g);
+			}
+		}
+		log.close();
+
+		double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		double cpu = cpu_seconds() - cpu0;
+
+		fprintf(stderr, "%llu lines, %llu bytes, %.2f bits per bin, %.2fx realtime, "
+			"%.1f MS/s per core",
+			(unsigned long long)log.lines(), (unsigned long long)log.bytes(),
+			log.lines() ? 8.0 * log.bytes() / (log.lines() * an.bins()) : 0.0,
+			an.inputs() / wall / opts.in_rate,
+			(cpu > 0) ? an.inputs() / cpu / 1e6 : 0.0);
+		if (gaps)
+			fprintf(stderr, ", %llu gaps", (unsigned long long)gaps);
+		if (stop != UINT64_MAX)
+			fprintf(stderr, ", stopped by a rate or format change");
+		fputc('\n', stderr);
+		if (torn)
+			fprintf(stderr, "warning: %llu blocks overwritten by DMA while being processed\n",
+				(unsigned long long)torn);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
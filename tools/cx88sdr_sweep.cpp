@@ -0,0 +1,470 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR ENOB/SFDR sweep
+ *
+ * Steps a card through every combination of format, sample rate, gain,
+ * Gain +6dB, Gain 2 and DC offset asked for, captures a reference tone at
+ * each point once the change has settled, and writes a CSV row of SNR,
+ * THD, SINAD, ENOB, SFDR and clip rate per point, see cx88sdr/tone.hpp.
+ * The card's settings are put back at the end. A raw capture can be
+ * measured the same way for a single row.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/device.hpp"
+#include "cx88sdr/tone.hpp"
+
+using namespace cx88sdr;
+
+/* The driver's bands, RU16LE runs the ADC at twice the sample rate */
+static constexpr double adc_min = 12672000, adc_max = 36480000;
+/* Captures that lose samples are taken again, this many times */
+static constexpr unsigned int max_retries = 8;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int)
+{
+	running = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -d DEV    card to sweep (default: /dev/swradio0)\n"
+		"  -i FILE   measure a raw capture instead, as the first -f format and -r rate\n"
+		"  -f LIST   formats, ru8,ru16le (default: both)\n"
+		"  -r LIST   sample rates in Hz, e.g. 14318181,28636363 (default: -R across the band)\n"
+		"  -R N      rates spread evenly across each format's band (default: 5)\n"
+		"  -g LIST   gains, e.g. 0,8,16-20 (default: as set)\n"
+		"  -6 LIST   Gain +6dB, 0,1 (default: both)\n"
+		"  -2 LIST   Gain 2 (default: as set)\n"
+		"  -c LIST   DC offsets (default: as set)\n"
+		"  -T HZ     tone frequency at the input (default: the highest bin)\n"
+		"  -k N      harmonics counted in THD (default: 5)\n"
+		"  -N N      FFT size, power of two (default: 65536)\n"
+		"  -a N      spectra averaged per point (default: 32)\n"
+		"  -w MS     wait after a change has settled (default: 100)\n"
+		"  -t N      worker threads, 0 = one per CPU (default: 0)\n"
+		"  -o FILE   write the table to FILE (default: stdout)\n",
+		prog);
+}
+
+/* "3,5,10-20" */
+static std::vector<int> parse_list(const char *s)
+{
+	std::vector<int> list;
+
+	while (*s) {
+		char *end;
+		long a = strtol(s, &end, 0), b = a;
+
+		if (*end == '-')
+			b = strtol(end + 1, &end, 0);
+		for (long k = a; k <= b; k++)
+			list.push_back(static_cast<int>(k));
+		s = (*end == ',') ? end + 1 : end;
+		if (*end && *end != ',')
+			break;
+	}
+	return list;
+}
+
+static std::vector<double> parse_rates(const char *s)
+{
+	std::vector<double> list;
+
+	while (*s) {
+		char *end;
+		double r = strtod(s, &end);
+
+		if (end == s)
+			break;
+		list.push_back(r);
+		s = (*end == ',') ? end + 1 : end;
+	}
+	return list;
+}
+
+static std::vector<format> parse_formats(const char *s)
+{
+	std::vector<format> list;
+	std::string str(s);
+	size_t at = 0;
+
+	while (at <= str.size()) {
+		size_t comma = std::min(str.find(',', at), str.size());
+		std::string name = str.substr(at, comma - at);
+
+		if (name == "ru8")
+			list.push_back(format::ru8);
+		else if (name == "ru16le")
+			list.push_back(format::ru16le);
+		else
+			throw std::invalid_argument("unknown format " + name);
+		at = comma + 1;
+	}
+	return list;
+}
+
+static const char *format_name(format fmt)
+{
+	return (fmt == format::ru16le) ? "ru16le" : "ru8";
+}
+
+/* Settings of one sweep point, -1 for a control left alone */
+struct point {
+	format		fmt;
+	double		rate;
+	int		gain, gain_6db, gain2, dc_offset;
+};
+
+static void print_header(FILE *f)
+{
+	fprintf(f, "card,format,rate_hz,gain,gain_6db,gain2,dc_offset,frames,tone_hz,tone_dbfs,"
+		"noise_dbfs,snr_db,thd_db,sinad_db,enob,enob_fs,sfdr_dbc,spur_hz,clip_rate,retries\n");
+}
+
+static void print_control(FILE *f, int val)
+{
+	if (val >= 0)
+		fprintf(f, ",%d", val);
+	else
+		fputc(',', f);
+}
+
+static void print_row(FILE *f, const std::string &card, const point &p, const tone_result &r,
+		      unsigned int retries)
+{
+	fprintf(f, "%s,%s,%.3f", card.c_str(), format_name(p.fmt), p.rate);
+	print_control(f, p.gain);
+	print_control(f, p.gain_6db);
+	print_control(f, p.gain2);
+	print_control(f, p.dc_offset);
+	fprintf(f, ",%llu,%.3f,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f,%.3f,%.2f,%.3f,%.3e,%u\n",
+		(unsigned long long)r.frames, r.tone_hz, r.tone_dbfs, r.noise_dbfs, r.snr_db,
+		r.thd_db, r.sinad_db, r.enob, r.enob_fs, r.sfdr_db, r.spur_hz, r.clip_rate, retries);
+	fflush(f);
+}
+
+/*
+ * Capture bytes past the hold-off of every change made since the last call,
+ * plus wait_ms, in one piece. Returns the captures lost to overruns.
+ */
+static unsigned int capture(device &dev, std::vector<uint8_t> &buf, unsigned int wait_ms)
+{
+	uint64_t settled = dev.pos().write, bps;
+	unsigned int retries = 0;
+	config_change c;
+
+	/* The driver queues the markers before the control calls return */
+	while (dev.next_config(c, 0))
+		settled = std::max(settled, c.settled);
+	bps = static_cast<uint64_t>(dev.achieved_rate() * dev.sample_size());
+	dev.wait(settled + bps * wait_ms / 1000, 2000 + wait_ms);
+
+	reader rd(dev, 1 << 20);
+	uint64_t expect = rd.position();
+	size_t got = 0;
+	block b;
+
+	while (running && got < buf.size()) {
+		if (!rd.next(b, 1000))
+			throw std::runtime_error(dev.path() + ": no samples");
+
+		size_t len = std::min(b.size, buf.size() - got);
+		bool whole = b.pos == expect && !b.lost;
+
+		memcpy(buf.data() + got, b.data, len);
+		whole = whole && rd.valid(b);
+		expect = b.pos + b.size;
+		if (whole) {
+			got += len;
+			continue;
+		}
+		if (++retries > max_retries)
+			throw std::runtime_error(dev.path() + ": keeps losing samples");
+		got = 0;
+	}
+	return retries;
+}
+
+static tone_result analyze(tone_analyzer &an, const std::vector<uint8_t> &buf, format fmt)
+{
+	if (fmt == format::ru16le)
+		return an.analyze(reinterpret_cast<const uint16_t *>(buf.data()), buf.size() / 2);
+	return an.analyze(buf.data(), buf.size());
+}
+
+static void read_file(const char *path, std::vector<uint8_t> &buf)
+{
+	int fd = STDIN_FILENO;
+	size_t got = 0;
+
+	if (strcmp(path, "-") && (fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		throw std::system_error(errno, std::generic_category(), path);
+	while (got < buf.size()) {
+		ssize_t ret = read(fd, buf.data() + got, buf.size() - got);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			throw std::system_error(errno, std::generic_category(), path);
+		if (!ret)
+			break;
+		got += static_cast<size_t>(ret);
+	}
+	if (fd != STDIN_FILENO)
+		close(fd);
+	buf.resize(got);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev_path = "/dev/swradio0", *in_path = nullptr, *out_path = nullptr;
+	std::vector<format> formats = { format::ru8, format::ru16le };
+	std::vector<double> rates;
+	std::vector<int> gains = { -1 }, gains_6db = { 0, 1 }, gains2 = { -1 }, dc_offsets = { -1 };
+	unsigned int spread = 5, average = 32, wait_ms = 100;
+	tone_options opts;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:i:f:r:R:g:6:2:c:T:k:N:a:w:t:o:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev_path = optarg;
+			break;
+		case 'i':
+			in_path = optarg;
+			break;
+		case 'f':
+			try {
+				formats = parse_formats(optarg);
+			} catch (const std::exception &e) {
+				fprintf(stderr, "%s\n", e.what());
+				return 1;
+			}
+			break;
+		case 'r':
+			rates = parse_rates(optarg);
+			break;
+		case 'R':
+			spread = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'g':
+			gains = parse_list(optarg);
+			break;
+		case '6':
+			gains_6db = parse_list(optarg);
+			break;
+		case '2':
+			gains2 = parse_list(optarg);
+			break;
+		case 'c':
+			dc_offsets = parse_list(optarg);
+			break;
+		case 'T':
+			opts.tone_hz = atof(optarg);
+			break;
+		case 'k':
+			opts.harmonics = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'N':
+			opts.fft_size = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'a':
+			average = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'w':
+			wait_ms = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 't':
+			opts.threads = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'o':
+			out_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc || formats.empty() || !spread || !average || gains.empty() ||
+	    gains_6db.empty() || gains2.empty() || dc_offsets.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	FILE *out = stdout;
+
+	if (out_path && !(out = fopen(out_path, "w"))) {
+		perror(out_path);
+		return 1;
+	}
+
+	try {
+		size_t samples = static_cast<size_t>(opts.fft_size) * average;
+		std::vector<uint8_t> buf;
+
+		print_header(out);
+
+		if (in_path) {
+			point p = { formats[0], rates.empty() ? device::achieved_rate(28800000, formats[0])
+							       : rates[0], -1, -1, -1, -1 };
+
+			buf.resize(samples * ((p.fmt == format::ru16le) ? 2 : 1));
+			read_file(in_path, buf);
+			opts.in_rate = p.rate;
+
+			tone_analyzer an(opts);
+
+			print_row(out, "(file)", p, analyze(an, buf, p.fmt), 0);
+			return (out != stdout && fclose(out)) ? 1 : 0;
+		}
+
+		device dev(dev_path);
+		std::string card = dev.bus_info();
+		/* Put back at the end */
+		format fmt0 = dev.get_format();
+		uint32_t rate0 = dev.sample_rate();
+		int32_t gain0 = dev.control(V4L2_CID_GAIN);
+		int32_t gain_6db0 = dev.control(V4L2_CID_CX88SDR_GAIN_6DB);
+		int32_t gain20 = dev.control(V4L2_CID_CX88SDR_AGC_ADJ3);
+		int32_t dc0 = dev.control(V4L2_CID_CX88SDR_AGC_TIP3);
+		std::vector<std::pair<point, tone_result>> rows;
+		unsigned int failed = 0;
+
+		dev.subscribe_config();
+
+		for (format fmt : formats) {
+			double div = (fmt == format::ru16le) ? 2 : 1;
+			double lo = adc_min / div, hi = adc_max / div;
+			std::vector<double> list = rates;
+
+			if (list.empty()) {
+				for (unsigned int i = 0; i < spread; i++)
+					list.push_back((spread > 1) ? lo + (hi - lo) * i / (spread - 1) : (lo + hi) / 2);
+			}
+			try {
+				dev.set_format(fmt);
+			} catch (const std::exception &e) {
+				fprintf(stderr, "%s, skipping %s\n", e.what(), format_name(fmt));
+				failed++;
+				continue;
+			}
+			buf.resize(samples * dev.sample_size());
+
+			std::vector<point> points;
+
+			for (double rate : list) {
+				if (rate < lo || rate > hi) {
+					fprintf(stderr, "%.0f Hz is outside the %s band, skipped\n", rate,
+						format_name(fmt));
+					continue;
+				}
+				for (int gain : gains)
+					for (int gain_6db : gains_6db)
+						for (int gain2 : gains2)
+							for (int dc : dc_offsets)
+								points.push_back({ fmt, rate, gain, gain_6db,
+										   gain2, dc });
+			}
+
+			for (point p : points) {
+				if (!running)
+					break;
+				try {
+					dev.set_sample_rate(static_cast<uint32_t>(p.rate));
+					if (p.gain >= 0)
+						dev.set_gain(p.gain);
+					if (p.gain_6db >= 0)
+						dev.set_gain_6db(p.gain_6db);
+					if (p.gain2 >= 0)
+						dev.set_gain2(p.gain2);
+					if (p.dc_offset >= 0)
+						dev.set_dc_offset(p.dc_offset);
+					/* What the card really runs at, for the table */
+					p.rate = dev.achieved_rate();
+					p.gain = dev.control(V4L2_CID_GAIN);
+					p.gain_6db = dev.control(V4L2_CID_CX88SDR_GAIN_6DB);
+					p.gain2 = dev.control(V4L2_CID_CX88SDR_AGC_ADJ3);
+					p.dc_offset = dev.control(V4L2_CID_CX88SDR_AGC_TIP3);
+					opts.in_rate = p.rate;
+
+					unsigned int retries = capture(dev, buf, wait_ms);
+
+					if (!running)
+						break;
+
+					tone_analyzer an(opts);
+					tone_result r = analyze(an, buf, fmt);
+
+					print_row(out, card, p, r, retries);
+					rows.push_back({ p, r });
+				} catch (const std::exception &e) {
+					fprintf(stderr, "%s, point skipped\n", e.what());
+					failed++;
+				}
+			}
+		}
+
+		try {
+			dev.set_format(fmt0);
+			dev.set_sample_rate(rate0);
+			dev.set_gain(gain0);
+			dev.set_gain_6db(gain_6db0);
+			dev.set_gain2(gain20);
+			dev.set_dc_offset(dc0);
+		} catch (const std::exception &e) {
+			fprintf(stderr, "%s, settings not restored\n", e.what());
+		}
+
+		/* The best unclipped point of each format */
+		for (format fmt : formats) {
+			const std::pair<point, tone_result> *best = nullptr;
+
+			for (const auto &row : rows) {
+				if (row.first.fmt != fmt || row.second.clip_rate > 0)
+					continue;
+				if (!best || row.second.enob > best->second.enob)
+					best = &row;
+			}
+			if (!best)
+				continue;
+			fprintf(stderr, "best %s: %.3f Hz, gain %d, +6dB %d, gain2 %d, DC offset %d: "
+				"ENOB %.2f, SFDR %.1f dBc\n", format_name(fmt), best->first.rate,
+				best->first.gain, best->first.gain_6db, best->first.gain2,
+				best->first.dc_offset, best->second.enob, best->second.sfdr_db);
+		}
+		if (failed)
+			fprintf(stderr, "warning: %u points failed\n", failed);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	if (out != stdout && fclose(out)) {
+		perror(out_path);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CX2388x SDR time-base corrector
+ *
+ * Captures composite video from a card in a raw video mode (or reads a raw
+ * RU8/RU16LE capture), locks to its sync and writes time-base corrected
+ * 8-bit frames, raw or as a YUV4MPEG2 stream for ffmpeg/ffplay/mpv.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "cx88sdr/capture.hpp"
+#include "cx88sdr/device.hpp"
+#include "cx88sdr/tbc.hpp"
+
+using namespace cx88sdr;
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int)
+{
+	running = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -d DEV    capture live from a card, sets its Mode control\n"
+		"  -k        keep the card's Mode and rate as they are\n"
+		"  -i FILE   raw capture, - for stdin (default)\n"
+		"  -f FMT    ru8 or ru16le, file input only (default: ru8)\n"
+		"  -r RATE   input rate in Hz, file input only (default: achieved\n"
+		"            rate of the raw video mode)\n"
+		"  -s STD    ntsc or pal (default: ntsc)\n"
+		"  -W N      output pixels per line (default: 910 NTSC, 1135 PAL)\n"
+		"  -w        weave the fields, top field on the even rows\n"
+		"  -y        write a YUV4MPEG2 stream instead of raw frames\n"
+		"  -t N      worker threads, 0 = one per CPU (default: 0)\n"
+		"  -o FILE   output file (default: stdout)\n",
+		prog);
+}
+
+static double cpu_seconds()
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+	       (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static bool write_all(int fd, const void *data, size_t len)
+{
+	const uint8_t *p = static_cast<const uint8_t *>(data);
+
+	while (len) {
+		ssize_t ret = write(fd, p, len);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		p += ret;
+		len -= static_cast<size_t>(ret);
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev_path = nullptr, *in_path = "-", *out_path = nullptr;
+	format fmt = format::ru8;
+	tbc_options opts;
+	double in_rate = 0;
+	bool keep = false, y4m = false;
+	int opt;
+
+	opts.threads = 0;
+	while ((opt = getopt(argc, argv, "d:ki:f:r:s:W:wyt:o:h")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev_path = optarg;
+			break;
+		case 'k':
+			keep = true;
+			break;
+		case 'i':
+			in_path = optarg;
+			break;
+		case 'f':
+			fmt = strcmp(optarg, "ru16le") ? format::ru8 : format::ru16le;
+			break;
+		case 'r':
+			in_rate = atof(optarg);
+			break;
+		case 's':
+			opts.standard = strcmp(optarg, "pal") ? video_standard::ntsc : video_standard::pal;
+			break;
+		case 'W':
+			opts.width = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'w':
+			opts.weave = true;
+			break;
+		case 'y':
+			y4m = true;
+			break;
+		case 't':
+			opts.threads = static_cast<unsigned int>(atoi(optarg));
+			break;
+		case 'o':
+			out_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	try {
+		bool pal = opts.standard == video_standard::pal;
+		std::unique_ptr<device> dev;
+		std::unique_ptr<reader> rd;
+		std::vector<uint8_t> buf(1 << 20), frames;
+		int in_fd = STDIN_FILENO, out_fd = STDOUT_FILENO;
+		uint64_t lost = 0, inputs = 0;
+		size_t pending = 0;
+
+		if (dev_path) {
+			dev = std::make_unique<device>(dev_path);
+			if (!keep)
+				dev->set_mode(pal ? CX88SDR_MODE_PAL : CX88SDR_MODE_NTSC);
+			fmt = dev->get_format();
+			in_rate = dev->achieved_rate();
+			rd = std::make_unique<reader>(*dev, buf.size());
+		} else {
+			/* The rates the Mode presets set */
+			if (!(in_rate > 0))
+				in_rate = device::achieved_rate(pal ? 1135 * 625 * 50 : 910 * 525 * 60, fmt);
+			if (strcmp(in_path, "-") && (in_fd = open(in_path, O_RDONLY | O_CLOEXEC)) < 0)
+				throw std::system_error(errno, std::generic_category(), in_path);
+		}
+		if (out_path && (out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+					       0644)) < 0)
+			throw std::system_error(errno, std::generic_category(), out_path);
+
+		opts.in_rate = in_rate;
+		tbc t(opts);
+		size_t ss = (fmt == format::ru16le) ? 2 : 1;
+
+		fprintf(stderr, "%s at %.3f Hz, %ux%u frames, %u threads\n", pal ? "PAL" : "NTSC",
+			in_rate, t.width(), t.height(),
+			opts.threads ? opts.threads : std::max(1U, std::thread::hardware_concurrency()));
+
+		if (y4m) {
+			char hdr[128];
+			int len = snprintf(hdr, sizeof(hdr), "YUV4MPEG2 W%u H%u F%u:%u I%c A1:1 Cmono\n",
+					   t.width(), t.height(), t.rate_num(), t.rate_den(),
+					   opts.weave ? 't' : 'p');
+
+			if (!write_all(out_fd, hdr, static_cast<size_t>(len)))
+				throw std::system_error(errno, std::generic_category(), "write");
+		}
+
+		auto t0 = std::chrono::steady_clock::now();
+		double cpu0 = cpu_seconds();
+
+		while (running) {
+			const uint8_t *data;
+			size_t len, n;
+
+			if (rd) {
+				block b;
+
+				if (!rd->next(b, 1000))
+					continue;
+				lost += b.lost;
+				data = b.data;
+				len = b.size;
+			} else {
+				ssize_t ret = read(in_fd, buf.data() + pending, buf.size() - pending);
+
+				if (ret < 0 && errno == EINTR)
+					continue;
+				if (ret <= 0)
+					break;
+				data = buf.data();
+				len = pending + static_cast<size_t>(ret);
+				/* Keep a split 16-bit sample for the next read */
+				pending = len % ss;
+				len -= pending;
+			}
+
+			inputs += len / ss;
+			if (ss == 2)
+				n = t.process(reinterpret_cast<const uint16_t *>(data), len / 2, frames);
+			else
+				n = t.process(data, len, frames);
+			if (pending)
+				memmove(buf.data(), data + len, pending);
+
+			bool ok = true;
+
+			for (size_t k = 0; k < n && ok; k++) {
+				if (y4m)
+					ok = write_all(out_fd, "FRAME\n", 6);
+				ok = ok && write_all(out_fd, frames.data() + k * t.frame_size(), t.frame_size());
+			}
+			frames.clear();
+			if (!ok)
+				break;
+		}
+
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		double cpu = cpu_seconds() - cpu0;
+		const tbc_stats &st = t.stats();
+
+		fprintf(stderr, "%llu frames, %llu dropped, %llu lines, %llu flywheeled, %llu lock losses, "
+			"sync %.1f blank %.1f, %.2fx realtime, %.1f MS/s per core",
+			(unsigned long long)st.frames, (unsigned long long)st.dropped,
+			(unsigned long long)st.lines, (unsigned long long)st.flywheel,
+			(unsigned long long)st.relocks, t.sync_level(), t.blank_level(),
+			inputs / secs / in_rate, (cpu > 0) ? inputs / cpu / 1e6 : 0.0);
+		if (rd)
+			fprintf(stderr, ", %llu bytes lost", (unsigned long long)lost);
+		fputc('\n', stderr);
+		if (out_fd != STDOUT_FILENO)
+			close(out_fd);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}